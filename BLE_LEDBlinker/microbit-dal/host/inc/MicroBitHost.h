@@ -0,0 +1,380 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Entry points for host native builds of the micro:bit runtime.
+  */
+
+#ifndef MICROBIT_HOST_H
+#define MICROBIT_HOST_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+// Size of the micro:bit heap created by host_main(), in bytes.
+#ifndef HOST_HEAP_SIZE
+#define HOST_HEAP_SIZE                          (256*1024)
+#endif
+
+/**
+  * Brings up a host native micro:bit runtime, and runs the given function on the system stack,
+  * as the main fiber would be on a device.
+  *
+  * A micro:bit heap of HOST_HEAP_SIZE bytes is created before the function is called, and
+  * the function may go on to call scheduler_init() as usual.
+  *
+  * @param entry_fn The function to run.
+  *
+  * @return The value returned by entry_fn.
+  */
+int host_main(int (*entry_fn)(void));
+
+/**
+  * A peripheral event, scheduled on the virtual clock. Used by the simulated peripherals behind nrf51.h.
+  *
+  * Unlike a Ticker, the handler runs as soon as the event falls due, even if interrupts are masked or
+  * a handler is running, as it models the hardware rather than the processor. Handlers typically set
+  * an event register, and raise the peripheral's interrupt with host_irq_raise().
+  */
+struct HostEvent
+{
+    void (*handler)(void *context);
+    void *context;
+    uint64_t deadline;
+    int scheduled;
+    HostEvent *next;
+};
+
+/**
+  * Schedules the given event, replacing any previous schedule.
+  *
+  * @param e The event to schedule. Its handler and context must be set.
+  *
+  * @param delay The number of microseconds from now at which the event occurs.
+  */
+void host_event_schedule(HostEvent &e, uint64_t delay);
+
+/**
+  * Cancels the given event, if it is scheduled.
+  *
+  * @param e The event to cancel.
+  */
+void host_event_cancel(HostEvent &e);
+
+/**
+  * Marks the given peripheral interrupt as pending. Its handler is run once the calling event handler
+  * has returned, as soon as the interrupt is enabled in the NVIC and the processor can take it.
+  *
+  * @param irq The interrupt to raise.
+  */
+void host_irq_raise(IRQn_Type irq);
+
+/**
+  * Sets the level of an input pin, as read by DigitalIn. Used by simulated devices to drive their interrupt lines.
+  *
+  * @param pin The pin to drive.
+  *
+  * @param value The level to drive it to, 0 or 1.
+  */
+void host_pin_write(PinName pin, int value);
+
+/**
+  * Determines the level of the given pin.
+  *
+  * @param pin The pin to read.
+  *
+  * @return The level last given to host_pin_write(), or 0 if the pin has never been driven.
+  */
+int host_pin_read(PinName pin);
+
+/**
+  * Determines the levels driven onto the GPIO port by DigitalOut and PortOut.
+  *
+  * @return The level of each output, a bit per pin.
+  */
+uint32_t host_gpio_read();
+
+/**
+  * Sets a function to be called whenever the processor writes to the GPIO port's outputs.
+  *
+  * @param handler The function to call, or NULL. It is given the levels of all outputs after the write.
+  */
+void host_gpio_on_write(void (*handler)(uint32_t outputs));
+
+/**
+  * A simulated I2C slave, presenting a file of 8 bit registers.
+  *
+  * The first byte written in each transaction selects a register, and each byte then read or written
+  * moves on to the next, as is usual for sensors. Devices attached to the bus are reached both by the
+  * TWI peripheral, and by the blocking mbed I2C interface.
+  */
+class HostI2CDevice
+{
+    public:
+
+    uint8_t address;                            // 8-bit I2C slave address [ addr | 0 ].
+    uint8_t pointer;                            // The register selected by the last transaction.
+    uint8_t registers[256];
+    HostI2CDevice *next;
+
+    /**
+      * Constructor. Attaches the device to the simulated bus.
+      *
+      * @param address 8-bit I2C slave address [ addr | 0 ].
+      */
+    HostI2CDevice(uint8_t address);
+
+    /**
+      * Destructor. Detaches the device from the bus.
+      */
+    virtual ~HostI2CDevice();
+
+    /**
+      * Reads a register. By default, returns the contents of the register file.
+      *
+      * @param reg The register to read.
+      */
+    virtual uint8_t read(uint8_t reg);
+
+    /**
+      * Writes a register. By default, updates the register file.
+      *
+      * @param reg The register to write.
+      *
+      * @param value The value written.
+      */
+    virtual void write(uint8_t reg, uint8_t value);
+};
+
+/**
+  * Counters kept by the simulated I2C bus.
+  */
+struct HostI2CStatistics
+{
+    uint32_t transactions;                      // The number of START conditions issued.
+    uint32_t bytes;                             // The number of bytes transferred, including addresses.
+    uint32_t errors;                            // The number of bytes not acknowledged.
+    uint64_t busyTime;                          // Microseconds the bus has spent transferring bytes.
+};
+
+/**
+  * Reads the simulated I2C bus' counters.
+  *
+  * @param s The structure to fill in.
+  */
+void host_i2c_statistics(HostI2CStatistics &s);
+
+/**
+  * Causes the given number of bytes sent from now on to be not acknowledged, to exercise error recovery.
+  *
+  * @param count The number of bytes to fail.
+  */
+void host_i2c_fail(int count);
+
+/**
+  * A simulated MMA8653 accelerometer, at 0x3A with its INT1 line on P0_28 as fitted to the micro:bit.
+  *
+  * Whilst active, a sample is taken at the output data rate selected by CTRL_REG1. This sets ZYXDR in
+  * the STATUS register, along with ZYXOW if the previous sample was never read, and drives INT1 low if the
+  * data ready interrupt is enabled and routed to it. Reading OUT_Z_MSB, the last of the most significant
+  * bytes, clears them all again.
+  */
+class HostMMA8653 : public HostI2CDevice
+{
+    public:
+
+    int16_t x, y, z;                            // The acceleration to report, in counts of the 10 bit output.
+    uint32_t samples;                           // The number of samples taken.
+    uint32_t overwritten;                       // The number of samples replaced before they were read.
+    HostEvent event;                            // The next sample.
+
+    /**
+      * Constructor. Attaches the device to the simulated bus, in standby.
+      */
+    HostMMA8653();
+
+    /**
+      * Destructor. Detaches the device from the bus.
+      */
+    virtual ~HostMMA8653();
+
+    /**
+      * Called as each sample is taken, before it is latched into the output registers.
+      * By default, does nothing, so that x, y and z are reported unchanged.
+      */
+    virtual void sample();
+
+    virtual uint8_t read(uint8_t reg);
+
+    virtual void write(uint8_t reg, uint8_t value);
+};
+
+/**
+  * A simulated MAG3110 magnetometer, at 0x1D with its INT1 line on P0_29 as fitted to the micro:bit.
+  *
+  * Whilst active, a sample is taken at the output data rate selected by the DR and OS fields of CTRL_REG1.
+  * This sets ZYXDR in DR_STATUS, along with ZYXOW if the previous sample was never read, and drives INT1 high.
+  * Reading OUT_X_MSB clears them all again.
+  */
+class HostMAG3110 : public HostI2CDevice
+{
+    public:
+
+    int16_t x, y, z;                            // The field to report, in counts of 0.1 micro teslas.
+    uint32_t samples;                           // The number of samples taken.
+    HostEvent event;                            // The next sample.
+
+    /**
+      * Constructor. Attaches the device to the simulated bus, in standby.
+      */
+    HostMAG3110();
+
+    /**
+      * Destructor. Detaches the device from the bus.
+      */
+    virtual ~HostMAG3110();
+
+    /**
+      * Called as each sample is taken, before it is latched into the output registers.
+      * By default, does nothing, so that x, y and z are reported unchanged.
+      */
+    virtual void sample();
+
+    virtual uint8_t read(uint8_t reg);
+
+    virtual void write(uint8_t reg, uint8_t value);
+};
+
+// Size of the simulated flash, of which the runtime's storage pages are the highest but 17 and 19.
+#define HOST_FLASH_PAGES                        20
+#define HOST_FLASH_PAGE_SIZE                    1024
+
+// Time taken by the nrf51 to erase a page, and to write a word, in microseconds.
+#define HOST_FLASH_ERASE_TIME                   22300
+#define HOST_FLASH_WRITE_TIME                   46
+
+/**
+  * Counters kept by the simulated flash.
+  */
+struct HostFlashStatistics
+{
+    uint32_t erases;                            // The number of pages erased.
+    uint32_t bytesWritten;                      // The number of bytes changed by writes.
+    uint32_t violations;                        // The number of writes that attempted to set a cleared bit, which NOR flash cannot do.
+    uint32_t maxErases;                         // The most times any one page has been erased.
+    uint64_t busyTime;                          // Microseconds the flash would have spent erasing and writing.
+};
+
+/**
+  * Reads the simulated flash's counters.
+  *
+  * @param s The structure to fill in.
+  */
+void host_flash_statistics(HostFlashStatistics &s);
+
+/**
+  * Erases the whole of the simulated flash, without counting wear, as if freshly programmed.
+  */
+void host_flash_format();
+
+/**
+  * Counters kept by the simulated radio.
+  */
+struct HostRadioStatistics
+{
+    uint32_t transmitted;                       // The number of packets sent.
+    uint32_t received;                          // The number of injected packets delivered to the processor.
+    uint32_t missed;                            // The number of injected packets that arrived whilst the receiver was not listening.
+    uint64_t airTime;                           // Microseconds spent transmitting.
+};
+
+/**
+  * Reads the simulated radio's counters.
+  *
+  * @param s The structure to fill in.
+  */
+void host_radio_statistics(HostRadioStatistics &s);
+
+/**
+  * Sets a function to be called with each packet transmitted by the radio, at the end of its transmission.
+  *
+  * @param handler The function to call, or NULL. It is given the packet as held in memory: a length byte,
+  *                followed by that many bytes of payload.
+  */
+void host_radio_on_transmit(void (*handler)(const uint8_t *packet));
+
+/**
+  * Starts the reception of a packet from another device. The packet is written to memory at the end of
+  * its air time, and only if the receiver was listening (started) when it began.
+  *
+  * @param packet A length byte, followed by that many bytes of payload.
+  *
+  * @param rssi The signal strength to report, as a positive number of -dBm.
+  *
+  * @return 1 if the receiver is listening for the packet, 0 if it will be missed.
+  */
+int host_radio_inject(const uint8_t *packet, uint8_t rssi);
+
+/**
+  * Counters kept by the simulated UART.
+  */
+struct HostUARTStatistics
+{
+    uint32_t transmitted;                       // The number of bytes sent.
+    uint32_t received;                          // The number of bytes placed in the receive FIFO.
+    uint32_t overruns;                          // The number of bytes lost as they arrived whilst the receive FIFO was full.
+};
+
+/**
+  * Reads the simulated UART's counters.
+  *
+  * @param s The structure to fill in.
+  */
+void host_uart_statistics(HostUARTStatistics &s);
+
+/**
+  * Connects the simulated UART's transmit line to its receive line, or disconnects it.
+  *
+  * @param enable 1 to receive every byte sent, as it finishes being sent, or 0 to disconnect the lines.
+  */
+void host_uart_loopback(int enable);
+
+/**
+  * Sets a function to be called with each byte sent by the UART, as it finishes being sent.
+  *
+  * @param handler The function to call, or NULL. It is not called for bytes that are looped back.
+  */
+void host_uart_on_transmit(void (*handler)(uint8_t c));
+
+/**
+  * Delivers a byte to the UART's receive line, as if it had just arrived from another device.
+  *
+  * @param c The byte received.
+  *
+  * @return 1 if the byte was placed in the receive FIFO, 0 if it was lost as the FIFO was full.
+  */
+int host_uart_inject(uint8_t c);
+
+#endif
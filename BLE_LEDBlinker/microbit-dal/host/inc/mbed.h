@@ -0,0 +1,650 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A minimal stand in for the parts of the mbed HAL used by the portable parts of the micro:bit runtime,
+  * allowing them to be built and run natively on a Linux host.
+  *
+  * Time is virtual: it only advances when the runtime waits (wait_us, wait_ms, __WFE), or when a test
+  * calls host_clock_advance(). Ticker and Timeout callbacks are run as simulated interrupts at their
+  * exact deadlines, so a given test always observes the same sequence of events.
+  *
+  * The runtime stores pointers in uint32_t in several places, so host builds must be linked as a
+  * non position independent executable, keeping code, static data and the native heap below 4GB.
+  */
+
+#ifndef MICROBIT_HOST_MBED_H
+#define MICROBIT_HOST_MBED_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "nrf51.h"
+
+// Space pushed onto the stack by swap_context() and save_context() beyond that used by their caller.
+// Reported stack depths include this, so that a fiber's stack buffer is always large enough to be paged out.
+#define HOST_CONTEXT_FRAME_SIZE                 64
+
+// Size of the (shared) system stack that fibers are paged onto and off of.
+#ifndef HOST_STACK_SIZE
+#define HOST_STACK_SIZE                         (64*1024)
+#endif
+
+// Top of the system stack, in place of the top of SRAM.
+extern uint32_t host_stack_base;
+#define CORTEX_M0_STACK_BASE                    host_stack_base
+
+/**
+  * Simulated CPU state.
+  */
+extern volatile int host_irq_masked;            // Nonzero between __disable_irq() and __enable_irq().
+extern volatile int host_irq_pending;           // Nonzero if a timer fell due whilst interrupts were masked.
+extern volatile int host_irq_active;            // Nonzero whilst a timer callback (simulated interrupt) is running.
+
+/**
+  * Runs any timer callbacks that are due at the current virtual time.
+  * Does nothing if interrupts are masked; the callbacks are instead run by the next __enable_irq().
+  */
+void host_clock_dispatch();
+
+/**
+  * Advances virtual time by the given number of microseconds, running any timer callbacks that
+  * fall due at their exact deadlines.
+  *
+  * @param us The number of microseconds to advance by.
+  */
+void host_clock_advance(uint64_t us);
+
+/**
+  * Advances virtual time to the next timer deadline, and runs the callbacks due at that time.
+  * This is the host equivalent of sleeping until the next interrupt.
+  *
+  * @return 1 if a timer was run, or 0 if no timers are active (i.e. the processor would sleep forever).
+  */
+int host_clock_next();
+
+/**
+  * Determines the current virtual time.
+  *
+  * @return The number of microseconds of virtual time since the host was started.
+  */
+uint64_t host_clock_now();
+
+inline void __disable_irq()
+{
+    host_irq_masked = 1;
+}
+
+inline void __enable_irq()
+{
+    host_irq_masked = 0;
+
+    if (host_irq_pending)
+        host_clock_dispatch();
+}
+
+inline uint32_t __get_PRIMASK()
+{
+    return host_irq_masked;
+}
+
+inline uint32_t __get_IPSR()
+{
+    return host_irq_active;
+}
+
+__attribute__((always_inline)) inline uint32_t __get_MSP()
+{
+    uintptr_t sp;
+
+    __asm__ volatile ("mov %%rsp, %0" : "=r" (sp));
+
+    return (uint32_t) (sp - HOST_CONTEXT_FRAME_SIZE);
+}
+
+inline void __WFE()
+{
+    if (!host_clock_next())
+    {
+        fprintf(stderr, "host: processor halted with no timers active\n");
+        abort();
+    }
+}
+
+inline void __WFI()
+{
+    __WFE();
+}
+
+inline void __SEV()
+{
+}
+
+inline void __NOP()
+{
+}
+
+inline void wait_us(int us)
+{
+    host_clock_advance(us);
+}
+
+inline void wait_ms(int ms)
+{
+    host_clock_advance((uint64_t) ms * 1000);
+}
+
+inline void wait(float s)
+{
+    host_clock_advance((uint64_t) (s * 1000000.0f));
+}
+
+/**
+  * Pin names, as used by the micro:bit pin maps. Input pins may be driven by simulated devices (see MicroBitHost.h).
+  */
+enum PinName
+{
+    p0, p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15,
+    p16, p17, p18, p19, p20, p21, p22, p23, p24, p25, p26, p27, p28, p29, p30,
+
+    P0_0 = p0, P0_1 = p1, P0_2 = p2, P0_3 = p3, P0_4 = p4, P0_5 = p5, P0_6 = p6, P0_7 = p7,
+    P0_8 = p8, P0_9 = p9, P0_10 = p10, P0_11 = p11, P0_12 = p12, P0_13 = p13, P0_14 = p14, P0_15 = p15,
+    P0_16 = p16, P0_17 = p17, P0_18 = p18, P0_19 = p19, P0_20 = p20, P0_21 = p21, P0_22 = p22, P0_23 = p23,
+    P0_24 = p24, P0_25 = p25, P0_26 = p26, P0_27 = p27, P0_28 = p28, P0_29 = p29, P0_30 = p30,
+
+    I2C_SCL0 = p0,
+    I2C_SDA0 = p30,
+
+    USBTX = p24,
+    USBRX = p25,
+
+    NC = (int) 0xFFFFFFFF
+};
+
+enum PinMode
+{
+    PullNone = 0,
+    PullDown = 1,
+    PullUp = 3
+};
+
+/**
+  * A digital input, reading the level given to the pin by host_pin_write().
+  */
+class DigitalIn
+{
+    PinName pin;
+
+    public:
+
+    DigitalIn(PinName pin, PinMode mode = PullNone) : pin(pin)
+    {
+        (void) mode;
+    }
+
+    void mode(PinMode)
+    {
+    }
+
+    int read();
+
+    operator int()
+    {
+        return read();
+    }
+};
+
+/**
+  * A digital output, driving a bit of the simulated GPIO port (see MicroBitHost.h).
+  */
+class DigitalOut
+{
+    PinName pin;
+
+    public:
+
+    DigitalOut(PinName pin) : pin(pin)
+    {
+    }
+
+    void write(int value);
+
+    int read();
+
+    DigitalOut& operator=(int value)
+    {
+        write(value);
+        return *this;
+    }
+
+    operator int()
+    {
+        return read();
+    }
+};
+
+/**
+  * An analog input. The ADC is not modelled, so every input reads as 0V.
+  */
+class AnalogIn
+{
+    public:
+
+    AnalogIn(PinName pin)
+    {
+        (void) pin;
+    }
+
+    uint16_t read_u16()
+    {
+        return 0;
+    }
+
+    float read()
+    {
+        return 0.0f;
+    }
+};
+
+enum PortName
+{
+    Port0
+};
+
+/**
+  * A group of digital outputs on the simulated GPIO port, written together.
+  */
+class PortOut
+{
+    uint32_t mask;
+
+    public:
+
+    PortOut(PortName port, int mask = 0xFFFFFFFF) : mask(mask)
+    {
+        (void) port;
+    }
+
+    void write(int value);
+
+    int read();
+
+    PortOut& operator=(int value)
+    {
+        write(value);
+        return *this;
+    }
+
+    operator int()
+    {
+        return read();
+    }
+};
+
+/**
+  * A group of digital inputs, reading the levels given to the pins by host_pin_write().
+  */
+class PortIn
+{
+    uint32_t mask;
+
+    public:
+
+    PortIn(PortName port, int mask = 0xFFFFFFFF) : mask(mask)
+    {
+        (void) port;
+    }
+
+    void mode(PinMode)
+    {
+    }
+
+    int read();
+
+    operator int()
+    {
+        return read();
+    }
+};
+
+/**
+  * The mbed TWI driver's state.
+  */
+struct i2c_t
+{
+    NRF_TWI_Type *i2c;
+};
+
+/**
+  * A blocking I2C master, transferring to and from the devices attached to the simulated bus.
+  * Each transfer takes as long as it would at the configured bus frequency.
+  */
+class I2C
+{
+    protected:
+
+    i2c_t _i2c;
+
+    public:
+
+    I2C(PinName sda, PinName scl);
+
+    void frequency(int hz);
+
+    /**
+      * @return 0 on success, or nonzero if the device did not acknowledge.
+      */
+    int read(int address, char *data, int length, bool repeated = false);
+
+    /**
+      * @return 0 on success, or nonzero if the device did not acknowledge.
+      */
+    int write(int address, const char *data, int length, bool repeated = false);
+};
+
+/**
+  * The mbed UART driver's state.
+  */
+struct serial_t
+{
+    PinName tx;
+    PinName rx;
+};
+
+void serial_init(serial_t *obj, PinName tx, PinName rx);
+
+/**
+  * An interrupt driven serial port, on the simulated UART (see MicroBitHost.h). Each byte takes as long
+  * to send as it would at the configured baud rate, and received bytes are held in the UART's six byte FIFO.
+  */
+class SerialBase
+{
+    public:
+
+    enum IrqType
+    {
+        RxIrq = 0,
+        TxIrq
+    };
+
+    // The handlers attached to each interrupt. As for a Ticker, thunk calls an attached member function in place of handler.
+    void (*handler[2])(void);
+    void (*thunk[2])(SerialBase *s, IrqType type);
+    void *object[2];
+    char method[2][2 * sizeof(void *)];
+
+    /**
+      * Calls the member function attached to the given interrupt.
+      */
+    template<typename T>
+    static void call(SerialBase *s, IrqType type)
+    {
+        void (T::*m)();
+
+        memcpy(&m, s->method[type], sizeof(m));
+        (((T *) s->object[type])->*m)();
+    }
+
+    SerialBase(PinName tx, PinName rx);
+
+    void baud(int baudrate);
+
+    int readable();
+
+    int writeable();
+
+    void attach(void (*fn)(void), IrqType type = RxIrq)
+    {
+        handler[type] = fn;
+        thunk[type] = NULL;
+        enable(type, fn != NULL);
+    }
+
+    /**
+      * Attaches a member function to the given interrupt. As with mbed, a NULL object detaches it.
+      */
+    template<typename T>
+    void attach(T *obj, void (T::*m)(), IrqType type = RxIrq)
+    {
+        handler[type] = NULL;
+        thunk[type] = obj != NULL ? &SerialBase::call<T> : NULL;
+        object[type] = obj;
+        memcpy(method[type], &m, sizeof(m));
+        enable(type, obj != NULL);
+    }
+
+    /**
+      * Runs the handler attached to the given interrupt. Called by the simulated UART.
+      */
+    void interrupt(IrqType type);
+
+    protected:
+
+    serial_t _serial;
+
+    /**
+      * Enables or disables the UART interrupt for the given condition, as the handler is attached and detached.
+      */
+    void enable(IrqType type, int on);
+};
+
+/**
+  * A serial port without stdio buffering.
+  */
+class RawSerial : public SerialBase
+{
+    public:
+
+    RawSerial(PinName tx, PinName rx) : SerialBase(tx, rx)
+    {
+    }
+
+    /**
+      * Reads a received byte, waiting for one to arrive if need be.
+      */
+    int getc();
+
+    /**
+      * Sends a byte, waiting for the previous one to be sent if need be.
+      */
+    int putc(int c);
+};
+
+/**
+  * Provides the names of the serial interrupts, as used by the runtime.
+  */
+class Serial : public RawSerial
+{
+    public:
+
+    Serial(PinName tx, PinName rx) : RawSerial(tx, rx)
+    {
+    }
+};
+
+/**
+  * A periodic timer callback, run as a simulated interrupt.
+  */
+class Ticker
+{
+    public:
+
+    // State used by the virtual clock, which keeps attached timers on a list ordered by deadline.
+    void (*handler)(void);
+    void (*thunk)(Ticker *t);                   // If not NULL, calls the member function attached in place of handler.
+    void *object;
+    char method[2 * sizeof(void *)];
+    uint64_t deadline;
+    uint64_t period;
+    Ticker *next;
+
+    /**
+      * Attaches the given callback, due after the given delay and repeating with the given period (or once only if zero).
+      */
+    void insert(void (*fn)(void), void (*thunk)(Ticker *t), uint64_t delay, uint64_t repeat);
+
+    /**
+      * Calls the member function attached to the given timer.
+      */
+    template<typename T>
+    static void call(Ticker *t)
+    {
+        void (T::*m)();
+
+        memcpy(&m, t->method, sizeof(m));
+        (((T *) t->object)->*m)();
+    }
+
+    /**
+      * Records the object and member function to call, ready for insert().
+      */
+    template<typename T>
+    void bind(T *obj, void (T::*m)())
+    {
+        object = obj;
+        memcpy(method, &m, sizeof(m));
+    }
+
+    Ticker();
+
+    virtual ~Ticker();
+
+    void attach(void (*fn)(void), float s)
+    {
+        attach_us(fn, (uint64_t) (s * 1000000.0f));
+    }
+
+    void attach_us(void (*fn)(void), uint64_t us)
+    {
+        insert(fn, NULL, us, us);
+    }
+
+    template<typename T>
+    void attach(T *obj, void (T::*m)(), float s)
+    {
+        attach_us(obj, m, (uint64_t) (s * 1000000.0f));
+    }
+
+    template<typename T>
+    void attach_us(T *obj, void (T::*m)(), uint64_t us)
+    {
+        bind(obj, m);
+        insert(NULL, &Ticker::call<T>, us, us);
+    }
+
+    void detach();
+};
+
+/**
+  * A one shot timer callback, run as a simulated interrupt.
+  */
+class Timeout : public Ticker
+{
+    public:
+
+    void attach(void (*fn)(void), float s)
+    {
+        attach_us(fn, (uint64_t) (s * 1000000.0f));
+    }
+
+    void attach_us(void (*fn)(void), uint64_t us)
+    {
+        insert(fn, NULL, us, 0);
+    }
+
+    template<typename T>
+    void attach(T *obj, void (T::*m)(), float s)
+    {
+        attach_us(obj, m, (uint64_t) (s * 1000000.0f));
+    }
+
+    template<typename T>
+    void attach_us(T *obj, void (T::*m)(), uint64_t us)
+    {
+        bind(obj, m);
+        insert(NULL, &Ticker::call<T>, us, 0);
+    }
+};
+
+/**
+  * A stopwatch, measuring virtual time.
+  */
+class Timer
+{
+    uint64_t started;
+    uint64_t elapsed;
+    int running;
+
+    public:
+
+    Timer() : started(0), elapsed(0), running(0)
+    {
+    }
+
+    void start()
+    {
+        if (!running)
+            started = host_clock_now();
+
+        running = 1;
+    }
+
+    void stop()
+    {
+        elapsed = read_high_resolution_us();
+        running = 0;
+    }
+
+    void reset()
+    {
+        started = host_clock_now();
+        elapsed = 0;
+    }
+
+    uint64_t read_high_resolution_us()
+    {
+        return running ? elapsed + host_clock_now() - started : elapsed;
+    }
+
+    int read_us()
+    {
+        return (int) read_high_resolution_us();
+    }
+
+    int read_ms()
+    {
+        return (int) (read_high_resolution_us() / 1000);
+    }
+
+    float read()
+    {
+        return read_high_resolution_us() / 1000000.0f;
+    }
+};
+
+#endif
@@ -0,0 +1,298 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A minimal stand in for the nrf51 peripheral registers used by the micro:bit runtime's drivers.
+  *
+  * Each register block is backed by a simulated peripheral (see source/HostFlash.cpp, HostRadio.cpp and HostTWI.cpp),
+  * which observes the processor's writes to its tasks and configuration registers, and schedules its events on the
+  * virtual clock. Reading an event register lets a microsecond of virtual time pass, so that code busy waiting on a
+  * peripheral (even with interrupts masked) sees it make progress, as it would on a device.
+  *
+  * Peripheral interrupts are delivered through a simulated NVIC, at the lowest priority, and run before any
+  * Ticker callbacks that fall due at the same time.
+  */
+
+#ifndef MICROBIT_HOST_NRF51_H
+#define MICROBIT_HOST_NRF51_H
+
+#include <stdint.h>
+
+/**
+  * Lets a microsecond of virtual time pass. Called whenever a polled register is read.
+  */
+void host_register_poll();
+
+/**
+  * A peripheral register. Behaves as a volatile uint32_t, but lets the peripheral that owns it observe accesses.
+  * Register blocks are zero initialised, so registers are plain memory until a peripheral attaches to them.
+  *
+  * Peripheral models must access the value field directly, to avoid calling back into themselves.
+  */
+struct HostRegister
+{
+    volatile uint32_t value;
+    void (*onWrite)(HostRegister &r);           // If not NULL, called after each write by the processor.
+    int polled;                                 // Nonzero if reading the register lets time pass.
+
+    operator uint32_t() const
+    {
+        if (polled)
+            host_register_poll();
+
+        return value;
+    }
+
+    HostRegister& operator=(uint32_t v)
+    {
+        value = v;
+
+        if (onWrite)
+            onWrite(*this);
+
+        return *this;
+    }
+
+    HostRegister& operator=(const HostRegister &r)
+    {
+        return *this = (uint32_t) r;
+    }
+};
+
+/**
+  * Interrupt numbers, as on the nrf51.
+  */
+enum IRQn_Type
+{
+    POWER_CLOCK_IRQn = 0,
+    RADIO_IRQn = 1,
+    UART0_IRQn = 2,
+    SPI0_TWI0_IRQn = 3,
+    SPI1_TWI1_IRQn = 4,
+    GPIOTE_IRQn = 6,
+    ADC_IRQn = 7,
+    TIMER0_IRQn = 8,
+    TIMER1_IRQn = 9,
+    TIMER2_IRQn = 10,
+    RTC0_IRQn = 11,
+    TEMP_IRQn = 12,
+    RNG_IRQn = 13
+};
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void NVIC_SystemReset();
+
+/**
+  * Factory information. Describes the simulated flash (see MicroBitHost.h).
+  */
+struct NRF_FICR_Type
+{
+    HostRegister CODEPAGESIZE;
+    HostRegister CODESIZE;
+    HostRegister DEVICEID[2];
+};
+
+/**
+  * Non-volatile memory controller.
+  */
+struct NRF_NVMC_Type
+{
+    HostRegister READY;
+    HostRegister CONFIG;
+    HostRegister ERASEPAGE;
+    HostRegister ERASEALL;
+};
+
+#define NVMC_READY_READY_Busy                   0
+#define NVMC_READY_READY_Ready                  1
+#define NVMC_CONFIG_WEN_Pos                     0
+#define NVMC_CONFIG_WEN_Ren                     0
+#define NVMC_CONFIG_WEN_Wen                     1
+#define NVMC_CONFIG_WEN_Een                     2
+
+/**
+  * Clock control. Only the high frequency clock is modelled, and it starts immediately.
+  */
+struct NRF_CLOCK_Type
+{
+    HostRegister TASKS_HFCLKSTART;
+    HostRegister TASKS_HFCLKSTOP;
+    HostRegister EVENTS_HFCLKSTARTED;
+};
+
+/**
+  * Analog to digital converter. Not modelled: its registers are plain memory.
+  */
+struct NRF_ADC_Type
+{
+    HostRegister ENABLE;
+    HostRegister CONFIG;
+};
+
+/**
+  * 2.4GHz radio.
+  */
+struct NRF_RADIO_Type
+{
+    HostRegister TASKS_TXEN;
+    HostRegister TASKS_RXEN;
+    HostRegister TASKS_START;
+    HostRegister TASKS_STOP;
+    HostRegister TASKS_DISABLE;
+    HostRegister TASKS_RSSISTART;
+    HostRegister TASKS_RSSISTOP;
+    HostRegister EVENTS_READY;
+    HostRegister EVENTS_ADDRESS;
+    HostRegister EVENTS_PAYLOAD;
+    HostRegister EVENTS_END;
+    HostRegister EVENTS_DISABLED;
+    HostRegister SHORTS;
+    HostRegister INTENSET;
+    HostRegister INTENCLR;
+    HostRegister CRCSTATUS;
+    HostRegister RXMATCH;
+    HostRegister RXCRC;
+    HostRegister PACKETPTR;
+    HostRegister FREQUENCY;
+    HostRegister TXPOWER;
+    HostRegister MODE;
+    HostRegister PCNF0;
+    HostRegister PCNF1;
+    HostRegister BASE0;
+    HostRegister BASE1;
+    HostRegister PREFIX0;
+    HostRegister PREFIX1;
+    HostRegister TXADDRESS;
+    HostRegister RXADDRESSES;
+    HostRegister CRCCNF;
+    HostRegister CRCPOLY;
+    HostRegister CRCINIT;
+    HostRegister RSSISAMPLE;
+    HostRegister STATE;
+    HostRegister DATAWHITEIV;
+    HostRegister POWER;
+};
+
+#define RADIO_SHORTS_READY_START_Msk            (1UL << 0)
+#define RADIO_SHORTS_END_DISABLE_Msk            (1UL << 1)
+#define RADIO_SHORTS_DISABLED_TXEN_Msk          (1UL << 2)
+#define RADIO_SHORTS_DISABLED_RXEN_Msk          (1UL << 3)
+#define RADIO_SHORTS_ADDRESS_RSSISTART_Msk      (1UL << 4)
+#define RADIO_SHORTS_END_START_Msk              (1UL << 5)
+#define RADIO_INTENSET_READY_Msk                (1UL << 0)
+#define RADIO_INTENSET_ADDRESS_Msk              (1UL << 1)
+#define RADIO_INTENSET_PAYLOAD_Msk              (1UL << 2)
+#define RADIO_INTENSET_END_Msk                  (1UL << 3)
+#define RADIO_INTENSET_DISABLED_Msk             (1UL << 4)
+#define RADIO_MODE_MODE_Nrf_1Mbit               0
+#define RADIO_MODE_MODE_Nrf_2Mbit               1
+#define RADIO_MODE_MODE_Nrf_250Kbit             2
+#define RADIO_MODE_MODE_Ble_1Mbit               3
+#define RADIO_CRCCNF_LEN_Disabled               0
+#define RADIO_CRCCNF_LEN_One                    1
+#define RADIO_CRCCNF_LEN_Two                    2
+#define RADIO_CRCCNF_LEN_Three                  3
+
+/**
+  * Two wire interface (I2C) master.
+  */
+struct NRF_TWI_Type
+{
+    HostRegister TASKS_STARTRX;
+    HostRegister TASKS_STARTTX;
+    HostRegister TASKS_STOP;
+    HostRegister TASKS_SUSPEND;
+    HostRegister TASKS_RESUME;
+    HostRegister EVENTS_STOPPED;
+    HostRegister EVENTS_RXDREADY;
+    HostRegister EVENTS_TXDSENT;
+    HostRegister EVENTS_ERROR;
+    HostRegister EVENTS_BB;
+    HostRegister EVENTS_SUSPENDED;
+    HostRegister SHORTS;
+    HostRegister INTENSET;
+    HostRegister INTENCLR;
+    HostRegister ERRORSRC;
+    HostRegister ENABLE;
+    HostRegister PSELSCL;
+    HostRegister PSELSDA;
+    HostRegister RXD;
+    HostRegister TXD;
+    HostRegister FREQUENCY;
+    HostRegister ADDRESS;
+    HostRegister POWER;
+};
+
+#define TWI_SHORTS_BB_SUSPEND_Msk               (1UL << 0)
+#define TWI_SHORTS_BB_STOP_Msk                  (1UL << 1)
+#define TWI_INTENSET_STOPPED_Msk                (1UL << 1)
+#define TWI_INTENSET_RXDREADY_Msk               (1UL << 2)
+#define TWI_INTENSET_TXDSENT_Msk                (1UL << 7)
+#define TWI_INTENSET_ERROR_Msk                  (1UL << 9)
+#define TWI_INTENSET_BB_Msk                     (1UL << 14)
+#define TWI_INTENSET_SUSPENDED_Msk              (1UL << 18)
+#define TWI_ERRORSRC_OVERRUN_Msk                (1UL << 0)
+#define TWI_ERRORSRC_ANACK_Msk                  (1UL << 1)
+#define TWI_ERRORSRC_DNACK_Msk                  (1UL << 2)
+#define TWI_ENABLE_ENABLE_Pos                   0
+#define TWI_ENABLE_ENABLE_Disabled              0
+#define TWI_ENABLE_ENABLE_Enabled               5
+#define TWI_FREQUENCY_FREQUENCY_K100            0x01980000UL
+#define TWI_FREQUENCY_FREQUENCY_K250            0x04000000UL
+#define TWI_FREQUENCY_FREQUENCY_K400            0x06680000UL
+
+#define ADC_ENABLE_ENABLE_Disabled              0
+#define ADC_CONFIG_RES_Pos                      0
+#define ADC_CONFIG_RES_8bit                     0
+#define ADC_CONFIG_INPSEL_Pos                   2
+#define ADC_CONFIG_INPSEL_SupplyTwoThirdsPrescaling 6
+#define ADC_CONFIG_REFSEL_Pos                   5
+#define ADC_CONFIG_REFSEL_VBG                   0
+#define ADC_CONFIG_PSEL_Pos                     8
+#define ADC_CONFIG_PSEL_Disabled                0
+#define ADC_CONFIG_EXTREFSEL_Pos                16
+#define ADC_CONFIG_EXTREFSEL_None               0
+
+extern NRF_FICR_Type host_ficr;
+extern NRF_NVMC_Type host_nvmc;
+extern NRF_CLOCK_Type host_clock;
+extern NRF_ADC_Type host_adc;
+extern NRF_RADIO_Type host_radio;
+extern NRF_TWI_Type host_twi[2];
+
+#define NRF_FICR                                (&host_ficr)
+#define NRF_NVMC                                (&host_nvmc)
+#define NRF_CLOCK                               (&host_clock)
+#define NRF_ADC                                 (&host_adc)
+#define NRF_RADIO                               (&host_radio)
+#define NRF_TWI0                                (&host_twi[0])
+#define NRF_TWI1                                (&host_twi[1])
+
+#endif
@@ -0,0 +1,197 @@
+# The MIT License (MIT)
+
+# Copyright (c) 2016 British Broadcasting Corporation.
+# This software is provided by Lancaster University by arrangement with the BBC.
+
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+
+# x86-64 equivalent of CortexContextSwitch.s, for host native builds.
+#
+# The Cortex_M0_TCB layout is unchanged. As on the device, all fibers share one system stack,
+# and are paged on and off of it by copying between stack_base and SP. The differences are:
+#
+# - Callee saved registers (RBX, RBP, R12-R15) are 64 bits wide. swap_context and save_context push them
+#   onto the stack, where they are paged out with the rest of it, and record resume_context as the LR.
+#   save_register_context has no stack to page, so stores them in R0-R11 of the TCB instead.
+#
+# - Contexts built by the scheduler (a new fiber, or the idle fiber) have an LR other than resume_context.
+#   These are entered with R0-R2 passed as the first three arguments, as on the device.
+#
+# - Stack pointers and return addresses are stored in 32 bits, so the host must be linked as a non
+#   position independent executable with its system stack in static memory.
+
+    .text
+    .align 16
+
+# Export our context switching subroutine as a C function for use in the runtime.
+    .global swap_context
+    .global save_context
+    .global save_register_context
+    .global restore_register_context
+
+# RDI Contains a pointer to the TCB of the fibre being scheduled out.
+# RSI Contains a pointer to the TCB of the fibre being scheduled in.
+# EDX Contains a pointer to the base of the stack of the fibre being scheduled out.
+# ECX Contains a pointer to the base of the stack of the fibre being scheduled in.
+swap_context:
+    # Zero extend our stack pointers, as the upper halves of their registers are undefined.
+    mov     %edx, %edx
+    mov     %ecx, %ecx
+
+    # Skip storing our context if we're given a NULL parameter for the TCB.
+    test    %rdi, %rdi
+    jz      store_context_complete
+
+    # Push our callee saved registers, and record the resulting SP and a LR that will pop them again.
+    push    %rbx
+    push    %rbp
+    push    %r12
+    push    %r13
+    push    %r14
+    push    %r15
+    mov     %esp, 52(%rdi)
+    movl    $resume_context, 56(%rdi)
+
+    # Copy the stack, from the fiber's defined stack_base down to SP.
+    # Skip this if we're given a NULL parameter for the stack.
+    test    %rdx, %rdx
+    jz      store_context_complete
+    movl    60(%rdi), %r8d
+
+store_stack:
+    sub     $4, %r8
+    sub     $4, %rdx
+    movl    (%r8), %eax
+    movl    %eax, (%rdx)
+    cmp     %rsp, %r8
+    jne     store_stack
+
+store_context_complete:
+    # Now page in the new context.
+    # n.b. we set the SP before copying the stack in to make comparisons easier.
+    movl    52(%rsi), %eax
+    mov     %rax, %rsp
+
+    # Skip this if we're given a NULL parameter for the stack.
+    test    %rcx, %rcx
+    jz      restore_stack_complete
+    movl    60(%rsi), %r8d
+
+restore_stack:
+    sub     $4, %r8
+    sub     $4, %rcx
+    movl    (%rcx), %eax
+    movl    %eax, (%r8)
+    cmp     %rsp, %r8
+    jne     restore_stack
+
+restore_stack_complete:
+    # If this context was stored by us, pop its registers and return to its caller.
+    movl    56(%rsi), %eax
+    cmpl    $resume_context, %eax
+    je      resume_context
+
+    # Otherwise, enter the function given as the LR with R0-R2 as its parameters,
+    # on a correctly aligned stack with a NULL return address.
+    movl    0(%rsi), %edi
+    movl    8(%rsi), %edx
+    movl    4(%rsi), %esi
+    and     $-16, %rsp
+    push    $0
+    jmp     *%rax
+
+resume_context:
+    pop     %r15
+    pop     %r14
+    pop     %r13
+    pop     %r12
+    pop     %rbp
+    pop     %rbx
+
+    # Return to caller (scheduler).
+    ret
+
+
+# RDI Contains a pointer to the TCB of the fibre to snapshot
+# ESI Contains a pointer to the base of the stack of the fibre being snapshotted
+save_context:
+    mov     %esi, %esi
+
+    # Push our callee saved registers, and record the resulting SP and a LR that will pop them again.
+    push    %rbx
+    push    %rbp
+    push    %r12
+    push    %r13
+    push    %r14
+    push    %r15
+    mov     %esp, 52(%rdi)
+    movl    $resume_context, 56(%rdi)
+
+    # Copy the stack, from the fiber's defined stack_base down to SP.
+    movl    60(%rdi), %r8d
+
+store_stack1:
+    sub     $4, %r8
+    sub     $4, %rsi
+    movl    (%r8), %eax
+    movl    %eax, (%rsi)
+    cmp     %rsp, %r8
+    jne     store_stack1
+
+    # Restore our callee saved registers, and return to caller (scheduler).
+    jmp     resume_context
+
+
+# RDI Contains a pointer to the TCB of the fiber to snapshot
+save_register_context:
+    # Write our callee saved registers into the TCB
+    mov     %rbx, 0(%rdi)
+    mov     %rbp, 8(%rdi)
+    mov     %r12, 16(%rdi)
+    mov     %r13, 24(%rdi)
+    mov     %r14, 32(%rdi)
+    mov     %r15, 40(%rdi)
+
+    # Now the Stack Pointer and Link Register, as they will be once we have returned.
+    lea     8(%rsp), %rax
+    mov     %eax, 52(%rdi)
+    mov     (%rsp), %rax
+    mov     %eax, 56(%rdi)
+
+    # Return to caller (typically the scheduler).
+    ret
+
+
+# RDI Contains a pointer to the TCB of the fiber to restore
+restore_register_context:
+    # Restore the Stack Pointer and callee saved registers
+    movl    52(%rdi), %eax
+    mov     %rax, %rsp
+    mov     0(%rdi), %rbx
+    mov     8(%rdi), %rbp
+    mov     16(%rdi), %r12
+    mov     24(%rdi), %r13
+    mov     32(%rdi), %r14
+    mov     40(%rdi), %r15
+
+    # Return to the caller of save_register_context (normally the scheduler).
+    movl    56(%rdi), %eax
+    jmp     *%rax
+
+    .section .note.GNU-stack,"",@progbits
@@ -0,0 +1,135 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Simulated flash memory, with the nrf51 NVMC used to erase and write it.
+  *
+  * The flash is a static array, described by the FICR as the top of the code region so that the runtime's
+  * storage pages fall within it. Erases and writes complete immediately, but are counted, along with the
+  * time the nrf51 would have spent on them. Writes are checked against the rules for NOR flash:
+  * a write can only clear bits, and only whilst writes are enabled.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHost.h"
+
+NRF_FICR_Type host_ficr;
+NRF_NVMC_Type host_nvmc;
+
+static uint8_t flash[HOST_FLASH_PAGES * HOST_FLASH_PAGE_SIZE] __attribute__((aligned(HOST_FLASH_PAGE_SIZE)));
+
+// The contents of the flash as last left by the NVMC, used to find what has been written since.
+static uint8_t snapshot[HOST_FLASH_PAGES * HOST_FLASH_PAGE_SIZE];
+
+static uint32_t pageErases[HOST_FLASH_PAGES];
+static HostFlashStatistics stats;
+static uint32_t config = NVMC_CONFIG_WEN_Ren;
+
+void host_flash_statistics(HostFlashStatistics &s)
+{
+    s = stats;
+}
+
+void host_flash_format()
+{
+    memset(flash, 0xFF, sizeof(flash));
+    memset(snapshot, 0xFF, sizeof(snapshot));
+}
+
+/**
+  * Counts the words changed since the snapshot was taken, then takes a new one.
+  *
+  * @param enabled Nonzero if writes were enabled, so that any changes are writes, or zero if any change is a violation.
+  */
+static void flash_count_writes(int enabled)
+{
+    uint32_t *now = (uint32_t *) flash;
+    uint32_t *then = (uint32_t *) snapshot;
+
+    for (uint32_t i = 0; i < sizeof(flash) / 4; i++)
+    {
+        if (now[i] == then[i])
+            continue;
+
+        stats.bytesWritten += 4;
+        stats.busyTime += HOST_FLASH_WRITE_TIME;
+
+        if (!enabled || (now[i] & ~then[i]))
+            stats.violations++;
+    }
+
+    memcpy(snapshot, flash, sizeof(flash));
+}
+
+static void nvmc_config(HostRegister &r)
+{
+    uint32_t mode = (r.value >> NVMC_CONFIG_WEN_Pos) & 3;
+
+    if (mode != config)
+        flash_count_writes(config == NVMC_CONFIG_WEN_Wen);
+
+    config = mode;
+}
+
+static void nvmc_erasepage(HostRegister &r)
+{
+    uint32_t page = (r.value - (uint32_t) (uintptr_t) flash) / HOST_FLASH_PAGE_SIZE;
+
+    if (config != NVMC_CONFIG_WEN_Een || r.value % HOST_FLASH_PAGE_SIZE || page >= HOST_FLASH_PAGES)
+    {
+        stats.violations++;
+        return;
+    }
+
+    memset(flash + page * HOST_FLASH_PAGE_SIZE, 0xFF, HOST_FLASH_PAGE_SIZE);
+    memset(snapshot + page * HOST_FLASH_PAGE_SIZE, 0xFF, HOST_FLASH_PAGE_SIZE);
+
+    stats.erases++;
+    stats.busyTime += HOST_FLASH_ERASE_TIME;
+
+    if (++pageErases[page] > stats.maxErases)
+        stats.maxErases = pageErases[page];
+}
+
+/**
+  * Attaches the simulated flash to the NVMC registers, and describes it in the FICR.
+  */
+static struct HostFlashInit
+{
+    HostFlashInit()
+    {
+        host_flash_format();
+
+        host_ficr.CODEPAGESIZE.value = HOST_FLASH_PAGE_SIZE;
+        host_ficr.CODESIZE.value = (uint32_t) (uintptr_t) flash / HOST_FLASH_PAGE_SIZE + HOST_FLASH_PAGES;
+        host_ficr.DEVICEID[0].value = 0x6D696372;
+        host_ficr.DEVICEID[1].value = 0x6F626974;
+
+        host_nvmc.READY.value = NVMC_READY_READY_Ready;
+        host_nvmc.READY.polled = 1;
+        host_nvmc.CONFIG.onWrite = nvmc_config;
+        host_nvmc.ERASEPAGE.onWrite = nvmc_erasepage;
+    }
+} init;
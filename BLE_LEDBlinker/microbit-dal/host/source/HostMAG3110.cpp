@@ -0,0 +1,149 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simulated MAG3110 magnetometer.
+  *
+  * Only what the runtime uses is modelled: the output data rates, the operating mode, the data ready status
+  * and interrupt, and the 16 bit output registers. Samples are taken on the virtual clock.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHost.h"
+
+#define MAG3110_ADDRESS             0x1D
+#define MAG3110_INT1                P0_29
+
+#define MAG3110_REG_DR_STATUS       0x00
+#define MAG3110_REG_OUT_X_MSB       0x01
+#define MAG3110_REG_WHO_AM_I        0x07
+#define MAG3110_REG_SYSMOD          0x08
+#define MAG3110_REG_DIE_TEMP        0x0F
+#define MAG3110_REG_CTRL_REG1       0x10
+#define MAG3110_REG_CTRL_REG2       0x11
+
+#define MAG3110_ZYXDR               0x08
+#define MAG3110_ZYXOW               0x80
+#define MAG3110_ACTIVE              0x01
+#define MAG3110_RAW                 0x20
+
+#define MAG3110_SYSMOD_STANDBY      0
+#define MAG3110_SYSMOD_RAW          1
+#define MAG3110_SYSMOD_CORRECTED    2
+
+/**
+  * Determines the time between samples selected by CTRL_REG1. The ADC runs at 1280Hz >> DR, and each sample
+  * averages 16 << OS conversions, so the fastest rate is 80Hz and each step of either field halves it.
+  *
+  * @return The sample period, in microseconds.
+  */
+static uint32_t mag3110_period(HostMAG3110 &d)
+{
+    uint8_t ctrl = d.registers[MAG3110_REG_CTRL_REG1];
+
+    return 12500 << ((ctrl >> 5) + ((ctrl >> 3) & 0x03));
+}
+
+static void mag3110_sample(void *context)
+{
+    HostMAG3110 &d = *(HostMAG3110 *) context;
+
+    d.samples++;
+    d.sample();
+
+    if (d.registers[MAG3110_REG_DR_STATUS] & MAG3110_ZYXDR)
+        d.registers[MAG3110_REG_DR_STATUS] |= MAG3110_ZYXOW;
+
+    d.registers[MAG3110_REG_DR_STATUS] |= MAG3110_ZYXDR;
+
+    int16_t values[3] = { d.x, d.y, d.z };
+
+    for (int i = 0; i < 3; i++)
+    {
+        d.registers[MAG3110_REG_OUT_X_MSB + 2*i] = (uint8_t) (values[i] >> 8);
+        d.registers[MAG3110_REG_OUT_X_MSB + 2*i + 1] = (uint8_t) values[i];
+    }
+
+    host_pin_write(MAG3110_INT1, 1);
+    host_event_schedule(d.event, mag3110_period(d));
+}
+
+HostMAG3110::HostMAG3110() : HostI2CDevice(MAG3110_ADDRESS), x(0), y(0), z(0), samples(0)
+{
+    memset(&event, 0, sizeof(event));
+    event.handler = mag3110_sample;
+    event.context = this;
+
+    registers[MAG3110_REG_WHO_AM_I] = 0xC4;
+    host_pin_write(MAG3110_INT1, 0);
+}
+
+HostMAG3110::~HostMAG3110()
+{
+    host_event_cancel(event);
+}
+
+void HostMAG3110::sample()
+{
+}
+
+uint8_t HostMAG3110::read(uint8_t reg)
+{
+    uint8_t value = registers[reg];
+
+    if (reg == MAG3110_REG_OUT_X_MSB)
+    {
+        registers[MAG3110_REG_DR_STATUS] = 0;
+        host_pin_write(MAG3110_INT1, 0);
+    }
+
+    return value;
+}
+
+void HostMAG3110::write(uint8_t reg, uint8_t value)
+{
+    // The status, output, identity, mode and temperature registers are read only.
+    if (reg <= MAG3110_REG_SYSMOD || reg == MAG3110_REG_DIE_TEMP)
+        return;
+
+    registers[reg] = value;
+
+    // Entering active mode starts sampling afresh, at the selected rate.
+    if (reg == MAG3110_REG_CTRL_REG1)
+    {
+        if (value & MAG3110_ACTIVE)
+        {
+            registers[MAG3110_REG_SYSMOD] = (registers[MAG3110_REG_CTRL_REG2] & MAG3110_RAW) ? MAG3110_SYSMOD_RAW : MAG3110_SYSMOD_CORRECTED;
+
+            if (!event.scheduled)
+                host_event_schedule(event, mag3110_period(*this));
+        }
+        else
+        {
+            registers[MAG3110_REG_SYSMOD] = MAG3110_SYSMOD_STANDBY;
+            host_event_cancel(event);
+        }
+    }
+}
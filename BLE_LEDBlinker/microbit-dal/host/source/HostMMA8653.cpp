@@ -0,0 +1,154 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simulated MMA8653 accelerometer.
+  *
+  * Only what the runtime uses is modelled: the output data rates, the data ready status and interrupt,
+  * and the 10 bit output registers. Samples are taken on the virtual clock, so a test can tell exactly
+  * which the driver read and which it missed.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHost.h"
+
+#define MMA8653_ADDRESS             0x3A
+#define MMA8653_INT1                P0_28
+
+#define MMA8653_REG_STATUS          0x00
+#define MMA8653_REG_OUT_X_MSB       0x01
+#define MMA8653_REG_OUT_Z_MSB       0x05
+#define MMA8653_REG_WHO_AM_I        0x0D
+#define MMA8653_REG_CTRL_REG1       0x2A
+#define MMA8653_REG_CTRL_REG4       0x2D
+#define MMA8653_REG_CTRL_REG5       0x2E
+
+#define MMA8653_ZYXDR               0x08
+#define MMA8653_ZYXOW               0x80
+#define MMA8653_ACTIVE              0x01
+#define MMA8653_INT_DRDY            0x01
+
+// Sample periods in microseconds, indexed by the DR field of CTRL_REG1.
+static const uint32_t mma8653Period[8] = { 1250, 2500, 5000, 10000, 20000, 80000, 160000, 640000 };
+
+/**
+  * Drives INT1 according to the data ready flag, and the interrupt configuration. The line is active low.
+  */
+static void mma8653_update_int1(HostMMA8653 &d)
+{
+    int active = (d.registers[MMA8653_REG_STATUS] & MMA8653_ZYXDR) &&
+        (d.registers[MMA8653_REG_CTRL_REG4] & MMA8653_INT_DRDY) && (d.registers[MMA8653_REG_CTRL_REG5] & MMA8653_INT_DRDY);
+
+    host_pin_write(MMA8653_INT1, !active);
+}
+
+/**
+  * Stores a value in a pair of output registers, left justified as the device does.
+  */
+static void mma8653_latch(HostMMA8653 &d, int reg, int16_t value)
+{
+    d.registers[reg] = (uint8_t) (value >> 2);
+    d.registers[reg + 1] = (uint8_t) (value << 6);
+}
+
+static void mma8653_sample(void *context)
+{
+    HostMMA8653 &d = *(HostMMA8653 *) context;
+
+    d.samples++;
+    d.sample();
+
+    if (d.registers[MMA8653_REG_STATUS] & MMA8653_ZYXDR)
+    {
+        d.overwritten++;
+        d.registers[MMA8653_REG_STATUS] |= MMA8653_ZYXOW;
+    }
+
+    d.registers[MMA8653_REG_STATUS] |= MMA8653_ZYXDR;
+
+    mma8653_latch(d, MMA8653_REG_OUT_X_MSB, d.x);
+    mma8653_latch(d, MMA8653_REG_OUT_X_MSB + 2, d.y);
+    mma8653_latch(d, MMA8653_REG_OUT_X_MSB + 4, d.z);
+    mma8653_update_int1(d);
+
+    host_event_schedule(d.event, mma8653Period[(d.registers[MMA8653_REG_CTRL_REG1] >> 3) & 0x07]);
+}
+
+HostMMA8653::HostMMA8653() : HostI2CDevice(MMA8653_ADDRESS), x(0), y(0), z(0), samples(0), overwritten(0)
+{
+    memset(&event, 0, sizeof(event));
+    event.handler = mma8653_sample;
+    event.context = this;
+
+    registers[MMA8653_REG_WHO_AM_I] = 0x5A;
+    mma8653_update_int1(*this);
+}
+
+HostMMA8653::~HostMMA8653()
+{
+    host_event_cancel(event);
+}
+
+void HostMMA8653::sample()
+{
+}
+
+uint8_t HostMMA8653::read(uint8_t reg)
+{
+    uint8_t value = registers[reg];
+
+    if (reg == MMA8653_REG_OUT_Z_MSB)
+    {
+        registers[MMA8653_REG_STATUS] = 0;
+        mma8653_update_int1(*this);
+    }
+
+    return value;
+}
+
+void HostMMA8653::write(uint8_t reg, uint8_t value)
+{
+    // The status and output registers are read only.
+    if (reg <= MMA8653_REG_OUT_X_MSB + 5)
+        return;
+
+    registers[reg] = value;
+
+    // Entering active mode starts sampling afresh, at the selected rate.
+    if (reg == MMA8653_REG_CTRL_REG1)
+    {
+        if (value & MMA8653_ACTIVE)
+        {
+            if (!event.scheduled)
+                host_event_schedule(event, mma8653Period[(value >> 3) & 0x07]);
+        }
+        else
+        {
+            host_event_cancel(event);
+        }
+    }
+
+    mma8653_update_int1(*this);
+}
@@ -0,0 +1,341 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simulated nrf51 RADIO peripheral (and the high frequency clock it depends on).
+  *
+  * The radio moves between the nrf51's states with its documented ramp up and packet timings, and honours the
+  * shortcuts between its tasks and events. There is no ether: packets transmitted are passed to a test's handler,
+  * and packets are received only when a test injects them (see MicroBitHost.h). As on a device, a packet that
+  * begins whilst the receiver is not started is lost.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHost.h"
+#include "MicroBitBLEManager.h"
+
+NRF_CLOCK_Type host_clock;
+NRF_RADIO_Type host_radio;
+
+const int8_t MICROBIT_BLE_POWER_LEVEL[] = {-30, -20, -16, -12, -8, -4, 0, 4};
+
+// Radio states, as reported by the nrf51's STATE register.
+#define RADIO_STATE_DISABLED        0
+#define RADIO_STATE_RXRU            1
+#define RADIO_STATE_RXIDLE          2
+#define RADIO_STATE_RX              3
+#define RADIO_STATE_RXDISABLE       4
+#define RADIO_STATE_TXRU            9
+#define RADIO_STATE_TXIDLE          10
+#define RADIO_STATE_TX              11
+#define RADIO_STATE_TXDISABLE       12
+
+// Transition times, in microseconds.
+#define RADIO_RAMP_UP_TIME          130
+#define RADIO_DISABLE_TIME          4
+
+static HostEvent event;                         // The end of the ramp up, packet or disable in progress.
+static void (*complete)(void);                  // What to do at the end of it.
+static uint32_t inten = 0;
+static uint8_t *packet = NULL;                  // The packet buffer in use, latched by the START task.
+static int receiving = 0;                       // Nonzero if a packet is arriving.
+static uint8_t incoming[256];
+static void (*transmitHandler)(const uint8_t *packet) = NULL;
+static HostRadioStatistics stats;
+
+void host_radio_statistics(HostRadioStatistics &s)
+{
+    s = stats;
+}
+
+void host_radio_on_transmit(void (*handler)(const uint8_t *packet))
+{
+    transmitHandler = handler;
+}
+
+/**
+  * Determines the time taken to send a packet with the given payload length, in the current configuration.
+  */
+static uint32_t radio_air_time(uint32_t length)
+{
+    uint32_t mode = host_radio.MODE.value;
+    uint32_t byteTime = mode == RADIO_MODE_MODE_Nrf_2Mbit ? 4 : mode == RADIO_MODE_MODE_Nrf_250Kbit ? 32 : 8;
+
+    // Preamble, base address and prefix, length field, payload and CRC.
+    uint32_t bytes = 1 + ((host_radio.PCNF1.value >> 16) & 7) + 1 + 1 + length + (host_radio.CRCCNF.value & 3);
+
+    return bytes * byteTime;
+}
+
+/**
+  * Determines the number of payload bytes that the radio will transfer for the packet in the given buffer.
+  */
+static uint32_t radio_length(const uint8_t *p)
+{
+    uint32_t max = host_radio.PCNF1.value & 0xFF;
+
+    return p[0] < max ? p[0] : max;
+}
+
+static void radio_event_handler(void *)
+{
+    complete();
+}
+
+static void radio_after(uint32_t us, void (*fn)(void))
+{
+    complete = fn;
+    host_event_schedule(event, us);
+}
+
+static void radio_state(uint32_t state)
+{
+    host_radio.STATE.value = state;
+}
+
+/**
+  * Sets one of the radio's event registers, and raises its interrupt if enabled.
+  */
+static void radio_event(HostRegister &e, uint32_t mask)
+{
+    e.value = 1;
+
+    if (inten & mask)
+        host_irq_raise(RADIO_IRQn);
+}
+
+static void radio_disabled()
+{
+    radio_state(RADIO_STATE_DISABLED);
+    radio_event(host_radio.EVENTS_DISABLED, RADIO_INTENSET_DISABLED_Msk);
+
+    if (host_radio.SHORTS.value & RADIO_SHORTS_DISABLED_TXEN_Msk)
+        host_radio.TASKS_TXEN = 1;
+    else if (host_radio.SHORTS.value & RADIO_SHORTS_DISABLED_RXEN_Msk)
+        host_radio.TASKS_RXEN = 1;
+}
+
+static void radio_disable()
+{
+    uint32_t state = host_radio.STATE.value;
+
+    if (receiving)
+    {
+        receiving = 0;
+        stats.missed++;
+    }
+
+    host_event_cancel(event);
+
+    if (state == RADIO_STATE_DISABLED)
+    {
+        radio_disabled();
+        return;
+    }
+
+    radio_state(state >= RADIO_STATE_TXRU ? RADIO_STATE_TXDISABLE : RADIO_STATE_RXDISABLE);
+    radio_after(RADIO_DISABLE_TIME, radio_disabled);
+}
+
+static void radio_start();
+
+static void radio_end()
+{
+    radio_event(host_radio.EVENTS_END, RADIO_INTENSET_END_Msk);
+
+    if (host_radio.SHORTS.value & RADIO_SHORTS_END_DISABLE_Msk)
+        radio_disable();
+    else if (host_radio.SHORTS.value & RADIO_SHORTS_END_START_Msk)
+        radio_start();
+}
+
+static void radio_tx_end()
+{
+    uint32_t length = radio_length(packet);
+
+    stats.transmitted++;
+    stats.airTime += radio_air_time(length);
+
+    radio_state(RADIO_STATE_TXIDLE);
+
+    if (transmitHandler != NULL)
+        transmitHandler(packet);
+
+    radio_end();
+}
+
+static void radio_rx_end()
+{
+    uint32_t length = radio_length(incoming);
+
+    memcpy(packet, incoming, length + 1);
+    packet[0] = length;
+
+    receiving = 0;
+    stats.received++;
+
+    host_radio.CRCSTATUS.value = 1;
+    radio_state(RADIO_STATE_RXIDLE);
+    radio_end();
+}
+
+static void radio_start()
+{
+    uint32_t state = host_radio.STATE.value;
+
+    if (state != RADIO_STATE_TXIDLE && state != RADIO_STATE_RXIDLE)
+        return;
+
+    packet = (uint8_t *) (uintptr_t) host_radio.PACKETPTR.value;
+
+    if (state == RADIO_STATE_TXIDLE)
+    {
+        radio_state(RADIO_STATE_TX);
+        radio_after(radio_air_time(radio_length(packet)), radio_tx_end);
+    }
+    else
+    {
+        // Listen until a packet is injected.
+        radio_state(RADIO_STATE_RX);
+    }
+}
+
+static void radio_ready()
+{
+    radio_state(host_radio.STATE.value == RADIO_STATE_TXRU ? RADIO_STATE_TXIDLE : RADIO_STATE_RXIDLE);
+    radio_event(host_radio.EVENTS_READY, RADIO_INTENSET_READY_Msk);
+
+    if (host_radio.SHORTS.value & RADIO_SHORTS_READY_START_Msk)
+        radio_start();
+}
+
+int host_radio_inject(const uint8_t *p, uint8_t rssi)
+{
+    if (host_radio.STATE.value != RADIO_STATE_RX || receiving)
+    {
+        stats.missed++;
+        return 0;
+    }
+
+    memcpy(incoming, p, p[0] + 1);
+    receiving = 1;
+
+    // The address is matched as soon as it has arrived, but we don't model the delay to that point.
+    host_radio.RSSISAMPLE.value = rssi;
+    radio_event(host_radio.EVENTS_ADDRESS, RADIO_INTENSET_ADDRESS_Msk);
+    radio_after(radio_air_time(radio_length(incoming)), radio_rx_end);
+
+    return 1;
+}
+
+static void radio_txen(HostRegister &)
+{
+    if (host_radio.STATE.value == RADIO_STATE_DISABLED)
+    {
+        radio_state(RADIO_STATE_TXRU);
+        radio_after(RADIO_RAMP_UP_TIME, radio_ready);
+    }
+}
+
+static void radio_rxen(HostRegister &)
+{
+    if (host_radio.STATE.value == RADIO_STATE_DISABLED)
+    {
+        radio_state(RADIO_STATE_RXRU);
+        radio_after(RADIO_RAMP_UP_TIME, radio_ready);
+    }
+}
+
+static void radio_task_start(HostRegister &)
+{
+    radio_start();
+}
+
+static void radio_task_stop(HostRegister &)
+{
+    uint32_t state = host_radio.STATE.value;
+
+    if (state == RADIO_STATE_TX || state == RADIO_STATE_RX)
+    {
+        if (receiving)
+        {
+            receiving = 0;
+            stats.missed++;
+        }
+
+        host_event_cancel(event);
+        radio_state(state - 1);
+    }
+}
+
+static void radio_task_disable(HostRegister &)
+{
+    radio_disable();
+}
+
+static void radio_intenset(HostRegister &r)
+{
+    inten |= r.value;
+    host_radio.INTENSET.value = host_radio.INTENCLR.value = inten;
+}
+
+static void radio_intenclr(HostRegister &r)
+{
+    inten &= ~r.value;
+    host_radio.INTENSET.value = host_radio.INTENCLR.value = inten;
+}
+
+static void clock_hfclkstart(HostRegister &)
+{
+    host_clock.EVENTS_HFCLKSTARTED.value = 1;
+}
+
+/**
+  * Attaches the simulated radio and clock to their registers.
+  */
+static struct HostRadioInit
+{
+    HostRadioInit()
+    {
+        event.handler = radio_event_handler;
+
+        host_clock.TASKS_HFCLKSTART.onWrite = clock_hfclkstart;
+        host_clock.EVENTS_HFCLKSTARTED.polled = 1;
+
+        host_radio.TASKS_TXEN.onWrite = radio_txen;
+        host_radio.TASKS_RXEN.onWrite = radio_rxen;
+        host_radio.TASKS_START.onWrite = radio_task_start;
+        host_radio.TASKS_STOP.onWrite = radio_task_stop;
+        host_radio.TASKS_DISABLE.onWrite = radio_task_disable;
+        host_radio.INTENSET.onWrite = radio_intenset;
+        host_radio.INTENCLR.onWrite = radio_intenclr;
+
+        host_radio.EVENTS_READY.polled = 1;
+        host_radio.EVENTS_ADDRESS.polled = 1;
+        host_radio.EVENTS_PAYLOAD.polled = 1;
+        host_radio.EVENTS_END.polled = 1;
+        host_radio.EVENTS_DISABLED.polled = 1;
+    }
+} init;
@@ -0,0 +1,494 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simulated I2C bus, with the nrf51 TWI peripheral and mbed I2C interface used to reach it.
+  *
+  * Devices are modelled as register files (HostI2CDevice). Each byte on the bus takes nine bit times
+  * at the peripheral's configured frequency, and the peripheral raises its events and interrupt
+  * as the nrf51's does, honouring the BB_SUSPEND and BB_STOP shortcuts used when reading.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHost.h"
+
+NRF_TWI_Type host_twi[2];
+
+// What the bus is doing.
+#define TWI_IDLE                0       // Not addressing a device.
+#define TWI_TX                  1       // Sending bytes to the addressed device.
+#define TWI_RX                  2       // Receiving bytes from the addressed device.
+#define TWI_SUSPENDED           3       // Receiving, but held at a byte boundary until resumed.
+#define TWI_FAILED              4       // A byte was not acknowledged. The master must issue a STOP.
+
+/**
+  * The state of one simulated TWI peripheral.
+  */
+struct HostTWI
+{
+    NRF_TWI_Type *regs;
+    IRQn_Type irq;
+    HostEvent event;                    // The end of the byte, or stop condition, in progress.
+    void (*complete)(HostTWI &t);       // What to do at the end of it.
+    int state;
+    int first;                          // Nonzero if the next byte sent selects a register.
+    uint32_t inten;
+    uint32_t errorsrc;
+    HostI2CDevice *device;
+};
+
+static HostTWI twi[2];
+
+static HostI2CDevice *devices = NULL;
+static HostI2CStatistics stats;
+static int failCount = 0;
+
+/**
+  * Finds the device answering to the given address.
+  *
+  * @param address 8-bit I2C slave address. The bottom (read/write) bit is ignored.
+  *
+  * @return the device, or NULL if nothing acknowledges the address.
+  */
+static HostI2CDevice *i2c_find(int address)
+{
+    for (HostI2CDevice *d = devices; d != NULL; d = d->next)
+        if (d->address == (address & 0xFE))
+            return d;
+
+    return NULL;
+}
+
+/**
+  * Counts a byte onto the bus, and determines whether it is acknowledged.
+  *
+  * @return 1 if the byte was acknowledged, 0 otherwise.
+  */
+static int i2c_byte(uint32_t us, int present)
+{
+    stats.bytes++;
+    stats.busyTime += us;
+
+    if (failCount > 0)
+    {
+        failCount--;
+        present = 0;
+    }
+
+    if (!present)
+        stats.errors++;
+
+    return present;
+}
+
+/**
+  * Delivers a byte written by the master to the given device.
+  */
+static void i2c_write(HostI2CDevice *d, int &first, uint8_t value)
+{
+    if (first)
+        d->pointer = value;
+    else
+        d->write(d->pointer++, value);
+
+    first = 0;
+}
+
+/**
+  * Determines the time taken to transfer a byte, including its acknowledgement.
+  *
+  * @param frequency The value of a TWI FREQUENCY register.
+  */
+static uint32_t i2c_byte_time(uint32_t frequency)
+{
+    if (frequency == TWI_FREQUENCY_FREQUENCY_K400)
+        return 23;
+
+    if (frequency == TWI_FREQUENCY_FREQUENCY_K250)
+        return 36;
+
+    return 90;
+}
+
+HostI2CDevice::HostI2CDevice(uint8_t address) : address(address & 0xFE), pointer(0)
+{
+    memset(registers, 0, sizeof(registers));
+
+    next = devices;
+    devices = this;
+}
+
+HostI2CDevice::~HostI2CDevice()
+{
+    HostI2CDevice **p = &devices;
+
+    while (*p != NULL && *p != this)
+        p = &(*p)->next;
+
+    if (*p != NULL)
+        *p = next;
+}
+
+uint8_t HostI2CDevice::read(uint8_t reg)
+{
+    return registers[reg];
+}
+
+void HostI2CDevice::write(uint8_t reg, uint8_t value)
+{
+    registers[reg] = value;
+}
+
+void host_i2c_statistics(HostI2CStatistics &s)
+{
+    s = stats;
+}
+
+void host_i2c_fail(int count)
+{
+    failCount = count;
+}
+
+/**
+  * Finds the peripheral that owns the given register.
+  */
+static HostTWI &twi_of(HostRegister &r)
+{
+    return &r >= &host_twi[1].TASKS_STARTRX ? twi[1] : twi[0];
+}
+
+/**
+  * Sets one of the peripheral's event registers, and raises its interrupt if enabled.
+  */
+static void twi_event(HostTWI &t, HostRegister &event, uint32_t mask)
+{
+    event.value = 1;
+
+    if (t.inten & mask)
+        host_irq_raise(t.irq);
+}
+
+/**
+  * Schedules the end of a byte (or of a stop condition) on the bus.
+  */
+static void twi_after(HostTWI &t, uint32_t bytes, void (*complete)(HostTWI &t))
+{
+    t.complete = complete;
+    host_event_schedule(t.event, bytes ? bytes * i2c_byte_time(t.regs->FREQUENCY.value) : 5);
+}
+
+static void twi_event_handler(void *context)
+{
+    HostTWI &t = *(HostTWI *) context;
+
+    t.complete(t);
+}
+
+static void twi_fail(HostTWI &t, uint32_t source)
+{
+    t.state = TWI_FAILED;
+    t.errorsrc |= source;
+    t.regs->ERRORSRC.value = t.errorsrc;
+
+    twi_event(t, t.regs->EVENTS_ERROR, TWI_INTENSET_ERROR_Msk);
+}
+
+static void twi_stopped(HostTWI &t)
+{
+    t.state = TWI_IDLE;
+    t.device = NULL;
+
+    twi_event(t, t.regs->EVENTS_STOPPED, TWI_INTENSET_STOPPED_Msk);
+}
+
+static void twi_txd_sent(HostTWI &t)
+{
+    if (!i2c_byte(i2c_byte_time(t.regs->FREQUENCY.value), 1))
+    {
+        twi_fail(t, TWI_ERRORSRC_DNACK_Msk);
+        return;
+    }
+
+    i2c_write(t.device, t.first, t.regs->TXD.value);
+
+    twi_event(t, t.regs->EVENTS_TXDSENT, TWI_INTENSET_TXDSENT_Msk);
+}
+
+static void twi_rxd_ready(HostTWI &t)
+{
+    i2c_byte(i2c_byte_time(t.regs->FREQUENCY.value), 1);
+
+    t.regs->RXD.value = t.device->read(t.device->pointer++);
+
+    twi_event(t, t.regs->EVENTS_RXDREADY, TWI_INTENSET_RXDREADY_Msk);
+
+    // Shortcuts take effect at the byte boundary.
+    if (t.regs->SHORTS.value & TWI_SHORTS_BB_STOP_Msk)
+        twi_after(t, 0, twi_stopped);
+    else if (t.regs->SHORTS.value & TWI_SHORTS_BB_SUSPEND_Msk)
+        t.state = TWI_SUSPENDED;
+    else
+        twi_after(t, 1, twi_rxd_ready);
+}
+
+static void twi_address_nack(HostTWI &t)
+{
+    twi_fail(t, TWI_ERRORSRC_ANACK_Msk);
+}
+
+/**
+  * Sends an address byte, and carries on to the given step at the end of it if a device acknowledges.
+  */
+static void twi_address(HostTWI &t, void (*next)(HostTWI &t))
+{
+    stats.transactions++;
+
+    t.device = i2c_find(t.regs->ADDRESS.value << 1);
+
+    if (!i2c_byte(i2c_byte_time(t.regs->FREQUENCY.value), t.device != NULL))
+        next = twi_address_nack;
+
+    twi_after(t, 1, next);
+}
+
+/**
+  * Follows the address of a write with the byte already in TXD.
+  */
+static void twi_tx_addressed(HostTWI &t)
+{
+    twi_after(t, 1, twi_txd_sent);
+}
+
+static void twi_starttx(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    if (t.regs->ENABLE.value != TWI_ENABLE_ENABLE_Enabled)
+        return;
+
+    t.state = TWI_TX;
+    t.first = 1;
+
+    twi_address(t, twi_tx_addressed);
+}
+
+static void twi_txd(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    // A byte written whilst transmitting (and not still addressing the device) is sent straight away.
+    if (t.state == TWI_TX && !t.event.scheduled)
+        twi_after(t, 1, twi_txd_sent);
+}
+
+/**
+  * Follows the address of a read with its first byte.
+  */
+static void twi_rx_addressed(HostTWI &t)
+{
+    twi_after(t, 1, twi_rxd_ready);
+}
+
+static void twi_startrx(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    if (t.regs->ENABLE.value != TWI_ENABLE_ENABLE_Enabled)
+        return;
+
+    t.state = TWI_RX;
+
+    twi_address(t, twi_rx_addressed);
+}
+
+static void twi_resume(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    if (t.state == TWI_SUSPENDED)
+    {
+        t.state = TWI_RX;
+        twi_after(t, 1, twi_rxd_ready);
+    }
+}
+
+static void twi_stop(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    if (t.state != TWI_IDLE)
+        twi_after(t, 0, twi_stopped);
+}
+
+static void twi_enable(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    // Disabling the peripheral abandons whatever it was doing.
+    if (r.value != TWI_ENABLE_ENABLE_Enabled)
+    {
+        host_event_cancel(t.event);
+        t.state = TWI_IDLE;
+        t.device = NULL;
+    }
+}
+
+static void twi_intenset(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    t.inten |= r.value;
+    t.regs->INTENSET.value = t.regs->INTENCLR.value = t.inten;
+}
+
+static void twi_intenclr(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    t.inten &= ~r.value;
+    t.regs->INTENSET.value = t.regs->INTENCLR.value = t.inten;
+}
+
+static void twi_errorsrc(HostRegister &r)
+{
+    HostTWI &t = twi_of(r);
+
+    // Bits are cleared by writing ones to them.
+    t.errorsrc &= ~r.value;
+    r.value = t.errorsrc;
+}
+
+/**
+  * Attaches the simulated peripherals to their registers.
+  */
+static struct HostTWIInit
+{
+    HostTWIInit()
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            HostTWI &t = twi[i];
+            NRF_TWI_Type *regs = &host_twi[i];
+
+            t.regs = regs;
+            t.irq = i ? SPI1_TWI1_IRQn : SPI0_TWI0_IRQn;
+            t.event.handler = twi_event_handler;
+            t.event.context = &t;
+
+            regs->TASKS_STARTTX.onWrite = twi_starttx;
+            regs->TASKS_STARTRX.onWrite = twi_startrx;
+            regs->TASKS_RESUME.onWrite = twi_resume;
+            regs->TASKS_STOP.onWrite = twi_stop;
+            regs->TXD.onWrite = twi_txd;
+            regs->ENABLE.onWrite = twi_enable;
+            regs->INTENSET.onWrite = twi_intenset;
+            regs->INTENCLR.onWrite = twi_intenclr;
+            regs->ERRORSRC.onWrite = twi_errorsrc;
+
+            regs->EVENTS_STOPPED.polled = 1;
+            regs->EVENTS_RXDREADY.polled = 1;
+            regs->EVENTS_TXDSENT.polled = 1;
+            regs->EVENTS_ERROR.polled = 1;
+        }
+    }
+} init;
+
+I2C::I2C(PinName sda, PinName scl)
+{
+    (void) sda;
+    (void) scl;
+
+    _i2c.i2c = NRF_TWI0;
+    _i2c.i2c->FREQUENCY = TWI_FREQUENCY_FREQUENCY_K100;
+    _i2c.i2c->ENABLE = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
+}
+
+void I2C::frequency(int hz)
+{
+    if (hz >= 400000)
+        _i2c.i2c->FREQUENCY = TWI_FREQUENCY_FREQUENCY_K400;
+    else if (hz >= 250000)
+        _i2c.i2c->FREQUENCY = TWI_FREQUENCY_FREQUENCY_K250;
+    else
+        _i2c.i2c->FREQUENCY = TWI_FREQUENCY_FREQUENCY_K100;
+}
+
+int I2C::read(int address, char *data, int length, bool repeated)
+{
+    uint32_t byteTime = i2c_byte_time(_i2c.i2c->FREQUENCY.value);
+    HostI2CDevice *d = i2c_find(address);
+
+    (void) repeated;
+
+    stats.transactions++;
+
+    if (!i2c_byte(byteTime, d != NULL))
+    {
+        wait_us(byteTime);
+        return 1;
+    }
+
+    for (int i = 0; i < length; i++)
+    {
+        i2c_byte(byteTime, 1);
+        data[i] = d->read(d->pointer++);
+    }
+
+    wait_us(byteTime * (length + 1));
+
+    return 0;
+}
+
+int I2C::write(int address, const char *data, int length, bool repeated)
+{
+    uint32_t byteTime = i2c_byte_time(_i2c.i2c->FREQUENCY.value);
+    HostI2CDevice *d = i2c_find(address);
+    int first = 1;
+
+    (void) repeated;
+
+    stats.transactions++;
+
+    if (!i2c_byte(byteTime, d != NULL))
+    {
+        wait_us(byteTime);
+        return 1;
+    }
+
+    for (int i = 0; i < length; i++)
+    {
+        if (!i2c_byte(byteTime, 1))
+        {
+            wait_us(byteTime * (i + 2));
+            return 1;
+        }
+
+        i2c_write(d, first, data[i]);
+    }
+
+    wait_us(byteTime * (length + 1));
+
+    return 0;
+}
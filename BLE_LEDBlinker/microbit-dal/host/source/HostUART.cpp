@@ -0,0 +1,209 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * A simulated nrf51 UART, and the mbed serial interface used to reach it.
+  *
+  * Each byte takes ten bit times to send at the configured baud rate. Received bytes are held in a six byte
+  * FIFO, as on the nrf51, and bytes that arrive whilst it is full are lost. As with mbed, the receive interrupt
+  * is raised whilst the FIFO holds a byte, and the transmit interrupt whilst the transmitter is idle.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitHost.h"
+
+#define UART_RX_FIFO_SIZE       6
+
+static SerialBase *owner = NULL;                // The serial port attached to the UART's interrupts.
+static int inten[2] = { 0, 0 };                 // Nonzero if the receive and transmit interrupts are enabled.
+static uint32_t byteTime = 1042;                // Microseconds to send a byte, at 9600 baud until configured.
+static HostEvent event;                         // The end of the byte being sent.
+static int sending = 0;
+static uint8_t sendingByte;
+static uint8_t fifo[UART_RX_FIFO_SIZE];
+static int fifoHead = 0;
+static int fifoLength = 0;
+static int loopback = 0;
+static void (*transmitHandler)(uint8_t c) = NULL;
+static HostUARTStatistics stats;
+
+void host_uart_statistics(HostUARTStatistics &s)
+{
+    s = stats;
+}
+
+void host_uart_loopback(int enable)
+{
+    loopback = enable;
+}
+
+void host_uart_on_transmit(void (*handler)(uint8_t c))
+{
+    transmitHandler = handler;
+}
+
+/**
+  * Raises the UART interrupt if any of its enabled conditions hold.
+  */
+static void uart_update()
+{
+    if ((inten[SerialBase::RxIrq] && fifoLength) || (inten[SerialBase::TxIrq] && !sending))
+        host_irq_raise(UART0_IRQn);
+}
+
+int host_uart_inject(uint8_t c)
+{
+    if (fifoLength == UART_RX_FIFO_SIZE)
+    {
+        stats.overruns++;
+        return 0;
+    }
+
+    fifo[(fifoHead + fifoLength) % UART_RX_FIFO_SIZE] = c;
+    fifoLength++;
+    stats.received++;
+
+    uart_update();
+
+    return 1;
+}
+
+static void uart_sent(void *)
+{
+    sending = 0;
+    stats.transmitted++;
+
+    if (loopback)
+        host_uart_inject(sendingByte);
+    else if (transmitHandler != NULL)
+        transmitHandler(sendingByte);
+
+    uart_update();
+}
+
+extern "C" void UART0_IRQHandler(void)
+{
+    if (owner == NULL)
+        return;
+
+    if (inten[SerialBase::RxIrq] && fifoLength)
+        owner->interrupt(SerialBase::RxIrq);
+
+    if (inten[SerialBase::TxIrq] && !sending)
+        owner->interrupt(SerialBase::TxIrq);
+
+    // The interrupt remains asserted for as long as its conditions hold.
+    uart_update();
+}
+
+void serial_init(serial_t *obj, PinName tx, PinName rx)
+{
+    obj->tx = tx;
+    obj->rx = rx;
+
+    NVIC_EnableIRQ(UART0_IRQn);
+}
+
+SerialBase::SerialBase(PinName tx, PinName rx)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        handler[i] = NULL;
+        thunk[i] = NULL;
+        object[i] = NULL;
+    }
+
+    serial_init(&_serial, tx, rx);
+}
+
+void SerialBase::baud(int baudrate)
+{
+    byteTime = (10 * 1000000 + baudrate - 1) / baudrate;
+}
+
+int SerialBase::readable()
+{
+    return fifoLength > 0;
+}
+
+int SerialBase::writeable()
+{
+    return !sending;
+}
+
+void SerialBase::interrupt(IrqType type)
+{
+    if (thunk[type])
+        thunk[type](this, type);
+    else if (handler[type])
+        handler[type]();
+}
+
+void SerialBase::enable(IrqType type, int on)
+{
+    owner = this;
+    inten[type] = on;
+
+    // Take the interrupt straight away if its condition already holds, as the processor would.
+    uart_update();
+    host_clock_dispatch();
+}
+
+int RawSerial::getc()
+{
+    uint8_t c;
+
+    while (fifoLength == 0)
+        host_register_poll();
+
+    c = fifo[fifoHead];
+    fifoHead = (fifoHead + 1) % UART_RX_FIFO_SIZE;
+    fifoLength--;
+
+    return c;
+}
+
+int RawSerial::putc(int c)
+{
+    while (sending)
+        host_register_poll();
+
+    sending = 1;
+    sendingByte = c;
+    host_event_schedule(event, byteTime);
+
+    return c;
+}
+
+/**
+  * Attaches the simulated UART's event handler.
+  */
+static struct HostUARTInit
+{
+    HostUARTInit()
+    {
+        event.handler = uart_sent;
+    }
+} init;
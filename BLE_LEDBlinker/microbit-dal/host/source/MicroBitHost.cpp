@@ -0,0 +1,493 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host native stand ins for the device specific parts of the micro:bit runtime:
+  * a virtual clock with mbed style timers, a simulated NVIC and pins, the system stack, heap and panic handling.
+  *
+  * The simulated peripherals themselves are in HostFlash.cpp, HostRadio.cpp and HostTWI.cpp.
+  */
+
+#include <malloc.h>
+#include <ucontext.h>
+
+#include "MicroBitConfig.h"
+#include "MicroBitHost.h"
+#include "MicroBitDevice.h"
+#include "ErrorNo.h"
+
+volatile int host_irq_masked = 0;
+volatile int host_irq_pending = 0;
+volatile int host_irq_active = 0;
+
+uint32_t host_stack_base = 0;
+
+// The current virtual time, in microseconds.
+static uint64_t host_time = 0;
+
+// Attached timers, ordered by deadline (and in order of attachment for equal deadlines).
+static Ticker *timers = NULL;
+
+// Scheduled peripheral events, ordered as timers are.
+static HostEvent *events = NULL;
+
+// Simulated NVIC state: a bit per interrupt number.
+static volatile uint32_t nvic_enabled = 0;
+static volatile uint32_t nvic_pending = 0;
+
+// Levels of the input pins, a bit per pin.
+static uint32_t pins = 0;
+
+// Levels of the output pins, a bit per pin, and the function told of each write to them.
+static uint32_t outputs = 0;
+static void (*gpio_handler)(uint32_t outputs) = NULL;
+
+// The ADC is not modelled, so its registers are plain memory.
+NRF_ADC_Type host_adc;
+
+// Peripheral interrupt handlers, provided by the drivers that are linked in.
+extern "C" void RADIO_IRQHandler(void) __attribute__((weak));
+extern "C" void UART0_IRQHandler(void) __attribute__((weak));
+extern "C" void SPI0_TWI0_IRQHandler(void) __attribute__((weak));
+
+// The system stack that fibers run on, and the contexts used to enter and leave it.
+static uint8_t host_stack[HOST_STACK_SIZE] __attribute__((aligned(16)));
+static ucontext_t host_context;
+static ucontext_t native_context;
+static int (*host_entry)(void) = NULL;
+static int host_result = 0;
+
+/**
+  * Removes the given timer from the list of attached timers, if present.
+  */
+static void unlink_timer(Ticker *t)
+{
+    Ticker **p = &timers;
+
+    while (*p != NULL && *p != t)
+        p = &(*p)->next;
+
+    if (*p != NULL)
+        *p = t->next;
+}
+
+Ticker::Ticker() : handler(NULL), thunk(NULL), object(NULL), deadline(0), period(0), next(NULL)
+{
+}
+
+Ticker::~Ticker()
+{
+    detach();
+}
+
+void Ticker::insert(void (*fn)(void), void (*call)(Ticker *t), uint64_t delay, uint64_t repeat)
+{
+    Ticker **p = &timers;
+
+    unlink_timer(this);
+
+    handler = fn;
+    thunk = call;
+    deadline = host_time + delay;
+    period = repeat;
+
+    while (*p != NULL && (*p)->deadline <= deadline)
+        p = &(*p)->next;
+
+    next = *p;
+    *p = this;
+}
+
+void Ticker::detach()
+{
+    unlink_timer(this);
+    handler = NULL;
+    thunk = NULL;
+}
+
+/**
+  * Determines if a simulated interrupt could be taken now.
+  * Interrupts of a single priority do not preempt one another, or masked code.
+  */
+static int host_interruptible()
+{
+    return !host_irq_masked && !host_irq_active;
+}
+
+/**
+  * Determines if a timer callback or peripheral interrupt is ready to run.
+  */
+static int host_irq_ready()
+{
+    return (timers != NULL && timers->deadline <= host_time) || (nvic_pending & nvic_enabled);
+}
+
+/**
+  * Runs the interrupt handler for the given peripheral interrupt.
+  */
+static void host_irq_vector(int irq)
+{
+    void (*handler)(void) = NULL;
+
+    if (irq == RADIO_IRQn)
+        handler = RADIO_IRQHandler;
+
+    if (irq == UART0_IRQn)
+        handler = UART0_IRQHandler;
+
+    if (irq == SPI0_TWI0_IRQn)
+        handler = SPI0_TWI0_IRQHandler;
+
+    if (handler != NULL)
+        handler();
+}
+
+void host_clock_dispatch()
+{
+    if (!host_interruptible())
+    {
+        host_irq_pending = 1;
+        return;
+    }
+
+    host_irq_pending = 0;
+
+    while (host_irq_ready())
+    {
+        uint32_t ready = nvic_pending & nvic_enabled;
+
+        host_irq_active = 1;
+
+        if (timers != NULL && timers->deadline <= host_time)
+        {
+            Ticker *t = timers;
+            void (*fn)(void) = t->handler;
+            void (*thunk)(Ticker *t) = t->thunk;
+
+            timers = t->next;
+
+            if (t->period)
+            {
+                t->insert(fn, thunk, t->deadline + t->period - host_time, t->period);
+            }
+            else
+            {
+                t->handler = NULL;
+                t->thunk = NULL;
+            }
+
+            // The callback may attach the timer again, but the object and method it was attached with are left in place.
+            if (thunk)
+                thunk(t);
+            else
+                fn();
+        }
+        else
+        {
+            // Lower interrupt numbers take precedence, as on the NVIC.
+            int irq = 0;
+
+            while (!(ready & (1 << irq)))
+                irq++;
+
+            nvic_pending &= ~(1 << irq);
+            host_irq_vector(irq);
+        }
+
+        host_irq_active = 0;
+    }
+}
+
+void host_clock_advance(uint64_t us)
+{
+    uint64_t target = host_time + us;
+
+    while (true)
+    {
+        // Peripheral events happen regardless of the processor's state. Timer callbacks wait until they can be taken.
+        uint64_t event = events != NULL ? events->deadline : target + 1;
+        uint64_t timer = timers != NULL && host_interruptible() ? timers->deadline : target + 1;
+
+        if (event > target && timer > target)
+            break;
+
+        if (event <= timer)
+        {
+            HostEvent *e = events;
+
+            if (e->deadline > host_time)
+                host_time = e->deadline;
+
+            events = e->next;
+            e->next = NULL;
+            e->scheduled = 0;
+            e->handler(e->context);
+        }
+        else if (timer > host_time)
+        {
+            host_time = timer;
+        }
+
+        if (host_interruptible() && host_irq_ready())
+            host_clock_dispatch();
+    }
+
+    host_time = target;
+
+    if (host_irq_ready())
+        host_clock_dispatch();
+}
+
+int host_clock_next()
+{
+    uint64_t next;
+
+    if (host_interruptible() && host_irq_ready())
+    {
+        host_clock_dispatch();
+        return 1;
+    }
+
+    if (events == NULL && timers == NULL)
+        return 0;
+
+    next = events != NULL ? events->deadline : timers->deadline;
+
+    if (timers != NULL && timers->deadline < next)
+        next = timers->deadline;
+
+    host_clock_advance(next > host_time ? next - host_time : 0);
+
+    return 1;
+}
+
+void host_register_poll()
+{
+    host_clock_advance(1);
+}
+
+void host_event_schedule(HostEvent &e, uint64_t delay)
+{
+    HostEvent **p = &events;
+
+    host_event_cancel(e);
+
+    e.deadline = host_time + delay;
+    e.scheduled = 1;
+
+    while (*p != NULL && (*p)->deadline <= e.deadline)
+        p = &(*p)->next;
+
+    e.next = *p;
+    *p = &e;
+}
+
+void host_event_cancel(HostEvent &e)
+{
+    HostEvent **p = &events;
+
+    while (*p != NULL && *p != &e)
+        p = &(*p)->next;
+
+    if (*p != NULL)
+        *p = e.next;
+
+    e.next = NULL;
+    e.scheduled = 0;
+}
+
+void host_irq_raise(IRQn_Type irq)
+{
+    // Peripheral events are called from the clock, which takes the interrupt once the event is complete.
+    nvic_pending |= 1 << irq;
+    host_irq_pending = 1;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+    nvic_enabled |= 1 << irq;
+
+    if (nvic_pending & nvic_enabled)
+        host_clock_dispatch();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq)
+{
+    nvic_enabled &= ~(1 << irq);
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq)
+{
+    nvic_pending |= 1 << irq;
+
+    if (nvic_pending & nvic_enabled)
+        host_clock_dispatch();
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq)
+{
+    nvic_pending &= ~(1 << irq);
+}
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type irq)
+{
+    return (nvic_pending >> irq) & 1;
+}
+
+void NVIC_SetPriority(IRQn_Type, uint32_t)
+{
+    // All peripheral interrupts share a single priority on the host.
+}
+
+void NVIC_SystemReset()
+{
+    fprintf(stderr, "host: system reset at %llu us\n", (unsigned long long) host_time);
+    abort();
+}
+
+uint64_t host_clock_now()
+{
+    return host_time;
+}
+
+void host_pin_write(PinName pin, int value)
+{
+    if (value)
+        pins |= 1 << pin;
+    else
+        pins &= ~(1 << pin);
+}
+
+int host_pin_read(PinName pin)
+{
+    return (pins >> pin) & 1;
+}
+
+int DigitalIn::read()
+{
+    return host_pin_read(pin);
+}
+
+uint32_t host_gpio_read()
+{
+    return outputs;
+}
+
+void host_gpio_on_write(void (*handler)(uint32_t outputs))
+{
+    gpio_handler = handler;
+}
+
+/**
+  * Drives the given outputs of the GPIO port.
+  */
+static void host_gpio_write(uint32_t mask, uint32_t value)
+{
+    outputs = (outputs & ~mask) | (value & mask);
+
+    if (gpio_handler)
+        gpio_handler(outputs);
+}
+
+void DigitalOut::write(int value)
+{
+    host_gpio_write(1 << pin, value ? 0xFFFFFFFF : 0);
+}
+
+int DigitalOut::read()
+{
+    return (outputs >> pin) & 1;
+}
+
+void PortOut::write(int value)
+{
+    host_gpio_write(mask, value);
+}
+
+int PortOut::read()
+{
+    return outputs & mask;
+}
+
+int PortIn::read()
+{
+    return pins & mask;
+}
+
+/**
+  * Runs the host's entry function. Called on the system stack.
+  */
+static void host_trampoline()
+{
+    host_result = host_entry();
+}
+
+int host_main(int (*entry_fn)(void))
+{
+    void *heap;
+
+    // Keep the native heap below 4GB, alongside our static data.
+    mallopt(M_MMAP_MAX, 0);
+
+    heap = native_malloc(HOST_HEAP_SIZE);
+    host_stack_base = (uint32_t) (uintptr_t) (host_stack + HOST_STACK_SIZE);
+
+    if (heap == NULL || (uintptr_t) heap + HOST_HEAP_SIZE > 0xFFFFFFFF || (uintptr_t) host_stack + HOST_STACK_SIZE > 0xFFFFFFFF)
+    {
+        fprintf(stderr, "host: memory is not addressable in 32 bits. Is this a non-PIE build?\n");
+        return MICROBIT_NO_RESOURCES;
+    }
+
+    microbit_create_heap((uint32_t) (uintptr_t) heap, (uint32_t) (uintptr_t) heap + HOST_HEAP_SIZE);
+
+    // Run the entry function on the system stack, as the main fiber.
+    host_entry = entry_fn;
+
+    getcontext(&host_context);
+    host_context.uc_stack.ss_sp = host_stack;
+    host_context.uc_stack.ss_size = HOST_STACK_SIZE;
+    host_context.uc_link = &native_context;
+    makecontext(&host_context, host_trampoline, 0);
+
+    swapcontext(&native_context, &host_context);
+
+    return host_result;
+}
+
+bool ble_running()
+{
+    return false;
+}
+
+void microbit_panic(int statusCode)
+{
+    fprintf(stderr, "host: panic %d at %llu us\n", statusCode, (unsigned long long) host_time);
+    abort();
+}
+
+void microbit_panic_timeout(int)
+{
+    // Host panics always abort, so there is no timeout to configure.
+}
@@ -0,0 +1,2190 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Benchmark and regression harness for host native builds of the micro:bit runtime.
+  *
+  * Each case runs on the main fiber of a host runtime with a virtual clock, so that the sequence of
+  * events (and hence the result) is the same on every run. Cases check their results, and report the
+  * wall clock time taken per operation, allowing throughput to be compared between builds.
+  *
+  * Usage: microbit-dal-host-bench [case name]
+  */
+
+#include <time.h>
+#include <stdarg.h>
+
+#include "MicroBitHost.h"
+#include "us_ticker_api.h"
+#include "MicroBitFiber.h"
+#include "MicroBitMessageBus.h"
+#include "MicroBitSystemTimer.h"
+#include "MicroBitFixedMath.h"
+#include "ManagedString.h"
+#include "MicroBitImage.h"
+#include "MicroBitPackedImage.h"
+#include "MicroBitDisplay.h"
+#include "PacketBuffer.h"
+#include "Matrix.h"
+#include "MicroBitI2C.h"
+#include "MicroBitAccelerometer.h"
+#include "MicroBitCompass.h"
+#include "MicroBitCompassCalibrator.h"
+#include "Matrix4.h"
+#include "MicroBitStorage.h"
+#include "MicroBitRadio.h"
+#include "MicroBitSerial.h"
+#include "MicroBitSerialFramer.h"
+#include "ErrorNo.h"
+
+#define CHECK(cond)                                                                     \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(cond))                                                                    \
+        {                                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            return 1;                                                                   \
+        }                                                                               \
+    } while (0)
+
+/**
+  * A single benchmark. Returns zero on success, and sets ops to the number of operations performed.
+  */
+struct BenchCase
+{
+    const char *name;
+    int (*run)(int &ops);
+};
+
+static MicroBitMessageBus *bus = NULL;
+static MicroBitI2C *i2c = NULL;
+static MicroBitRadio *radio = NULL;
+static MicroBitSerial *serial = NULL;
+static MicroBitSerialFramer *framer = NULL;
+static const char *selected = NULL;
+static char detail[128];
+
+/**
+  * Records a further result of the running case, reported after its timings.
+  */
+static void bench_detail(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(detail, sizeof(detail), format, args);
+    va_end(args);
+}
+
+/**
+  * Determines the current wall clock time, in nanoseconds.
+  */
+static uint64_t wall_time()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/**
+  * A deterministic pseudo random sequence, independent of the host's C library.
+  */
+static uint32_t lcg_state = 1;
+
+static uint32_t lcg()
+{
+    lcg_state = lcg_state * 1664525 + 1013904223;
+
+    return lcg_state >> 8;
+}
+
+//
+// Fiber scheduler.
+//
+
+static int wakeCount = 0;
+static int wakeOrder[3];
+static uint64_t wakeTime[3];
+
+static void sleeper(void *param)
+{
+    int t = (int) (uintptr_t) param;
+
+    fiber_sleep(t);
+
+    wakeOrder[wakeCount] = t;
+    wakeTime[wakeCount] = system_timer_current_time();
+    wakeCount++;
+}
+
+static int bench_fiber_sleep(int &ops)
+{
+    uint64_t start = system_timer_current_time();
+
+    wakeCount = 0;
+    create_fiber(sleeper, (void *) 30);
+    create_fiber(sleeper, (void *) 10);
+    create_fiber(sleeper, (void *) 20);
+
+    for (int i = 0; i < 100 && wakeCount < 3; i++)
+        fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+    CHECK(wakeCount == 3);
+
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(wakeOrder[i] == (i + 1) * 10);
+        CHECK(wakeTime[i] >= start + wakeOrder[i]);
+        CHECK(wakeTime[i] <= start + wakeOrder[i] + SYSTEM_TICK_PERIOD_MS);
+    }
+
+    ops = 3;
+    return 0;
+}
+
+static int sleepersDone = 0;
+static uint64_t sleepersLate = 0;
+
+static void long_sleeper(void *param)
+{
+    int t = (int) (uintptr_t) param;
+    uint64_t due = system_timer_current_time() + t;
+
+    fiber_sleep(t);
+
+    if (system_timer_current_time() - due > sleepersLate)
+        sleepersLate = system_timer_current_time() - due;
+
+    sleepersDone++;
+}
+
+static int bench_tick_cost(int &ops)
+{
+    static const int sleeping[] = { 0, 50, 200 };
+    double cost[3];
+    int created = 0;
+
+    sleepersDone = 0;
+    sleepersLate = 0;
+    lcg_state = 1;
+
+    for (int c = 0; c < 3; c++)
+    {
+        // Add sleepers with a spread of deadlines, all after the measurement.
+        while (created < sleeping[c])
+        {
+            create_fiber(long_sleeper, (void *) (uintptr_t) (1000 + lcg() % 1000));
+            created++;
+        }
+
+        schedule();
+
+        // The tick should only look at the head of the sleep queue, so cost the same however many fibers are asleep.
+        uint64_t start = wall_time();
+
+        for (int i = 0; i < 10000; i++)
+            scheduler_tick();
+
+        cost[c] = (wall_time() - start) / 10000.0;
+        CHECK(sleepersDone == 0);
+    }
+
+    // Let every sleeper wake, each in the tick after its deadline.
+    fiber_sleep(2000 + SYSTEM_TICK_PERIOD_MS);
+    CHECK(sleepersDone == created);
+    CHECK(sleepersLate <= SYSTEM_TICK_PERIOD_MS);
+
+    bench_detail("%.1f / %.1f / %.1f ns per tick with 0 / 50 / 200 fibers asleep", cost[0], cost[1], cost[2]);
+
+    ops = 30000;
+    return 0;
+}
+
+static volatile int pingCount = 0;
+
+static void pinger()
+{
+    while (pingCount < 100000)
+    {
+        pingCount++;
+        schedule();
+    }
+}
+
+static int bench_context_switch(int &ops)
+{
+    pingCount = 0;
+    create_fiber(pinger);
+
+    while (pingCount < 100000)
+        schedule();
+
+    // Let the other fiber run to completion.
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+    ops = 2 * pingCount;
+    return 0;
+}
+
+static int waiterCount = 0;
+
+static void waiter()
+{
+    if (fiber_wait_for_event(100, 1) == MICROBIT_OK)
+        waiterCount++;
+}
+
+static int bench_wait_for_event(int &ops)
+{
+    waiterCount = 0;
+
+    for (int i = 0; i < 4; i++)
+        create_fiber(waiter);
+
+    // Let the waiters block, then raise a non matching and a matching event.
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+    MicroBitEvent(100, 2);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    CHECK(waiterCount == 0);
+
+    MicroBitEvent(100, 1);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    CHECK(waiterCount == 4);
+
+    ops = 4;
+    return 0;
+}
+
+static int wokenCount = 0;
+static bool waitersStop = false;
+static uint64_t wokenAt;
+
+static void wake_waiter(void *param)
+{
+    uint16_t id = (uint16_t) (uintptr_t) param;
+
+    while (!waitersStop)
+    {
+        fiber_wait_for_event(id, 1);
+
+        wokenAt = wall_time();
+        wokenCount++;
+    }
+}
+
+static void any_waiter()
+{
+    if (fiber_wait_for_event(MICROBIT_ID_ANY, MICROBIT_EVT_ANY) == MICROBIT_OK)
+        waiterCount++;
+}
+
+static int bench_wake_latency(int &ops)
+{
+    static const int counts[] = { 1, 8, 64 };
+    double latency[3];
+    int blocked = 0;
+
+    wokenCount = 0;
+    waitersStop = false;
+
+    for (int c = 0; c < 3; c++)
+    {
+        uint64_t total = 0;
+
+        // Block more fibers, each on its own event ID.
+        while (blocked < counts[c])
+            create_fiber(wake_waiter, (void *) (uintptr_t) (3000 + blocked++));
+
+        fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+        // Wake each fiber in turn, timing from the event being raised to the fiber running.
+        for (int i = 0; i < 1000; i++)
+        {
+            uint64_t start = wall_time();
+
+            MicroBitEvent(3000 + i % blocked, 1);
+            schedule();
+
+            total += wokenAt - start;
+        }
+
+        latency[c] = total / 1000.0;
+    }
+
+    CHECK(wokenCount == 3000);
+
+    waitersStop = true;
+
+    for (int i = 0; i < blocked; i++)
+        MicroBitEvent(3000 + i, 1);
+
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    CHECK(wokenCount == 3000 + blocked);
+
+    // A fiber waiting on any event is woken by the next one, after which the listener for any event is dropped.
+    waiterCount = 0;
+    create_fiber(any_waiter);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    CHECK(waiterCount == 0);
+
+    MicroBitEvent(3000, 2);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    CHECK(waiterCount == 1);
+
+    for (MicroBitListener *l = bus->elementAt(0); l != NULL; l = l->next)
+        CHECK(l->id != MICROBIT_ID_ANY);
+
+    bench_detail("%.1f / %.1f / %.1f ns to wake one of 1 / 8 / 64 blocked fibers", latency[0], latency[1], latency[2]);
+
+    ops = 3000;
+    return 0;
+}
+
+//
+// Message bus.
+//
+
+static int handled = 0;
+
+static void counting_handler(MicroBitEvent)
+{
+    handled++;
+}
+
+static void blocking_handler(MicroBitEvent)
+{
+    fiber_sleep(10);
+    handled++;
+}
+
+static int bench_bus_immediate(int &ops)
+{
+    handled = 0;
+    bus->listen(200, MICROBIT_EVT_ANY, counting_handler, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    for (int i = 0; i < 100000; i++)
+        MicroBitEvent(200, i & 0xFF);
+
+    bus->ignore(200, MICROBIT_EVT_ANY, counting_handler);
+    CHECK(handled == 100000);
+
+    ops = 100000;
+    return 0;
+}
+
+static int bench_bus_dispatch_cost(int &ops)
+{
+    static const int counts[] = { 1, 16, 64, 256 };
+    double cost[4];
+    MicroBitHeapStatistics before, after;
+    int registered = 0;
+
+    handled = 0;
+
+    for (int c = 0; c < 4; c++)
+    {
+        // Add listeners on distinct IDs, so the index grows with them.
+        while (registered < counts[c])
+            bus->listen(2000 + registered++, MICROBIT_EVT_ANY, counting_handler, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+        // Raise events for the last listener, which a walk of the chain would find last.
+        uint64_t start = wall_time();
+
+        for (int i = 0; i < 10000; i++)
+            MicroBitEvent(2000 + registered - 1, 1);
+
+        cost[c] = (wall_time() - start) / 10000.0;
+    }
+
+    CHECK(handled == 40000);
+
+    for (int i = 0; i < registered; i++)
+        bus->ignore(2000 + i, MICROBIT_EVT_ANY, counting_handler);
+
+    // Let the idle thread delete the listeners, and check nothing else fires.
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    MicroBitEvent(2000, 1);
+    CHECK(handled == 40000);
+
+    // A second round of the same listeners should reuse the index, and leave the heap as it was.
+    microbit_heap_statistics(before);
+
+    for (int i = 0; i < registered; i++)
+        bus->listen(2000 + i, MICROBIT_EVT_ANY, counting_handler, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    for (int i = 0; i < registered; i++)
+        bus->ignore(2000 + i, MICROBIT_EVT_ANY, counting_handler);
+
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    microbit_heap_statistics(after);
+    CHECK(after.used == before.used);
+
+    bench_detail("%.1f / %.1f / %.1f / %.1f ns per event with 1 / 16 / 64 / 256 listeners", cost[0], cost[1], cost[2], cost[3]);
+
+    ops = 40000;
+    return 0;
+}
+
+static int bench_bus_queued(int &ops)
+{
+    handled = 0;
+    bus->listen(201, MICROBIT_EVT_ANY, counting_handler);
+
+    // Raise events in batches no larger than the event queue, and let the idle thread deliver them.
+    for (int i = 0; i < 1000; i++)
+    {
+        for (int j = 0; j < 8; j++)
+            MicroBitEvent(201, j);
+
+        fiber_sleep(0);
+    }
+
+    bus->ignore(201, MICROBIT_EVT_ANY, counting_handler);
+    CHECK(handled == 8000);
+
+    ops = 8000;
+    return 0;
+}
+
+static int bench_bus_fork_on_block(int &ops)
+{
+    handled = 0;
+    bus->listen(202, MICROBIT_EVT_ANY, blocking_handler);
+
+    // Each handler blocks, so is forked onto a fiber of its own. Later events queue behind it.
+    for (int i = 0; i < 5; i++)
+        MicroBitEvent(202, i);
+
+    for (int i = 0; i < 100 && handled < 5; i++)
+        fiber_sleep(10);
+
+    bus->ignore(202, MICROBIT_EVT_ANY, blocking_handler);
+    CHECK(handled == 5);
+
+    ops = 5;
+    return 0;
+}
+
+//
+// Heap allocator.
+//
+
+static int bench_heap(int &ops)
+{
+    MicroBitHeapStatistics before, during, after;
+    void *blocks[256];
+
+    microbit_heap_statistics(before);
+    lcg_state = 1;
+
+    for (int i = 0; i < 256; i++)
+        blocks[i] = NULL;
+
+    for (int i = 0; i < 100000; i++)
+    {
+        int b = lcg() & 0xFF;
+
+        if (blocks[b] == NULL)
+        {
+            blocks[b] = malloc(4 + (lcg() % 120));
+            CHECK(blocks[b] != NULL);
+        }
+        else
+        {
+            free(blocks[b]);
+            blocks[b] = NULL;
+        }
+    }
+
+    microbit_heap_statistics(during);
+    CHECK(during.used > before.used);
+
+    for (int i = 0; i < 256; i++)
+        if (blocks[i] != NULL)
+            free(blocks[i]);
+
+    microbit_heap_statistics(after);
+    CHECK(after.used == before.used);
+    CHECK(after.free == before.free);
+
+    ops = 100000;
+    return 0;
+}
+
+/**
+  * The sizes of the runtime's most common allocations on the nrf51, in bytes, weighted by how often they
+  * are made: event queue items, short ManagedStrings, listeners, radio packets, fibers and paged out stacks.
+  * A size of zero stands for a fiber stack, whose size varies with the depth of the stack.
+  */
+static const uint16_t traceSizes[] = { 16, 16, 16, 20, 20, 28, 40, 96, 0, 0 };
+
+#define TRACE_LENGTH    20000
+#define TRACE_SLOTS     64
+
+struct TraceStep
+{
+    uint8_t slot;
+    uint16_t size;                      // The number of bytes to allocate, or zero to free the slot.
+};
+
+static TraceStep trace[TRACE_LENGTH];
+
+static int bench_heap_trace(int &ops)
+{
+    MicroBitHeapStatistics before, during, after;
+    void *blocks[TRACE_SLOTS];
+    bool live[TRACE_SLOTS];
+    uint64_t start;
+    double cost;
+
+    // Record the trace up front, so only the allocator is timed as it is replayed.
+    lcg_state = 1;
+
+    for (int i = 0; i < TRACE_SLOTS; i++)
+        live[i] = false;
+
+    for (int i = 0; i < TRACE_LENGTH; i++)
+    {
+        int b = lcg() % TRACE_SLOTS;
+
+        trace[i].slot = b;
+        trace[i].size = 0;
+
+        if (!live[b])
+        {
+            trace[i].size = traceSizes[lcg() % (sizeof(traceSizes) / sizeof(traceSizes[0]))];
+
+            if (trace[i].size == 0)
+                trace[i].size = 128 + (lcg() % 96) * 4;
+        }
+
+        live[b] = !live[b];
+    }
+
+    for (int i = 0; i < TRACE_SLOTS; i++)
+        blocks[i] = NULL;
+
+    microbit_heap_statistics(before);
+    start = wall_time();
+
+    for (int i = 0; i < TRACE_LENGTH; i++)
+    {
+        TraceStep &t = trace[i];
+
+        if (t.size)
+        {
+            blocks[t.slot] = malloc(t.size);
+            CHECK(blocks[t.slot] != NULL);
+        }
+        else
+        {
+            free(blocks[t.slot]);
+            blocks[t.slot] = NULL;
+        }
+    }
+
+    cost = (wall_time() - start) / (double) TRACE_LENGTH;
+    microbit_heap_statistics(during);
+
+    for (int i = 0; i < TRACE_SLOTS; i++)
+        if (blocks[i] != NULL)
+            free(blocks[i]);
+
+    microbit_heap_statistics(after);
+    CHECK(after.used == before.used);
+
+    bench_detail("%.1f ns per operation, %d bytes in use, largest free %d of %d bytes, %d pooled (pool limit %d words)",
+        cost, (int) (during.used - before.used), (int) during.largestFree, (int) during.free, (int) during.pooled, MICROBIT_HEAP_POOL_MAX_BLOCKS);
+
+    ops = TRACE_LENGTH;
+    return 0;
+}
+
+//
+// Fixed point math.
+//
+
+#define FIXED_MATH_VECTORS      100000
+
+static volatile int fixedSink;
+static volatile float floatSink;
+
+/**
+  * Reads the host processor's time stamp counter.
+  */
+static uint64_t host_cycles()
+{
+    return __builtin_ia32_rdtsc();
+}
+
+/**
+  * Determines the difference between two binary angles, the short way around.
+  */
+static int angle_error(int a, int b)
+{
+    int d = (int16_t) (a - b);
+
+    return d < 0 ? -d : d;
+}
+
+static int bench_fixed_math(int &ops)
+{
+    int sinError = 0, cosError = 0, atanError = 0;
+    double magnitudeError = 0;
+    uint64_t start, fixedSin, floatSin, fixedAtan, floatAtan;
+    static int16_t xs[FIXED_MATH_VECTORS], ys[FIXED_MATH_VECTORS];
+
+    // Every angle, against the C library in double precision.
+    for (int a = 0; a < 65536; a++)
+    {
+        double radians = (int16_t) a * PI / MICROBIT_FIXED_PI;
+
+        sinError = max(sinError, abs(fixed_sin(a) - (int) lround(sin(radians) * MICROBIT_FIXED_ONE)));
+        cosError = max(cosError, abs(fixed_cos(a) - (int) lround(cos(radians) * MICROBIT_FIXED_ONE)));
+    }
+
+    CHECK(sinError <= 2);
+    CHECK(cosError <= 2);
+
+    // Vectors of every direction, with lengths from 1 to beyond the range of a sample scaled up by 256 as the drivers do.
+    for (int i = 0; i < FIXED_MATH_VECTORS; i++)
+    {
+        int bits = 1 + lcg() % 30;
+        int x = (int) (lcg() & ((1u << bits) - 1)) - (1 << (bits - 1));
+        int y = (int) (lcg() & ((1u << bits) - 1)) - (1 << (bits - 1));
+        int magnitude;
+
+        if (x == 0 && y == 0)
+            continue;
+
+        int angle = fixed_atan2(y, x, &magnitude);
+        double length = sqrt((double) x * x + (double) y * y);
+
+        atanError = max(atanError, angle_error(angle, (int) lround(atan2((double) y, (double) x) * MICROBIT_FIXED_PI / PI)));
+
+        // Small vectors are rounded to a whole number of units, so only compare the larger ones.
+        if (length >= 1024)
+            magnitudeError = max(magnitudeError, fabs(magnitude - length) / length);
+    }
+
+    CHECK(atanError <= 2);
+    CHECK(magnitudeError < 0.0001);
+
+    // The cost of each, against the C library in single precision as the drivers would otherwise use.
+    for (int i = 0; i < FIXED_MATH_VECTORS; i++)
+    {
+        xs[i] = (int16_t) lcg();
+        ys[i] = (int16_t) lcg();
+    }
+
+    start = host_cycles();
+    for (int i = 0; i < FIXED_MATH_VECTORS; i++)
+        fixedSink = fixed_sin(xs[i]);
+    fixedSin = host_cycles() - start;
+
+    start = host_cycles();
+    for (int i = 0; i < FIXED_MATH_VECTORS; i++)
+        floatSink = sinf(xs[i] * (float) (PI / MICROBIT_FIXED_PI));
+    floatSin = host_cycles() - start;
+
+    start = host_cycles();
+    for (int i = 0; i < FIXED_MATH_VECTORS; i++)
+        fixedSink = fixed_atan2(ys[i], xs[i]);
+    fixedAtan = host_cycles() - start;
+
+    start = host_cycles();
+    for (int i = 0; i < FIXED_MATH_VECTORS; i++)
+        floatSink = atan2f(ys[i], xs[i]);
+    floatAtan = host_cycles() - start;
+
+    bench_detail("error sin %d / atan2 %d units, magnitude %.4f%%; host cycles sin %.0f (sinf %.0f), atan2 %.0f (atan2f %.0f)",
+        max(sinError, cosError), atanError, magnitudeError * 100,
+        (double) fixedSin / FIXED_MATH_VECTORS, (double) floatSin / FIXED_MATH_VECTORS,
+        (double) fixedAtan / FIXED_MATH_VECTORS, (double) floatAtan / FIXED_MATH_VECTORS);
+
+    ops = 2 * 65536 + 5 * FIXED_MATH_VECTORS;
+    return 0;
+}
+
+//
+// Data types.
+//
+
+static int bench_managed_string(int &ops)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        ManagedString s;
+
+        for (int j = 0; j < 10; j++)
+            s = s + ManagedString(j);
+
+        CHECK(s.length() == 10);
+        CHECK(s == ManagedString("0123456789"));
+        CHECK(s.substring(3, 4) == ManagedString("3456"));
+        CHECK(s.charAt(9) == '9');
+    }
+
+    ops = 1000;
+    return 0;
+}
+
+static int bench_image(int &ops)
+{
+    for (int i = 0; i < 10000; i++)
+    {
+        MicroBitImage a("0,255,0\n255,0,255\n");
+        MicroBitImage b(5, 5);
+
+        b.paste(a, 1, 1);
+        CHECK(b.getPixelValue(2, 1) == 255);
+        CHECK(b.getPixelValue(1, 2) == 255);
+        CHECK(b.getPixelValue(1, 1) == 0);
+
+        b.shiftLeft(1);
+        CHECK(b.getPixelValue(1, 1) == 255);
+
+        b.print('A');
+        CHECK(b == b.clone());
+    }
+
+    ops = 10000;
+    return 0;
+}
+
+/**
+  * Determines if a packed image holds the same pixels as a black and white MicroBitImage, through each
+  * of the ways it can be read.
+  */
+static bool packed_matches(MicroBitPackedImage &packed, MicroBitImage &image)
+{
+    if (packed.getWidth() != image.getWidth() || packed.getHeight() != image.getHeight())
+        return false;
+
+    for (int y = 0; y < image.getHeight(); y++)
+        for (int x = 0; x < image.getWidth(); x++)
+            if (packed.getPixelValue(x, y) != image.getPixelValue(x, y))
+                return false;
+
+    return MicroBitPackedImage(image) == packed && packed.toImage() == image;
+}
+
+/**
+  * Fills a MicroBitImage with a random black and white pattern.
+  */
+static void random_image(MicroBitImage &image)
+{
+    for (int y = 0; y < image.getHeight(); y++)
+        for (int x = 0; x < image.getWidth(); x++)
+            image.setPixelValue(x, y, (lcg() & 1) ? 255 : 0);
+}
+
+/**
+  * Times the given number of repeats of an operation on a packed and a byte image. Returns the time per operation in nanoseconds.
+  */
+#define IMAGE_OP_COST(result, repeats, op) \
+    do { \
+        uint64_t start = wall_time(); \
+        for (int i = 0; i < (repeats); i++) \
+        { \
+            op; \
+        } \
+        result = (wall_time() - start) / (double) (repeats); \
+    } while (0)
+
+static int bench_packed_image(int &ops)
+{
+    static const int16_t widths[] = {1, 5, 31, 32, 33, 64, 70};
+    double packedShift, byteShift, packedPaste, bytePaste, packedCompare, byteCompare;
+    int steps = 0;
+
+    // Apply the same random operations to a packed image and a MicroBitImage, which must always agree.
+    for (unsigned int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        int16_t width = widths[w];
+        int16_t height = 1 + lcg() % 9;
+        MicroBitImage image(width, height);
+        MicroBitPackedImage packed(width, height);
+
+        CHECK(packed_matches(packed, image));
+
+        random_image(image);
+        packed = MicroBitPackedImage(image);
+        CHECK(packed_matches(packed, image));
+
+        for (int i = 0; i < 500; i++, steps++)
+        {
+            int x = (int) (lcg() % (width + 4)) - 2;
+            int y = (int) (lcg() % (height + 4)) - 2;
+            int n = lcg() % (width + 2);
+
+            switch (lcg() % 7)
+            {
+                case 0:
+                {
+                    uint8_t value = (lcg() & 1) ? 255 : 0;
+                    CHECK(packed.setPixelValue(x, y, value) == image.setPixelValue(x, y, value));
+                    break;
+                }
+
+                case 1:
+                    CHECK(packed.shiftLeft(n) == image.shiftLeft(n));
+                    break;
+
+                case 2:
+                    CHECK(packed.shiftRight(n) == image.shiftRight(n));
+                    break;
+
+                case 3:
+                    n = lcg() % (height + 2);
+                    CHECK(packed.shiftUp(n) == image.shiftUp(n));
+                    break;
+
+                case 4:
+                    n = lcg() % (height + 2);
+                    CHECK(packed.shiftDown(n) == image.shiftDown(n));
+                    break;
+
+                case 5:
+                {
+                    MicroBitImage source(1 + lcg() % (width + 40), 1 + lcg() % (height + 2));
+                    uint8_t alpha = lcg() & 1;
+
+                    random_image(source);
+                    x = (int) (lcg() % (width + source.getWidth() + 2)) - source.getWidth();
+                    y = (int) (lcg() % (height + source.getHeight() + 2)) - source.getHeight();
+
+                    CHECK(packed.paste(MicroBitPackedImage(source), x, y, alpha) == image.paste(source, x, y, alpha));
+                    break;
+                }
+
+                case 6:
+                {
+                    // MicroBitImage::crop() doesn't handle every region, so the crop is checked against our own pixels.
+                    int cropWidth = 1 + lcg() % (width + 2);
+                    int cropHeight = 1 + lcg() % (height + 2);
+                    MicroBitPackedImage cropped = packed.crop(x, y, cropWidth, cropHeight);
+
+                    CHECK(cropped.getWidth() == min(x + cropWidth, (int) width) - max(x, 0) || cropped.getWidth() == 0);
+
+                    for (int cy = 0; cy < cropped.getHeight(); cy++)
+                        for (int cx = 0; cx < cropped.getWidth(); cx++)
+                            CHECK(cropped.getPixelValue(cx, cy) == image.getPixelValue(max(x, 0) + cx, max(y, 0) + cy));
+
+                    break;
+                }
+            }
+
+            CHECK(packed_matches(packed, image));
+        }
+    }
+
+    // The cost of shifting, pasting and comparing a 64x16 image, a word at a time and a byte at a time.
+    {
+        MicroBitImage image(64, 16), source(16, 8), other(64, 16);
+
+        random_image(image);
+        random_image(source);
+
+        MicroBitPackedImage packed(image), packedSource(source), packedOther(image);
+        bool same = true;
+
+        IMAGE_OP_COST(packedShift, 100000, packed.shiftLeft(1 + (i & 7)));
+        IMAGE_OP_COST(byteShift, 100000, image.shiftLeft(1 + (i & 7)));
+        IMAGE_OP_COST(packedPaste, 100000, packed.paste(packedSource, i & 63, i & 15, 1));
+        IMAGE_OP_COST(bytePaste, 100000, image.paste(source, i & 63, i & 15, 1));
+
+        other = image.clone();
+        packedOther = MicroBitPackedImage(image);
+        CHECK(packed_matches(packedOther, image));
+
+        IMAGE_OP_COST(packedCompare, 100000, same &= (packed == packedOther));
+        IMAGE_OP_COST(byteCompare, 100000, same &= (image == other));
+        CHECK(same);
+    }
+
+    bench_detail("packed / byte ns at 64x16: shift %.0f / %.0f, paste %.0f / %.0f, compare %.0f / %.0f",
+        packedShift, byteShift, packedPaste, bytePaste, packedCompare, byteCompare);
+
+    ops = steps;
+    return 0;
+}
+
+static int bench_packet_buffer(int &ops)
+{
+    for (int i = 0; i < 10000; i++)
+    {
+        PacketBuffer a(32);
+
+        for (int j = 0; j < 32; j++)
+            a.setByte(j, j);
+
+        PacketBuffer b = a;
+        PacketBuffer c(a.getBytes(), a.length());
+
+        CHECK(b == a);
+        CHECK(c == a);
+
+        c[0] = 0xFF;
+        CHECK(!(c == a));
+        CHECK(a.getByte(31) == 31);
+        CHECK(a.setByte(32, 0) == MICROBIT_INVALID_PARAMETER);
+    }
+
+    ops = 10000;
+    return 0;
+}
+
+//
+// Drivers, running against the simulated peripherals.
+//
+
+static uint32_t displaySeen = 0;
+
+/**
+  * Records the LEDs lit by each write to the display's GPIO pins, a bit per (row, column).
+  */
+static void display_watch(uint32_t outputs)
+{
+    for (int row = 0; row < microbitMatrixMap.rows; row++)
+        if (outputs & (1 << (microbitMatrixMap.rowStart + row)))
+            for (int col = 0; col < microbitMatrixMap.columns; col++)
+                if (!(outputs & (1 << (microbitMatrixMap.columnStart + col))))
+                    displaySeen |= 1 << (row * microbitMatrixMap.columns + col);
+}
+
+/**
+  * Determines if the LED at the given position was lit since displaySeen was last cleared.
+  */
+static bool display_seen(int x, int y)
+{
+    for (int row = 0; row < microbitMatrixMap.rows; row++)
+        for (int col = 0; col < microbitMatrixMap.columns; col++)
+        {
+            const MatrixPoint &p = microbitMatrixMap.map[col * microbitMatrixMap.rows + row];
+
+            if (p.x == x && p.y == y)
+                return (displaySeen >> (row * microbitMatrixMap.columns + col)) & 1;
+        }
+
+    return false;
+}
+
+/**
+  * Times the given number of display ticks, calling the display directly. Returns the time per tick in nanoseconds.
+  */
+static double display_tick_cost(MicroBitDisplay *display, int ticks, bool modify)
+{
+    uint64_t start = wall_time();
+
+    for (int i = 0; i < ticks; i++)
+    {
+        if (modify)
+            display->image.setPixelValue(i % 5, 0, 255);
+
+        display->systemTick();
+    }
+
+    return (wall_time() - start) / (double) ticks;
+}
+
+static int bench_display_render(int &ops)
+{
+    // The display is used from interrupt context, so must not be on a fiber's stack.
+    MicroBitDisplay *display = new MicroBitDisplay();
+    double unchanged, modified, shared, greyscale, bitmap;
+    uint64_t start;
+    uint8_t *p;
+
+    host_gpio_on_write(display_watch);
+
+    // A pixel set through the display's own image is shown within a frame or two.
+    display->image.setPixelValue(1, 2, 255);
+    fiber_sleep(2 * SYSTEM_TICK_PERIOD_MS * microbitMatrixMap.rows);
+    displaySeen = 0;
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS * microbitMatrixMap.rows);
+    CHECK(display_seen(1, 2) && !display_seen(3, 3));
+
+    // As is one set through another reference to the same bitmap, which the display's generation doesn't count.
+    {
+        MicroBitImage alias = display->image;
+
+        CHECK(alias.isShared());
+        alias.setPixelValue(3, 3, 255);
+        fiber_sleep(2 * SYSTEM_TICK_PERIOD_MS * microbitMatrixMap.rows);
+        displaySeen = 0;
+        fiber_sleep(SYSTEM_TICK_PERIOD_MS * microbitMatrixMap.rows);
+        CHECK(display_seen(1, 2) && display_seen(3, 3));
+    }
+
+    CHECK(!display->image.isShared());
+    host_gpio_on_write(NULL);
+
+    // The cost of a tick, with the patterns cached, recomputed after each change, and recomputed as the image is shared.
+    unchanged = display_tick_cost(display, 100000, false);
+    modified = display_tick_cost(display, 100000, true);
+
+    {
+        MicroBitImage alias = display->image;
+        shared = display_tick_cost(display, 100000, false);
+    }
+
+    display->setDisplayMode(DISPLAY_MODE_GREYSCALE);
+    greyscale = display_tick_cost(display, 100000, false);
+    display->setDisplayMode(DISPLAY_MODE_BLACK_AND_WHITE);
+
+    start = wall_time();
+
+    for (int i = 0; i < 1000000; i++)
+    {
+        p = display->image.getBitmap();
+        __asm__ volatile("" : : "r" (p) : "memory");
+    }
+
+    bitmap = (wall_time() - start) / 1000000.0;
+
+    delete display;
+
+    bench_detail("%.0f / %.0f / %.0f ns per tick unchanged / modified / shared, %.0f greyscale, %.1f ns per getBitmap()",
+        unchanged, modified, shared, greyscale, bitmap);
+
+    ops = 400000;
+    return 0;
+}
+
+static uint32_t greyscaleOutputs = 0;
+static uint32_t greyscaleLast = 0;
+static uint32_t greyscaleShortest = 0xFFFFFFFF;
+static uint32_t greyscaleWrites = 0;
+static uint32_t greyscaleStrobes = 0;
+static int greyscaleRow = -1;
+static int greyscaleLit[MICROBIT_DISPLAY_COLUMN_COUNT];
+static int greyscaleExpected[MICROBIT_DISPLAY_ROW_COUNT * MICROBIT_DISPLAY_COLUMN_COUNT];
+static int greyscaleWorst = 0;
+static int greyscaleBest = 0;
+
+/**
+  * Times how long each LED is lit for during each complete strobe of its row, tracking the range of errors
+  * from its expected on time, and the shortest time between two writes to the display's pins.
+  */
+static void greyscale_watch(uint32_t outputs)
+{
+    uint32_t now = us_ticker_read();
+
+    if (greyscaleRow >= 0)
+        for (int col = 0; col < microbitMatrixMap.columns; col++)
+            if (!(greyscaleOutputs & (1 << (microbitMatrixMap.columnStart + col))))
+                greyscaleLit[col] += now - greyscaleLast;
+
+    for (int row = 0; row < microbitMatrixMap.rows; row++)
+    {
+        uint32_t bit = 1 << (microbitMatrixMap.rowStart + row);
+
+        if (!(outputs & bit) || (greyscaleOutputs & bit))
+            continue;
+
+        // A new row is starting, so the last one is complete.
+        if (greyscaleRow >= 0)
+        {
+            for (int col = 0; col < microbitMatrixMap.columns; col++)
+            {
+                int error = greyscaleLit[col] - greyscaleExpected[greyscaleRow * microbitMatrixMap.columns + col];
+
+                greyscaleWorst = max(greyscaleWorst, error);
+                greyscaleBest = min(greyscaleBest, error);
+            }
+
+            greyscaleStrobes++;
+        }
+
+        memset(greyscaleLit, 0, sizeof(greyscaleLit));
+        greyscaleRow = row;
+    }
+
+    if (greyscaleWrites && now - greyscaleLast < greyscaleShortest)
+        greyscaleShortest = now - greyscaleLast;
+
+    greyscaleOutputs = outputs;
+    greyscaleLast = now;
+    greyscaleWrites++;
+}
+
+static int bench_display_greyscale(int &ops)
+{
+    // The on time of each bit of a pixel's brightness, as rendered by the display.
+    static const int timings[MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH] = {1, 23, 70, 163, 351, 726, 1476, 2976};
+    static const uint8_t levels[] = {0, 1, 2, 3, 8, 24, 25, 64, 100, 128, 160, 200, 254, 255};
+
+    // The display is used from interrupt context, so must not be on a fiber's stack.
+    MicroBitDisplay *display = new MicroBitDisplay();
+    int frames = 200;
+
+    for (int y = 0; y < 5; y++)
+        for (int x = 0; x < 5; x++)
+            display->image.setPixelValue(x, y, levels[(y * 5 + x) % sizeof(levels)]);
+
+    for (int row = 0; row < microbitMatrixMap.rows; row++)
+        for (int col = 0; col < microbitMatrixMap.columns; col++)
+        {
+            const MatrixPoint &p = microbitMatrixMap.map[col * microbitMatrixMap.rows + row];
+            uint8_t level = display->image.getPixelValue(p.x, p.y);
+            int expected = 0;
+
+            for (int bit = 0; bit < MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH; bit++)
+                if (level & (1 << bit))
+                    expected += timings[bit];
+
+            greyscaleExpected[row * microbitMatrixMap.columns + col] = expected;
+        }
+
+    display->setDisplayMode(DISPLAY_MODE_GREYSCALE);
+    fiber_sleep(2 * SYSTEM_TICK_PERIOD_MS * microbitMatrixMap.rows);
+
+    greyscaleOutputs = host_gpio_read();
+    greyscaleLast = us_ticker_read();
+    host_gpio_on_write(greyscale_watch);
+
+    fiber_sleep(frames * SYSTEM_TICK_PERIOD_MS * microbitMatrixMap.rows);
+
+    host_gpio_on_write(NULL);
+    display->setDisplayMode(DISPLAY_MODE_BLACK_AND_WHITE);
+    delete display;
+
+    // Every pixel is lit for its brightness' share of each strobe, stretched by at most the render timer's latency,
+    // and nothing is ever scheduled closer together than the render timer can manage.
+    CHECK(greyscaleStrobes >= (uint32_t) (frames - 1) * microbitMatrixMap.rows);
+    CHECK(greyscaleBest >= 0 && greyscaleWorst < MICROBIT_DISPLAY_TIMER_LATENCY_US);
+    CHECK(greyscaleShortest >= MICROBIT_DISPLAY_TIMER_LATENCY_US);
+
+    bench_detail("%.1f timer interrupts per strobe, shortest %u us apart, on time error %d..%d us",
+        (greyscaleWrites - greyscaleStrobes) / (double) greyscaleStrobes, (unsigned) greyscaleShortest,
+        greyscaleBest, greyscaleWorst);
+
+    ops = greyscaleStrobes;
+    return 0;
+}
+
+static int bench_i2c(int &ops)
+{
+    // Simulated devices are used from interrupt context, so must not be on a fiber's stack.
+    HostI2CDevice *device = new HostI2CDevice(0x3A);
+    HostI2CStatistics before, after;
+    uint8_t data[6];
+    uint8_t value = 0x55;
+    char buffer[2] = { 0x11, 0x66 };
+
+    for (int i = 0; i < 256; i++)
+        device->registers[i] = i;
+
+    host_i2c_statistics(before);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        uint8_t reg = i & 0x7F;
+
+        CHECK(i2c->readRegister(0x3A, reg, data, 6) == MICROBIT_OK);
+
+        for (int j = 0; j < 6; j++)
+            CHECK(data[j] == reg + j);
+    }
+
+    // Each read sends the address, the register, and the address again before the data.
+    host_i2c_statistics(after);
+    CHECK(after.bytes - before.bytes == 1000 * 9);
+    CHECK(after.errors == before.errors);
+
+    bench_detail("%llu us bus time per 6 byte read", (unsigned long long) (after.busyTime - before.busyTime) / 1000);
+
+    // Writes, through the queue and the blocking interface.
+    CHECK(i2c->writeRegister(0x3A, 0x10, &value, 1) == MICROBIT_OK);
+    CHECK(device->registers[0x10] == 0x55);
+
+    CHECK(i2c->write(0x3A, buffer, 2) == MICROBIT_OK);
+    CHECK(device->registers[0x11] == 0x66);
+
+    CHECK(i2c->write(0x3A, buffer, 1, true) == MICROBIT_OK);
+    CHECK(i2c->read(0x3A, buffer, 1) == MICROBIT_OK);
+    CHECK(buffer[0] == 0x66);
+
+    // Errors are retried, and devices that never answer are reported.
+    host_i2c_fail(1);
+    CHECK(i2c->readRegister(0x3A, 0x20, data, 6) == MICROBIT_OK);
+    CHECK(data[0] == 0x20);
+    CHECK(i2c->readRegister(0x1C, 0, data, 6) == MICROBIT_I2C_ERROR);
+    CHECK(i2c->read(0x1C, buffer, 1) == MICROBIT_I2C_ERROR);
+
+    delete device;
+
+    ops = 1000;
+    return 0;
+}
+
+/**
+  * An accelerometer that reports the number of each sample in its X axis, so that a reader's gaps can be counted.
+  */
+class SequencedMMA8653 : public HostMMA8653
+{
+    public:
+
+    virtual void sample()
+    {
+        x = (samples % 128) << 2;
+    }
+};
+
+/**
+  * What a reader of the accelerometer's sample buffer saw.
+  */
+struct AccelRun
+{
+    int taken;                                  // Samples taken by the device whilst reading.
+    int read;                                   // Samples read from the buffer.
+    int missed;                                 // Samples absent from the sequence read.
+    int estimated;                              // The driver's count of lost samples.
+    uint32_t transactions;                      // I2C transactions issued whilst reading.
+};
+
+#define ACCEL_RUN_MS            600
+#define ACCEL_READ_MS           10
+#define ACCEL_BUFFER_SIZE       64
+#define ACCEL_HOG_US            5000
+
+static int accelHogUs = 0;
+static int accelHogging = 0;
+
+/**
+  * Keeps the processor busy for accelHogUs at a time between sleeps, starving the idle fiber, until told to stop.
+  */
+static void accelerometer_hog()
+{
+    while (accelHogging)
+    {
+        wait_us(accelHogUs);
+        fiber_sleep(ACCEL_READ_MS);
+    }
+}
+
+/**
+  * Reads batches of samples every ACCEL_READ_MS at the given sample period, whilst another fiber
+  * keeps the processor busy for hogUs at a time.
+  */
+static int accelerometer_run(MicroBitAccelerometer &accel, HostMMA8653 &device, int period, int hogUs, AccelRun &r)
+{
+    MMA8653TimestampedSample buffer[ACCEL_BUFFER_SIZE];
+    HostI2CStatistics before, after;
+    int last = -1;
+
+    memset(&r, 0, sizeof(r));
+
+    CHECK(accel.setPeriod(period) == MICROBIT_OK);
+    CHECK(accel.enableSampleBuffer(ACCEL_BUFFER_SIZE) == MICROBIT_OK);
+
+    host_i2c_statistics(before);
+    uint32_t taken = device.samples;
+
+    accelHogUs = hogUs;
+    accelHogging = hogUs > 0;
+
+    if (accelHogging)
+        create_fiber(accelerometer_hog);
+
+    for (int t = 0; t < ACCEL_RUN_MS; t += ACCEL_READ_MS)
+    {
+        fiber_sleep(ACCEL_READ_MS);
+
+        int count = accel.readSamples(buffer, ACCEL_BUFFER_SIZE);
+        CHECK(count >= 0);
+
+        // Samples are stored at 16 milli-g per count of the most significant byte, at +/- 2g.
+        for (int i = 0; i < count; i++)
+        {
+            int sequence = buffer[i].x / 16;
+
+            if (last >= 0)
+                r.missed += (sequence - last - 1) & 127;
+
+            last = sequence;
+            r.read++;
+        }
+    }
+
+    host_i2c_statistics(after);
+    r.taken = device.samples - taken;
+    r.transactions = after.transactions - before.transactions;
+    r.estimated = accel.getLostSampleCount();
+
+    accelHogging = 0;
+    fiber_sleep(2 * ACCEL_READ_MS);
+
+    CHECK(accel.disableSampleBuffer() == MICROBIT_OK);
+
+    return 0;
+}
+
+static int bench_accelerometer_burst(int &ops)
+{
+    static const int periods[] = { 20, 10, 5, 2, 1 };
+    SequencedMMA8653 *device = new SequencedMMA8653();
+    MicroBitAccelerometer *accel = new MicroBitAccelerometer(*i2c);
+    AccelRun r, starved;
+
+    CHECK(accel->whoAmI() == MMA8653_WHOAMI_VAL);
+
+    ops = 0;
+
+    // Given the processor, the driver keeps up with every rate the device offers.
+    for (unsigned int i = 0; i < sizeof(periods) / sizeof(int); i++)
+    {
+        CHECK(accelerometer_run(*accel, *device, periods[i], 0, r) == 0);
+        CHECK(r.read >= r.taken - 1);
+        CHECK(r.missed == 0);
+        CHECK(r.estimated == 0);
+
+        ops += r.read;
+    }
+
+    // At 800Hz, when the idle fiber is starved for several sample periods at a time, the overwritten samples are counted.
+    uint32_t overwritten = device->overwritten;
+
+    CHECK(accelerometer_run(*accel, *device, 1, ACCEL_HOG_US, starved) == 0);
+    CHECK(starved.missed > 0);
+    CHECK(starved.missed <= (int) (device->overwritten - overwritten));
+    CHECK(starved.estimated >= starved.missed * 9 / 10 && starved.estimated <= starved.missed * 11 / 10);
+
+    ops += starved.read;
+
+    bench_detail("800Hz: %.2f I2C transactions per sample, none lost; starved for %d ms at a time: %d%% lost, %d%% estimated",
+        (double) r.transactions / r.read, ACCEL_HOG_US / 1000, starved.missed * 100 / starved.taken, starved.estimated * 100 / starved.taken);
+
+    // Put the device into standby, so that the driver's last read can finish before it is deleted.
+    device->write(MMA8653_CTRL_REG1, 0);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+    delete accel;
+    delete device;
+
+    return 0;
+}
+
+/**
+  * Sensors that note when each sample is taken, and report its number, so that the age of what a driver reports can be measured.
+  */
+class TimedMMA8653 : public HostMMA8653
+{
+    public:
+
+    uint64_t takenAt;
+
+    virtual void sample()
+    {
+        takenAt = system_timer_current_time_us();
+        x = (samples % 128) << 2;
+    }
+};
+
+class TimedMAG3110 : public HostMAG3110
+{
+    public:
+
+    uint64_t takenAt;
+
+    virtual void sample()
+    {
+        takenAt = system_timer_current_time_us();
+        x = samples % 1000;
+    }
+};
+
+/**
+  * The age of the samples reported as each MICROBIT_*_EVT_DATA_UPDATE is raised.
+  */
+struct SensorAge
+{
+    uint32_t updates;                           // The number of updates raised.
+    uint32_t stale;                             // Updates after which the driver reported anything but the latest sample.
+    uint64_t total;                             // The sum of the age of each sample when its update was raised, in microseconds.
+    uint64_t worst;                             // The greatest age of any sample when its update was raised, in microseconds.
+};
+
+#define SENSOR_RUN_MS           1000
+
+static TimedMMA8653 *sensorAccelerometerDevice;
+static TimedMAG3110 *sensorCompassDevice;
+static MicroBitAccelerometer *sensorAccelerometer;
+static MicroBitCompass *sensorCompass;
+static SensorAge accelerometerAge, compassAge;
+
+static void sensor_age(SensorAge &a, uint64_t takenAt, bool latest)
+{
+    uint64_t age = system_timer_current_time_us() - takenAt;
+
+    a.updates++;
+    a.total += age;
+    a.worst = age > a.worst ? age : a.worst;
+
+    if (!latest)
+        a.stale++;
+}
+
+static void accelerometer_updated(MicroBitEvent)
+{
+    // At +/- 2g, each count of the most significant byte is 16 milli-g.
+    sensor_age(accelerometerAge, sensorAccelerometerDevice->takenAt,
+        sensorAccelerometer->getX(RAW) == (sensorAccelerometerDevice->x >> 2) * 16);
+}
+
+static void compass_updated(MicroBitEvent)
+{
+    sensor_age(compassAge, sensorCompassDevice->takenAt,
+        sensorCompass->getX(RAW) == MAG3110_NORMALIZE_SAMPLE(sensorCompassDevice->x));
+}
+
+static int bench_sensor_samples(int &ops)
+{
+    // The drivers are used from interrupt context, so must not be on a fiber's stack.
+    sensorAccelerometerDevice = new TimedMMA8653();
+    sensorCompassDevice = new TimedMAG3110();
+    sensorAccelerometer = new MicroBitAccelerometer(*i2c);
+    sensorCompass = new MicroBitCompass(*i2c);
+
+    CHECK(sensorCompass->whoAmI() == MAG3110_WHOAMI_VAL);
+
+    // The very first reading is a sample taken by the device, rather than zeros.
+    uint64_t start = system_timer_current_time_us();
+    CHECK(sensorAccelerometer->getX(RAW) != 0);
+    CHECK(sensorAccelerometer->getX(RAW) == (sensorAccelerometerDevice->x >> 2) * 16);
+    uint64_t accelerometerFirst = system_timer_current_time_us() - start;
+
+    start = system_timer_current_time_us();
+    CHECK(sensorCompass->getX(RAW) != 0);
+    CHECK(sensorCompass->getX(RAW) == MAG3110_NORMALIZE_SAMPLE(sensorCompassDevice->x));
+    uint64_t compassFirst = system_timer_current_time_us() - start;
+
+    // Each sample is reported as soon as it has been read, whilst nothing asks for it.
+    memset(&accelerometerAge, 0, sizeof(SensorAge));
+    memset(&compassAge, 0, sizeof(SensorAge));
+
+    bus->listen(MICROBIT_ID_ACCELEROMETER, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE, accelerometer_updated, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    bus->listen(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_DATA_UPDATE, compass_updated, MESSAGE_BUS_LISTENER_IMMEDIATE);
+
+    uint32_t accelerometerTaken = sensorAccelerometerDevice->samples;
+    uint32_t compassTaken = sensorCompassDevice->samples;
+
+    fiber_sleep(SENSOR_RUN_MS);
+
+    accelerometerTaken = sensorAccelerometerDevice->samples - accelerometerTaken;
+    compassTaken = sensorCompassDevice->samples - compassTaken;
+
+    bus->ignore(MICROBIT_ID_ACCELEROMETER, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE, accelerometer_updated);
+    bus->ignore(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_DATA_UPDATE, compass_updated);
+
+    // Every sample is reported within a read's time on the bus, well before the next system tick.
+    CHECK(accelerometerAge.updates + 1 >= accelerometerTaken && accelerometerAge.updates <= accelerometerTaken);
+    CHECK(compassAge.updates + 1 >= compassTaken && compassAge.updates <= compassTaken);
+    CHECK(accelerometerAge.stale == 0 && compassAge.stale == 0);
+    CHECK(accelerometerAge.worst < SYSTEM_TICK_PERIOD_MS * 1000 / 2);
+    CHECK(compassAge.worst < SYSTEM_TICK_PERIOD_MS * 1000 / 2);
+
+    bench_detail("first read %llu / %llu us, then aged %llu / %llu us (worst %llu / %llu) when reported, accel / compass",
+        (unsigned long long) accelerometerFirst, (unsigned long long) compassFirst,
+        (unsigned long long) (accelerometerAge.total / accelerometerAge.updates), (unsigned long long) (compassAge.total / compassAge.updates),
+        (unsigned long long) accelerometerAge.worst, (unsigned long long) compassAge.worst);
+
+    ops = accelerometerAge.updates + compassAge.updates;
+
+    // Put the devices into standby, so that the drivers' last reads can finish before they are deleted.
+    sensorAccelerometerDevice->write(MMA8653_CTRL_REG1, 0);
+    sensorCompassDevice->write(MAG_CTRL_REG1, 0);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+    delete sensorCompass;
+    delete sensorAccelerometer;
+    delete sensorCompassDevice;
+    delete sensorAccelerometerDevice;
+
+    return 0;
+}
+
+#define CALIBRATION_SAMPLES     64
+#define CALIBRATION_SOLVES      200
+
+/**
+  * Solves for the centre of the given samples as the calibrator used to, with Matrix4: beta = (XtX)^-1 XtY.
+  */
+static void calibration_solve_matrix4(CompassSample *samples, CompassSample &centre)
+{
+    Matrix4 X(CALIBRATION_SAMPLES, 4);
+    Matrix4 Y(CALIBRATION_SAMPLES, 1);
+
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+    {
+        float x = samples[i].x, y = samples[i].y, z = samples[i].z;
+
+        X.set(i, 0, x);
+        X.set(i, 1, y);
+        X.set(i, 2, z);
+        X.set(i, 3, 1);
+        Y.set(i, 0, x*x + y*y + z*z);
+    }
+
+    Matrix4 Xt = X.transpose();
+    Matrix4 beta = Xt.multiply(X).invert().multiply(Xt).multiply(Y);
+
+    centre = CompassSample((int)(beta.get(0, 0) / 2), (int)(beta.get(1, 0) / 2), (int)(beta.get(2, 0) / 2));
+}
+
+/**
+  * Solves the same problem with the fixed size Matrix, without building X transposed.
+  */
+static void calibration_solve_matrix(CompassSample *samples, CompassSample &centre)
+{
+    static Matrix<CALIBRATION_SAMPLES, 4> X;
+    static Matrix<CALIBRATION_SAMPLES, 1> Y;
+
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+    {
+        float x = samples[i].x, y = samples[i].y, z = samples[i].z;
+
+        X.at(i, 0) = x;
+        X.at(i, 1) = y;
+        X.at(i, 2) = z;
+        X.at(i, 3) = 1;
+        Y.at(i, 0) = x*x + y*y + z*z;
+    }
+
+    Matrix<4, 4> XtX = X.multiplyT(X);
+    Matrix<4, 1> XtY = X.multiplyT(Y);
+
+    XtX.invert(XtX);
+    Matrix<4, 1> beta = XtX.multiply(XtY);
+
+    centre = CompassSample((int)(beta.at(0, 0) / 2), (int)(beta.at(1, 0) / 2), (int)(beta.at(2, 0) / 2));
+}
+
+static uint64_t least(uint64_t a, uint64_t b)
+{
+    return a < b ? a : b;
+}
+
+/**
+  * Determines how far a solution lies from the expected centre, in the compass's RAW units.
+  */
+static int calibration_error(CompassSample &c, CompassSample &expected)
+{
+    return abs(c.x - expected.x) + abs(c.y - expected.y) + abs(c.z - expected.z);
+}
+
+static int bench_compass_solve(int &ops)
+{
+    // The drivers are used from interrupt context, so must not be on a fiber's stack.
+    HostMMA8653 *accelerometerDevice = new HostMMA8653();
+    HostMAG3110 *compassDevice = new HostMAG3110();
+    MicroBitAccelerometer *accelerometer = new MicroBitAccelerometer(*i2c);
+    MicroBitCompass *compass = new MicroBitCompass(*i2c, *accelerometer);
+    MicroBitDisplay *display = new MicroBitDisplay();
+    MicroBitCompassCalibrator *calibrator = new MicroBitCompassCalibrator(*compass, *accelerometer, *display);
+
+    CompassSample samples[CALIBRATION_SAMPLES];
+    CompassSample expected(12000, -8000, 4000);
+    CompassSample c4, cm, cc;
+    MicroBitHeapStatistics before, after;
+    uint32_t allocations4, allocationsM, allocationsC;
+    uint64_t start, cycles4 = ~0ULL, cyclesM = ~0ULL, cyclesAdd = ~0ULL, cyclesSolve = ~0ULL;
+
+    // Samples on a sphere of radius 30000 about the expected centre, in random directions with a little noise.
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+    {
+        double x, y, z, r;
+
+        do
+        {
+            x = (int) (lcg() % 2001) - 1000;
+            y = (int) (lcg() % 2001) - 1000;
+            z = (int) (lcg() % 2001) - 1000;
+            r = sqrt(x*x + y*y + z*z);
+        } while (r < 100 || r > 1000);
+
+        samples[i].x = expected.x + (int) (x * 30000 / r) + (int) (lcg() % 201) - 100;
+        samples[i].y = expected.y + (int) (y * 30000 / r) + (int) (lcg() % 201) - 100;
+        samples[i].z = expected.z + (int) (z * 30000 / r) + (int) (lcg() % 201) - 100;
+    }
+
+    microbit_heap_statistics(before);
+    for (int n = 0; n < CALIBRATION_SOLVES; n++)
+    {
+        start = host_cycles();
+        calibration_solve_matrix4(samples, c4);
+        cycles4 = least(cycles4, host_cycles() - start);
+    }
+    microbit_heap_statistics(after);
+    allocations4 = after.allocations - before.allocations;
+
+    microbit_heap_statistics(before);
+    for (int n = 0; n < CALIBRATION_SOLVES; n++)
+    {
+        start = host_cycles();
+        calibration_solve_matrix(samples, cm);
+        cyclesM = least(cyclesM, host_cycles() - start);
+    }
+    microbit_heap_statistics(after);
+    allocationsM = after.allocations - before.allocations;
+
+    microbit_heap_statistics(before);
+    for (int n = 0; n < CALIBRATION_SOLVES; n++)
+    {
+        calibrator->reset();
+
+        start = host_cycles();
+        for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+            calibrator->addSample(samples[i]);
+        cyclesAdd = least(cyclesAdd, host_cycles() - start);
+
+        start = host_cycles();
+        CHECK(calibrator->solve(cc) == MICROBIT_OK);
+        cyclesSolve = least(cyclesSolve, host_cycles() - start);
+    }
+    microbit_heap_statistics(after);
+    allocationsC = after.allocations - before.allocations;
+
+    // All three find the centre, to within the noise, and only Matrix4 uses the heap.
+    CHECK(calibration_error(c4, expected) < 300);
+    CHECK(calibration_error(cm, expected) < 300);
+    CHECK(calibration_error(cc, expected) < 300);
+    CHECK(allocations4 > 0);
+    CHECK(allocationsM == 0);
+    CHECK(allocationsC == 0);
+
+    // Samples that all lie in one plane do not determine a centre.
+    calibrator->reset();
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+        calibrator->addSample(CompassSample(samples[i].x, samples[i].y, expected.z));
+    CHECK(calibrator->solve(cc) == MICROBIT_CALIBRATION_REQUIRED);
+
+    // Host cycles are the best of all the runs, to leave out interruptions by the host's own scheduler.
+    bench_detail("%d samples: Matrix4 %u allocs %llu host cycles, Matrix 0 / %llu, calibrator 0 / %llu solving + %llu adding",
+        CALIBRATION_SAMPLES, (unsigned int) (allocations4 / CALIBRATION_SOLVES), (unsigned long long) cycles4,
+        (unsigned long long) cyclesM, (unsigned long long) cyclesSolve, (unsigned long long) cyclesAdd);
+
+    bus->ignore(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_CALIBRATE, calibrator, &MicroBitCompassCalibrator::calibrate);
+
+    delete calibrator;
+    delete display;
+    delete compass;
+    delete accelerometer;
+    delete compassDevice;
+    delete accelerometerDevice;
+
+    ops = 3 * CALIBRATION_SOLVES;
+    return 0;
+}
+
+static int bench_storage(int &ops)
+{
+    HostFlashStatistics before, after;
+    char key[4] = "k0";
+
+    host_flash_format();
+    host_flash_statistics(before);
+
+    MicroBitStorage storage;
+
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        key[1] = '0' + i % 8;
+        CHECK(storage.put(key, (uint8_t *) &i, sizeof(i)) == MICROBIT_OK);
+    }
+
+    CHECK(storage.size() == 8);
+
+    for (uint32_t i = 192; i < 200; i++)
+    {
+        KeyValuePair *pair;
+        uint32_t value;
+
+        key[1] = '0' + i % 8;
+        pair = storage.get(key);
+
+        CHECK(pair != NULL);
+        memcpy(&value, pair->value, sizeof(value));
+        delete pair;
+
+        CHECK(value == i);
+    }
+
+    // The store must survive a restart.
+    MicroBitStorage restarted;
+    CHECK(restarted.size() == 8);
+
+    host_flash_statistics(after);
+    CHECK(after.violations == before.violations);
+
+    bench_detail("%.2f erases, %.1f bytes written per put", (after.erases - before.erases) / 200.0,
+        (after.bytesWritten - before.bytesWritten) / 200.0);
+
+    ops = 200;
+    return 0;
+}
+
+static int bench_storage_wear(int &ops)
+{
+    HostFlashStatistics before, after;
+
+    host_flash_format();
+    host_flash_statistics(before);
+
+    MicroBitStorage storage;
+
+    // Repeatedly update a single key, as a program saving its state would.
+    for (uint32_t i = 0; i < 1000; i++)
+        CHECK(storage.put("state", (uint8_t *) &i, sizeof(i)) == MICROBIT_OK);
+
+    CHECK(storage.size() == 1);
+
+    host_flash_statistics(after);
+    CHECK(after.violations == before.violations);
+
+    // Compaction alternates between the two pages, so neither should wear faster than the other.
+    CHECK(after.maxErases - before.maxErases <= (after.erases - before.erases) / 2 + 1);
+
+    bench_detail("%.3f erases, %.1f bytes written, %.0f us of flash time per put, %d erases in all",
+        (after.erases - before.erases) / 1000.0, (after.bytesWritten - before.bytesWritten) / 1000.0,
+        (after.busyTime - before.busyTime) / 1000.0, (int) (after.erases - before.erases));
+
+    ops = 1000;
+    return 0;
+}
+
+static int bench_storage_transaction(int &ops)
+{
+    HostFlashStatistics start, middle, end;
+    MicroBitHeapStatistics before, during;
+    char key[4] = "k0";
+
+    host_flash_format();
+
+    MicroBitStorage storage;
+
+    // Update four keys at a time, first as separate puts, then as transactions.
+    host_flash_statistics(start);
+
+    for (uint32_t i = 0; i < 400; i++)
+    {
+        key[1] = '0' + i % 4;
+        CHECK(storage.put(key, (uint8_t *) &i, sizeof(i)) == MICROBIT_OK);
+    }
+
+    host_flash_statistics(middle);
+
+    for (uint32_t i = 0; i < 400; i += 4)
+    {
+        microbit_heap_statistics(before);
+        CHECK(storage.beginTransaction() == MICROBIT_OK);
+
+        for (uint32_t j = i; j < i + 4; j++)
+        {
+            key[1] = '0' + j % 4;
+            CHECK(storage.put(key, (uint8_t *) &j, sizeof(j)) == MICROBIT_OK);
+        }
+
+        // A transaction only holds a few records, so a fifth key is refused.
+        CHECK(storage.put("k4", (uint8_t *) &i, sizeof(i)) == MICROBIT_NO_RESOURCES);
+
+        microbit_heap_statistics(during);
+        CHECK(during.used - before.used <= MICROBIT_STORAGE_TRANSACTION_SIZE * sizeof(KeyValueRecord) + 8);
+
+        CHECK(storage.commitTransaction() == MICROBIT_OK);
+    }
+
+    host_flash_statistics(end);
+    CHECK(end.violations == start.violations);
+    CHECK(storage.size() == 4);
+
+    // The last batch must survive a restart.
+    MicroBitStorage restarted;
+
+    for (uint32_t j = 396; j < 400; j++)
+    {
+        const KeyValuePair *pair;
+        uint32_t value;
+
+        key[1] = '0' + j % 4;
+        pair = restarted.find(key);
+
+        CHECK(pair != NULL);
+        memcpy(&value, pair->value, sizeof(value));
+        CHECK(value == j);
+    }
+
+    bench_detail("per 4 keys: %.2f erases, %.0f bytes as puts; %.2f erases, %.0f bytes as a transaction",
+        (middle.erases - start.erases) / 100.0, (middle.bytesWritten - start.bytesWritten) / 100.0,
+        (end.erases - middle.erases) / 100.0, (end.bytesWritten - middle.bytesWritten) / 100.0);
+
+    ops = 800;
+    return 0;
+}
+
+static int transmitted = 0;
+static uint32_t transmittedAt = 0;
+
+static void count_transmitted(const uint8_t *)
+{
+    transmitted++;
+    transmittedAt = us_ticker_read();
+}
+
+static int bench_radio(int &ops)
+{
+    HostRadioStatistics before, after;
+    RadioTxStatistics tx;
+    uint8_t payload[16];
+    uint8_t packet[MICROBIT_RADIO_HEADER_SIZE + 16];
+
+    CHECK(radio->enable() == MICROBIT_OK);
+
+    transmitted = 0;
+    host_radio_on_transmit(count_transmitted);
+    host_radio_statistics(before);
+
+    // Send in bursts that fill the transmit queue, and let each drain.
+    for (int i = 0; i < 1000; i++)
+    {
+        payload[0] = i;
+        CHECK(radio->datagram.send(payload, sizeof(payload)) == MICROBIT_OK);
+
+        if (radio->getTxQueueDepth() == MICROBIT_RADIO_MAXIMUM_TX_BUFFERS)
+            while (radio->getTxQueueDepth() > 0)
+                fiber_sleep(0);
+    }
+
+    while (radio->getTxQueueDepth() > 0)
+        fiber_sleep(0);
+
+    radio->getTxStatistics(tx);
+    CHECK(transmitted == 1000);
+    CHECK(tx.dropped == 0);
+    CHECK(tx.packets == 1000);
+
+    bench_detail("%u us air time, %u us mean latency per packet", (unsigned int) (tx.airtime / tx.packets),
+        (unsigned int) (tx.latency / tx.packets));
+
+    // Receive packets sent by another device, spaced out so that the receiver is always listening.
+    packet[0] = MICROBIT_RADIO_HEADER_SIZE - 1 + sizeof(payload);
+    packet[1] = 1;
+    packet[2] = 0;
+    packet[3] = MICROBIT_RADIO_PROTOCOL_DATAGRAM;
+
+    for (int i = 0; i < 10; i++)
+    {
+        uint8_t received[32];
+
+        packet[MICROBIT_RADIO_HEADER_SIZE] = i;
+        CHECK(host_radio_inject(packet, 50) == 1);
+
+        fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+        CHECK(radio->datagram.recv(received, sizeof(received)) == sizeof(payload));
+        CHECK(received[0] == i);
+    }
+
+    host_radio_on_transmit(NULL);
+    host_radio_statistics(after);
+    CHECK(after.transmitted - before.transmitted == 1000);
+    CHECK(after.received - before.received == 10);
+    CHECK(after.missed == before.missed);
+
+    ops = 1010;
+    return 0;
+}
+
+static int radioDisableResult = 0;
+static int radioDisableDepth = 0;
+
+static void radio_disable_from_interrupt()
+{
+    radioDisableResult = radio->disable();
+    radioDisableDepth = radio->getTxQueueDepth();
+}
+
+static int bench_radio_queue(int &ops)
+{
+    // Timers are used from interrupt context, so must not be on a fiber's stack.
+    static Timeout timeout;
+    uint8_t payload[16] = { 0 };
+    uint32_t start, single, burst;
+    int sent;
+
+    transmitted = 0;
+    host_radio_on_transmit(count_transmitted);
+
+    // send() may be called from an interrupt, so it doesn't enable the radio (and allocate its buffers) itself.
+    CHECK(radio->disable() == MICROBIT_OK);
+    CHECK(radio->datagram.send(payload, sizeof(payload)) == MICROBIT_NOT_SUPPORTED);
+    CHECK(radio->enable() == MICROBIT_OK);
+
+    // The time to send a packet on its own, and the time per packet when a full queue is sent back to back.
+    start = us_ticker_read();
+    CHECK(radio->datagram.send(payload, sizeof(payload)) == MICROBIT_OK);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    CHECK(transmitted == 1);
+    single = transmittedAt - start;
+
+    start = us_ticker_read();
+
+    for (int i = 0; i < MICROBIT_RADIO_MAXIMUM_TX_BUFFERS; i++)
+        CHECK(radio->datagram.send(payload, sizeof(payload)) == MICROBIT_OK);
+
+    fiber_sleep(2 * SYSTEM_TICK_PERIOD_MS);
+    CHECK(transmitted == 1 + MICROBIT_RADIO_MAXIMUM_TX_BUFFERS);
+    burst = (transmittedAt - start) / MICROBIT_RADIO_MAXIMUM_TX_BUFFERS;
+
+    // Disabling the radio from a fiber lets a full queue drain first.
+    sent = transmitted;
+
+    for (int i = 0; i < MICROBIT_RADIO_MAXIMUM_TX_BUFFERS; i++)
+        CHECK(radio->datagram.send(payload, sizeof(payload)) == MICROBIT_OK);
+
+    CHECK(radio->disable() == MICROBIT_OK);
+    CHECK(transmitted - sent == MICROBIT_RADIO_MAXIMUM_TX_BUFFERS);
+    CHECK(radio->getTxQueueDepth() == 0);
+
+    // Disabling it from an interrupt can't wait for the RADIO interrupt, so discards the queue rather than hanging.
+    CHECK(radio->enable() == MICROBIT_OK);
+    sent = transmitted;
+
+    for (int i = 0; i < MICROBIT_RADIO_MAXIMUM_TX_BUFFERS; i++)
+        CHECK(radio->datagram.send(payload, sizeof(payload)) == MICROBIT_OK);
+
+    radioDisableResult = -1;
+    timeout.attach_us(radio_disable_from_interrupt, 100);
+    fiber_sleep(2 * SYSTEM_TICK_PERIOD_MS);
+
+    CHECK(radioDisableResult == MICROBIT_OK);
+    CHECK(radioDisableDepth == 0);
+    CHECK(transmitted - sent < MICROBIT_RADIO_MAXIMUM_TX_BUFFERS);
+
+    // And the radio can be brought back up afterwards.
+    CHECK(radio->enable() == MICROBIT_OK);
+    sent = transmitted;
+    CHECK(radio->datagram.send(payload, sizeof(payload)) == MICROBIT_OK);
+    fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+    CHECK(transmitted == sent + 1);
+
+    host_radio_on_transmit(NULL);
+
+    bench_detail("%u us per packet sent alone, %u us each sent back to back", (unsigned int) single, (unsigned int) burst);
+
+    ops = transmitted;
+    return 0;
+}
+
+#define SERIAL_FRAME_SIZE       32
+
+static int framesReceived = 0;
+static int framesCorrupt = 0;
+
+/**
+  * Fills the payload of the given frame of a sequence. Every few frames include bytes that SLIP must escape.
+  */
+static void serial_frame_payload(uint8_t *payload, int sequence)
+{
+    for (int i = 0; i < SERIAL_FRAME_SIZE; i++)
+        payload[i] = sequence + i * 37;
+}
+
+/**
+  * Checks each frame received against the next expected in the sequence, and returns its buffer to the pool.
+  */
+static void serial_frame_received(MicroBitEvent e)
+{
+    int index = MICROBIT_SERIAL_FRAME_INDEX(e.value);
+    uint8_t expected[SERIAL_FRAME_SIZE];
+
+    serial_frame_payload(expected, framesReceived);
+
+    if (framer->getFrameLength(index) != SERIAL_FRAME_SIZE || memcmp(framer->getFrame(index), expected, SERIAL_FRAME_SIZE) != 0)
+        framesCorrupt++;
+
+    framesReceived++;
+    framer->release(index);
+}
+
+static void serial_send_line()
+{
+    fiber_sleep(10);
+    serial->send("line\n", ASYNC);
+}
+
+static int bench_serial_framer(int &ops)
+{
+    MicroBitHeapStatistics before, after;
+    HostUARTStatistics uartBefore, uartAfter;
+    uint8_t payload[SERIAL_FRAME_SIZE];
+    uint64_t start, wallStart, virtualTime, wallTime;
+    int frames = 500;
+
+    host_uart_loopback(1);
+    bus->listen(MICROBIT_ID_SERIAL_FRAME, MICROBIT_EVT_ANY, serial_frame_received);
+
+    // A line read whilst the framer is listening must leave its frame delimeter in place.
+    create_fiber(serial_send_line);
+    CHECK(serial->readUntil("\n", SYNC_SLEEP) == ManagedString("line"));
+
+    framesReceived = 0;
+    framesCorrupt = 0;
+
+    microbit_heap_statistics(before);
+    host_uart_statistics(uartBefore);
+    start = host_clock_now();
+    wallStart = wall_time();
+
+    for (int i = 0; i < frames; i++)
+    {
+        serial_frame_payload(payload, i);
+        CHECK(framer->send(payload, SERIAL_FRAME_SIZE, SYNC_SLEEP) == MICROBIT_OK);
+    }
+
+    // Give the last frame time to arrive.
+    for (int i = 0; i < 100 && framesReceived < frames; i++)
+        fiber_sleep(1);
+
+    virtualTime = host_clock_now() - start;
+    wallTime = wall_time() - wallStart;
+    microbit_heap_statistics(after);
+    host_uart_statistics(uartAfter);
+
+    bus->ignore(MICROBIT_ID_SERIAL_FRAME, MICROBIT_EVT_ANY, serial_frame_received);
+    host_uart_loopback(0);
+
+    CHECK(framesReceived == frames);
+    CHECK(framesCorrupt == 0);
+    CHECK(framer->getDroppedCount() == 0);
+    CHECK(uartAfter.overruns == uartBefore.overruns);
+    CHECK(after.used == before.used);
+
+    bench_detail("%.0f frames/s, %.0f%% of bytes sent as payload, %.2f allocations and %.0f ns per frame",
+        frames * 1000000.0 / virtualTime,
+        100.0 * frames * SERIAL_FRAME_SIZE / (uartAfter.transmitted - uartBefore.transmitted),
+        (after.allocations - before.allocations) / (double) frames, wallTime / (double) frames);
+
+    ops = frames;
+    return 0;
+}
+
+static BenchCase cases[] =
+{
+    { "fiber_sleep", bench_fiber_sleep },
+    { "tick_cost", bench_tick_cost },
+    { "context_switch", bench_context_switch },
+    { "wait_for_event", bench_wait_for_event },
+    { "wake_latency", bench_wake_latency },
+    { "bus_immediate", bench_bus_immediate },
+    { "bus_dispatch_cost", bench_bus_dispatch_cost },
+    { "bus_queued", bench_bus_queued },
+    { "bus_fork_on_block", bench_bus_fork_on_block },
+    { "heap", bench_heap },
+    { "heap_trace", bench_heap_trace },
+    { "fixed_math", bench_fixed_math },
+    { "managed_string", bench_managed_string },
+    { "image", bench_image },
+    { "packed_image", bench_packed_image },
+    { "packet_buffer", bench_packet_buffer },
+    { "display_render", bench_display_render },
+    { "display_greyscale", bench_display_greyscale },
+    { "i2c", bench_i2c },
+    { "accelerometer_burst", bench_accelerometer_burst },
+    { "sensor_samples", bench_sensor_samples },
+    { "compass_solve", bench_compass_solve },
+    { "storage", bench_storage },
+    { "storage_wear", bench_storage_wear },
+    { "storage_transaction", bench_storage_transaction },
+    { "radio", bench_radio },
+    { "radio_queue", bench_radio_queue },
+    { "serial_framer", bench_serial_framer }
+};
+
+/**
+  * Runs each selected case on the main fiber, and reports its results.
+  */
+static int run_cases()
+{
+    int failures = 0;
+
+    bus = new MicroBitMessageBus();
+    scheduler_init(*bus);
+
+    i2c = new MicroBitI2C(I2C_SDA0, I2C_SCL0);
+    radio = new MicroBitRadio();
+    serial = new MicroBitSerial(USBTX, USBRX, 128, 64);
+    framer = new MicroBitSerialFramer(*serial);
+
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(BenchCase); i++)
+    {
+        int ops = 0;
+
+        if (selected != NULL && strcmp(selected, cases[i].name) != 0)
+            continue;
+
+        detail[0] = 0;
+
+        uint64_t virtualStart = host_clock_now();
+        uint64_t wallStart = wall_time();
+
+        int result = cases[i].run(ops);
+
+        uint64_t wallTime = wall_time() - wallStart;
+        uint64_t virtualTime = host_clock_now() - virtualStart;
+
+        printf("%-20s %-4s %8d ops %10.1f ns/op %10llu us virtual\n", cases[i].name, result ? "FAIL" : "ok",
+            ops, ops ? (double) wallTime / ops : 0.0, (unsigned long long) virtualTime);
+
+        if (detail[0])
+            printf("%-20s %s\n", "", detail);
+
+        if (result)
+            failures++;
+    }
+
+    MicroBitFiberStatistics fibers;
+    MicroBitHeapStatistics heap;
+
+    fiber_statistics(fibers);
+    microbit_heap_statistics(heap);
+
+    printf("fibers %d (%d pooled), deepest stack %d bytes, heap peak %d bytes\n",
+        (int) fibers.fibers, (int) fibers.pooled, (int) fibers.deepestStack, (int) heap.peak);
+
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        selected = argv[1];
+
+    return host_main(run_cases) ? 1 : 0;
+}
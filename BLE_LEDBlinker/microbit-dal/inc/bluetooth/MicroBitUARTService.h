@@ -61,11 +61,17 @@ class MicroBitUARTService
     BLEDevice           &ble;
 
     //delimeters used for matching on receive.
-    ManagedString delimeters;
+    DelimeterMap delimeters;
 
     //a variable used when a user calls the eventAfter() method.
     int rxBuffHeadMatch;
 
+    //the position in rxBuffer that peekUntil() has scanned up to, without finding a delimeter.
+    uint8_t rxScanPosition;
+
+    //the delimeters that peekUntil() was last asked to scan for.
+    DelimeterMap rxScanDelimeters;
+
     /**
       * A callback function for whenever a Bluetooth device writes to our TX characteristic.
       */
@@ -85,6 +91,15 @@ class MicroBitUARTService
       */
     void circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition);
 
+    /**
+      * An internal method that continues the scan of the rxBuffer for a delimeter, from
+      * where the last scan stopped.
+      *
+      * @return the position of the first delimeter after the rxBufferTail, or -1 if
+      *         there is no delimeter in the rxBuffer.
+      */
+    int scanUntil();
+
     public:
 
     /**
@@ -240,6 +255,34 @@ class MicroBitUARTService
       */
     ManagedString readUntil(ManagedString delimeters, MicroBitSerialMode mode = SYNC_SLEEP);
 
+    /**
+      * Finds the characters up to one of the given delimeters, without copying them
+      * or removing them from the rxBuffer.
+      *
+      * Scanning resumes from where the previous call stopped, so polling for a line
+      * only ever examines each received character once.
+      *
+      * @param delimeters the characters to match against
+      * @param span set to describe the characters before the delimeter, which stay valid
+      *        until they are removed with consume().
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP, which
+      *        behave as described for readUntil().
+      *
+      * @return the number of characters before the delimeter, MICROBIT_NO_DATA if no
+      *         delimeter was found, or MICROBIT_INVALID_PARAMETER if the mode is SYNC_SPINWAIT.
+      */
+    int peekUntil(ManagedString delimeters, CircularSpan &span, MicroBitSerialMode mode = SYNC_SLEEP);
+
+    /**
+      * Removes characters from the rxBuffer, without copying them.
+      *
+      * @param len the number of characters to remove.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if fewer than len
+      *         characters are buffered.
+      */
+    int consume(int len);
+
     /**
       * Configures an event to be fired on a match with one of the delimeters.
       *
@@ -67,6 +67,8 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_ID_RADIO_DATA_READY    30
 #define MICROBIT_ID_MULTIBUTTON_ATTACH  31
 #define MICROBIT_ID_SERIAL              32
+#define MICROBIT_ID_SERIAL_FRAME        33
+#define MICROBIT_ID_I2C                 34
 
 #define MICROBIT_ID_MESSAGE_BUS_LISTENER            1021          // Message bus indication that a handler for a given ID has been registered.
 #define MICROBIT_ID_NOTIFY_ONE                      1022          // Notfication channel, for general purpose synchronisation
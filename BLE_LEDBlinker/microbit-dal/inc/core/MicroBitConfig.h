@@ -85,6 +85,14 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_HEAP_BLOCK_SIZE                4
 #endif
 
+// Blocks of up to this size (in MICROBIT_HEAP_BLOCK_SIZE units, including the block header) are held on
+// segregated free lists when released, allowing small, frequently used allocation sizes to be recycled in constant time.
+// Pooled blocks are returned to the heap if an allocation would otherwise fail.
+// Set '0' to disable.
+#ifndef MICROBIT_HEAP_POOL_MAX_BLOCKS
+#define MICROBIT_HEAP_POOL_MAX_BLOCKS           24
+#endif
+
 // The proportion of SRAM available on the mbed heap to reserve for the micro:bit heap.
 #ifndef MICROBIT_NESTED_HEAP_SIZE
 #define MICROBIT_NESTED_HEAP_SIZE               0
@@ -114,6 +122,41 @@ DEALINGS IN THE SOFTWARE.
 #define SYSTEM_TICK_PERIOD_MS                   6
 #endif
 
+// Enables tickless operation of the fiber sleep queue.
+// If enabled, sleeping fibers are woken by a one-shot timer programmed to the earliest sleep deadline,
+// rather than the scheduler inspecting the sleep queue on every system tick.
+// Set '1' to enable.
+#ifndef MICROBIT_FIBER_TICKLESS
+#define MICROBIT_FIBER_TICKLESS                 0
+#endif
+
+// The number of fibers to preallocate when the scheduler is initialised.
+// Each is given a stack buffer of MICROBIT_FIBER_STACK_SIZE bytes up front, so that fibers created or forked
+// at runtime need not allocate (or grow) stack buffers on the heap unless their stack outgrows this size.
+// Set '0' to disable, and allocate fibers and their stacks on demand.
+#ifndef MICROBIT_FIBER_POOL_SIZE
+#define MICROBIT_FIBER_POOL_SIZE                0
+#endif
+
+// The size of the stack buffer given to each preallocated fiber, in bytes.
+// Should be a multiple of 32 bytes.
+#ifndef MICROBIT_FIBER_STACK_SIZE
+#define MICROBIT_FIBER_STACK_SIZE               512
+#endif
+
+// The number of hash buckets used to hold fibers blocked waiting on an event, keyed by event ID.
+// Fibers waiting on MICROBIT_ID_ANY are held separately.
+#ifndef MICROBIT_FIBER_WAIT_QUEUE_BUCKETS
+#define MICROBIT_FIBER_WAIT_QUEUE_BUCKETS       8
+#endif
+
+// The number of event IDs the scheduler remembers having registered a message bus listener for, on behalf of
+// fibers waiting on events. Waits on a remembered ID skip the call to listen(). Waits on other IDs still work,
+// but call listen() each time.
+#ifndef MICROBIT_FIBER_WAIT_LISTENERS
+#define MICROBIT_FIBER_WAIT_LISTENERS           8
+#endif
+
 //
 // Message Bus:
 // Default behaviour for event handlers, if not specified in the listen() call
@@ -262,6 +305,12 @@ DEALINGS IN THE SOFTWARE.
 #define USE_ACCEL_LSB                           0
 #endif
 
+// The default number of timestamped samples held by the accelerometer when its sample buffer is enabled.
+// Each sample consumes 12 bytes of RAM.
+#ifndef MICROBIT_ACCELEROMETER_SAMPLE_BUFFER_SIZE
+#define MICROBIT_ACCELEROMETER_SAMPLE_BUFFER_SIZE   32
+#endif
+
 //
 // Display options
 //
@@ -318,6 +367,22 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_DEFAULT_SERIAL_MODE            SYNC_SLEEP
 #endif
 
+// The number of received frames that a MicroBitSerialFramer can hold, awaiting processing.
+#ifndef MICROBIT_SERIAL_FRAME_POOL_SIZE
+#define MICROBIT_SERIAL_FRAME_POOL_SIZE         4
+#endif
+
+// The largest payload that a MicroBitSerialFramer can receive in a single frame (bytes).
+#ifndef MICROBIT_SERIAL_FRAME_MAX_SIZE
+#define MICROBIT_SERIAL_FRAME_MAX_SIZE          64
+#endif
+
+// The number of keys that a single MicroBitStorage transaction can update. The records of an open transaction
+// are held on the heap, at 52 bytes each.
+#ifndef MICROBIT_STORAGE_TRANSACTION_SIZE
+#define MICROBIT_STORAGE_TRANSACTION_SIZE       4
+#endif
+
 
 //
 // I/O Options
@@ -44,6 +44,7 @@ DEALINGS IN THE SOFTWARE.
 
 // Fiber Scheduler Flags
 #define MICROBIT_SCHEDULER_RUNNING	     	0x01
+#define MICROBIT_SCHEDULER_LISTENING_ANY    0x02
 
 // Fiber Flags
 #define MICROBIT_FIBER_FLAG_FOB             0x01
@@ -85,12 +86,23 @@ struct Fiber
     Cortex_M0_TCB tcb;                  // Thread context when last scheduled out.
     uint32_t stack_bottom;              // The start address of this Fiber's stack. The stack is heap allocated, and full descending.
     uint32_t stack_top;                 // The end address of this Fiber's stack.
+    uint32_t stack_high_water;          // The deepest stack depth recorded for this Fiber, in bytes.
     uint32_t context;                   // Context specific information.
     uint32_t flags;                     // Information about this fiber.
     Fiber **queue;                      // The queue this fiber is stored on.
     Fiber *next, *prev;                 // Position of this Fiber on the run queue.
 };
 
+/**
+  * Usage statistics for the fiber scheduler.
+  */
+struct MicroBitFiberStatistics
+{
+    uint16_t fibers;                    // The number of fiber contexts allocated, including those in the pool.
+    uint16_t pooled;                    // The number of fiber contexts currently unused, waiting in the pool.
+    uint32_t deepestStack;              // The deepest stack seen in any fiber when it was scheduled out, in bytes.
+};
+
 extern Fiber *currentFiber;
 
 
@@ -296,6 +308,17 @@ inline void verify_stack_size(Fiber *f);
   */
 void scheduler_event(MicroBitEvent evt);
 
+/**
+  * Provides usage statistics for the fiber scheduler.
+  *
+  * This can be used to determine appropriate values for MICROBIT_FIBER_POOL_SIZE and MICROBIT_FIBER_STACK_SIZE.
+  *
+  * @param stats The MicroBitFiberStatistics to populate.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int fiber_statistics(MicroBitFiberStatistics &stats);
+
 /**
   * Determines if any fibers are waiting to be scheduled.
   *
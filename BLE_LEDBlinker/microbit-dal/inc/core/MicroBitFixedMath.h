@@ -0,0 +1,101 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Fixed point trigonometry, for use where floating point would be too costly.
+  *
+  * The nrf51822 has no FPU, so each call to sin(), cos() or atan2() costs thousands of cycles in
+  * software floating point. These functions use only integer arithmetic instead.
+  *
+  * Angles are represented as binary angles, in units of PI/32768: a half turn is 32768, and a full turn is 65536.
+  * Results are returned in the range -32768..32767. Arguments may be any integer, and wrap around every full turn.
+  *
+  * Sines and cosines are returned in Q15 format, where 32767 represents 1.0.
+  */
+
+#ifndef MICROBIT_FIXED_MATH_H
+#define MICROBIT_FIXED_MATH_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+
+#define MICROBIT_FIXED_PI           32768       // Half a turn, as a binary angle.
+#define MICROBIT_FIXED_ONE          32767       // 1.0, in Q15 format.
+
+/**
+  * Multiplies a value by a Q15 fraction, such as a sine or cosine.
+  *
+  * @param a The value to scale.
+  *
+  * @param b The Q15 fraction to scale it by.
+  *
+  * @return a * b / 32768, rounded towards negative infinity.
+  */
+inline int fixed_mul(int a, int b)
+{
+    return (int)(((int64_t)a * b) >> 15);
+}
+
+/**
+  * Computes the sine of the given angle, using a quarter wave lookup table with linear interpolation.
+  *
+  * @param angle The angle, in units of PI/32768.
+  *
+  * @return The sine of the angle, in Q15 format. Accurate to within 2 LSB.
+  */
+int fixed_sin(int angle);
+
+/**
+  * Computes the cosine of the given angle, using a quarter wave lookup table with linear interpolation.
+  *
+  * @param angle The angle, in units of PI/32768.
+  *
+  * @return The cosine of the angle, in Q15 format. Accurate to within 2 LSB.
+  */
+int fixed_cos(int angle);
+
+/**
+  * Computes the angle of the vector (x, y) from the positive x axis, using CORDIC.
+  *
+  * @param y The y component of the vector.
+  *
+  * @param x The x component of the vector.
+  *
+  * @param magnitude If not NULL, the length of the vector (x, y) is stored here.
+  *
+  * @return The angle, in units of PI/32768, in the range -32768..32767. Zero if x and y are both zero.
+  */
+int fixed_atan2(int y, int x, int *magnitude = NULL);
+
+/**
+  * Converts a binary angle to whole degrees, rounding towards zero.
+  *
+  * @param angle The angle, in units of PI/32768.
+  *
+  * @return The angle in degrees, in the range -180..179.
+  */
+int fixed_degrees(int angle);
+
+#endif
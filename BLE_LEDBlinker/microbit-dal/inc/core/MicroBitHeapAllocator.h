@@ -61,6 +61,20 @@ DEALINGS IN THE SOFTWARE.
 // Flag to indicate that a given block is FREE/USED
 #define MICROBIT_HEAP_BLOCK_FREE		0x80000000
 
+/**
+  * Usage statistics for the heaps managed by the micro:bit heap allocator.
+  * All values are in bytes.
+  */
+struct MicroBitHeapStatistics
+{
+    uint32_t used;                  // Memory currently allocated from our heaps, including block headers.
+    uint32_t peak;                  // The highest value of used seen since power on.
+    uint32_t free;                  // Memory currently available in our heaps, including any pooled blocks.
+    uint32_t largestFree;           // The largest contiguous free region in our heaps, excluding pooled blocks.
+    uint32_t pooled;                // Memory held on the segregated free lists, awaiting reuse.
+    uint32_t allocations;           // The number of allocations made from our heaps since power on.
+};
+
 /**
   * Create and initialise a given memory region as for heap storage.
   * After this is called, any future calls to malloc, new, free or delete may use the new heap.
@@ -109,6 +123,17 @@ void *microbit_malloc(size_t size);
   */
 void microbit_free(void *mem);
 
+/**
+  * Provides usage statistics for the heaps managed by the micro:bit heap allocator.
+  *
+  * The ratio of largestFree to free gives an indication of how fragmented the heaps are.
+  *
+  * @param stats The MicroBitHeapStatistics to populate.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int microbit_heap_statistics(MicroBitHeapStatistics &stats);
+
 /*
  * Wrapper function to ensure we have an explicit handle on the heap allocator provided
  * by our underlying platform.
@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitComponent.h"
 #include "MicroBitCoordinateSystem.h"
 #include "MicroBitI2C.h"
+#include "MicroBitFixedMath.h"
 
 /**
   * Relevant pin assignments
@@ -42,6 +43,7 @@ DEALINGS IN THE SOFTWARE.
   */
 #define MICROBIT_ACCEL_PITCH_ROLL_VALID           0x02
 #define MICROBIT_ACCEL_ADDED_TO_IDLE              0x04
+#define MICROBIT_ACCEL_SAMPLE_VALID               0x08
 
 /**
   * I2C constants
@@ -66,6 +68,8 @@ DEALINGS IN THE SOFTWARE.
   * MMA8653 constants
   */
 #define MMA8653_WHOAMI_VAL      0x5A
+#define MMA8653_STATUS_ZYXDR    0x08        // Set when a new sample is available.
+#define MMA8653_STATUS_ZYXOW    0x80        // Set when a sample was overwritten before it was read.
 
 #define MMA8653_SAMPLE_RANGES   3
 #define MMA8653_SAMPLE_RATES    8
@@ -74,6 +78,7 @@ DEALINGS IN THE SOFTWARE.
   * Accelerometer events
   */
 #define MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE              1
+#define MICROBIT_ACCELEROMETER_EVT_SAMPLES_READY            2       // The sample buffer is half full.
 
 /**
   * Gesture events
@@ -119,6 +124,14 @@ struct MMA8653Sample
     int16_t         z;
 };
 
+struct MMA8653TimestampedSample
+{
+    uint32_t        timestamp;          // The time at which the sample was read, in microseconds since power on (modulo 2^32).
+    int16_t         x;                  // The force measured in the X axis, in milli-g, using the RAW coordinate system.
+    int16_t         y;                  // The force measured in the Y axis, in milli-g, using the RAW coordinate system.
+    int16_t         z;                  // The force measured in the Z axis, in milli-g, using the RAW coordinate system.
+};
+
 struct MMA8653SampleRateConfig
 {
     uint32_t        sample_period;
@@ -163,14 +176,23 @@ class MicroBitAccelerometer : public MicroBitComponent
     uint8_t         sampleRange;        // The sample range of the accelerometer in g.
     MMA8653Sample   sample;             // The last sample read.
     DigitalIn       int1;               // Data ready interrupt.
-    float           pitch;              // Pitch of the device, in radians.
+    int16_t         pitch;              // Pitch of the device, in units of PI/32768.
     MicroBitI2C&    i2c;                // The I2C interface to use.
-    float           roll;               // Roll of the device, in radians.
+    int16_t         roll;               // Roll of the device, in units of PI/32768.
     uint8_t         sigma;              // the number of ticks that the instantaneous gesture has been stable.
     uint8_t         impulseSigma;       // the number of ticks since an impulse event has been generated.
     uint16_t        lastGesture;        // the last, stable gesture recorded.
     uint16_t        currentGesture;     // the instantaneous, unfiltered gesture detected.
     ShakeHistory    shake;              // State information needed to detect shake events.
+    MMA8653TimestampedSample *samples;  // A ring of samples awaiting collection by readSamples(), or NULL if not enabled.
+    uint16_t        samplesSize;        // The capacity of the sample ring.
+    uint16_t        samplesHead;        // The index at which the next sample will be stored.
+    uint16_t        samplesCount;       // The number of samples awaiting collection.
+    uint32_t        samplesLost;        // The number of samples missed, or discarded because the ring was full.
+    uint32_t        lastSampleTime;     // The time at which the previous sample was read, in microseconds.
+    uint32_t        sampleTime;         // The time at which the queued read was issued, in microseconds.
+    MicroBitI2CTransfer sampleTransfer; // The queued read of the STATUS and sample registers.
+    uint8_t         sampleData[7];      // The raw STATUS and sample registers.
 
     public:
 
@@ -206,6 +228,10 @@ class MicroBitAccelerometer : public MicroBitComponent
       * Reads the acceleration data from the accelerometer, and stores it in our buffer.
       * This only happens if the accelerometer indicates that it has new data via int1.
       *
+      * The data is read in a single burst, queued on the I2C bus without waiting for it to complete. The new sample
+      * is stored, and MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE raised, by the I2C interrupt handler as soon as it arrives.
+      * Until the first sample has arrived, a call from outside of interrupt context waits up to a sample period for it.
+      *
       * On first use, this member function will attempt to add this component to the
       * list of fiber components in order to constantly update the values stored
       * by this object.
@@ -334,6 +360,18 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     float getPitchRadians();
 
+    /**
+      * Provides a rotation compensated pitch of the device, based on the latest update retrieved from the accelerometer.
+      * This is the native format of the calculation, and needs no floating point arithmetic.
+      *
+      * @return The pitch of the device, in units of PI/32768 (see MicroBitFixedMath.h).
+      *
+      * @code
+      * accelerometer.getPitchAngle();
+      * @endcode
+      */
+    int getPitchAngle();
+
     /**
       * Provides a rotation compensated roll of the device, based on the latest update retrieved from the accelerometer.
       *
@@ -356,6 +394,18 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     float getRollRadians();
 
+    /**
+      * Provides a rotation compensated roll of the device, based on the latest update retrieved from the accelerometer.
+      * This is the native format of the calculation, and needs no floating point arithmetic.
+      *
+      * @return The roll of the device, in units of PI/32768 (see MicroBitFixedMath.h).
+      *
+      * @code
+      * accelerometer.getRollAngle();
+      * @endcode
+      */
+    int getRollAngle();
+
     /**
       * Retrieves the last recorded gesture.
       *
@@ -371,10 +421,62 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     uint16_t getGesture();
 
+    /**
+      * Retains every sample read from the accelerometer, along with the time it was read, so that none are missed
+      * if the application does not call getX/Y/Z() or the idle thread is delayed. Combined with setPeriod(1),
+      * this captures the accelerometer's full 800Hz output.
+      *
+      * A MICROBIT_ACCELEROMETER_EVT_SAMPLES_READY event is raised whenever the buffer becomes half full.
+      *
+      * @param size The number of samples to retain. Defaults to MICROBIT_ACCELEROMETER_SAMPLE_BUFFER_SIZE.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if size is less than 2,
+      *         or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+      */
+    int enableSampleBuffer(int size = MICROBIT_ACCELEROMETER_SAMPLE_BUFFER_SIZE);
+
+    /**
+      * Stops retaining samples, and releases the sample buffer. Any samples not yet read are discarded.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int disableSampleBuffer();
+
+    /**
+      * Determines the number of samples waiting to be read from the sample buffer.
+      *
+      * @return The number of samples available, or MICROBIT_INVALID_PARAMETER if the sample buffer is not enabled.
+      */
+    int getSampleCount();
+
+    /**
+      * Copies the oldest samples from the sample buffer into the given array, and removes them from the buffer.
+      *
+      * @param buffer The array to fill.
+      *
+      * @param length The maximum number of samples to copy.
+      *
+      * @return The number of samples copied, or MICROBIT_INVALID_PARAMETER if the sample buffer is not enabled or the parameters are invalid.
+      *
+      * @code
+      * MMA8653TimestampedSample s[16];
+      * int n = accelerometer.readSamples(s, 16);
+      * @endcode
+      */
+    int readSamples(MMA8653TimestampedSample *buffer, int length);
+
+    /**
+      * Determines the number of samples lost since the sample buffer was enabled. This includes samples the
+      * accelerometer overwrote before they could be read, and samples discarded because the buffer was full.
+      *
+      * @return The number of samples lost.
+      */
+    int getLostSampleCount();
+
     /**
       * A periodic callback invoked by the fiber scheduler idle thread.
       *
-      * Internally calls updateSample().
+      * Polls int1, and queues a read of any new sample. Unlike updateSample(), this never waits, as the idle thread cannot sleep.
       */
     virtual void idleTick();
 
@@ -413,14 +515,42 @@ class MicroBitAccelerometer : public MicroBitComponent
       */
     int readCommand(uint8_t reg, uint8_t* buffer, int length);
 
+    /**
+      * Queues a read of the STATUS and sample registers, unless one is already in progress.
+      *
+      * @param force Read the registers even if int1 does not indicate that a new sample is available.
+      */
+    void requestSample(bool force);
+
+    /**
+      * Called by the I2C interrupt handler when the queued read of the STATUS and sample registers completes.
+      * Stores the sample, if the accelerometer flagged it as new.
+      *
+      * @param t The completed transfer.
+      */
+    static void sampleComplete(MicroBitI2CTransfer *t);
+
+    /**
+      * Converts the raw sample registers into a sample, retains it, updates gesture tracking,
+      * and raises MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE.
+      */
+    void storeSample();
+
     /**
       * Recalculate roll and pitch values for the current sample.
       *
-      * @note We only do this at most once per sample, as the necessary trigonemteric functions are rather
-      *       heavyweight for a CPU without a floating point unit.
+      * @note We only do this at most once per sample. The trigonometry is performed in fixed point,
+      *       as floating point is rather heavyweight for a CPU without a floating point unit.
       */
     void recalculatePitchRoll();
 
+    /**
+      * Appends the current sample to the sample buffer, if enabled, and accounts for any samples missed since the last.
+      *
+      * @param flags The value of the STATUS register read along with the sample.
+      */
+    void recordSample(uint8_t flags);
+
     /**
       * Updates the basic gesture recognizer. This performs instantaneous pose recognition, and also some low pass filtering to promote
       * stability.
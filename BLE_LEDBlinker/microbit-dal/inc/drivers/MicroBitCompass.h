@@ -95,6 +95,7 @@ extern const MAG3110SampleRateConfig MAG3110SampleRate[];
 #define MICROBIT_COMPASS_STATUS_CALIBRATED      2
 #define MICROBIT_COMPASS_STATUS_CALIBRATING     4
 #define MICROBIT_COMPASS_STATUS_ADDED_TO_IDLE   8
+#define MICROBIT_COMPASS_STATUS_SAMPLE_VALID    16
 
 /**
   * Term to convert sample data into SI units
@@ -107,6 +108,11 @@ extern const MAG3110SampleRateConfig MAG3110SampleRate[];
   */
 #define MAG3110_WHOAMI_VAL 0xC4
 
+/**
+  * MAG_DR_STATUS bits
+  */
+#define MAG3110_STATUS_ZYXDR 0x08       // Set when a new sample is available.
+
 struct CompassSample
 {
     int     x;
@@ -155,6 +161,8 @@ class MicroBitCompass : public MicroBitComponent
     MicroBitI2C&		    i2c;                      // The I2C interface the sensor is connected to.
     MicroBitAccelerometer*  accelerometer;            // The accelerometer to use for tilt compensation.
     MicroBitStorage*        storage;                  // An instance of MicroBitStorage used for persistence.
+    MicroBitI2CTransfer     sampleTransfer;           // The queued read of the status and sample registers.
+    uint8_t                 sampleData[7];            // The raw DR_STATUS register, then X, Y and Z, most significant byte first.
 
     public:
 
@@ -406,6 +414,12 @@ class MicroBitCompass : public MicroBitComponent
       * Updates the local sample, only if the compass indicates that
       * data is stale.
       *
+      * The sample registers are read in a single burst, queued on the I2C bus without waiting for it to complete. The new
+      * sample is stored, and MICROBIT_COMPASS_EVT_DATA_UPDATE raised, by the I2C interrupt handler as soon as it arrives.
+      * Until the first sample has arrived, a call from outside of interrupt context waits up to a sample period for it.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the first sample could not be read.
+      *
       * @note Can be used to trigger manual updates, if the device is running without a scheduler.
       *       Also called internally by all get[X,Y,Z]() member functions.
       */
@@ -414,7 +428,7 @@ class MicroBitCompass : public MicroBitComponent
     /**
       * Periodic callback from MicroBit idle thread.
       *
-      * Calls updateSample().
+      * Polls int1, and queues a read of any new sample. Unlike updateSample(), this never waits, as the idle thread cannot sleep.
       */
     virtual void idleTick();
 
@@ -490,6 +504,21 @@ class MicroBitCompass : public MicroBitComponent
       */
     int read8(uint8_t reg);
 
+    /**
+      * Queues a read of the status and sample registers, unless one is already in progress.
+      *
+      * @param force Read the registers even if int1 does not indicate that a new sample is available.
+      */
+    void requestSample(bool force);
+
+    /**
+      * Called by the I2C interrupt handler when the queued read of the status and sample registers completes.
+      * Stores the sample, if the magnetometer flagged it as new.
+      *
+      * @param t The completed transfer.
+      */
+    static void sampleComplete(MicroBitI2CTransfer *t);
+
     /**
       * Calculates a tilt compensated bearing of the device, using the accelerometer.
       */
@@ -30,6 +30,17 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitCompass.h"
 #include "MicroBitAccelerometer.h"
 #include "MicroBitDisplay.h"
+#include "Matrix.h"
+
+/**
+  * Streaming calibration constants. Distances are in the compass's RAW units.
+  */
+#define MICROBIT_COMPASS_CALIBRATOR_MIN_DISTANCE        2000    // Samples closer than this to the last one accepted are ignored.
+#define MICROBIT_COMPASS_CALIBRATOR_MIN_SAMPLES         16      // The number of samples needed before a solution is attempted.
+#define MICROBIT_COMPASS_CALIBRATOR_SOLVE_INTERVAL      8       // The number of samples accepted between solutions.
+#define MICROBIT_COMPASS_CALIBRATOR_WINDOW              256     // Older samples are progressively forgotten once this many have been accepted.
+#define MICROBIT_COMPASS_CALIBRATOR_CONVERGED           500     // The solution is converged once its centre moves less than this between solutions.
+#define MICROBIT_COMPASS_CALIBRATOR_TOLERANCE           1000    // A converged solution is only applied if it differs from the current calibration by more than this.
 
 
 /**
@@ -43,6 +54,10 @@ DEALINGS IN THE SOFTWARE.
   *
   * This class listens for calibration requests from the compass (on the default event model),
   * and automatically initiates a calibration sequence as necessary.
+  *
+  * Alternatively, streaming calibration can be enabled. This fits every new compass sample into the same
+  * least squares model as it arrives, without any user interaction, and keeps the compass calibrated
+  * in the background.
   */
 class MicroBitCompassCalibrator
 {
@@ -50,6 +65,20 @@ class MicroBitCompassCalibrator
     MicroBitAccelerometer&  accelerometer;
     MicroBitDisplay&        display;
 
+    Matrix<4, 4>            XtX;                // The running sum of X transposed times X, over the samples accepted (upper triangle only).
+    Matrix<4, 1>            XtY;                // The running sum of X transposed times Y, over the samples accepted.
+    uint16_t                sampleCount;        // The number of samples accepted into the sums.
+    uint16_t                solveCountdown;     // The number of samples to accept before the next solution.
+    CompassSample           last;               // The last sample accepted.
+    CompassSample           centre;             // The centre of the most recent solution.
+    int                     convergence;        // The distance the centre moved at the most recent solution.
+    bool                    solved;             // Set once a solution has been found since the sums were last cleared.
+
+    /**
+      * Event handler for streaming calibration. Called whenever the compass has a new sample.
+      */
+    void sampleReceived(MicroBitEvent);
+
     public:
 
     /**
@@ -79,6 +108,55 @@ class MicroBitCompassCalibrator
       * This function is, by design, synchronous and only returns once calibration is complete.
       */
     void calibrate(MicroBitEvent);
+
+    /**
+      * Starts calibrating the compass continuously in the background, using the samples the compass produces.
+      *
+      * The compass is recalibrated whenever the solution has converged and differs from the calibration in use.
+      * This requires no user interaction, but the device must be turned through a range of orientations before a solution can be found.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if no default EventModel is available.
+      */
+    int enableStreaming();
+
+    /**
+      * Stops calibrating the compass in the background.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if no default EventModel is available.
+      */
+    int disableStreaming();
+
+    /**
+      * Clears the least squares sums, ready to accept a new set of samples.
+      *
+      * Together with addSample() and solve(), this also lets an application compute a calibration from samples of its own.
+      */
+    void reset();
+
+    /**
+      * Adds a sample to the least squares sums. This takes a handful of multiply-adds, and allocates no memory.
+      *
+      * @param s The sample to add, in the compass's RAW units.
+      */
+    void addSample(CompassSample s);
+
+    /**
+      * Solves the least squares problem for the samples accepted so far, using a 4x4 system held on the stack.
+      *
+      * @param result The centre of the best fitting sphere, which is the zero offset of each axis.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_CALIBRATION_REQUIRED if the samples do not cover
+      *         enough directions to determine a solution.
+      */
+    int solve(CompassSample &result);
+
+    /**
+      * Reports how well the streaming calibration has converged.
+      *
+      * @return The distance the estimated zero offset moved at the most recent solution, in the compass's RAW units.
+      *         Smaller values indicate a more stable calibration. MICROBIT_CALIBRATION_REQUIRED is returned until two solutions have been found.
+      */
+    int getConvergence();
 };
 
 #endif
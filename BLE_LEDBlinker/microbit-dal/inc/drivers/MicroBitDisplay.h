@@ -47,6 +47,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_DISPLAY_DEFAULT_AUTOCLEAR      1
 #define MICROBIT_DISPLAY_SPACING                1
 #define MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH    8
+#define MICROBIT_DISPLAY_TIMER_LATENCY_US       30  // The shortest delay the render timer can reliably schedule.
 #define MICROBIT_DISPLAY_ANIMATE_DEFAULT_POS    -255
 
 enum AnimationMode {
@@ -86,10 +87,27 @@ class MicroBitDisplay : public MicroBitComponent
     uint8_t strobeRow;
     uint8_t rotation;
     uint8_t mode;
-    uint8_t greyscaleBitMsk;
-    uint8_t timingCount;
+    uint8_t greyscaleStep;
     uint32_t col_mask;
 
+    // The GPIO pattern for each row of the current image, under the current rotation.
+    uint32_t *rowPatterns;
+
+    // The sequence of GPIO patterns used to render each row in greyscale, each turning off the pixels
+    // that have been lit for long enough, and the time in microseconds until the next one (0 for the last).
+    // Only computed in greyscale mode.
+    uint32_t *greyscalePatterns;
+    uint16_t *greyscaleDelays;
+
+    // The generation of the image the row patterns were computed from.
+    uint16_t rowPatternsGeneration;
+
+    // Set once the row patterns have been recomputed on a tick with no change to the image.
+    bool rowPatternsSettled;
+
+    // Set if the greyscale patterns were computed along with the row patterns.
+    bool rowPatternsGreyscale;
+
     Timeout renderTimer;
     PortOut *LEDMatrix;
 
@@ -113,14 +131,14 @@ class MicroBitDisplay : public MicroBitComponent
     // State for scrollString() method.
     // This is a surprisingly intricate method.
     //
-    // The text being displayed.
-    ManagedString scrollingText;
+    // The text being displayed, rendered up front as one byte per column, with bit n representing row n.
+    uint8_t *scrollingStrip;
 
-    // The index of the character currently being displayed.
-    uint16_t scrollingChar;
+    // The number of columns in the strip.
+    uint16_t scrollingStripLength;
 
-    // The number of pixels the current character has been shifted on the display.
-    uint8_t scrollingPosition;
+    // The column of the strip currently shown at the left of the display.
+    uint16_t scrollingStripPosition;
 
     //
     // State for printString() method.
@@ -167,6 +185,12 @@ class MicroBitDisplay : public MicroBitComponent
       */
     void renderFinish();
 
+    /**
+      * Recomputes the GPIO patterns for each row if the image, rotation or brightness may have changed
+      * since they were last computed.
+      */
+    void updateRowPatterns();
+
     /**
       * Translates a bit mask to a bit mask suitable for the nrf PORT0 and PORT1.
       * Brightness has two levels on, or off.
@@ -180,13 +204,22 @@ class MicroBitDisplay : public MicroBitComponent
     void renderWithLightSense();
 
     /**
-      * Translates a bit mask into a timer interrupt that gives the appearence of greyscale.
+      * Steps through the precomputed greyscale patterns for the current row, using a timer interrupt
+      * to turn each pixel off once it has been lit for a time proportional to its brightness.
       */
     void renderGreyscale();
 
+    /**
+      * Renders the given string into the scrolling strip, preceded by the columns currently on
+      * the display, so that they scroll out as the text scrolls in.
+      *
+      * @param s The string to render.
+      */
+    void renderScrollingStrip(ManagedString s);
+
     /**
       * Internal scrollText update method.
-      * Shift the screen image by one pixel to the left. If necessary, paste in the next char.
+      * Shift the screen image by one pixel to the left, by copying the next window of the scrolling strip.
       */
     void updateScrollText();
 
@@ -28,9 +28,67 @@ DEALINGS IN THE SOFTWARE.
 
 #include "mbed.h"
 #include "MicroBitConfig.h"
+#include "MicroBitComponent.h"
+#include "ErrorNo.h"
 
 #define MICROBIT_I2C_MAX_RETRIES 9
 
+// Priority of the TWI interrupt. Must be an application priority (1 or 3), as the others are reserved by the SoftDevice.
+#define MICROBIT_I2C_IRQ_PRIORITY 3
+
+/**
+  * Status flags
+  */
+#define MICROBIT_I2C_STATUS_LOCKED          0x01        // A blocking read() or write() is using the peripheral.
+
+/**
+  * Transfer flags
+  */
+#define MICROBIT_I2C_TRANSFER_READ          0x01        // Read from the device, rather than write to it.
+#define MICROBIT_I2C_TRANSFER_WAKE          0x02        // Raise an event with the ID MICROBIT_ID_I2C on completion. Set by transfer().
+
+/**
+  * Describes a single register burst transfer: the register address is written, followed by
+  * a repeated start and a read, or by the data to write.
+  *
+  * Transfers are owned by the caller, and must remain valid until their status is no longer MICROBIT_BUSY.
+  * As fibers' stacks are paged out whilst they sleep, a queued transfer (or its data) must not be on the stack of a fiber
+  * that may sleep before the transfer completes. transfer() takes care of this itself.
+  */
+struct MicroBitI2CTransfer
+{
+    MicroBitI2CTransfer     *next;              // The next transfer in the queue. Maintained by MicroBitI2C.
+    void                    (*callback)(MicroBitI2CTransfer *); // Called in interrupt context on completion, if not NULL.
+    void                    *context;           // Free for use by the callback.
+    uint8_t                 *data;              // The buffer to read into, or write from.
+    volatile int            status;             // MICROBIT_BUSY until complete, then MICROBIT_OK or MICROBIT_I2C_ERROR.
+    uint16_t                event;              // The event value raised on completion, if MICROBIT_I2C_TRANSFER_WAKE is set.
+    uint8_t                 address;            // 8-bit I2C slave address [ addr | 0 ].
+    uint8_t                 reg;                // The first register to access.
+    uint8_t                 length;             // The number of bytes to read or write, after the register address.
+    uint8_t                 flags;              // MICROBIT_I2C_TRANSFER_READ for a read, otherwise a write.
+    uint8_t                 retries;            // The number of times the transfer has been restarted after a bus error.
+
+    /**
+      * Constructor.
+      * Creates an empty, idle transfer.
+      */
+    MicroBitI2CTransfer()
+    {
+        next = NULL;
+        callback = NULL;
+        context = NULL;
+        data = NULL;
+        status = MICROBIT_OK;
+        event = 0;
+        address = 0;
+        reg = 0;
+        length = 0;
+        flags = 0;
+        retries = 0;
+    }
+};
+
 /**
   * Class definition for MicroBitI2C.
   *
@@ -42,13 +100,76 @@ DEALINGS IN THE SOFTWARE.
   * https://www.nordicsemi.com/eng/nordic/Products/nRF51822/PAN-nRF51822/24634
   *
   * v2.0 through to v2.4
+  *
+  * Register burst transfers can also be queued, and are then driven entirely by the TWI interrupt.
+  * Queued transfers complete in order, and report completion through a callback or by waking the fiber
+  * that issued them, so the processor is free to do other work while the bus is busy.
   */
 class MicroBitI2C : public I2C
 {
-    uint8_t retries;
+    uint8_t                         retries;
+    uint8_t                         status;
+    uint8_t                         index;          // The number of data bytes moved by the current transfer.
+    uint16_t                        sequence;       // The event value given to the last transfer that requested a wake up.
+    MicroBitI2CTransfer             *head;          // The oldest transfer in the queue. This is the one in progress, if any.
+    MicroBitI2CTransfer             *tail;          // The newest transfer in the queue.
+    MicroBitI2CTransfer * volatile  current;        // The transfer the peripheral is working on, or NULL if it is idle.
+
+    /**
+      * Applies the PAN56 workaround, by power cycling the TWI peripheral and clearing the bus.
+      */
+    void reset();
+
+    /**
+      * Starts the transfer at the head of the queue, unless the peripheral is busy or locked.
+      */
+    void start();
+
+    /**
+      * Programs the peripheral to perform the given transfer from the beginning.
+      *
+      * @param t The transfer to perform.
+      */
+    void begin(MicroBitI2CTransfer *t);
+
+    /**
+      * Removes the current transfer from the queue, reports its result, and starts the next one.
+      *
+      * @param result The status to report.
+      */
+    void complete(int result);
+
+    /**
+      * Waits until the peripheral is idle, then prevents queued transfers from starting.
+      * Used to keep blocking operations from interleaving with queued ones.
+      *
+      * In interrupt context, queued transfers are completed by polling the peripheral, as the TWI interrupt
+      * cannot preempt the caller.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_BUSY if called from an interrupt handler that has
+      *         interrupted a blocking read or write.
+      */
+    int lock();
+
+    /**
+      * Allows queued transfers to start again.
+      */
+    void unlock();
+
+    /**
+      * Checks that a transfer is idle, and describes a valid transfer.
+      *
+      * @param t The transfer to check.
+      *
+      * @return MICROBIT_OK if the transfer can be queued, MICROBIT_BUSY if it is already queued,
+      *         or MICROBIT_INVALID_PARAMETER if it does not describe a valid transfer.
+      */
+    int validate(MicroBitI2CTransfer &t);
 
     public:
 
+    static MicroBitI2C  *instance;  // Used by the TWI interrupt handler.
+
     /**
       * Constructor.
       *
@@ -84,7 +205,8 @@ class MicroBitI2C : public I2C
       *
       * @param repeated if true, stop is not sent at the end. Defaults to false.
       *
-      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved read failure is detected.
+      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved read failure is detected, or MICROBIT_BUSY
+      *         if called from an interrupt handler that has interrupted another read or write.
       */
     int read(int address, char *data, int length, bool repeated = false);
 
@@ -99,9 +221,100 @@ class MicroBitI2C : public I2C
       *
       * @param repeated if true, stop is not sent at the end. Defaults to false.
       *
-      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved write failure is detected.
+      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved write failure is detected, or MICROBIT_BUSY
+      *         if called from an interrupt handler that has interrupted another read or write.
       */
     int write(int address, const char *data, int length, bool repeated = false);
+
+    /**
+      * Adds a transfer to the queue, and returns without waiting for it to complete.
+      *
+      * The status of the transfer reads MICROBIT_BUSY until it completes. Its callback, if any, is then
+      * called in interrupt context. The transfer and its data buffer must remain valid until then.
+      *
+      * @param t The transfer to perform.
+      *
+      * @return MICROBIT_OK if the transfer was queued, MICROBIT_BUSY if it is already queued,
+      *         or MICROBIT_INVALID_PARAMETER if it does not describe a valid transfer.
+      *
+      * @code
+      * MicroBitI2CTransfer t;
+      *
+      * t.address = 0x1D << 1;
+      * t.reg = 0x01;
+      * t.flags = MICROBIT_I2C_TRANSFER_READ;
+      * t.length = 6;
+      * t.data = buffer;
+      *
+      * i2c.queue(t);
+      * @endcode
+      */
+    int queue(MicroBitI2CTransfer &t);
+
+    /**
+      * Adds a transfer to the queue, and waits for it to complete.
+      *
+      * If the scheduler is running, the calling fiber sleeps while the transfer is in progress. Otherwise the processor
+      * spins until it completes. In interrupt context, where the TWI interrupt cannot preempt the caller, the peripheral
+      * is polled instead, completing any transfers queued ahead of this one.
+      *
+      * @param t The transfer to perform.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved bus failure is detected,
+      *         MICROBIT_BUSY if the transfer is already queued (or if called from an interrupt handler that has
+      *         interrupted a blocking read or write), MICROBIT_NO_RESOURCES if there is not enough memory to hold a copy
+      *         of the transfer, or MICROBIT_INVALID_PARAMETER if it does not describe a valid transfer.
+      *
+      * @note Outside of interrupt context, a copy of the transfer and its data is queued, so both may be on the caller's stack.
+      *       This must not be called from an idle tick, as the idle thread cannot sleep.
+      */
+    int transfer(MicroBitI2CTransfer &t);
+
+    /**
+      * Reads a block of consecutive registers from a device, in a single transaction.
+      *
+      * @param address 8-bit I2C slave address [ addr | 0 ]
+      *
+      * @param reg The first register to read.
+      *
+      * @param data A pointer to a byte buffer used for storing retrieved data.
+      *
+      * @param length Number of bytes to read, between 1 and 255.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the read request failed.
+      *
+      * @note As transfer(), this puts the calling fiber to sleep until the read is complete.
+      */
+    int readRegister(uint8_t address, uint8_t reg, uint8_t *data, int length);
+
+    /**
+      * Writes a block of consecutive registers on a device, in a single transaction.
+      *
+      * @param address 8-bit I2C slave address [ addr | 0 ]
+      *
+      * @param reg The first register to write.
+      *
+      * @param data A pointer to a byte buffer containing the data to write.
+      *
+      * @param length Number of bytes to write, between 0 and 255.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the write request failed.
+      *
+      * @note As transfer(), this puts the calling fiber to sleep until the write is complete.
+      */
+    int writeRegister(uint8_t address, uint8_t reg, const uint8_t *data, int length);
+
+    /**
+      * Determines if any queued transfers have yet to complete.
+      *
+      * @return true if the queue is not empty, false otherwise.
+      */
+    bool isBusy();
+
+    /**
+      * Advances the transfer in progress. Called by the TWI interrupt handler.
+      */
+    void interruptHandler();
 };
 
 #endif
\ No newline at end of file
@@ -33,6 +33,16 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitListener.h"
 #include "EventModel.h"
 
+/**
+  * Entry in the MicroBitMessageBus listener index.
+  * Records the first listener in the (sorted) chain of listeners registered for a given ID.
+  */
+struct MicroBitListenerIndexEntry
+{
+    uint16_t            id;                 // The ID of the component.
+    MicroBitListener    *first;             // The first listener in the chain registered for this ID.
+};
+
 /**
   * Class definition for the MicroBitMessageBus.
   *
@@ -139,13 +149,25 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     virtual int remove(MicroBitListener *newListener);
 
+    /**
+      * Determines the number of events that have been dropped because the event queue was full.
+      *
+      * @return The number of events dropped since this MicroBitMessageBus was created.
+      */
+    uint32_t getDroppedEventCount();
+
 	private:
 
     MicroBitListener            *listeners;		    // Chain of active listeners.
-    MicroBitEventQueueItem      *evt_queue_head;    // Head of queued events to be processed.
-    MicroBitEventQueueItem      *evt_queue_tail;    // Tail of queued events to be processed.
+    MicroBitListenerIndexEntry  *listenerIndex;     // Sorted index into the listener chain, one entry per distinct non-wildcard ID.
+    uint16_t                    listenerIndexSize;  // The number of entries in listenerIndex.
+    uint16_t                    listenerIndexCapacity; // The number of entries listenerIndex has room for.
+    MicroBitEvent               evt_queue[MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH];   // Ring buffer of queued events to be processed.
+    uint16_t                    evt_queue_head;     // Index of the oldest event in evt_queue.
     uint16_t                    nonce_val;          // The last nonce issued.
     uint16_t                    queueLength;        // The number of events currently waiting to be processed.
+    uint16_t                    queueCount;         // The number of events ever added to the queue (wraps). Used to maintain causal ordering.
+    uint32_t                    droppedEvents;      // The number of events dropped as the queue was full.
 
     /**
       * Cleanup any MicroBitListeners marked for deletion from the list.
@@ -154,6 +176,36 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
       */
     int deleteMarkedListeners();
 
+    /**
+      * Rebuilds the listener index from the chain of active listeners.
+      * Called whenever listeners are added to or removed from the chain.
+      *
+      * The index only grows, doubling in size as needed, so it is rarely reallocated as listeners are added.
+      */
+    void rebuildListenerIndex();
+
+    /**
+      * Determines the first listener in the chain registered for the given ID.
+      *
+      * @param id The ID to look up. Must not be MICROBIT_ID_ANY.
+      *
+      * @return The first MicroBitListener registered for the given ID, or NULL if there are none.
+      */
+    MicroBitListener *findListeners(uint16_t id);
+
+    /**
+      * Delivers the given event to the run of listeners starting at l that share the same ID.
+      *
+      * @param l The first listener in the run.
+      *
+      * @param evt The event to deliver.
+      *
+      * @param urgent The type of listeners to process.
+      *
+      * @return 1 if all matching listeners were processed, 0 if further processing is required.
+      */
+    int processListeners(MicroBitListener *l, MicroBitEvent &evt, bool urgent);
+
     /**
       * Queue the given event for processing at a later time.
       * Add the given event at the tail of our queue.
@@ -165,9 +217,11 @@ class MicroBitMessageBus : public EventModel, public MicroBitComponent
     /**
       * Extract the next event from the front of the event queue (if present).
       *
-      * @return a pointer to the MicroBitEventQueueItem that is at the head of the list.
+      * @param evt The MicroBitEvent to store the event in.
+      *
+      * @return 1 if an event was extracted, 0 if the queue is empty.
       */
-    MicroBitEventQueueItem* dequeueEvent();
+    int dequeueEvent(MicroBitEvent &evt);
 
     /**
       * Periodic callback from MicroBit.
@@ -60,6 +60,7 @@ struct FrameBuffer;
 
 // Status Flags
 #define MICROBIT_RADIO_STATUS_INITIALISED       0x0001
+#define MICROBIT_RADIO_STATUS_TRANSMITTING      0x0002
 
 // Default configuration values
 #define MICROBIT_RADIO_BASE_ADDRESS             0x75626974
@@ -69,10 +70,18 @@ struct FrameBuffer;
 #define MICROBIT_RADIO_MAX_PACKET_SIZE          32
 #define MICROBIT_RADIO_HEADER_SIZE              4
 #define MICROBIT_RADIO_MAXIMUM_RX_BUFFERS       4
+#define MICROBIT_RADIO_MAXIMUM_TX_BUFFERS       4
+
+// The receive buffers held by the radio: one for the RADIO hardware to fill, the queued packets, and the one last returned by recv().
+#define MICROBIT_RADIO_RX_POOL_SIZE             (MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 2)
+
+// The transmit buffers held by the radio: the queued packets, plus one spare slot to tell a full queue from an empty one.
+#define MICROBIT_RADIO_TX_POOL_SIZE             (MICROBIT_RADIO_MAXIMUM_TX_BUFFERS + 1)
 
 // Known Protocol Numbers
 #define MICROBIT_RADIO_PROTOCOL_DATAGRAM        1       // A simple, single frame datagram. a little like UDP but with smaller packets. :-)
 #define MICROBIT_RADIO_PROTOCOL_EVENTBUS        2       // Transparent propogation of events from one micro:bit to another.
+#define MICROBIT_RADIO_PROTOCOL_EVENTBATCH      3       // As above, but with several events coalesced into each packet.
 
 // Events
 #define MICROBIT_RADIO_EVT_DATAGRAM             1       // Event to signal that a new datagram has been received.
@@ -90,14 +99,32 @@ struct FrameBuffer
     uint8_t         rssi;                               // Received signal strength of this frame.
 };
 
+struct RadioTxStatistics
+{
+    uint32_t        packets;                            // The number of packets transmitted.
+    uint32_t        dropped;                            // The number of packets rejected by send() because the transmit queue was full.
+    uint32_t        latency;                            // Total time from send() to the end of transmission, over all packets, in microseconds.
+    uint32_t        maxLatency;                         // The longest time from send() to the end of transmission of any one packet, in microseconds.
+    uint32_t        airtime;                            // Total time the transmitter has been active, from ramp up to the end of each packet, in microseconds.
+    uint8_t         queueDepth;                         // The number of packets currently waiting to be sent.
+    uint8_t         maxQueueDepth;                      // The greatest number of packets that have been waiting to be sent at any one time.
+};
+
 
 class MicroBitRadio : MicroBitComponent
 {
     uint8_t                 group;      // The radio group to which this micro:bit belongs.
-    uint8_t                 queueDepth; // The number of packets in the receiver queue.
     uint8_t                 rssi;
-    FrameBuffer             *rxQueue;   // A linear list of incoming packets, queued awaiting processing.
-    FrameBuffer             *rxBuf;     // A pointer to the buffer being actively used by the RADIO hardware.
+    FrameBuffer             *rxPool;    // A fixed pool of receive buffers, used as a ring of incoming packets awaiting processing.
+    volatile uint8_t        rxHead;     // The index of the buffer being actively used by the RADIO hardware.
+    volatile uint8_t        rxTail;     // The index of the oldest packet awaiting processing.
+    uint16_t                rxDropped;  // The number of packets discarded because the receiver queue was full.
+    FrameBuffer             *txPool;    // A fixed pool of transmit buffers, used as a ring of outgoing packets awaiting transmission.
+    volatile uint8_t        txHead;     // The index of the next free transmit buffer.
+    volatile uint8_t        txTail;     // The index of the packet being transmitted, or next to be transmitted.
+    uint32_t                txQueuedAt[MICROBIT_RADIO_TX_POOL_SIZE]; // The time at which each queued packet was passed to send(), in microseconds.
+    uint32_t                txStartedAt;    // The time at which the transmitter was last enabled, in microseconds.
+    RadioTxStatistics       txStats;    // Running statistics on the transmit queue.
 
     public:
     MicroBitRadioDatagram   datagram;   // A simple datagram service.
@@ -143,12 +170,55 @@ class MicroBitRadio : MicroBitComponent
 
     /**
       * Attempt to queue a buffer received by the radio hardware, if sufficient space is available.
+      * This takes constant time, and allocates no memory, so is safe to call from the RADIO interrupt.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if a replacement receiver buffer
-      *         could not be allocated (either by policy or memory exhaustion).
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the receiver queue is full,
+      *         in which case the packet is dropped.
       */
     int queueRxBuf();
 
+    /**
+      * Retrieve the packet at the front of the transmit queue, and record that the transmitter is in use.
+      *
+      * @return a pointer to the packet to transmit next, or NULL if the transmit queue is empty.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    FrameBuffer * beginTx();
+
+    /**
+      * Remove the packet just transmitted from the transmit queue, and record that the transmitter is idle.
+      * This takes constant time, and allocates no memory, so is safe to call from the RADIO interrupt.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if no transmission was in progress.
+      *
+      * @note should only be called from RADIO_IRQHandler...
+      */
+    int endTx();
+
+    /**
+      * Determines if the transmitter is currently in use.
+      *
+      * @return 1 if a packet is being transmitted, 0 otherwise.
+      */
+    int isTransmitting();
+
+    /**
+      * Determines the number of packets waiting to be sent, including any packet currently being transmitted.
+      *
+      * @return The number of packets in the transmit queue.
+      */
+    int getTxQueueDepth();
+
+    /**
+      * Retrieves statistics describing the performance of the transmit queue.
+      *
+      * @param stats The structure to fill in.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int getTxStatistics(RadioTxStatistics &stats);
+
     /**
       * Sets the RSSI for the most recent packet.
       *
@@ -174,6 +244,8 @@ class MicroBitRadio : MicroBitComponent
 
     /**
       * Disables the radio for use as a multipoint sender/receiver.
+      * When called from a fiber, packets still waiting in the transmit queue are given time to be sent first.
+      * Any that remain are discarded.
       *
       * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
       */
@@ -208,18 +280,28 @@ class MicroBitRadio : MicroBitComponent
       *
       * @return The buffer containing the the packet. If no data is available, NULL is returned.
       *
-      * @note Once recv() has been called, it is the callers responsibility to
-      *       delete the buffer when appropriate.
+      * @note The buffer belongs to the radio, and must not be deleted. It remains valid until
+      *       the next call to recv(), after which it is reused for incoming packets.
       */
     FrameBuffer* recv();
 
+    /**
+      * Determines the number of received packets that have been discarded because
+      * the receiver queue was full.
+      *
+      * @return The number of packets dropped.
+      */
+    int getDroppedCount();
+
     /**
       * Transmits the given buffer onto the broadcast radio.
-      * The call will wait until the transmission of the packet has completed before returning.
+      * The packet is copied into the transmit queue, and the call returns immediately.
+      * Transmission then takes place in the background, driven by the RADIO interrupt.
       *
-      * @param data The packet contents to transmit.
+      * @param buffer The packet contents to transmit.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running or the radio
+      *         has not been enabled, or MICROBIT_NO_RESOURCES if the transmit queue is full.
       */
     int send(FrameBuffer *buffer);
 };
@@ -45,7 +45,10 @@ DEALINGS IN THE SOFTWARE.
 class MicroBitRadioDatagram
 {
     MicroBitRadio   &radio;     // The underlying radio module used to send and receive data.
-    FrameBuffer     *rxQueue;   // A linear list of incoming packets, queued awaiting processing.
+    FrameBuffer     *rxQueue;   // A ring of incoming packets, queued awaiting processing. Allocated on first use.
+    uint8_t         rxHead;     // The index in rxQueue at which the next packet will be stored.
+    uint8_t         rxTail;     // The index in rxQueue of the oldest packet.
+    uint16_t        rxDropped;  // The number of packets discarded because rxQueue was full.
 
     public:
 
@@ -86,44 +89,52 @@ class MicroBitRadioDatagram
     /**
       * Transmits the given buffer onto the broadcast radio.
       *
-      * This is a synchronous call that will wait until the transmission of the packet
-      * has completed before returning.
+      * The packet is queued for transmission, and the call returns immediately.
       *
       * @param buffer The packet contents to transmit.
       *
       * @param len The number of bytes to transmit.
       *
       * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
-      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`,
+      *         or MICROBIT_NO_RESOURCES if the radio's transmit queue is full.
       */
     int send(uint8_t *buffer, int len);
 
     /**
       * Transmits the given string onto the broadcast radio.
       *
-      * This is a synchronous call that will wait until the transmission of the packet
-      * has completed before returning.
+      * The packet is queued for transmission, and the call returns immediately.
       *
       * @param data The packet contents to transmit.
       *
       * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
-      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`,
+      *         or MICROBIT_NO_RESOURCES if the radio's transmit queue is full.
       */
     int send(PacketBuffer data);
 
     /**
       * Transmits the given string onto the broadcast radio.
       *
-      * This is a synchronous call that will wait until the transmission of the packet
-      * has completed before returning.
+      * The packet is queued for transmission, and the call returns immediately.
       *
       * @param data The packet contents to transmit.
       *
       * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
-      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+      *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`,
+      *         or MICROBIT_NO_RESOURCES if the radio's transmit queue is full.
       */
     int send(ManagedString data);
 
+    /**
+      * Determines the number of received datagrams that have been discarded because
+      * too many were already waiting to be received.
+      *
+      * @return The number of datagrams dropped.
+      */
+    int getDroppedCount();
+
     /**
       * Protocol handler callback. This is called when the radio receives a packet marked as a datagram.
       *
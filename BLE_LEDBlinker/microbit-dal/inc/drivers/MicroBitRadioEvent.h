@@ -28,9 +28,44 @@ DEALINGS IN THE SOFTWARE.
 
 #include "mbed.h"
 #include "MicroBitConfig.h"
+#include "MicroBitComponent.h"
 #include "MicroBitRadio.h"
 #include "EventModel.h"
 
+// The number of events carried in each batched packet. Each takes six bytes of the 32 byte payload.
+#define MICROBIT_RADIO_EVENT_BATCH_SIZE         5
+
+// The default time an event may wait for others to share its packet, in milliseconds.
+#define MICROBIT_RADIO_EVENT_BATCH_DEADLINE     10
+
+// The number of recently forwarded events remembered when suppressing duplicates.
+#define MICROBIT_RADIO_EVENT_HISTORY_SIZE       4
+
+struct RadioEventRecord
+{
+    uint16_t        source;                     // ID of the component that generated the event.
+    uint16_t        value;                      // Component specific code indicating the cause of the event.
+    uint16_t        age;                        // Time from the event being generated to its packet being sent, in microseconds (saturating).
+};
+
+struct RadioEventHistory
+{
+    uint16_t        source;                     // ID of the component that generated the event.
+    uint16_t        value;                      // Component specific code indicating the cause of the event.
+    uint32_t        timestamp;                  // The time at which this event was last forwarded, in microseconds.
+};
+
+struct RadioEventStatistics
+{
+    uint32_t        eventsSent;                 // The number of events forwarded onto the radio.
+    uint32_t        packetsSent;                // The number of packets used to carry them.
+    uint32_t        eventsSuppressed;           // The number of events not forwarded, as they repeated a recent event.
+    uint32_t        eventsReceived;             // The number of events received from the radio.
+    uint32_t        packetsReceived;            // The number of packets that carried them.
+    uint32_t        latency;                    // Total time from generation to transmission of all batched events received, in microseconds.
+    uint32_t        maxLatency;                 // The longest time from generation to transmission of any batched event received, in microseconds.
+};
+
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
  *
@@ -44,10 +79,51 @@ DEALINGS IN THE SOFTWARE.
  * teaching aid to demonstrate how simple communications operates, and to provide a sandpit through which learning can take place.
  * For serious applications, BLE should be considered a substantially more secure alternative.
  */
-class MicroBitRadioEvent
+class MicroBitRadioEvent : public MicroBitComponent
 {
-    bool            suppressForwarding;     // A private flag used to prevent event forwarding loops.
-    MicroBitRadio   &radio;                 // A reference to the underlying radio module to use.
+    bool                    suppressForwarding;     // A private flag used to prevent event forwarding loops.
+    MicroBitRadio           &radio;                 // A reference to the underlying radio module to use.
+    RadioEventRecord        batch[MICROBIT_RADIO_EVENT_BATCH_SIZE];             // Events waiting to be sent.
+    uint32_t                batchTimestamp[MICROBIT_RADIO_EVENT_BATCH_SIZE];    // The time at which each waiting event was generated, in microseconds.
+    uint8_t                 batchLength;            // The number of events waiting to be sent.
+    uint32_t                batchDeadline;          // The time by which the waiting events must be sent, in microseconds.
+    uint32_t                deadline;               // The time an event may wait to be batched, in milliseconds. Zero disables batching.
+    uint32_t                window;                 // The time within which repeated events are suppressed, in milliseconds. Zero disables this.
+    RadioEventHistory       history[MICROBIT_RADIO_EVENT_HISTORY_SIZE];         // Recently forwarded events.
+    uint8_t                 historyIndex;           // The entry in the history to be replaced next.
+    RadioEventStatistics    stats;                  // Running statistics on forwarded and received events.
+
+    /**
+      * Determines if the given event repeats one forwarded within the de-duplication window,
+      * and if not, records it as forwarded.
+      *
+      * @param e The event to test.
+      *
+      * @return true if the event should be suppressed, false otherwise.
+      */
+    bool isDuplicate(MicroBitEvent &e);
+
+    /**
+      * Packs the waiting events into the given packet, and empties the batch.
+      *
+      * @param buf The packet to fill in.
+      *
+      * @return The number of events packed, or zero if none were waiting.
+      *
+      * @note must be called with interrupts disabled.
+      */
+    int packBatch(FrameBuffer &buf);
+
+    /**
+      * Transmits a packet of forwarded events, and records it in the statistics.
+      *
+      * @param buf The packet to send.
+      *
+      * @param count The number of events it contains.
+      *
+      * @return MICROBIT_OK on success, or an error code from MicroBitRadio::send().
+      */
+    int sendBatch(FrameBuffer &buf, int count);
 
     public:
 
@@ -61,6 +137,63 @@ class MicroBitRadioEvent
       */
     MicroBitRadioEvent(MicroBitRadio &r);
 
+    /**
+      * Coalesces forwarded events into shared packets, rather than sending one packet per event.
+      *
+      * A packet is sent as soon as it is full, or once its oldest event has waited for the given deadline.
+      * Batched packets use the MICROBIT_RADIO_PROTOCOL_EVENTBATCH protocol, and are only understood by
+      * micro:bits running a runtime that supports it.
+      *
+      * @param deadline The maximum time an event may wait to be sent, in milliseconds.
+      *        Defaults to MICROBIT_RADIO_EVENT_BATCH_DEADLINE.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the deadline is zero.
+      */
+    int enableBatching(uint32_t deadline = MICROBIT_RADIO_EVENT_BATCH_DEADLINE);
+
+    /**
+      * Returns to sending one packet per forwarded event. Any events waiting in a batch are sent immediately.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int disableBatching();
+
+    /**
+      * Suppresses forwarding of events that repeat the source and value of an event forwarded recently.
+      *
+      * @param window The period within which repeated events are suppressed, in milliseconds. Zero disables suppression.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int setDeduplicationWindow(uint32_t window);
+
+    /**
+      * Sends any events waiting in the current batch immediately.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if no events were waiting,
+      *         or an error code from MicroBitRadio::send().
+      */
+    int flush();
+
+    /**
+      * Retrieves statistics describing the events forwarded and received.
+      * The average number of events per packet is eventsSent / packetsSent, and eventsReceived / packetsReceived.
+      * The latency of received events is the time each waited in the sender's batch before being transmitted, and
+      * does not include the time spent on air or in the receiver's event queue.
+      *
+      * @param s The structure to fill in.
+      *
+      * @return MICROBIT_OK on success.
+      */
+    int getStatistics(RadioEventStatistics &s);
+
+    /**
+      * Periodic callback from MicroBit system timer.
+      *
+      * Sends the current batch of events once its deadline has passed.
+      */
+    virtual void systemTick();
+
     /**
       * Associates the given event with the radio channel.
       *
@@ -128,7 +261,7 @@ class MicroBitRadioEvent
     /**
       * Protocol handler callback. This is called when the radio receives a packet marked as using the event protocol.
       *
-      * This function process this packet, and fires the event contained inside onto the default EventModel.
+      * This function process this packet, and fires the events contained inside onto the default EventModel.
       */
     void packetReceived();
 
@@ -49,6 +49,92 @@ enum MicroBitSerialMode
 	SYNC_SLEEP
 };
 
+/**
+  * A set of delimeter characters, held as a 256 bit bitmap.
+  *
+  * This lets a received byte be matched against any number of delimeters with a single
+  * lookup, rather than a scan of the delimeter string for every byte.
+  */
+struct DelimeterMap
+{
+    uint32_t map[8];
+
+    /**
+      * Removes all characters from the set.
+      */
+    void clear();
+
+    /**
+      * Replaces the contents of the set with the given characters.
+      *
+      * @param delimeters the characters to match e.g. ManagedString("\r\n")
+      */
+    void set(ManagedString delimeters);
+
+    /**
+      * Adds the characters of another set to this one.
+      *
+      * @param other the set of characters to add.
+      */
+    void add(const DelimeterMap &other);
+
+    /**
+      * Determines if the given character is in the set.
+      *
+      * @param c the character to test.
+      *
+      * @return true if c is one of the delimeters, false otherwise.
+      */
+    bool contains(uint8_t c) const
+    {
+        return (map[c >> 5] & (1UL << (c & 31))) != 0;
+    }
+};
+
+/**
+  * Describes a run of bytes held in a circular buffer, without copying them.
+  *
+  * Because the run may wrap around the end of the buffer, it is made up of up to two
+  * contiguous regions. The second region is empty unless the run wraps.
+  */
+struct CircularSpan
+{
+    uint8_t *first;         // the start of the first region
+    int firstLength;        // the number of bytes in the first region
+    uint8_t *second;        // the start of the second region, always the start of the buffer
+    int secondLength;       // the number of bytes in the second region
+
+    /**
+      * Describes the bytes of a circular buffer between two positions.
+      *
+      * @param buffer the circular buffer
+      *
+      * @param size the size of the circular buffer
+      *
+      * @param tailPosition the position of the first byte of the run
+      *
+      * @param headPosition the position after the last byte of the run
+      */
+    void set(uint8_t *buffer, int size, int tailPosition, int headPosition);
+
+    /**
+      * Gets the number of bytes in the run.
+      *
+      * @return the combined length of both regions.
+      */
+    int length() const
+    {
+        return firstLength + secondLength;
+    }
+
+    /**
+      * Copies the run into a new ManagedString. This is the only copy made.
+      *
+      * @return a ManagedString containing the bytes of the run, in order.
+      */
+    ManagedString toString() const;
+};
+
 /**
   * Class definition for MicroBitSerial.
   *
@@ -64,7 +150,7 @@ class MicroBitSerial : public RawSerial
     static int baudrate;
 
     //delimeters used for matching on receive.
-    ManagedString delimeters;
+    DelimeterMap delimeters;
 
     //a variable used when a user calls the eventAfter() method.
     int rxBuffHeadMatch;
@@ -74,6 +160,11 @@ class MicroBitSerial : public RawSerial
     volatile uint16_t rxBuffHead;
     uint16_t rxBuffTail;
 
+    //the position in rxBuff that peekUntil() has scanned up to, without finding a delimeter.
+    uint16_t rxScanPosition;
+
+    //the delimeters that peekUntil() was last asked to scan for.
+    DelimeterMap rxScanDelimeters;
 
     uint8_t *txBuff;
     uint8_t txBuffSize;
@@ -84,7 +175,8 @@ class MicroBitSerial : public RawSerial
       * An internal interrupt callback for MicroBitSerial configured for when a
       * character is received.
       *
-      * Each time a character is received fill our circular buffer!
+      * Drains every character the UART is holding into our circular buffer, then
+      * raises at most one event of each type for the whole batch.
       */
     void dataReceived();
 
@@ -178,22 +270,25 @@ class MicroBitSerial : public RawSerial
     int getChar(MicroBitSerialMode mode);
 
     /**
-      * An internal method that copies values from a circular buffer to a linear buffer.
+      * An internal method that continues the scan of the rxBuff for a delimeter, from
+      * where the last scan stopped.
       *
-      * @param circularBuff a pointer to the source circular buffer
-      *
-      * @param circularBuffSize the size of the circular buffer
-      *
-      * @param linearBuff a pointer to the destination linear buffer
+      * @return the position of the first delimeter after the rxBuffTail, or -1 if
+      *         there is no delimeter in the rxBuff.
+      */
+    int scanUntil();
+
+    /**
+      * An internal method that finds the first delimeter in the rxBuff, waiting for one
+      * to arrive as determined by the mode.
       *
-      * @param tailPosition the tail position in the circular buffer you want to copy from
+      * @param delimeters the characters to match received characters against.
       *
-      * @param headPosition the head position in the circular buffer you want to copy to
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP.
       *
-      * @note this method assumes that the linear buffer has the appropriate amount of
-      *       memory to contain the copy operation
+      * @return the position of the delimeter in the rxBuff, or -1 if none was found.
       */
-    void circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition);
+    int findDelimeter(ManagedString delimeters, MicroBitSerialMode mode);
 
     public:
 
@@ -410,6 +505,77 @@ class MicroBitSerial : public RawSerial
       */
     ManagedString readUntil(ManagedString delimeters, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
 
+    /**
+      * Finds the characters up to one of the delimeters in the rxBuff, without copying
+      * them or removing them from the rxBuff.
+      *
+      * Scanning resumes from where the previous call stopped, so polling for a line
+      * only ever examines each received character once.
+      *
+      * @param delimeters a ManagedString containing a sequence of delimeter characters e.g. ManagedString("\r\n")
+      *
+      * @param span set to describe the characters before the delimeter, which stay valid
+      *        until they are removed with consume().
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP, which
+      *        behave as described for readUntil().
+      *
+      * @return the number of characters before the delimeter, MICROBIT_NO_DATA if no
+      *         delimeter was found, or MICROBIT_SERIAL_IN_USE if another fiber is currently
+      *         using this instance for reception.
+      *
+      * @code
+      * CircularSpan line;
+      * int len = serial.peekUntil("\n", line);
+      *
+      * if (len >= 0)
+      * {
+      *     handleCommand(line.first, line.firstLength, line.second, line.secondLength);
+      *     serial.consume(len + 1);    // + 1 for the delimeter
+      * }
+      * @endcode
+      */
+    int peekUntil(ManagedString delimeters, CircularSpan &span, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
+    /**
+      * Removes characters from the rxBuff, without copying them.
+      *
+      * @param len the number of characters to remove.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if fewer than len
+      *         characters are buffered, or MICROBIT_SERIAL_IN_USE if another fiber is
+      *         currently using this instance for reception.
+      */
+    int consume(int len);
+
+    /**
+      * Finds the free space in the txBuff, so that it can be filled directly rather than
+      * copied from another buffer. The space must then be handed back with commitTx().
+      *
+      * This instance is locked for transmission until commitTx() is called.
+      *
+      * @param span set to describe the free space in the txBuff.
+      *
+      * @return the number of bytes of free space, MICROBIT_SERIAL_IN_USE if another fiber
+      *         is currently transmitting with this instance, or MICROBIT_NO_RESOURCES if
+      *         the txBuff could not be allocated.
+      */
+    int reserveTx(CircularSpan &span);
+
+    /**
+      * Transmits bytes written directly into the space found by reserveTx(), and unlocks
+      * this instance for transmission.
+      *
+      * @param len the number of bytes written, from the start of the reserved space.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP, which
+      *        behave as described for send().
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if len is larger
+      *         than the reserved space.
+      */
+    int commitTx(int len, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
     /**
       * A wrapper around the inherited method "baud" so we can trap the baud rate
       * as it changes and restore it if redirect() is called.
@@ -0,0 +1,196 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_SERIAL_FRAMER_H
+#define MICROBIT_SERIAL_FRAMER_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "MicroBitSerial.h"
+#include "MicroBitEvent.h"
+#include "PacketBuffer.h"
+#include "ManagedString.h"
+
+// SLIP (RFC 1055) special characters.
+#define MICROBIT_SERIAL_FRAME_END           0xC0
+#define MICROBIT_SERIAL_FRAME_ESC           0xDB
+#define MICROBIT_SERIAL_FRAME_ESC_END       0xDC
+#define MICROBIT_SERIAL_FRAME_ESC_ESC       0xDD
+
+// The number of CRC bytes that follow the payload of each frame.
+#define MICROBIT_SERIAL_FRAME_CRC_SIZE      2
+
+// Frame ready events are raised with the ID MICROBIT_ID_SERIAL_FRAME, and a value that identifies the frame buffer.
+#define MICROBIT_SERIAL_FRAME_EVT_READY(index)      ((index) + 1)
+#define MICROBIT_SERIAL_FRAME_INDEX(value)          ((value) - 1)
+
+/**
+  * A received frame, held in the pool of a MicroBitSerialFramer.
+  */
+struct SerialFrame
+{
+    uint16_t    length;     // The length of the payload, or 0 if this buffer is free.
+    uint8_t     data[MICROBIT_SERIAL_FRAME_MAX_SIZE + MICROBIT_SERIAL_FRAME_CRC_SIZE];  // The payload, followed by its CRC.
+};
+
+/**
+  * Class definition for MicroBitSerialFramer.
+  *
+  * Provides a packet based transport on top of a MicroBitSerial instance, so that binary
+  * data can be exchanged without relying upon delimeter characters in the data.
+  *
+  * Each frame is SLIP encoded, and carries a CRC-16 (CCITT) of its payload. Frames are sent
+  * by encoding them straight into the serial txBuff. Received frames are decoded straight from
+  * the serial rxBuff into a fixed pool of frame buffers, so no memory is allocated per frame.
+  *
+  * When a valid frame arrives, an event is raised with the ID MICROBIT_ID_SERIAL_FRAME and the value
+  * MICROBIT_SERIAL_FRAME_EVT_READY(index), where index identifies the frame buffer. The buffer
+  * must be returned to the pool with release() once it has been processed.
+  *
+  * @note The rxBuff of the MicroBitSerial instance must be large enough to hold a whole encoded frame.
+  *       This class uses the delimeter event of the MicroBitSerial instance, so eventOn() and
+  *       readUntil() should not also be used on the same instance.
+  */
+class MicroBitSerialFramer
+{
+    MicroBitSerial  &serial;                                    // The underlying serial port used to send and receive data.
+    ManagedString   delimeter;                                  // The frame delimeter, as expected by MicroBitSerial.
+    SerialFrame     frames[MICROBIT_SERIAL_FRAME_POOL_SIZE];    // The pool of received frames.
+    uint16_t        dropped;                                    // The number of frames discarded, as they were corrupt or the pool was full.
+
+    /**
+      * Decodes a frame from the rxBuff of our MicroBitSerial instance into a free frame buffer.
+      *
+      * @param span the encoded frame, without its delimeter.
+      */
+    void frameReceived(CircularSpan &span);
+
+    public:
+
+    /**
+      * Constructor.
+      *
+      * Creates an instance of a MicroBitSerialFramer, which offers the ability to exchange
+      * binary packets over the given serial port.
+      *
+      * @param s The underlying serial port used to send and receive data.
+      */
+    MicroBitSerialFramer(MicroBitSerial &s);
+
+    /**
+      * Transmits the given buffer as a single frame.
+      *
+      * @param buffer The frame payload to transmit.
+      *
+      * @param len The number of bytes to transmit.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+      *        gives a different behaviour:
+      *
+      *            ASYNC - The frame is queued only if all of it fits in the txBuff, and
+      *                    this method returns immediately.
+      *
+      *            SYNC_SPINWAIT - The frame is queued a txBuff at a time, spinning (locking
+      *                            up the processor) until each part is sent.
+      *
+      *            SYNC_SLEEP - The frame is queued a txBuff at a time, with the calling fiber
+      *                         sleeping until each part is sent.
+      *
+      *         Defaults to SYNC_SLEEP.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+      *         MICROBIT_NO_RESOURCES if the mode is ASYNC and the frame does not fit in the txBuff,
+      *         or MICROBIT_SERIAL_IN_USE if another fiber is using the serial port for transmission.
+      */
+    int send(uint8_t *buffer, int len, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
+    /**
+      * Transmits the given PacketBuffer as a single frame.
+      *
+      * @param data The frame payload to transmit.
+      *
+      * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP.
+      *
+      * @return MICROBIT_OK on success, or an error code as described for send(uint8_t *, int, MicroBitSerialMode).
+      */
+    int send(PacketBuffer data, MicroBitSerialMode mode = MICROBIT_DEFAULT_SERIAL_MODE);
+
+    /**
+      * Retrieves the payload of a received frame, without copying it.
+      *
+      * @param index The frame buffer, as given by the value of a frame ready event.
+      *
+      * @return A pointer to the payload, or NULL if the frame buffer does not hold a frame.
+      *
+      * @code
+      * void onFrame(MicroBitEvent e)
+      * {
+      *     int index = MICROBIT_SERIAL_FRAME_INDEX(e.value);
+      *
+      *     process(framer.getFrame(index), framer.getFrameLength(index));
+      *     framer.release(index);
+      * }
+      *
+      * uBit.messageBus.listen(MICROBIT_ID_SERIAL_FRAME, MICROBIT_EVT_ANY, onFrame);
+      * @endcode
+      */
+    uint8_t *getFrame(int index);
+
+    /**
+      * Determines the length of the payload of a received frame.
+      *
+      * @param index The frame buffer, as given by the value of a frame ready event.
+      *
+      * @return The length of the payload, or MICROBIT_INVALID_PARAMETER if the frame buffer does not hold a frame.
+      */
+    int getFrameLength(int index);
+
+    /**
+      * Returns a frame buffer to the pool, so that it can receive another frame.
+      *
+      * @param index The frame buffer, as given by the value of a frame ready event.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the index is invalid.
+      */
+    int release(int index);
+
+    /**
+      * Determines the number of received frames that have been discarded, either
+      * because they were corrupt or because there was no free frame buffer.
+      *
+      * @return the number of frames discarded.
+      */
+    int getDroppedCount();
+
+    /**
+      * Protocol handler callback. This is called when a frame delimeter is received
+      * by our MicroBitSerial instance.
+      *
+      * This function decodes every complete frame in the rxBuff.
+      */
+    void dataReceived(MicroBitEvent);
+};
+
+#endif
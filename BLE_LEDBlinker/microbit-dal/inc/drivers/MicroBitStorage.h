@@ -40,6 +40,16 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_STORAGE_STORE_PAGE_OFFSET      17      //Use the page just above the BLE Bond Data.
 #define MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET    19      //Use the page just below the BLE Bond Data.
 
+#define MICROBIT_STORAGE_LOG_MAGIC              0xCAFE1095
+#define MICROBIT_STORAGE_PAGE_COUNT             2
+
+#define MICROBIT_STORAGE_RECORD_ERASED          0xFFFF
+#define MICROBIT_STORAGE_RECORD_PAIR            0x5AA5
+#define MICROBIT_STORAGE_RECORD_DELETED         0x0AA0
+#define MICROBIT_STORAGE_RECORD_BATCH_PAIR      0x5A00
+#define MICROBIT_STORAGE_RECORD_BATCH_DELETED   0x0A00
+#define MICROBIT_STORAGE_RECORD_COMMIT          0x00A5
+
 struct KeyValuePair
 {
     uint8_t key[MICROBIT_STORAGE_KEY_SIZE];
@@ -64,6 +74,25 @@ struct KeyValueStore
     }
 };
 
+struct KeyValueLog
+{
+    uint32_t magic;
+    uint32_t sequence;
+};
+
+struct KeyValueRecord
+{
+    uint16_t type;
+    uint16_t crc;
+    KeyValuePair pair;
+} __attribute__ ((aligned (4)));
+
+struct KeyValueIndex
+{
+    uint16_t hash;                          // A hash of the record's key, checked before the key itself.
+    uint16_t offset;                        // The offset, in words, of the record in the active page, or 0 if the slot is empty.
+};
+
 
 /**
   * Class definition for the MicroBitStorage class.
@@ -72,16 +101,32 @@ struct KeyValueStore
   * This class operates as a key value store, it allows the retrieval, addition
   * and deletion of KeyValuePairs.
   *
-  * The first 8 bytes are reserved for the KeyValueStore struct which gives core
-  * information such as the number of KeyValuePairs in the store, and whether the
-  * store has been initialised.
+  * The store is an append only log, spread over the two pages either side of the
+  * BLE bond data. Only one page is active at a time. It begins with a KeyValueLog
+  * struct, whose sequence number identifies the most recent page, followed by
+  * KeyValueRecords. Each record carries its type and a CRC of its KeyValuePair,
+  * so that a record torn by a reset is ignored.
+  *
+  * Updating a key appends a new record, and removing a key appends a deleted record.
+  * Only when the active page is full are the live records compacted into the other page,
+  * which then becomes active. This spreads erases evenly over both pages, and costs
+  * one erase every few updates instead of two for every update.
   *
-  * After the KeyValueStore struct, KeyValuePairs are arranged contiguously until
-  * the end of the block used as persistent storage.
+  * |-------8-------|---------52--------|-----|---------52----------|-------|
+  * |  KeyValueLog  | KeyValueRecord[0] | ... | KeyValueRecord[N-1] | 0xFF..|
+  * |---------------|-------------------|-----|---------------------|-------|
   *
-  * |-------8-------|--------48-------|-----|---------48--------|
-  * | KeyValueStore | KeyValuePair[0] | ... | KeyValuePair[N-1] |
-  * |---------------|-----------------|-----|-------------------|
+  * An index of the live records in the active page is kept in RAM, as an open addressed hash table
+  * keyed by an FNV-1a hash of each key, so that a lookup typically reads a single record from flash.
+  *
+  * Updates made within a transaction are appended as batch records, followed by a commit
+  * record. A batch only takes effect once its commit record is found.
+  *
+  * A page written by the previous, single page store is converted on first use. Records are larger
+  * than the KeyValuePairs of that store, so a page holds fewer of them. If the old store holds more
+  * pairs than that, it is left in place and read directly until enough keys are removed (in a single
+  * transaction if need be) for the remainder to be converted. Until then, updates that would leave
+  * too many pairs fail with MICROBIT_NO_RESOURCES.
   */
 class MicroBitStorage
 {
@@ -96,23 +141,119 @@ class MicroBitStorage
       */
     void flashCopy(uint32_t* from, uint32_t* to, int sizeInWords);
 
+    uint32_t            sequence;           // The sequence number of the active page.
+    uint8_t             activePage;         // The page currently being appended to (0 or 1).
+    uint16_t            writeOffset;        // The offset, in words, of the next free record in the active page.
+    uint16_t            capacity;           // The number of records that fit in a page.
+    uint16_t            indexSize;          // The number of live records in the index.
+    uint16_t            indexSlots;         // The number of slots in the index. Always a power of two.
+    uint8_t             legacy;             // Nonzero if the index refers to the pairs of a page written by the previous store.
+    KeyValueIndex       *index;             // An open addressed table of the live records in the active page, keyed by the hash of their key.
+    uint16_t            transactionSize;    // The number of records held in the open transaction.
+    KeyValueRecord      *transaction;       // The records of the open transaction, or NULL if there is none.
+
     /**
-      * Function for populating the scratch page with a KeyValueStore.
+      * Determines the address of one of the pages used by the store.
       *
-      * @param store the KeyValueStore struct to write to the scratch page.
+      * @param page the page to locate (0 or 1).
+      *
+      * @return a pointer to the first word of the page.
       */
-    void scratchKeyValueStore(KeyValueStore store);
+    uint32_t* pageAddress(int page);
 
     /**
-      * Function for populating the scratch page with a KeyValuePair.
+      * Scans the pages used by the store, selects the active page and rebuilds the index
+      * of live records. A page written by the previous, single page store is converted if
+      * its pairs fit in a page of records, and indexed in place otherwise.
+      */
+    void init();
+
+    /**
+      * Locates the live record with the given key in the index.
       *
-      * @param pair the KeyValuePair struct to write to the scratch page.
+      * @param key the null terminated key to look for.
       *
-      * @param flashPointer the pointer in flash where this KeyValuePair resides. This pointer
-      * is used to determine the offset into the scratch page, where the KeyValuePair should
-      * be written.
+      * @return the slot of the record in the index, or -1 if the key is not stored.
       */
-    void scratchKeyValuePair(KeyValuePair pair, uint32_t* flashPointer);
+    int indexOf(const char* key);
+
+    /**
+      * Adds a record to the index. The caller must ensure its key is not already indexed.
+      *
+      * @param hash the hash of the record's key.
+      *
+      * @param offset the offset, in words, of the record in the active page.
+      */
+    void indexInsert(uint16_t hash, uint16_t offset);
+
+    /**
+      * Removes a record from the index, moving back any records that were displaced past it.
+      *
+      * @param slot the slot of the record in the index.
+      */
+    void indexRemove(int slot);
+
+    /**
+      * Updates the index with a record held in the active page.
+      *
+      * @param offset the offset, in words, of the record in the active page.
+      */
+    void applyRecord(uint16_t offset);
+
+    /**
+      * Updates the index with a committed batch of records held in the active page.
+      *
+      * @param start the offset, in words, of the first record in the batch.
+      *
+      * @param end the offset, in words, of the commit record that ends the batch.
+      */
+    void applyBatch(uint16_t start, uint16_t end);
+
+    /**
+      * Writes a record at the end of the active page.
+      * The caller must ensure there is space in the active page.
+      *
+      * @param record the record to write.
+      *
+      * @param type the type to record it with.
+      *
+      * @return the offset, in words, of the record in the active page.
+      */
+    uint16_t appendRecord(KeyValueRecord &record, uint16_t type);
+
+    /**
+      * Copies the live records into the inactive page, then makes that page active.
+      *
+      * @param records an optional list of records to apply during the copy, each replacing or removing
+      *        any live record with the same key. May be NULL.
+      *
+      * @param count the number of records in the list.
+      *
+      * @note the caller must ensure the resulting records fit in a page.
+      */
+    void compact(KeyValueRecord *records, int count);
+
+    /**
+      * Adds a list of records to the log as a single atomic update, compacting the store
+      * first if they don't fit in the active page.
+      *
+      * @param records the records to add. Each must have a different key.
+      *
+      * @param count the number of records in the list.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the store is full.
+      */
+    int writeRecords(KeyValueRecord *records, int count);
+
+    /**
+      * Adds a record to the open transaction, replacing any earlier record for the same key.
+      *
+      * @param record the record to add.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if a removed key is not stored,
+      *         or MICROBIT_NO_RESOURCES if the transaction is full.
+      */
+    int stageRecord(KeyValueRecord &record);
 
     public:
 
@@ -165,7 +306,7 @@ class MicroBitStorage
       * @param dataSize the size of the data to be persisted
       *
       * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-      *         MICROBIT_NO_RESOURCES if the storage page is full
+      *         MICROBIT_NO_RESOURCES if the store is full
       */
     int put(const char* key, uint8_t* data, int dataSize);
 
@@ -181,7 +322,7 @@ class MicroBitStorage
       * @param dataSize the size of the data to be persisted
       *
       * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-      *         MICROBIT_NO_RESOURCES if the storage page is full
+      *         MICROBIT_NO_RESOURCES if the store is full
       */
     int put(ManagedString key, uint8_t* data, int dataSize);
 
@@ -209,13 +350,36 @@ class MicroBitStorage
       */
     KeyValuePair* get(ManagedString key);
 
+    /**
+      * Locates a KeyValuePair identified by a given key, without copying it out of flash.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @return a pointer to the KeyValuePair in flash, or NULL if the key was not found in storage.
+      *
+      * @note the pointer is only valid until the next call to put() or remove().
+      */
+    const KeyValuePair* find(const char* key);
+
+    /**
+      * Locates a KeyValuePair identified by a given key, without copying it out of flash.
+      *
+      * @param key the unique name used to identify a KeyValuePair in flash.
+      *
+      * @return a pointer to the KeyValuePair in flash, or NULL if the key was not found in storage.
+      *
+      * @note the pointer is only valid until the next call to put() or remove().
+      */
+    const KeyValuePair* find(ManagedString key);
+
     /**
       * Removes a KeyValuePair identified by a given key.
       *
       * @param key the unique name used to identify a KeyValuePair in flash.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-      *         was not found in flash.
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key
+      *         was not found in flash, or MICROBIT_NO_RESOURCES if a page written by the
+      *         previous store would still hold more pairs than a page of records.
       */
     int remove(const char* key);
 
@@ -224,11 +388,48 @@ class MicroBitStorage
       *
       * @param key the unique name used to identify a KeyValuePair in flash.
       *
-      * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-      *         was not found in flash.
+      * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key
+      *         was not found in flash, or MICROBIT_NO_RESOURCES if a page written by the
+      *         previous store would still hold more pairs than a page of records.
       */
     int remove(ManagedString key);
 
+    /**
+      * Starts a transaction. Subsequent calls to put() and remove() are held in RAM
+      * until commitTransaction() writes them to flash together.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_BUSY if a transaction is already open.
+      *
+      * @code
+      * storage.beginTransaction();
+      * storage.put("x", (uint8_t *)&x, sizeof(int));
+      * storage.put("y", (uint8_t *)&y, sizeof(int));
+      * storage.commitTransaction();
+      * @endcode
+      *
+      * @note get() and find() continue to return the committed values while a transaction is open.
+      *
+      * @note a transaction can update at most MICROBIT_STORAGE_TRANSACTION_SIZE keys. Further calls to
+      *       put() or remove() for other keys fail with MICROBIT_NO_RESOURCES.
+      */
+    int beginTransaction();
+
+    /**
+      * Writes every put() and remove() made since beginTransaction() to flash as a single
+      * update. If the micro:bit is reset part way through, none of them take effect.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if no transaction is open,
+      *         or MICROBIT_NO_RESOURCES if the store would be full, in which case nothing is written.
+      */
+    int commitTransaction();
+
+    /**
+      * Discards every put() and remove() made since beginTransaction().
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no transaction is open.
+      */
+    int abortTransaction();
+
     /**
       * The size of the flash based KeyValueStore.
       *
@@ -0,0 +1,280 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_MATRIX_H
+#define MICROBIT_MATRIX_H
+
+#include "MicroBitConfig.h"
+#include "ErrorNo.h"
+
+/**
+  * Matrix kernels, operating on row major buffers of floats.
+  *
+  * These are shared by the Matrix and Matrix4 classes. None of them allocate memory or check bounds,
+  * so the caller is responsible for providing buffers of the right size. Unless stated otherwise,
+  * the result buffer must not overlap either of the inputs.
+  */
+
+/**
+  * Multiplies two matrices.
+  *
+  * @param a The left hand matrix, of rows x inner elements.
+  *
+  * @param b The right hand matrix, of inner x cols elements.
+  *
+  * @param result The buffer to write the rows x cols result to.
+  */
+void matrix_multiply(const float *a, const float *b, float *result, int rows, int inner, int cols);
+
+/**
+  * Multiplies the transpose of a matrix with another matrix, without building the transpose.
+  *
+  * @param a The left hand matrix, of inner x rows elements. Its transpose is used.
+  *
+  * @param b The right hand matrix, of inner x cols elements.
+  *
+  * @param result The buffer to write the rows x cols result to.
+  */
+void matrix_multiply_transpose(const float *a, const float *b, float *result, int rows, int inner, int cols);
+
+/**
+  * Transposes a matrix.
+  *
+  * @param a The matrix to transpose, of rows x cols elements.
+  *
+  * @param result The buffer to write the cols x rows result to.
+  */
+void matrix_transpose(const float *a, float *result, int rows, int cols);
+
+/**
+  * Inverts a 4x4 matrix, using the 2x2 sub-determinants of its upper and lower halves.
+  *
+  * @param a The matrix to invert, of 16 elements.
+  *
+  * @param result The buffer to write the 16 element inverse to. This may be the same buffer as a.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the matrix is singular.
+  */
+int matrix_invert4(const float *a, float *result);
+
+/**
+  * Class definition for a matrix whose size is fixed at compile time.
+  *
+  * The elements are held inline, so a Matrix can live on the stack or inside another object,
+  * and returning one from a function never allocates memory. Operations whose sizes do not
+  * match are rejected by the compiler rather than at run time.
+  *
+  * @code
+  * Matrix<10, 4> X;
+  * Matrix<4, 4> XtX = X.multiplyT(X);      // X transposed times X, without building X transposed.
+  * @endcode
+  */
+template <int R, int C>
+class Matrix
+{
+    public:
+
+    float   data[R * C];        // Row major buffer holding the elements of the matrix.
+
+    /**
+      * Constructor.
+      * Create a matrix with all of its elements set to zero.
+      */
+    Matrix()
+    {
+        clear();
+    }
+
+    /**
+      * Sets every element of this matrix to zero.
+      */
+    void clear()
+    {
+        for (int i = 0; i < R * C; i++)
+            data[i] = 0.0f;
+    }
+
+    /**
+      * Determines the number of columns in this matrix.
+      *
+      * @return The number of columns in the matrix.
+      */
+    int width() const
+    {
+        return C;
+    }
+
+    /**
+      * Determines the number of rows in this matrix.
+      *
+      * @return The number of rows in the matrix.
+      */
+    int height() const
+    {
+        return R;
+    }
+
+    /**
+      * Provides direct access to the element at the given position. No bounds checking is performed.
+      *
+      * @param row The row of the element.
+      *
+      * @param col The column of the element.
+      *
+      * @return A reference to the element.
+      *
+      * @code
+      * matrix.at(1,2) += 1.0f;
+      * @endcode
+      */
+    float& at(int row, int col)
+    {
+        return data[row * C + col];
+    }
+
+    /**
+      * Provides direct access to the element at the given position. No bounds checking is performed.
+      *
+      * @param row The row of the element.
+      *
+      * @param col The column of the element.
+      *
+      * @return The value of the element.
+      */
+    float at(int row, int col) const
+    {
+        return data[row * C + col];
+    }
+
+    /**
+      * Reads the matrix element at the given position.
+      *
+      * @param row The row of the element to read.
+      *
+      * @param col The column of the element to read.
+      *
+      * @return The value of the matrix element at the given position. 0 is returned if the given index is out of range.
+      */
+    float get(int row, int col) const
+    {
+        if (row < 0 || col < 0 || row >= R || col >= C)
+            return 0;
+
+        return data[row * C + col];
+    }
+
+    /**
+      * Writes the matrix element at the given position.
+      *
+      * @param row The row of the element to write.
+      *
+      * @param col The column of the element to write.
+      *
+      * @param v The new value of the element.
+      */
+    void set(int row, int col, float v)
+    {
+        if (row < 0 || col < 0 || row >= R || col >= C)
+            return;
+
+        data[row * C + col] = v;
+    }
+
+    /**
+      * Transposes this matrix.
+      *
+      * @return the resultant matrix.
+      */
+    Matrix<C, R> transpose() const
+    {
+        Matrix<C, R> result;
+        matrix_transpose(data, result.data, R, C);
+
+        return result;
+    }
+
+    /**
+      * Multiplies this matrix with the given matrix.
+      *
+      * @param matrix the matrix to multiply this matrix's values against.
+      *
+      * @return the resultant matrix.
+      *
+      * @code
+      * Matrix<4, 1> result = matrixA.multiply(matrixB);
+      * @endcode
+      */
+    template <int K>
+    Matrix<R, K> multiply(const Matrix<C, K> &matrix) const
+    {
+        Matrix<R, K> result;
+        matrix_multiply(data, matrix.data, result.data, R, C, K);
+
+        return result;
+    }
+
+    /**
+      * Multiplies the transpose of this matrix with the given matrix. The transpose is never built.
+      *
+      * @param matrix the matrix to multiply this matrix's transposed values against.
+      *
+      * @return the resultant matrix.
+      *
+      * @code
+      * Matrix<4, 1> result = matrixA.multiplyT(matrixB);
+      * @endcode
+      */
+    template <int K>
+    Matrix<C, K> multiplyT(const Matrix<R, K> &matrix) const
+    {
+        Matrix<C, K> result;
+        matrix_multiply_transpose(data, matrix.data, result.data, C, R, K);
+
+        return result;
+    }
+
+    /**
+      * Inverts this matrix. Only 4x4 matrices are supported by this operation.
+      *
+      * @param result The matrix to store the inverse in. This may be this matrix.
+      *
+      * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if this is not a 4x4 matrix,
+      *         or MICROBIT_INVALID_PARAMETER if the matrix is singular.
+      *
+      * @code
+      * Matrix<4, 4> inverse;
+      * matrixA.invert(inverse);
+      * @endcode
+      */
+    int invert(Matrix<R, C> &result) const
+    {
+        if (R != 4 || C != 4)
+            return MICROBIT_NOT_SUPPORTED;
+
+        return matrix_invert4(data, result.data);
+    }
+};
+
+#endif
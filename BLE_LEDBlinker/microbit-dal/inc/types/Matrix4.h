@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 #define MICROBIT_MATRIX4_H
 
 #include "MicroBitConfig.h"
+#include "Matrix.h"
 
 /**
 * Class definition for a simple matrix, that is optimised for nx4 or 4xn matrices.
@@ -34,6 +35,11 @@ DEALINGS IN THE SOFTWARE.
 * This class is heavily optimised for these commonly used matrices as used in 3D geometry.
 * Whilst this class does support basic operations on matrices of any dimension, it is not intended as a
 * general purpose matrix class as inversion operations are only provided for 4x4 matrices.
+*
+* Matrix4 is retained for compatibility, and chooses its size at run time, so its elements are held on the heap.
+* Where the size is known at compile time, the Matrix template avoids those allocations entirely.
+* Both classes share the same matrix kernels.
+*
 * For programmers needing more flexible Matrix support, the Matrix and MatrixMath classes from
 * Ernsesto Palacios provide a good basis:
 *
@@ -74,6 +80,16 @@ public:
 	  */
 	Matrix4(const Matrix4 &matrix);
 
+	/**
+	  * Copy assignment operator.
+	  * Makes this matrix an identical copy of the given matrix.
+	  *
+	  * @param matrix The matrix to copy.
+	  *
+	  * @return A reference to this matrix.
+	  */
+	Matrix4& operator = (const Matrix4 &matrix);
+
 	/**
 	  * Determines the number of columns in this matrix.
 	  *
@@ -154,7 +170,8 @@ public:
 
 	/**
 	  * Multiplies the transpose of this matrix with the given matrix (if possible).
-      *
+	  * The transpose is never built.
+	  *
 	  * @param matrix the matrix to multiply this matrix's values against.
 	  *
 	  * @return the resultant matrix. An empty matrix is returned if the operation canot be completed.
@@ -187,6 +204,7 @@ public:
 
 /**
   * Multiplies the transpose of this matrix with the given matrix (if possible).
+  * The transpose is never built.
   *
   * @return the resultant matrix. An empty matrix is returned if the operation canot be completed.
   *
@@ -47,6 +47,7 @@ struct ImageData : RefCounted
 class MicroBitImage
 {
     ImageData *ptr;     // Pointer to payload data
+    uint16_t generation; // Incremented whenever the bitmap may have been modified through this instance.
 
 
     /**
@@ -77,12 +78,58 @@ class MicroBitImage
 
     /**
       * Return a 2D array representing the bitmap image.
+      *
+      * @note as the caller may modify the bitmap, this increments the generation of this instance.
+      *       The display only looks for changes for a couple of frames afterwards, so fetch the
+      *       bitmap again rather than writing through a pointer kept across a fiber yield.
       */
     uint8_t *getBitmap()
+    {
+        modified();
+        return ptr->data;
+    }
+
+    /**
+      * Return a 2D array representing the bitmap image, for callers that only read it.
+      * Unlike getBitmap(), this leaves the generation unchanged.
+      */
+    const uint8_t *peekBitmap() const
     {
         return ptr->data;
     }
 
+    /**
+      * Records that the bitmap may have been modified through this instance.
+      */
+    void modified()
+    {
+        generation++;
+    }
+
+    /**
+      * Determines the generation of this instance, which changes whenever the bitmap may have been modified,
+      * or replaced, through it. Consumers such as MicroBitDisplay can cache data derived from the image until it changes.
+      *
+      * @return the generation of this instance.
+      *
+      * @note changes made through another MicroBitImage that shares the same bitmap are not counted. Use isShared() to
+      *       determine whether there may be any.
+      */
+    uint16_t getGeneration() const
+    {
+        return generation;
+    }
+
+    /**
+      * Determines whether any other MicroBitImage refers to the same bitmap as this one.
+      *
+      * @return true if the bitmap is shared, false if this is the only reference to it, or it is held in flash.
+      */
+    bool isShared() const
+    {
+        return ptr->refCount != 0xffff && (ptr->refCount >> 1) > 1;
+    }
+
     /**
       * Constructor.
       * Create an image from a specially prepared constant array, with no copying. Will call ptr->incr().
@@ -0,0 +1,272 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MICROBIT_PACKED_IMAGE_H
+#define MICROBIT_PACKED_IMAGE_H
+
+#include "mbed.h"
+#include "MicroBitConfig.h"
+#include "RefCounted.h"
+#include "MicroBitImage.h"
+
+struct PackedImageData : RefCounted
+{
+    uint16_t width;     // Width in pixels
+    uint16_t height;    // Height in pixels
+    uint32_t data[0];   // Rows of the image, one bit per pixel, each padded to a whole number of words
+};
+
+/**
+  * Class definition for a MicroBitPackedImage.
+  *
+  * A MicroBitPackedImage is a black and white bitmap, stored with one bit per pixel.
+  * It uses an eighth of the memory of a MicroBitImage, and operates on a word (32 pixels)
+  * at a time, so shifting, pasting and comparing images is correspondingly cheaper.
+  *
+  * Each row starts on a word boundary, with the leftmost pixel in the least significant bit.
+  * Any bits beyond the width of the image are always zero.
+  *
+  * Use MicroBitPackedImage(MicroBitImage) and toImage() to convert to and from a MicroBitImage,
+  * for example to show a MicroBitPackedImage on the display.
+  * n.b. This is a mutable, managed type.
+  */
+class MicroBitPackedImage
+{
+    PackedImageData *ptr;     // Pointer to payload data
+
+    /**
+      * Internal constructor which provides sanity checking and initialises class properties.
+      *
+      * @param x the width of the image
+      *
+      * @param y the height of the image
+      */
+    void init(const int16_t x, const int16_t y);
+
+    /**
+      * The number of words used to store each row of the image.
+      */
+    int getStride() const
+    {
+        return (ptr->width + 31) / 32;
+    }
+
+    public:
+
+    /**
+      * Default Constructor.
+      * Creates a new, empty image with no pixels.
+      */
+    MicroBitPackedImage();
+
+    /**
+      * Constructor.
+      * Create a blank bitmap representation of a given size.
+      *
+      * @param x the width of the image.
+      *
+      * @param y the height of the image.
+      */
+    MicroBitPackedImage(const int16_t x, const int16_t y);
+
+    /**
+      * Constructor.
+      * Create a packed copy of a MicroBitImage. Any pixel with a non-zero brightness is set.
+      *
+      * @param image The MicroBitImage to copy.
+      *
+      * @code
+      * MicroBitImage i("0,1,0,1,0\n1,0,1,0,1\n0,1,0,1,0\n1,0,1,0,1\n0,1,0,1,0\n"); // 5x5 image
+      * MicroBitPackedImage p(i);
+      * @endcode
+      */
+    explicit MicroBitPackedImage(MicroBitImage image);
+
+    /**
+      * Copy Constructor.
+      * Add ourselves as a reference to an existing MicroBitPackedImage.
+      *
+      * @param image The MicroBitPackedImage to reference.
+      */
+    MicroBitPackedImage(const MicroBitPackedImage &image);
+
+    /**
+      * Destructor.
+      *
+      * Removes buffer resources held by the instance.
+      */
+    ~MicroBitPackedImage();
+
+    /**
+      * Copy assign operation.
+      *
+      * Decrement our reference count and free up the buffer as necessary,
+      * then refer to the buffer of the supplied MicroBitPackedImage.
+      *
+      * @param i The MicroBitPackedImage to reference.
+      */
+    MicroBitPackedImage& operator = (const MicroBitPackedImage& i);
+
+    /**
+      * Equality operation.
+      *
+      * @param i The MicroBitPackedImage to test ourselves against.
+      *
+      * @return true if this MicroBitPackedImage is identical to the one supplied, false otherwise.
+      */
+    bool operator== (const MicroBitPackedImage& i);
+
+    /**
+      * Resets all pixels in this image to 0.
+      */
+    void clear();
+
+    /**
+      * Sets the pixel at the given co-ordinates.
+      *
+      * @param x The co-ordinate of the pixel to change.
+      *
+      * @param y The co-ordinate of the pixel to change.
+      *
+      * @param value Non-zero to set the pixel, or 0 to clear it.
+      *
+      * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+      */
+    int setPixelValue(int16_t x , int16_t y, uint8_t value);
+
+    /**
+      * Retrieves the value of a given pixel.
+      *
+      * @param x The x co-ordinate of the pixel to read. Must be within the dimensions of the image.
+      *
+      * @param y The y co-ordinate of the pixel to read. Must be within the dimensions of the image.
+      *
+      * @return 255 if the pixel is set, 0 if it is clear, or MICROBIT_INVALID_PARAMETER.
+      */
+    int getPixelValue(int16_t x , int16_t y);
+
+    /**
+      * Pastes a given bitmap at the given co-ordinates.
+      *
+      * Any pixels in the relevant area of this image are replaced.
+      *
+      * @param image The MicroBitPackedImage to paste.
+      *
+      * @param x The leftmost X co-ordinate in this image where the given image should be pasted. Defaults to 0.
+      *
+      * @param y The uppermost Y co-ordinate in this image where the given image should be pasted. Defaults to 0.
+      *
+      * @param alpha set to 1 if clear pixels in given image should be treated as transparent. Set to 0 otherwise. Defaults to 0.
+      *
+      * @return The number of pixels written.
+      */
+    int paste(const MicroBitPackedImage &image, int16_t x = 0, int16_t y = 0, uint8_t alpha = 0);
+
+    /**
+      * Shifts the pixels in this Image a given number of pixels to the left.
+      *
+      * @param n The number of pixels to shift.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+      */
+    int shiftLeft(int16_t n);
+
+    /**
+      * Shifts the pixels in this Image a given number of pixels to the right.
+      *
+      * @param n The number of pixels to shift.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+      */
+    int shiftRight(int16_t n);
+
+    /**
+      * Shifts the pixels in this Image a given number of pixels upward.
+      *
+      * @param n The number of pixels to shift.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+      */
+    int shiftUp(int16_t n);
+
+    /**
+      * Shifts the pixels in this Image a given number of pixels downward.
+      *
+      * @param n The number of pixels to shift.
+      *
+      * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+      */
+    int shiftDown(int16_t n);
+
+    /**
+      * Returns a new image, containing the given region of this image.
+      *
+      * @param startx the leftmost column of the region.
+      *
+      * @param starty the uppermost row of the region.
+      *
+      * @param cropWidth the width of the region.
+      *
+      * @param cropHeight the height of the region.
+      *
+      * @return a new MicroBitPackedImage, clipped to the bounds of this image.
+      */
+    MicroBitPackedImage crop(int startx, int starty, int cropWidth, int cropHeight);
+
+    /**
+      * Converts this image to a MicroBitImage, with set pixels at full brightness.
+      *
+      * @return a new MicroBitImage of the same size.
+      *
+      * @code
+      * MicroBitPackedImage p(5,5);
+      * p.setPixelValue(2,2,1);
+      * uBit.display.print(p.toImage());
+      * @endcode
+      */
+    MicroBitImage toImage();
+
+    /**
+      * Gets the width of this image.
+      *
+      * @return The width of this image.
+      */
+    int getWidth() const
+    {
+        return ptr->width;
+    }
+
+    /**
+      * Gets the height of this image.
+      *
+      * @return The height of this image.
+      */
+    int getHeight() const
+    {
+        return ptr->height;
+    }
+};
+
+#endif
@@ -79,7 +79,7 @@ static void storeSystemAttributes(Gap::Handle_t handle)
     {
         ManagedString key("bleSysAttrs");
 
-        KeyValuePair* bleSysAttrs = manager->storage->get(key);
+        const KeyValuePair* bleSysAttrs = manager->storage->find(key);
 
         BLESysAttribute attrib;
         BLESysAttributeStore attribStore;
@@ -90,10 +90,7 @@ static void storeSystemAttributes(Gap::Handle_t handle)
 
         //copy our stored sysAttrs
         if(bleSysAttrs != NULL)
-        {
             memcpy(&attribStore, bleSysAttrs->value, sizeof(BLESysAttributeStore));
-            delete bleSysAttrs;
-        }
 
         //check if we need to update
         if(memcmp(attribStore.sys_attrs[deviceID].sys_attr, attrib.sys_attr, len) != 0)
@@ -144,7 +141,7 @@ static void bleSysAttrMissingCallback(const GattSysAttrMissingCallbackParams *pa
     {
         ManagedString key("bleSysAttrs");
 
-        KeyValuePair* bleSysAttrs = manager->storage->get(key);
+        const KeyValuePair* bleSysAttrs = manager->storage->find(key);
 
         BLESysAttributeStore attribStore;
         BLESysAttribute attrib;
@@ -153,7 +150,6 @@ static void bleSysAttrMissingCallback(const GattSysAttrMissingCallbackParams *pa
         {
             //restore our sysAttrStore
             memcpy(&attribStore, bleSysAttrs->value, sizeof(BLESysAttributeStore));
-            delete bleSysAttrs;
 
             attrib = attribStore.sys_attrs[deviceID];
 
@@ -72,8 +72,13 @@ MicroBitUARTService::MicroBitUARTService(BLEDevice &_ble, uint8_t rxBufferSize,
 
     rxBufferHead = 0;
     rxBufferTail = 0;
+    rxScanPosition = 0;
+    rxBuffHeadMatch = -1;
     this->rxBufferSize = rxBufferSize;
 
+    delimeters.clear();
+    rxScanDelimeters.clear();
+
     txBufferHead = 0;
     txBufferTail = 0;
     this->txBufferSize = txBufferSize;
@@ -102,6 +107,10 @@ void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
     {
         uint16_t bytesWritten = params->len;
 
+        bool delimeterMatch = false;
+        bool headMatch = false;
+        bool full = false;
+
         for(int byteIterator = 0; byteIterator <  bytesWritten; byteIterator++)
         {
             int newHead = (rxBufferHead + 1) % rxBufferSize;
@@ -110,18 +119,8 @@ void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
             {
                 char c = params->data[byteIterator];
 
-                int delimeterOffset = 0;
-                int delimLength = this->delimeters.length();
-
-                //iterate through our delimeters (if any) to see if there is a match
-                while(delimeterOffset < delimLength)
-                {
-                    //fire an event if there is to block any waiting fibers
-                    if(this->delimeters.charAt(delimeterOffset) == c)
-                        MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_DELIM_MATCH);
-
-                    delimeterOffset++;
-                }
+                if(this->delimeters.contains(c))
+                    delimeterMatch = true;
 
                 rxBuffer[rxBufferHead] = c;
 
@@ -130,12 +129,22 @@ void MicroBitUARTService::onDataWritten(const GattWriteCallbackParams *params) {
                 if(rxBufferHead == rxBuffHeadMatch)
                 {
                     rxBuffHeadMatch = -1;
-                    MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_HEAD_MATCH);
+                    headMatch = true;
                 }
             }
             else
-                MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_RX_FULL);
+                full = true;
         }
+
+        //fire at most one of each event for the whole write, to unblock any waiting fibers
+        if(delimeterMatch)
+            MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_DELIM_MATCH);
+
+        if(headMatch)
+            MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_HEAD_MATCH);
+
+        if(full)
+            MicroBitEvent(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_RX_FULL);
     }
 }
 
@@ -198,6 +207,7 @@ int MicroBitUARTService::getc(MicroBitSerialMode mode)
     char c = rxBuffer[rxBufferTail];
 
     rxBufferTail = (rxBufferTail + 1) % rxBufferSize;
+    rxScanPosition = rxBufferTail;
 
     return c;
 }
@@ -430,56 +440,114 @@ ManagedString MicroBitUARTService::read(int len, MicroBitSerialMode mode)
   */
 ManagedString MicroBitUARTService::readUntil(ManagedString delimeters, MicroBitSerialMode mode)
 {
-    if(mode == SYNC_SPINWAIT)
-        return MICROBIT_INVALID_PARAMETER;
+    CircularSpan span;
+
+    int len = peekUntil(delimeters, span, mode);
 
-    int localTail = rxBufferTail;
-    int preservedTail = rxBufferTail;
+    if(len < 0)
+        return ManagedString();
+
+    ManagedString s = span.toString();
+
+    //plus one for the character we listened for...
+    consume(len + 1);
 
-    int foundIndex = -1;
+    return s;
+}
+
+/**
+  * An internal method that continues the scan of the rxBuffer for a delimeter, from
+  * where the last scan stopped.
+  *
+  * @return the position of the first delimeter after the rxBufferTail, or -1 if
+  *         there is no delimeter in the rxBuffer.
+  */
+int MicroBitUARTService::scanUntil()
+{
+    //take a copy of the head, as it is updated by our BLE callback.
+    uint8_t head = rxBufferHead;
 
-    //ASYNC mode just iterates through our stored characters checking for any matches.
-    while(localTail != rxBufferHead && foundIndex  == -1)
+    //every character before rxScanPosition has already been checked.
+    while(rxScanPosition != head)
     {
-        //we use localTail to prevent modification of the actual tail.
-        char c = rxBuffer[localTail];
+        if(rxScanDelimeters.contains(rxBuffer[rxScanPosition]))
+            return rxScanPosition;
 
-        for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
-            if(delimeters.charAt(delimeterIterator) == c)
-                foundIndex = localTail;
+        rxScanPosition = (rxScanPosition + 1) % rxBufferSize;
+    }
+
+    return -1;
+}
 
-        localTail = (localTail + 1) % rxBufferSize;
+/**
+  * Finds the characters up to one of the given delimeters, without copying them
+  * or removing them from the rxBuffer.
+  *
+  * Scanning resumes from where the previous call stopped, so polling for a line
+  * only ever examines each received character once.
+  *
+  * @param delimeters the characters to match against
+  * @param span set to describe the characters before the delimeter, which stay valid
+  *        until they are removed with consume().
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP, which
+  *        behave as described for readUntil().
+  *
+  * @return the number of characters before the delimeter, MICROBIT_NO_DATA if no
+  *         delimeter was found, or MICROBIT_INVALID_PARAMETER if the mode is SYNC_SPINWAIT.
+  */
+int MicroBitUARTService::peekUntil(ManagedString delimeters, CircularSpan &span, MicroBitSerialMode mode)
+{
+    if(mode == SYNC_SPINWAIT)
+        return MICROBIT_INVALID_PARAMETER;
+
+    DelimeterMap map;
+    map.set(delimeters);
+
+    //if we're looking for something different this time, our previous scan is of no use.
+    if(memcmp(&map, &rxScanDelimeters, sizeof(DelimeterMap)) != 0)
+    {
+        rxScanDelimeters = map;
+        rxScanPosition = rxBufferTail;
     }
 
-    //if our mode is SYNC_SLEEP, we set up an event to be fired when we see a
-    //matching character.
+    int foundIndex = scanUntil();
+
+    //if our mode is SYNC_SLEEP, we sleep until a matching character is received.
     if(mode == SYNC_SLEEP && foundIndex == -1)
     {
-        eventOn(delimeters, mode);
+        this->delimeters = map;
 
-        foundIndex = rxBufferHead - 1;
+        while((foundIndex = scanUntil()) == -1)
+            fiber_wait_for_event(MICROBIT_ID_BLE_UART, MICROBIT_UART_S_EVT_DELIM_MATCH);
 
-        this->delimeters = ManagedString();
+        this->delimeters.clear();
     }
 
-    if(foundIndex >= 0)
-    {
-        //calculate our local buffer size
-        int localBuffSize = (preservedTail > foundIndex) ? (rxBufferSize - preservedTail) + foundIndex : foundIndex - preservedTail;
-
-        uint8_t localBuff[localBuffSize + 1];
+    if(foundIndex < 0)
+        return MICROBIT_NO_DATA;
 
-        memclr(&localBuff, localBuffSize + 1);
+    span.set(rxBuffer, rxBufferSize, rxBufferTail, foundIndex);
 
-        circularCopy(rxBuffer, rxBufferSize, localBuff, preservedTail, foundIndex);
+    return span.length();
+}
 
-        //plus one for the character we listened for...
-        rxBufferTail = (rxBufferTail + localBuffSize + 1) % rxBufferSize;
+/**
+  * Removes characters from the rxBuffer, without copying them.
+  *
+  * @param len the number of characters to remove.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if fewer than len
+  *         characters are buffered.
+  */
+int MicroBitUARTService::consume(int len)
+{
+    if(len < 0 || len > rxBufferedSize())
+        return MICROBIT_INVALID_PARAMETER;
 
-        return ManagedString((char *)localBuff, localBuffSize);
-    }
+    rxBufferTail = (rxBufferTail + len) % rxBufferSize;
+    rxScanPosition = rxBufferTail;
 
-    return ManagedString();
+    return MICROBIT_OK;
 }
 
 /**
@@ -506,7 +574,7 @@ int MicroBitUARTService::eventOn(ManagedString delimeters, MicroBitSerialMode mo
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->delimeters = delimeters;
+    this->delimeters.set(delimeters);
 
     //block!
     if(mode == SYNC_SLEEP)
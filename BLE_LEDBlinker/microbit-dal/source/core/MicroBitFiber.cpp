@@ -47,8 +47,11 @@ static Fiber *idleFiber = NULL;                    // the idle task - performs a
  * Scheduler state.
  */
 static Fiber *runQueue = NULL;                     // The list of runnable fibers.
-static Fiber *sleepQueue = NULL;                   // The list of blocked fibers waiting on a fiber_sleep() operation.
-static Fiber *waitQueue = NULL;                    // The list of blocked fibers waiting on an event.
+static Fiber *sleepQueue = NULL;                   // The list of blocked fibers waiting on a fiber_sleep() operation, ordered by wake up time.
+static Fiber *waitQueue[MICROBIT_FIBER_WAIT_QUEUE_BUCKETS];    // Lists of blocked fibers waiting on an event, hashed by event ID.
+static Fiber *waitAnyQueue = NULL;                 // The list of blocked fibers waiting on an event from MICROBIT_ID_ANY.
+static uint16_t waitListeners[MICROBIT_FIBER_WAIT_LISTENERS];  // The event IDs we have registered scheduler_event() as a listener for.
+static uint8_t waitListenerCount = 0;              // The number of entries in waitListeners.
 static Fiber *fiberPool = NULL;                    // Pool of unused fibers, just waiting for a job to do.
 
 /*
@@ -56,6 +59,13 @@ static Fiber *fiberPool = NULL;                    // Pool of unused fibers, jus
  */
 static uint8_t fiber_flags = 0;
 
+/*
+ * Scheduler statistics.
+ */
+static uint16_t fiber_count = 0;                   // The number of fiber contexts allocated.
+static uint16_t fiber_pool_count = 0;              // The number of fiber contexts on the fiber pool.
+static uint32_t fiber_deepest_stack = 0;           // The deepest stack recorded by verify_stack_size().
+
 
 /*
  * Fibers may perform wait/notify semantics on events. If set, these operations will be permitted on this EventModel.
@@ -65,6 +75,11 @@ static EventModel *messageBus = NULL;
 // Array of components which are iterated during idle thread execution.
 static MicroBitComponent* idleThreadComponents[MICROBIT_IDLE_COMPONENTS];
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_TICKLESS)
+// One shot timer, programmed to fire when the fiber at the head of the sleep queue is due to wake up.
+static Timeout *sleepTimer = NULL;
+#endif
+
 /**
   * Utility function to add the currenty running fiber to the given queue.
   *
@@ -109,6 +124,66 @@ void queue_fiber(Fiber *f, Fiber **queue)
     __enable_irq();
 }
 
+/**
+  * Utility function to add the given fiber to the sleep queue.
+  *
+  * The sleep queue is kept sorted by wake up time (held in the context field of each fiber), such that
+  * the system tick need only inspect the head of the queue. Fibers with equal wake up times are
+  * kept in the order they went to sleep.
+  *
+  * @param f The fiber to add to the sleep queue.
+  */
+static void queue_sleeping_fiber(Fiber *f)
+{
+    __disable_irq();
+
+    Fiber *last = NULL;
+    Fiber *next = sleepQueue;
+
+    // Find the first fiber due to wake up after this one.
+    while (next != NULL && next->context <= f->context)
+    {
+        last = next;
+        next = next->next;
+    }
+
+    f->queue = &sleepQueue;
+    f->prev = last;
+    f->next = next;
+
+    if (last == NULL)
+        sleepQueue = f;
+    else
+        last->next = f;
+
+    if (next != NULL)
+        next->prev = f;
+
+    __enable_irq();
+}
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_TICKLESS)
+/**
+  * Programs the sleep timer to fire when the fiber at the head of the sleep queue is due to wake up,
+  * or disables it if there are no sleeping fibers.
+  */
+static void update_sleep_timer()
+{
+    if (sleepTimer == NULL)
+        return;
+
+    sleepTimer->detach();
+
+    if (sleepQueue == NULL)
+        return;
+
+    uint64_t now = system_timer_current_time();
+    uint32_t delay = sleepQueue->context > now ? sleepQueue->context - now : 0;
+
+    sleepTimer->attach_us(scheduler_tick, delay * 1000);
+}
+#endif
+
 /**
   * Utility function to the given fiber from whichever queue it is currently stored on.
   *
@@ -139,6 +214,84 @@ void dequeue_fiber(Fiber *f)
 
 }
 
+/**
+  * Determines the wait queue that holds fibers blocked on events with the given ID.
+  *
+  * @param id The ID of the event.
+  *
+  * @return The wait queue for the given ID.
+  */
+static Fiber **getWaitQueue(uint16_t id)
+{
+    if (id == MICROBIT_ID_ANY)
+        return &waitAnyQueue;
+
+    return &waitQueue[id % MICROBIT_FIBER_WAIT_QUEUE_BUCKETS];
+}
+
+/**
+  * Wakes any fibers on the given wait queue that are blocked on the given event.
+  *
+  * @param queue The wait queue to inspect.
+  *
+  * @param evt The event that has been raised.
+  */
+static void wakeWaitingFibers(Fiber *queue, MicroBitEvent &evt)
+{
+    Fiber *f = queue;
+    Fiber *t;
+
+    while (f != NULL)
+    {
+        t = f->next;
+
+        // extract the event data this fiber is blocked on.
+        uint16_t id = f->context & 0xFFFF;
+        uint16_t value = (f->context & 0xFFFF0000) >> 16;
+
+        if ((id == MICROBIT_ID_ANY || id == evt.source) && (value == MICROBIT_EVT_ANY || value == evt.value))
+        {
+            // Wakey wakey!
+            dequeue_fiber(f);
+            queue_fiber(f,&runQueue);
+        }
+
+        f = t;
+    }
+}
+
+/**
+  * Allocates a new fiber context from the heap.
+  *
+  * @param stackSize The size of stack buffer to allocate for the fiber, in bytes. If zero, the
+  *                  stack buffer is allocated on demand by verify_stack_size().
+  *
+  * @return The new Fiber, or NULL if the operation could not be completed.
+  */
+static Fiber *allocateFiberContext(uint32_t stackSize)
+{
+    Fiber *f = new Fiber();
+
+    if (f == NULL)
+        return NULL;
+
+    f->stack_bottom = 0;
+    f->stack_top = 0;
+    f->stack_high_water = 0;
+
+    if (stackSize > 0)
+    {
+        f->stack_bottom = (uint32_t) malloc(stackSize);
+
+        if (f->stack_bottom != 0)
+            f->stack_top = f->stack_bottom + stackSize;
+    }
+
+    fiber_count++;
+
+    return f;
+}
+
 /**
   * Allocates a fiber from the fiber pool if availiable. Otherwise, allocates a new one from the heap.
   */
@@ -151,6 +304,7 @@ Fiber *getFiberContext()
     if (fiberPool != NULL)
     {
         f = fiberPool;
+        fiber_pool_count--;
         dequeue_fiber(f);
         // dequeue_fiber() exits with irqs enabled, so no need to do this again!
     }
@@ -158,13 +312,10 @@ Fiber *getFiberContext()
     {
         __enable_irq();
 
-        f = new Fiber();
+        f = allocateFiberContext(0);
 
         if (f == NULL)
             return NULL;
-
-        f->stack_bottom = 0;
-        f->stack_top = 0;
     }
 
     // Ensure this fiber is in suitable state for reuse.
@@ -199,6 +350,20 @@ void scheduler_init(EventModel &_messageBus)
     // Add ourselves to the run queue.
     queue_fiber(currentFiber, &runQueue);
 
+#if MICROBIT_FIBER_POOL_SIZE > 0
+    // Populate the fiber pool, so that fibers and their stacks need not be allocated at runtime.
+    for (int i = 0; i < MICROBIT_FIBER_POOL_SIZE; i++)
+    {
+        Fiber *f = allocateFiberContext(MICROBIT_FIBER_STACK_SIZE);
+
+        if (f == NULL)
+            break;
+
+        queue_fiber(f, &fiberPool);
+        fiber_pool_count++;
+    }
+#endif
+
     // Create the IDLE fiber.
     // Configure the fiber to directly enter the idle task.
     idleFiber = getFiberContext();
@@ -212,8 +377,13 @@ void scheduler_init(EventModel &_messageBus)
 		messageBus->listen(MICROBIT_ID_NOTIFY_ONE, MICROBIT_EVT_ANY, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
 	}
 
+#if CONFIG_ENABLED(MICROBIT_FIBER_TICKLESS)
+    // Sleeping fibers are woken by a one shot timer, programmed on demand.
+    sleepTimer = new Timeout();
+#else
 	// register a period callback to drive the scheduler and any other registered components.
     new MicroBitSystemTimerCallback(scheduler_tick);
+#endif
 
 	fiber_flags |= MICROBIT_SCHEDULER_RUNNING;
 }
@@ -235,26 +405,26 @@ int fiber_scheduler_running()
   * The timer callback, called from interrupt context once every SYSTEM_TICK_PERIOD_MS milliseconds.
   * This function checks to determine if any fibers blocked on the sleep queue need to be woken up
   * and made runnable.
+  *
+  * As the sleep queue is ordered by wake up time, only those fibers that are due are inspected.
   */
 void scheduler_tick()
 {
-    Fiber *f = sleepQueue;
-    Fiber *t;
+    uint64_t now = system_timer_current_time();
 
-    // Check the sleep queue, and wake up any fibers as necessary.
-    while (f != NULL)
+    // Wake up any fibers at the head of the sleep queue whose time has come.
+    while (sleepQueue != NULL && now >= sleepQueue->context)
     {
-        t = f->next;
-
-        if (system_timer_current_time() >= f->context)
-        {
-            // Wakey wakey!
-            dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
-        }
+        Fiber *f = sleepQueue;
 
-        f = t;
+        // Wakey wakey!
+        dequeue_fiber(f);
+        queue_fiber(f,&runQueue);
     }
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_TICKLESS)
+    update_sleep_timer();
+#endif
 }
 
 /**
@@ -267,51 +437,78 @@ void scheduler_tick()
   */
 void scheduler_event(MicroBitEvent evt)
 {
-    Fiber *f = waitQueue;
-    Fiber *t;
-    int notifyOneComplete = 0;
-
-	// This should never happen.
-	// It is however, safe to simply ignore any events provided, as if no messageBus if recorded,
+	// It is safe to simply ignore any events provided, as if no messageBus if recorded,
 	// no fibers are permitted to block on events.
 	if (messageBus == NULL)
 		return;
 
-    // Check the wait queue, and wake up any fibers as necessary.
-    while (f != NULL)
+    // Special case for the NOTIFY_ONE channel, which wakes only the first fiber waiting on the matching NOTIFY event.
+    if (evt.source == MICROBIT_ID_NOTIFY_ONE)
     {
-        t = f->next;
-
-        // extract the event data this fiber is blocked on.
-        uint16_t id = f->context & 0xFFFF;
-        uint16_t value = (f->context & 0xFFFF0000) >> 16;
+        Fiber *f = *getWaitQueue(MICROBIT_ID_NOTIFY);
 
-        // Special case for the NOTIFY_ONE channel...
-        if ((evt.source == MICROBIT_ID_NOTIFY_ONE && id == MICROBIT_ID_NOTIFY) && (value == MICROBIT_EVT_ANY || value == evt.value))
+        while (f != NULL)
         {
-            if (!notifyOneComplete)
+            uint16_t id = f->context & 0xFFFF;
+            uint16_t value = (f->context & 0xFFFF0000) >> 16;
+
+            if (id == MICROBIT_ID_NOTIFY && (value == MICROBIT_EVT_ANY || value == evt.value))
             {
                 // Wakey wakey!
                 dequeue_fiber(f);
                 queue_fiber(f,&runQueue);
-                notifyOneComplete = 1;
+                break;
             }
-        }
 
-        // Normal case.
-        else if ((id == MICROBIT_ID_ANY || id == evt.source) && (value == MICROBIT_EVT_ANY || value == evt.value))
-        {
-            // Wakey wakey!
-            dequeue_fiber(f);
-            queue_fiber(f,&runQueue);
+            f = f->next;
         }
+    }
 
-        f = t;
+    // Normal case. Only those fibers waiting on this event's ID need be considered.
+    // Fibers waiting on any ID are handled by scheduler_event_any(), which has its own listener.
+    wakeWaitingFibers(*getWaitQueue(evt.source), evt);
+}
+
+/**
+  * Event callback for fibers blocked on events from MICROBIT_ID_ANY.
+  *
+  * This is registered separately from scheduler_event(), so that each event is only
+  * passed to scheduler_event() once, by the listener for its own ID.
+  *
+  * @param evt the event that has just been raised on an instance of MicroBitMessageBus.
+  */
+static void scheduler_event_any(MicroBitEvent evt)
+{
+    if (waitAnyQueue == NULL)
+        return;
+
+    wakeWaitingFibers(waitAnyQueue, evt);
+
+    // Once the last fiber waiting on any event has been woken, stop being called for every event raised.
+    if (waitAnyQueue == NULL)
+    {
+        fiber_flags &= ~MICROBIT_SCHEDULER_LISTENING_ANY;
+        messageBus->ignore(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, scheduler_event_any);
     }
+}
+
+/**
+  * Ensures scheduler_event() is registered as a listener for the given event ID.
+  *
+  * The IDs registered are remembered, so that the message bus is only consulted on the first wait for each.
+  *
+  * @param id The ID of the event. Must not be MICROBIT_ID_ANY.
+  */
+static void listen_for_wait(uint16_t id)
+{
+    for (int i = 0; i < waitListenerCount; i++)
+        if (waitListeners[i] == id)
+            return;
+
+    messageBus->listen(id, MICROBIT_EVT_ANY, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
 
-    // Unregister this event, as we've woken up all the fibers with this match.
-    if (evt.source != MICROBIT_ID_NOTIFY && evt.source != MICROBIT_ID_NOTIFY_ONE)
-        messageBus->ignore(evt.source, evt.value, scheduler_event);
+    if (waitListenerCount < MICROBIT_FIBER_WAIT_LISTENERS)
+        waitListeners[waitListenerCount++] = id;
 }
 
 
@@ -357,7 +554,13 @@ void fiber_sleep(unsigned long t)
     dequeue_fiber(f);
 
     // Add fiber to the sleep queue. We maintain strict ordering here to reduce lookup times.
-    queue_fiber(f, &sleepQueue);
+    queue_sleeping_fiber(f);
+
+#if CONFIG_ENABLED(MICROBIT_FIBER_TICKLESS)
+    // If we're now the first fiber due to wake up, bring the sleep timer forward.
+    if (sleepQueue == f)
+        update_sleep_timer();
+#endif
 
     // Finally, enter the scheduler.
     schedule();
@@ -436,19 +639,30 @@ int fiber_wake_on_event(uint16_t id, uint16_t value)
         }
     }
 
+    // Fibers waiting on any ID share a single listener, which is dropped by scheduler_event_any() once no fibers
+    // are waiting on it. It is registered before we join the wait queue, so that we are not woken by the
+    // MICROBIT_ID_MESSAGE_BUS_LISTENER event that announces it.
+    if (id == MICROBIT_ID_ANY && !(fiber_flags & MICROBIT_SCHEDULER_LISTENING_ANY))
+    {
+        fiber_flags |= MICROBIT_SCHEDULER_LISTENING_ANY;
+        messageBus->listen(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, scheduler_event_any, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    }
+
     // Encode the event data in the context field. It's handy having a 32 bit core. :-)
     f->context = value << 16 | id;
 
     // Remove ourselves from the run queue
     dequeue_fiber(f);
 
-    // Add ourselves to the sleep queue. We maintain strict ordering here to reduce lookup times.
-    queue_fiber(f, &waitQueue);
+    // Add ourselves to the wait queue for this event ID.
+    queue_fiber(f, getWaitQueue(id));
 
-    // Register to receive this event, so we can wake up the fiber when it happens.
-    // Special case for the notify channel, as we always stay registered for that.
-    if (id != MICROBIT_ID_NOTIFY && id != MICROBIT_ID_NOTIFY_ONE)
-        messageBus->listen(id, value, scheduler_event, MESSAGE_BUS_LISTENER_IMMEDIATE);
+    // Register to receive events with this ID, so we can wake up the fiber when it happens.
+    // The listener is kept once registered, so only the first wait on each ID adds one. This is also what
+    // announces the wait to the rest of the system, through a MICROBIT_ID_MESSAGE_BUS_LISTENER event.
+    // The notify channel is special cased, as we always stay registered for that.
+    if (id != MICROBIT_ID_ANY && id != MICROBIT_ID_NOTIFY && id != MICROBIT_ID_NOTIFY_ONE)
+        listen_for_wait(id);
 
     return MICROBIT_OK;
 }
@@ -712,6 +926,7 @@ void release_fiber(void)
 
     // Add ourselves to the list of free fibers
     queue_fiber(currentFiber, &fiberPool);
+    fiber_pool_count++;
 
     // Find something else to do!
     schedule();
@@ -736,6 +951,15 @@ void verify_stack_size(Fiber *f)
     // Calculate the stack depth.
     stackDepth = f->tcb.stack_base - ((uint32_t) __get_MSP());
 
+    // Record the high water mark of this fiber, and of the scheduler as a whole.
+    if (stackDepth > f->stack_high_water)
+    {
+        f->stack_high_water = stackDepth;
+
+        if (stackDepth > fiber_deepest_stack)
+            fiber_deepest_stack = stackDepth;
+    }
+
     // Calculate the size of our allocated stack buffer
     bufferSize = f->stack_top - f->stack_bottom;
 
@@ -757,6 +981,28 @@ void verify_stack_size(Fiber *f)
     }
 }
 
+/**
+  * Provides usage statistics for the fiber scheduler.
+  *
+  * This can be used to determine appropriate values for MICROBIT_FIBER_POOL_SIZE and MICROBIT_FIBER_STACK_SIZE.
+  *
+  * @param stats The MicroBitFiberStatistics to populate.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int fiber_statistics(MicroBitFiberStatistics &stats)
+{
+    __disable_irq();
+
+    stats.fibers = fiber_count;
+    stats.pooled = fiber_pool_count;
+    stats.deepestStack = fiber_deepest_stack;
+
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
 /**
   * Determines if any fibers are waiting to be scheduled.
   *
@@ -881,7 +1127,7 @@ int fiber_add_idle_component(MicroBitComponent *component)
 {
     int i = 0;
 
-    while(idleThreadComponents[i] != NULL && i < MICROBIT_IDLE_COMPONENTS)
+    while(i < MICROBIT_IDLE_COMPONENTS && idleThreadComponents[i] != NULL)
         i++;
 
     if(i == MICROBIT_IDLE_COMPONENTS)
@@ -902,7 +1148,7 @@ int fiber_remove_idle_component(MicroBitComponent *component)
 {
     int i = 0;
 
-    while(idleThreadComponents[i] != component && i < MICROBIT_IDLE_COMPONENTS)
+    while(i < MICROBIT_IDLE_COMPONENTS && idleThreadComponents[i] != component)
         i++;
 
     if(i == MICROBIT_IDLE_COMPONENTS)
@@ -0,0 +1,219 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Fixed point trigonometry, for use where floating point would be too costly.
+  *
+  * The nrf51822 has no FPU, so each call to sin(), cos() or atan2() costs thousands of cycles in
+  * software floating point. These functions use only integer arithmetic instead.
+  *
+  * Angles are represented as binary angles, in units of PI/32768: a half turn is 32768, and a full turn is 65536.
+  * Sines and cosines are returned in Q15 format, where 32767 represents 1.0.
+  */
+#include "MicroBitConfig.h"
+#include "MicroBitFixedMath.h"
+
+// sin(x) in Q15, for x from 0 to PI/2 in 128 equal steps.
+static const int16_t sine_table[129] = {
+        0,   402,   804,  1206,  1608,  2009,  2410,  2811,  3212,  3612,  4011,  4410,
+     4808,  5205,  5602,  5998,  6393,  6786,  7179,  7571,  7962,  8351,  8739,  9126,
+     9512,  9896, 10278, 10659, 11039, 11417, 11793, 12167, 12539, 12910, 13279, 13645,
+    14010, 14372, 14732, 15090, 15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869,
+    18204, 18537, 18868, 19195, 19519, 19841, 20159, 20475, 20787, 21096, 21403, 21705,
+    22005, 22301, 22594, 22884, 23170, 23452, 23731, 24007, 24279, 24547, 24811, 25072,
+    25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019, 27245, 27466, 27683, 27896,
+    28105, 28310, 28510, 28706, 28898, 29085, 29268, 29447, 29621, 29791, 29956, 30117,
+    30273, 30424, 30571, 30714, 30852, 30985, 31113, 31237, 31356, 31470, 31580, 31685,
+    31785, 31880, 31971, 32057, 32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567,
+    32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765, 32767
+};
+
+// atan(2^-i), in units of PI/2^30. The extra precision keeps rounding errors out of the final result.
+#define CORDIC_ITERATIONS   20
+
+static const int32_t cordic_table[CORDIC_ITERATIONS] = {
+    268435456, 158466703, 83729454, 42502378, 21333666, 10677233, 5339919, 2670123, 1335082, 667543,
+    333772, 166886, 83443, 41722, 20861, 10430, 5215, 2608, 1304, 652
+};
+
+// The reciprocal of the CORDIC gain, in Q15 format.
+#define CORDIC_GAIN_INVERSE 19898
+
+/**
+  * Computes the sine of an angle in the first quadrant.
+  *
+  * @param angle The angle, in units of PI/32768, in the range 0..16384.
+  *
+  * @return The sine of the angle, in Q15 format.
+  */
+static int quarter_sine(int angle)
+{
+    int i = angle >> 7;
+    int fraction = angle & 0x7F;
+
+    if (fraction == 0)
+        return sine_table[i];
+
+    return sine_table[i] + (((sine_table[i+1] - sine_table[i]) * fraction + 64) >> 7);
+}
+
+/**
+  * Computes the sine of the given angle, using a quarter wave lookup table with linear interpolation.
+  *
+  * @param angle The angle, in units of PI/32768.
+  *
+  * @return The sine of the angle, in Q15 format. Accurate to within 2 LSB.
+  */
+int fixed_sin(int angle)
+{
+    int a = angle & 0x3FFF;
+
+    switch ((angle >> 14) & 3)
+    {
+        case 0:
+            return quarter_sine(a);
+
+        case 1:
+            return quarter_sine(0x4000 - a);
+
+        case 2:
+            return -quarter_sine(a);
+
+        default:
+            return -quarter_sine(0x4000 - a);
+    }
+}
+
+/**
+  * Computes the cosine of the given angle, using a quarter wave lookup table with linear interpolation.
+  *
+  * @param angle The angle, in units of PI/32768.
+  *
+  * @return The cosine of the angle, in Q15 format. Accurate to within 2 LSB.
+  */
+int fixed_cos(int angle)
+{
+    return fixed_sin(angle + 0x4000);
+}
+
+/**
+  * Computes the angle of the vector (x, y) from the positive x axis, using CORDIC.
+  *
+  * @param y The y component of the vector.
+  *
+  * @param x The x component of the vector.
+  *
+  * @param magnitude If not NULL, the length of the vector (x, y) is stored here.
+  *
+  * @return The angle, in units of PI/32768, in the range -32768..32767. Zero if x and y are both zero.
+  */
+int fixed_atan2(int y, int x, int *magnitude)
+{
+    int32_t angle = 0;
+    int shift = 0;
+
+    if (x == 0 && y == 0)
+    {
+        if (magnitude)
+            *magnitude = 0;
+
+        return 0;
+    }
+
+    // CORDIC only converges in the right half plane, so rotate by half a turn if needed.
+    if (x < 0)
+    {
+        angle = y < 0 ? -(1 << 30) : (1 << 30);
+        x = -x;
+        y = -y;
+    }
+
+    // Scale the vector to use as much precision as we can, while leaving headroom for the CORDIC gain.
+    uint32_t m = (uint32_t)(x > (y < 0 ? -y : y) ? x : (y < 0 ? -y : y));
+
+    while (m >= (1u << 28))
+    {
+        m >>= 1;
+        shift--;
+    }
+
+    while (m < (1u << 27))
+    {
+        m <<= 1;
+        shift++;
+    }
+
+    if (shift > 0)
+    {
+        x <<= shift;
+        y <<= shift;
+    }
+    else
+    {
+        x >>= -shift;
+        y >>= -shift;
+    }
+
+    // Rotate the vector onto the x axis, accumulating the angle turned through.
+    for (int i = 0; i < CORDIC_ITERATIONS; i++)
+    {
+        int dx = x >> i;
+        int dy = y >> i;
+
+        if (y > 0)
+        {
+            x += dy;
+            y -= dx;
+            angle += cordic_table[i];
+        }
+        else
+        {
+            x -= dy;
+            y += dx;
+            angle -= cordic_table[i];
+        }
+    }
+
+    if (magnitude)
+    {
+        int64_t r = ((int64_t)x * CORDIC_GAIN_INVERSE + (1 << 14)) >> 15;
+        *magnitude = (int)(shift > 0 ? (r + (1 << (shift - 1))) >> shift : r << -shift);
+    }
+
+    // Round to units of PI/32768, and wrap into the range -32768..32767.
+    return (int16_t)((angle + (1 << 14)) >> 15);
+}
+
+/**
+  * Converts a binary angle to whole degrees, rounding towards zero.
+  *
+  * @param angle The angle, in units of PI/32768.
+  *
+  * @return The angle in degrees, in the range -180..179.
+  */
+int fixed_degrees(int angle)
+{
+    return ((int16_t)angle * 180) / MICROBIT_FIXED_PI;
+}
@@ -63,6 +63,86 @@ struct HeapDefinition
 HeapDefinition heap[MICROBIT_MAXIMUM_HEAPS] = { };
 uint8_t heap_count = 0;
 
+// The number of blocks currently allocated from our heaps, and the most that have ever been allocated.
+static uint32_t heap_blocks_used = 0;
+static uint32_t heap_blocks_peak = 0;
+
+// The number of allocations made from our heaps.
+static uint32_t heap_allocations = 0;
+
+#if MICROBIT_HEAP_POOL_MAX_BLOCKS > 0
+// Segregated free lists of small blocks, indexed by block size (including the block header).
+// Pooled blocks remain marked as used in the heap, and hold a pointer to the next block in the list in their first data word.
+static uint32_t *heap_pool[MICROBIT_HEAP_POOL_MAX_BLOCKS + 1];
+static uint32_t heap_blocks_pooled = 0;
+
+/**
+  * Attempt to allocate a block of the given size from the segregated free lists.
+  * As blocks that are a near fit are never split by the first fit allocator, a block one larger than needed is also acceptable.
+  *
+  * @param blocksNeeded The size of the block needed, including its header.
+  *
+  * @return A pointer to the block header, or NULL if no suitable block is pooled.
+  */
+static uint32_t *microbit_pool_malloc(uint32_t blocksNeeded)
+{
+    uint32_t *block = NULL;
+
+    __disable_irq();
+
+    for (uint32_t size = blocksNeeded; size <= blocksNeeded + 1 && size <= MICROBIT_HEAP_POOL_MAX_BLOCKS; size++)
+    {
+        if (heap_pool[size] != NULL)
+        {
+            block = heap_pool[size];
+            heap_pool[size] = (uint32_t *) block[1];
+            heap_blocks_pooled -= size;
+
+            heap_blocks_used += size;
+            heap_allocations++;
+
+            if (heap_blocks_used > heap_blocks_peak)
+                heap_blocks_peak = heap_blocks_used;
+
+            break;
+        }
+    }
+
+    __enable_irq();
+
+    return block;
+}
+
+/**
+  * Returns every pooled block to its heap, so that it may be merged with its neighbours by the first fit allocator.
+  *
+  * @return The number of blocks released.
+  */
+static uint32_t microbit_pool_flush()
+{
+    uint32_t released;
+
+    __disable_irq();
+
+    for (int size = 0; size <= MICROBIT_HEAP_POOL_MAX_BLOCKS; size++)
+    {
+        while (heap_pool[size] != NULL)
+        {
+            uint32_t *block = heap_pool[size];
+            heap_pool[size] = (uint32_t *) block[1];
+            *block |= MICROBIT_HEAP_BLOCK_FREE;
+        }
+    }
+
+    released = heap_blocks_pooled;
+    heap_blocks_pooled = 0;
+
+    __enable_irq();
+
+    return released;
+}
+#endif
+
 #if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
 // Diplays a usage summary about a given heap...
 void microbit_heap_print(HeapDefinition &heap)
@@ -313,6 +393,12 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 		*block = blocksNeeded;
 	}
 
+    heap_blocks_used += *block;
+    heap_allocations++;
+
+    if (heap_blocks_used > heap_blocks_peak)
+        heap_blocks_peak = heap_blocks_used;
+
 	// Enable Interrupts
     __enable_irq();
 
@@ -320,26 +406,68 @@ void *microbit_malloc(size_t size, HeapDefinition &heap)
 }
 
 /**
-  * Release a given area of memory from the heap.
+  * Attempt to allocate a given amount of memory from the first of our configured heap areas that has space.
   *
-  * @param mem The memory area to release.
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
+  */
+static void *microbit_heap_malloc(size_t size)
+{
+    for (int i=0; i < heap_count; i++)
+    {
+        void *p = microbit_malloc(size, heap[i]);
+
+        if (p != NULL)
+            return p;
+    }
+
+    return NULL;
+}
+
+/**
+  * Attempt to allocate a given amount of memory from any of our configured heap areas.
+  *
+  * @param size The amount of memory, in bytes, to allocate.
+  *
+  * @return A pointer to the allocated memory, or NULL if insufficient memory is available.
   */
 void *microbit_malloc(size_t size)
 {
     void *p;
 
-    // Assign the memory from the first heap created that has space.
-    for (int i=0; i < heap_count; i++)
+#if MICROBIT_HEAP_POOL_MAX_BLOCKS > 0
+    // Small allocations are first served from the segregated free lists, in constant time.
+    if (size > 0 && heap_count > 0)
     {
-        p = microbit_malloc(size, heap[i]);
-        if (p != NULL)
+        uint32_t *block = microbit_pool_malloc((size + MICROBIT_HEAP_BLOCK_SIZE - 1) / MICROBIT_HEAP_BLOCK_SIZE + 1);
+
+        if (block != NULL)
         {
 #if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
-            if(SERIAL_DEBUG) SERIAL_DEBUG->printf("microbit_malloc: ALLOCATED: %d [%p]\n", size, p);
+            if(SERIAL_DEBUG) SERIAL_DEBUG->printf("microbit_malloc: POOL ALLOCATED: %d [%p]\n", size, block+1);
 #endif
-            return p;
+            return block+1;
         }
     }
+#endif
+
+    // Assign the memory from the first heap created that has space.
+    p = microbit_heap_malloc(size);
+
+#if MICROBIT_HEAP_POOL_MAX_BLOCKS > 0
+    // If our heaps are full, return any pooled blocks to them and try again.
+    if (p == NULL && microbit_pool_flush() > 0)
+        p = microbit_heap_malloc(size);
+#endif
+
+    if (p != NULL)
+    {
+#if CONFIG_ENABLED(MICROBIT_DBG) && CONFIG_ENABLED(MICROBIT_HEAP_DBG)
+        if(SERIAL_DEBUG) SERIAL_DEBUG->printf("microbit_malloc: ALLOCATED: %d [%p]\n", size, p);
+#endif
+        return p;
+    }
 
     // If we reach here, then either we have no memory available, or our heap spaces
     // haven't been initialised. Either way, we try the native allocator.
@@ -392,9 +520,28 @@ void microbit_free(void *mem)
     {
         if(memory > heap[i].heap_start && memory < heap[i].heap_end)
         {
+            __disable_irq();
+
+            heap_blocks_used -= *cb;
+
+#if MICROBIT_HEAP_POOL_MAX_BLOCKS > 0
+            // Small blocks are held on the free list for their size, ready for reuse.
+            if (*cb <= MICROBIT_HEAP_POOL_MAX_BLOCKS)
+            {
+                memory[0] = (uint32_t) heap_pool[*cb];
+                heap_pool[*cb] = cb;
+                heap_blocks_pooled += *cb;
+
+                __enable_irq();
+                return;
+            }
+#endif
+
             // The memory block given is part of this heap, so we can simply
 	        // flag that this memory area is now free, and we're done.
 	        *cb |= MICROBIT_HEAP_BLOCK_FREE;
+
+            __enable_irq();
             return;
         }
     }
@@ -403,3 +550,66 @@ void microbit_free(void *mem)
     // Forward it to the native heap allocator, and let nature take its course...
     native_free(mem);
 }
+
+/**
+  * Provides usage statistics for the heaps managed by the micro:bit heap allocator.
+  *
+  * The ratio of largestFree to free gives an indication of how fragmented the heaps are.
+  *
+  * @param stats The MicroBitHeapStatistics to populate.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int microbit_heap_statistics(MicroBitHeapStatistics &stats)
+{
+    uint32_t totalFree = 0;
+    uint32_t largestFree = 0;
+
+	// Disable IRQ temporarily to ensure no race conditions!
+    __disable_irq();
+
+    for (int i=0; i < heap_count; i++)
+    {
+        uint32_t *block = heap[i].heap_start;
+        uint32_t run = 0;
+
+        // Walk the heap, treating adjacent free blocks as a single region, as the allocator would.
+        while (block < heap[i].heap_end)
+        {
+            uint32_t blockSize = *block & ~MICROBIT_HEAP_BLOCK_FREE;
+
+            if (*block & MICROBIT_HEAP_BLOCK_FREE)
+            {
+                run += blockSize;
+                totalFree += blockSize;
+
+                if (run > largestFree)
+                    largestFree = run;
+            }
+            else
+            {
+                run = 0;
+            }
+
+            block += blockSize;
+        }
+    }
+
+    stats.used = heap_blocks_used * MICROBIT_HEAP_BLOCK_SIZE;
+    stats.peak = heap_blocks_peak * MICROBIT_HEAP_BLOCK_SIZE;
+    stats.largestFree = largestFree * MICROBIT_HEAP_BLOCK_SIZE;
+    stats.allocations = heap_allocations;
+
+#if MICROBIT_HEAP_POOL_MAX_BLOCKS > 0
+    stats.pooled = heap_blocks_pooled * MICROBIT_HEAP_BLOCK_SIZE;
+#else
+    stats.pooled = 0;
+#endif
+
+    stats.free = totalFree * MICROBIT_HEAP_BLOCK_SIZE + stats.pooled;
+
+	// Enable Interrupts
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
@@ -36,6 +36,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitEvent.h"
 #include "MicroBitCompat.h"
 #include "MicroBitFiber.h"
+#include "MicroBitSystemTimer.h"
 
 /**
   * Configures the accelerometer for G range and sample rate defined
@@ -122,11 +123,7 @@ int MicroBitAccelerometer::configure()
   */
 int MicroBitAccelerometer::writeCommand(uint8_t reg, uint8_t value)
 {
-    uint8_t command[2];
-    command[0] = reg;
-    command[1] = value;
-
-    return i2c.write(address, (const char *)command, 2);
+    return i2c.writeRegister(address, reg, &value, 1);
 }
 
 /**
@@ -144,20 +141,10 @@ int MicroBitAccelerometer::writeCommand(uint8_t reg, uint8_t value)
   */
 int MicroBitAccelerometer::readCommand(uint8_t reg, uint8_t* buffer, int length)
 {
-    int result;
-
     if (buffer == NULL || length <= 0 )
         return MICROBIT_INVALID_PARAMETER;
 
-    result = i2c.write(address, (const char *)&reg, 1, true);
-    if (result !=0)
-        return MICROBIT_I2C_ERROR;
-
-    result = i2c.read(address, (char *)buffer, length);
-    if (result !=0)
-        return MICROBIT_I2C_ERROR;
-
-    return MICROBIT_OK;
+    return i2c.readRegister(address, reg, buffer, length);
 }
 
 /**
@@ -201,6 +188,19 @@ MicroBitAccelerometer::MicroBitAccelerometer(MicroBitI2C& _i2c, uint16_t address
     this->shake.impulse_6 = 1;
     this->shake.impulse_8 = 1;
 
+    // The sample buffer is only allocated on demand.
+    this->samples = NULL;
+    this->samplesSize = 0;
+    this->samplesHead = 0;
+    this->samplesCount = 0;
+    this->samplesLost = 0;
+    this->lastSampleTime = 0;
+    this->sampleTime = 0;
+
+    // Samples are stored as soon as they are read, by the I2C interrupt handler.
+    this->sampleTransfer.callback = sampleComplete;
+    this->sampleTransfer.context = this;
+
     // Configure and enable the accelerometer.
     if (this->configure() == MICROBIT_OK)
         status |= MICROBIT_COMPONENT_RUNNING;
@@ -232,6 +232,10 @@ int MicroBitAccelerometer::whoAmI()
   * Reads the acceleration data from the accelerometer, and stores it in our buffer.
   * This only happens if the accelerometer indicates that it has new data via int1.
   *
+  * The data is read in a single burst, queued on the I2C bus without waiting for it to complete. The new sample
+  * is stored, and MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE raised, by the I2C interrupt handler as soon as it arrives.
+  * Until the first sample has arrived, a call from outside of interrupt context waits up to a sample period for it.
+  *
   * On first use, this member function will attempt to add this component to the
   * list of fiber components in order to constantly update the values stored
   * by this object.
@@ -249,51 +253,111 @@ int MicroBitAccelerometer::updateSample()
         status |= MICROBIT_ACCEL_ADDED_TO_IDLE;
     }
 
+    // Until a sample has been read, there is nothing to report but zeros. So collect the one the accelerometer
+    // holds now, or wait for it to take one. Interrupt handlers cannot wait, and are given the zeros.
+    if(!(status & MICROBIT_ACCEL_SAMPLE_VALID) && (status & MICROBIT_COMPONENT_RUNNING) && !inInterruptContext())
+    {
+        requestSample(true);
+
+        for (int waited = 0; !(status & MICROBIT_ACCEL_SAMPLE_VALID) && waited <= samplePeriod; waited += SYSTEM_TICK_PERIOD_MS)
+        {
+            fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+            requestSample(false);
+        }
+
+        if(!(status & MICROBIT_ACCEL_SAMPLE_VALID) && sampleTransfer.status == MICROBIT_I2C_ERROR)
+            return MICROBIT_I2C_ERROR;
+    }
+    else
+    {
+        requestSample(false);
+    }
+
+    return MICROBIT_OK;
+};
+
+/**
+  * Queues a read of the STATUS and sample registers, unless one is already in progress.
+  *
+  * @param force Read the registers even if int1 does not indicate that a new sample is available.
+  */
+void MicroBitAccelerometer::requestSample(bool force)
+{
     // Poll interrupt line from accelerometer.
     // n.b. Default is Active LO. Interrupt is cleared in data read.
-    if(!int1)
+    // The STATUS register and the sample that follows it are read in a single transaction.
+    if((force || !int1) && sampleTransfer.status != MICROBIT_BUSY)
     {
-        int8_t data[6];
-        int result;
+        sampleTransfer.address = address;
+        sampleTransfer.reg = MMA8653_STATUS;
+        sampleTransfer.data = sampleData;
+        sampleTransfer.length = 7;
+        sampleTransfer.flags = MICROBIT_I2C_TRANSFER_READ;
 
-        result = readCommand(MMA8653_OUT_X_MSB, (uint8_t *)data, 6);
-        if (result !=0)
-            return MICROBIT_I2C_ERROR;
+        // The read starts straight away, so this is when the sample was taken, however late we see the result.
+        sampleTime = (uint32_t)system_timer_current_time_us();
+
+        i2c.queue(sampleTransfer);
+    }
+}
 
-        // read MSB values...
-        sample.x = data[0];
-        sample.y = data[2];
-        sample.z = data[4];
+/**
+  * Called by the I2C interrupt handler when the queued read of the STATUS and sample registers completes.
+  * Stores the sample, if the accelerometer flagged it as new.
+  *
+  * @param t The completed transfer.
+  */
+void MicroBitAccelerometer::sampleComplete(MicroBitI2CTransfer *t)
+{
+    MicroBitAccelerometer *accelerometer = (MicroBitAccelerometer *)t->context;
 
-        // Normalize the data in the 0..1024 range.
-        sample.x *= 8;
-        sample.y *= 8;
-        sample.z *= 8;
+    if (t->status == MICROBIT_OK && (accelerometer->sampleData[0] & MMA8653_STATUS_ZYXDR))
+        accelerometer->storeSample();
+}
+
+/**
+  * Converts the raw sample registers into a sample, retains it, updates gesture tracking,
+  * and raises MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE.
+  */
+void MicroBitAccelerometer::storeSample()
+{
+    int8_t *data = (int8_t *)&sampleData[1];
+
+    // read MSB values...
+    sample.x = data[0];
+    sample.y = data[2];
+    sample.z = data[4];
+
+    // Normalize the data in the 0..1024 range.
+    sample.x *= 8;
+    sample.y *= 8;
+    sample.z *= 8;
 
 #if CONFIG_ENABLED(USE_ACCEL_LSB)
-        // Add in LSB values.
-        sample.x += (data[1] / 64);
-        sample.y += (data[3] / 64);
-        sample.z += (data[5] / 64);
+    // Add in LSB values.
+    sample.x += (data[1] / 64);
+    sample.y += (data[3] / 64);
+    sample.z += (data[5] / 64);
 #endif
 
-        // Scale into millig (approx!)
-        sample.x *= this->sampleRange;
-        sample.y *= this->sampleRange;
-        sample.z *= this->sampleRange;
+    // Scale into millig (approx!)
+    sample.x *= this->sampleRange;
+    sample.y *= this->sampleRange;
+    sample.z *= this->sampleRange;
 
-        // Indicate that pitch and roll data is now stale, and needs to be recalculated if needed.
-        status &= ~MICROBIT_ACCEL_PITCH_ROLL_VALID;
+    // Indicate that pitch and roll data is now stale, and needs to be recalculated if needed.
+    status &= ~MICROBIT_ACCEL_PITCH_ROLL_VALID;
+    status |= MICROBIT_ACCEL_SAMPLE_VALID;
 
-        // Update gesture tracking
-        updateGesture();
+    // Retain the sample, if the application has asked us to.
+    recordSample(sampleData[0]);
 
-        // Indicate that a new sample is available
-        MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
-    }
+    // Update gesture tracking
+    updateGesture();
 
-    return MICROBIT_OK;
-};
+    // Indicate that a new sample is available
+    MicroBitEvent e(id, MICROBIT_ACCELEROMETER_EVT_DATA_UPDATE);
+}
 
 /**
   * A service function.
@@ -633,7 +697,7 @@ int MicroBitAccelerometer::getZ(MicroBitCoordinateSystem system)
   */
 int MicroBitAccelerometer::getPitch()
 {
-    return (int) ((360*getPitchRadians()) / (2*PI));
+    return fixed_degrees(getPitchAngle());
 }
 
 /**
@@ -646,6 +710,21 @@ int MicroBitAccelerometer::getPitch()
   * @endcode
   */
 float MicroBitAccelerometer::getPitchRadians()
+{
+    return getPitchAngle() * (float)(PI / MICROBIT_FIXED_PI);
+}
+
+/**
+  * Provides a rotation compensated pitch of the device, based on the latest update retrieved from the accelerometer.
+  * This is the native format of the calculation, and needs no floating point arithmetic.
+  *
+  * @return The pitch of the device, in units of PI/32768 (see MicroBitFixedMath.h).
+  *
+  * @code
+  * accelerometer.getPitchAngle();
+  * @endcode
+  */
+int MicroBitAccelerometer::getPitchAngle()
 {
     if (!(status & MICROBIT_ACCEL_PITCH_ROLL_VALID))
         recalculatePitchRoll();
@@ -664,7 +743,7 @@ float MicroBitAccelerometer::getPitchRadians()
   */
 int MicroBitAccelerometer::getRoll()
 {
-    return (int) ((360*getRollRadians()) / (2*PI));
+    return fixed_degrees(getRollAngle());
 }
 
 /**
@@ -677,6 +756,21 @@ int MicroBitAccelerometer::getRoll()
   * @endcode
   */
 float MicroBitAccelerometer::getRollRadians()
+{
+    return getRollAngle() * (float)(PI / MICROBIT_FIXED_PI);
+}
+
+/**
+  * Provides a rotation compensated roll of the device, based on the latest update retrieved from the accelerometer.
+  * This is the native format of the calculation, and needs no floating point arithmetic.
+  *
+  * @return The roll of the device, in units of PI/32768 (see MicroBitFixedMath.h).
+  *
+  * @code
+  * accelerometer.getRollAngle();
+  * @endcode
+  */
+int MicroBitAccelerometer::getRollAngle()
 {
     if (!(status & MICROBIT_ACCEL_PITCH_ROLL_VALID))
         recalculatePitchRoll();
@@ -687,21 +781,204 @@ float MicroBitAccelerometer::getRollRadians()
 /**
   * Recalculate roll and pitch values for the current sample.
   *
-  * @note We only do this at most once per sample, as the necessary trigonemteric functions are rather
-  *       heavyweight for a CPU without a floating point unit.
+  * @note We only do this at most once per sample. The trigonometry is performed in fixed point,
+  *       as floating point is rather heavyweight for a CPU without a floating point unit.
   */
 void MicroBitAccelerometer::recalculatePitchRoll()
 {
-    double x = (double) getX(NORTH_EAST_DOWN);
-    double y = (double) getY(NORTH_EAST_DOWN);
-    double z = (double) getZ(NORTH_EAST_DOWN);
+    int x = getX(NORTH_EAST_DOWN);
+    int y = getY(NORTH_EAST_DOWN);
+    int z = getZ(NORTH_EAST_DOWN);
+    int r;
 
-    roll = atan2(y, z);
-    pitch = atan(-x / (y*sin(roll) + z*cos(roll)));
+    // y*sin(roll) + z*cos(roll) is simply the length of (y, z), which CORDIC gives us for free.
+    // As that length is never negative, atan(-x / r) is equivalent to atan2(-x, r).
+    // The readings are scaled up first, so that the integer length keeps enough precision for small values.
+    roll = fixed_atan2(y * 256, z * 256, &r);
+    pitch = fixed_atan2(-x * 256, r);
 
     status |= MICROBIT_ACCEL_PITCH_ROLL_VALID;
 }
 
+/**
+  * Appends the current sample to the sample buffer, if enabled, and accounts for any samples missed since the last.
+  *
+  * @param flags The value of the STATUS register read along with the sample.
+  */
+void MicroBitAccelerometer::recordSample(uint8_t flags)
+{
+    if (samples == NULL)
+        return;
+
+    uint32_t now = sampleTime;
+
+    // If the accelerometer overwrote a sample before we read it, estimate how many we missed from the time elapsed.
+    if (flags & MMA8653_STATUS_ZYXOW)
+    {
+        // samplePeriod is rounded to whole milliseconds, so look up the exact period of the hardware.
+        uint32_t period = MMA8653SampleRate[0].sample_period;
+        for (int i = 0; i < MMA8653_SAMPLE_RATES; i++)
+            if (MMA8653SampleRate[i].sample_period / 1000 == samplePeriod)
+                period = MMA8653SampleRate[i].sample_period;
+
+        // The previous sample was, on average, half a period old when read. So round to the nearest period.
+        uint32_t periods = (now - lastSampleTime + period / 2) / period;
+        samplesLost += periods > 1 ? periods - 1 : 1;
+    }
+
+    lastSampleTime = now;
+
+    // If the buffer is full, discard the oldest sample to make room.
+    if (samplesCount == samplesSize)
+    {
+        samplesCount--;
+        samplesLost++;
+    }
+
+    MMA8653TimestampedSample *s = &samples[samplesHead];
+    s->timestamp = now;
+    s->x = sample.x;
+    s->y = sample.y;
+    s->z = sample.z;
+
+    samplesHead = (samplesHead + 1) % samplesSize;
+    samplesCount++;
+
+    if (samplesCount == samplesSize / 2)
+        MicroBitEvent(id, MICROBIT_ACCELEROMETER_EVT_SAMPLES_READY);
+}
+
+/**
+  * Retains every sample read from the accelerometer, along with the time it was read, so that none are missed
+  * if the application does not call getX/Y/Z() or the idle thread is delayed. Combined with setPeriod(1),
+  * this captures the accelerometer's full 800Hz output.
+  *
+  * A MICROBIT_ACCELEROMETER_EVT_SAMPLES_READY event is raised whenever the buffer becomes half full.
+  *
+  * @param size The number of samples to retain. Defaults to MICROBIT_ACCELEROMETER_SAMPLE_BUFFER_SIZE.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if size is less than 2,
+  *         or MICROBIT_NO_RESOURCES if the buffer could not be allocated.
+  */
+int MicroBitAccelerometer::enableSampleBuffer(int size)
+{
+    if (size < 2 || size > 0xFFFF)
+        return MICROBIT_INVALID_PARAMETER;
+
+    MMA8653TimestampedSample *s = (MMA8653TimestampedSample *) malloc(size * sizeof(MMA8653TimestampedSample));
+
+    if (s == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    disableSampleBuffer();
+
+    // Samples are recorded by the I2C interrupt handler, so it must not see the buffer half set up.
+    __disable_irq();
+
+    samples = s;
+    samplesSize = size;
+    samplesHead = 0;
+    samplesCount = 0;
+    samplesLost = 0;
+    lastSampleTime = (uint32_t)system_timer_current_time_us();
+
+    __enable_irq();
+
+    // Ensure we're being polled, even if the application never asks for a reading.
+    updateSample();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops retaining samples, and releases the sample buffer. Any samples not yet read are discarded.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitAccelerometer::disableSampleBuffer()
+{
+    __disable_irq();
+
+    MMA8653TimestampedSample *s = samples;
+
+    samples = NULL;
+    samplesSize = 0;
+    samplesHead = 0;
+    samplesCount = 0;
+
+    __enable_irq();
+
+    if (s != NULL)
+        free(s);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the number of samples waiting to be read from the sample buffer.
+  *
+  * @return The number of samples available, or MICROBIT_INVALID_PARAMETER if the sample buffer is not enabled.
+  */
+int MicroBitAccelerometer::getSampleCount()
+{
+    if (samples == NULL)
+        return MICROBIT_INVALID_PARAMETER;
+
+    updateSample();
+
+    return samplesCount;
+}
+
+/**
+  * Copies the oldest samples from the sample buffer into the given array, and removes them from the buffer.
+  *
+  * @param buffer The array to fill.
+  *
+  * @param length The maximum number of samples to copy.
+  *
+  * @return The number of samples copied, or MICROBIT_INVALID_PARAMETER if the sample buffer is not enabled or the parameters are invalid.
+  *
+  * @code
+  * MMA8653TimestampedSample s[16];
+  * int n = accelerometer.readSamples(s, 16);
+  * @endcode
+  */
+int MicroBitAccelerometer::readSamples(MMA8653TimestampedSample *buffer, int length)
+{
+    if (samples == NULL || buffer == NULL || length < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    updateSample();
+
+    // Keep the I2C interrupt handler from recording a sample part way through the copy.
+    __disable_irq();
+
+    int count = min(length, (int)samplesCount);
+    int tail = (samplesHead + samplesSize - samplesCount) % samplesSize;
+
+    // Copy out in at most two pieces, either side of the end of the ring.
+    int first = min(count, samplesSize - tail);
+    memcpy(buffer, &samples[tail], first * sizeof(MMA8653TimestampedSample));
+    memcpy(buffer + first, samples, (count - first) * sizeof(MMA8653TimestampedSample));
+
+    samplesCount -= count;
+
+    __enable_irq();
+
+    return count;
+}
+
+/**
+  * Determines the number of samples lost since the sample buffer was enabled. This includes samples the
+  * accelerometer overwrote before they could be read, and samples discarded because the buffer was full.
+  *
+  * @return The number of samples lost.
+  */
+int MicroBitAccelerometer::getLostSampleCount()
+{
+    return samplesLost;
+}
+
 /**
   * Retrieves the last recorded gesture.
   *
@@ -723,11 +1000,11 @@ uint16_t MicroBitAccelerometer::getGesture()
 /**
   * A periodic callback invoked by the fiber scheduler idle thread.
   *
-  * Internally calls updateSample().
+  * Polls int1, and queues a read of any new sample. Unlike updateSample(), this never waits, as the idle thread cannot sleep.
   */
 void MicroBitAccelerometer::idleTick()
 {
-    updateSample();
+    requestSample(false);
 }
 
 /**
@@ -736,6 +1013,10 @@ void MicroBitAccelerometer::idleTick()
 MicroBitAccelerometer::~MicroBitAccelerometer()
 {
     fiber_remove_idle_component(this);
+    disableSampleBuffer();
+
+    // Let any queued read finish, as it refers to our buffers.
+    while(sampleTransfer.status == MICROBIT_BUSY);
 }
 
 const MMA8653SampleRangeConfig MMA8653SampleRange[MMA8653_SAMPLE_RANGES] = {
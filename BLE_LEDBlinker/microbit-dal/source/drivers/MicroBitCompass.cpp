@@ -32,6 +32,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitCompass.h"
 #include "MicroBitFiber.h"
+#include "MicroBitFixedMath.h"
 #include "ErrorNo.h"
 
 /**
@@ -46,6 +47,10 @@ void MicroBitCompass::init(uint16_t id, uint16_t address)
     this->id = id;
     this->address = address;
 
+    // Samples are stored as soon as they are read, by the I2C interrupt handler.
+    this->sampleTransfer.callback = sampleComplete;
+    this->sampleTransfer.context = this;
+
     // Select 10Hz update rate, with oversampling, and enable the device.
     this->samplePeriod = 100;
     this->configure();
@@ -55,7 +60,7 @@ void MicroBitCompass::init(uint16_t id, uint16_t address)
 
     if(this->storage != NULL)
     {
-        KeyValuePair *calibrationData =  storage->get("compassCal");
+        const KeyValuePair *calibrationData =  storage->find("compassCal");
 
         if(calibrationData != NULL)
         {
@@ -64,8 +69,6 @@ void MicroBitCompass::init(uint16_t id, uint16_t address)
             memcpy(&storedSample, calibrationData->value, sizeof(CompassSample));
 
             setCalibration(storedSample);
-
-            delete calibrationData;
         }
     }
 
@@ -210,11 +213,7 @@ MicroBitCompass::MicroBitCompass(MicroBitI2C& _i2c, uint16_t address, uint16_t i
   */
 int MicroBitCompass::writeCommand(uint8_t reg, uint8_t value)
 {
-    uint8_t command[2];
-    command[0] = reg;
-    command[1] = value;
-
-    return i2c.write(address, (const char *)command, 2);
+    return i2c.writeRegister(address, reg, &value, 1);
 }
 
 /**
@@ -232,20 +231,10 @@ int MicroBitCompass::writeCommand(uint8_t reg, uint8_t value)
   */
 int MicroBitCompass::readCommand(uint8_t reg, uint8_t* buffer, int length)
 {
-    int result;
-
     if (buffer == NULL || length <= 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    result = i2c.write(address, (const char *)&reg, 1, true);
-    if (result !=0)
-        return MICROBIT_I2C_ERROR;
-
-    result = i2c.read(address, (char *)buffer, length);
-    if (result !=0)
-        return MICROBIT_I2C_ERROR;
-
-    return MICROBIT_OK;
+    return i2c.readRegister(address, reg, buffer, length);
 }
 
 
@@ -263,16 +252,11 @@ int MicroBitCompass::read16(uint8_t reg)
     uint8_t cmd[2];
     int result;
 
-    cmd[0] = reg;
-    result = i2c.write(address, (const char *)cmd, 1);
-    if (result !=0)
-        return MICROBIT_I2C_ERROR;
-
     cmd[0] = 0x00;
     cmd[1] = 0x00;
 
-    result = i2c.read(address, (char *)cmd, 2);
-    if (result !=0)
+    result = readCommand(reg, cmd, 2);
+    if (result != MICROBIT_OK)
         return MICROBIT_I2C_ERROR;
 
     return (int16_t) ((cmd[1] | (cmd[0] << 8))); //concatenate the MSB and LSB
@@ -306,25 +290,25 @@ int MicroBitCompass::read8(uint8_t reg)
 int MicroBitCompass::tiltCompensatedBearing()
 {
     // Precompute the tilt compensation parameters to improve readability.
-    float phi = accelerometer->getRollRadians();
-    float theta = accelerometer->getPitchRadians();
+    // All angles are in units of PI/32768, and all sines and cosines in Q15 (see MicroBitFixedMath.h).
+    int phi = accelerometer->getRollAngle();
+    int theta = accelerometer->getPitchAngle();
 
-    float x = (float) getX(NORTH_EAST_DOWN);
-    float y = (float) getY(NORTH_EAST_DOWN);
-    float z = (float) getZ(NORTH_EAST_DOWN);
+    int x = getX(NORTH_EAST_DOWN);
+    int y = getY(NORTH_EAST_DOWN);
+    int z = getZ(NORTH_EAST_DOWN);
 
     // Precompute cos and sin of pitch and roll angles to make the calculation a little more efficient.
-    float sinPhi = sin(phi);
-    float cosPhi = cos(phi);
-    float sinTheta = sin(theta);
-    float cosTheta = cos(theta);
-
-    float bearing = (360*atan2(z*sinPhi - y*cosPhi, x*cosTheta + y*sinTheta*sinPhi + z*sinTheta*cosPhi)) / (2*PI);
+    int sinPhi = fixed_sin(phi);
+    int cosPhi = fixed_cos(phi);
+    int sinTheta = fixed_sin(theta);
+    int cosTheta = fixed_cos(theta);
 
-    if (bearing < 0)
-        bearing += 360.0;
+    int bearing = fixed_atan2(fixed_mul(z, sinPhi) - fixed_mul(y, cosPhi),
+                              fixed_mul(x, cosTheta) + fixed_mul(fixed_mul(y, sinTheta), sinPhi) + fixed_mul(fixed_mul(z, sinTheta), cosPhi));
 
-    return (int) bearing;
+    // Map -PI..PI onto 0..359 degrees.
+    return ((bearing & 0xFFFF) * 360) >> 16;
 }
 
 /**
@@ -334,12 +318,10 @@ int MicroBitCompass::basicBearing()
 {
     updateSample();
 
-    float bearing = (atan2((double)(sample.y - average.y),(double)(sample.x - average.x)))*180/PI;
-
-    if (bearing < 0)
-        bearing += 360.0;
+    // Map -PI..PI onto 0..359 degrees, then reverse the direction of rotation.
+    int bearing = fixed_atan2(sample.y - average.y, sample.x - average.x) & 0xFFFF;
 
-    return (int)(360.0 - bearing);
+    return ((65536 - bearing) * 360) >> 16;
 }
 
 /**
@@ -375,6 +357,12 @@ int MicroBitCompass::heading()
   * Updates the local sample, only if the compass indicates that
   * data is stale.
   *
+  * The sample registers are read in a single burst, queued on the I2C bus without waiting for it to complete. The new
+  * sample is stored, and MICROBIT_COMPASS_EVT_DATA_UPDATE raised, by the I2C interrupt handler as soon as it arrives.
+  * Until the first sample has arrived, a call from outside of interrupt context waits up to a sample period for it.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if the first sample could not be read.
+  *
   * @note Can be used to trigger manual updates, if the device is running without a scheduler.
   *       Also called internally by all get[X,Y,Z]() member functions.
   */
@@ -390,29 +378,82 @@ int MicroBitCompass::updateSample()
         status |= MICROBIT_COMPASS_STATUS_ADDED_TO_IDLE;
     }
 
+    // Until a sample has been read, there is nothing to report but zeros. So collect the one the magnetometer
+    // holds now, or wait for it to take one. Interrupt handlers cannot wait, and are given the zeros.
+    if(!(status & MICROBIT_COMPASS_STATUS_SAMPLE_VALID) && (status & MICROBIT_COMPONENT_RUNNING) && !inInterruptContext())
+    {
+        requestSample(true);
+
+        for (int waited = 0; !(status & MICROBIT_COMPASS_STATUS_SAMPLE_VALID) && waited <= samplePeriod; waited += SYSTEM_TICK_PERIOD_MS)
+        {
+            fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+            requestSample(false);
+        }
+
+        if(!(status & MICROBIT_COMPASS_STATUS_SAMPLE_VALID) && sampleTransfer.status == MICROBIT_I2C_ERROR)
+            return MICROBIT_I2C_ERROR;
+    }
+    else
+    {
+        requestSample(false);
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Queues a read of the status and sample registers, unless one is already in progress.
+  *
+  * @param force Read the registers even if int1 does not indicate that a new sample is available.
+  */
+void MicroBitCompass::requestSample(bool force)
+{
     // Poll interrupt line from compass (Active HI).
     // Interrupt is cleared on data read of MAG_OUT_X_MSB.
-    if(int1)
+    // The registers auto-increment, so the status, X, Y and Z are read in a single 7 byte burst.
+    if((force || int1) && sampleTransfer.status != MICROBIT_BUSY)
     {
-        sample.x = MAG3110_NORMALIZE_SAMPLE((int) read16(MAG_OUT_X_MSB));
-        sample.y = MAG3110_NORMALIZE_SAMPLE((int) read16(MAG_OUT_Y_MSB));
-        sample.z = MAG3110_NORMALIZE_SAMPLE((int) read16(MAG_OUT_Z_MSB));
+        sampleTransfer.address = address;
+        sampleTransfer.reg = MAG_DR_STATUS;
+        sampleTransfer.data = sampleData;
+        sampleTransfer.length = 7;
+        sampleTransfer.flags = MICROBIT_I2C_TRANSFER_READ;
 
-        // Indicate that a new sample is available
-        MicroBitEvent e(id, MICROBIT_COMPASS_EVT_DATA_UPDATE);
+        i2c.queue(sampleTransfer);
     }
+}
 
-    return MICROBIT_OK;
+/**
+  * Called by the I2C interrupt handler when the queued read of the status and sample registers completes.
+  * Stores the sample, if the magnetometer flagged it as new.
+  *
+  * @param t The completed transfer.
+  */
+void MicroBitCompass::sampleComplete(MicroBitI2CTransfer *t)
+{
+    MicroBitCompass *compass = (MicroBitCompass *)t->context;
+    uint8_t *data = compass->sampleData;
+
+    if (t->status != MICROBIT_OK || !(data[0] & MAG3110_STATUS_ZYXDR))
+        return;
+
+    compass->sample.x = MAG3110_NORMALIZE_SAMPLE((int) (int16_t) (data[2] | (data[1] << 8)));
+    compass->sample.y = MAG3110_NORMALIZE_SAMPLE((int) (int16_t) (data[4] | (data[3] << 8)));
+    compass->sample.z = MAG3110_NORMALIZE_SAMPLE((int) (int16_t) (data[6] | (data[5] << 8)));
+    compass->status |= MICROBIT_COMPASS_STATUS_SAMPLE_VALID;
+
+    // Indicate that a new sample is available
+    MicroBitEvent e(compass->id, MICROBIT_COMPASS_EVT_DATA_UPDATE);
 }
 
 /**
   * Periodic callback from MicroBit idle thread.
   *
-  * Calls updateSample().
+  * Polls int1, and queues a read of any new sample. Unlike updateSample(), this never waits, as the idle thread cannot sleep.
   */
 void MicroBitCompass::idleTick()
 {
-    updateSample();
+    requestSample(false);
 }
 
 /**
@@ -751,6 +792,9 @@ void MicroBitCompass::clearCalibration()
 MicroBitCompass::~MicroBitCompass()
 {
     fiber_remove_idle_component(this);
+
+    // Let any queued read finish, as it refers to our buffers.
+    while(sampleTransfer.status == MICROBIT_BUSY);
 }
 
 const MAG3110SampleRateConfig MAG3110SampleRate[MAG3110_SAMPLE_RATES] = {
@@ -26,7 +26,6 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitCompassCalibrator.h"
 #include "EventModel.h"
-#include "Matrix4.h"
 
 /**
   * Constructor.
@@ -47,6 +46,8 @@ DEALINGS IN THE SOFTWARE.
   */
 MicroBitCompassCalibrator::MicroBitCompassCalibrator(MicroBitCompass& _compass, MicroBitAccelerometer& _accelerometer, MicroBitDisplay& _display) : compass(_compass), accelerometer(_accelerometer), display(_display)
 {
+    reset();
+
     if (EventModel::defaultEventBus)
         EventModel::defaultEventBus->listen(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_CALIBRATE, this, &MicroBitCompassCalibrator::calibrate, MESSAGE_BUS_LISTENER_IMMEDIATE);
 }
@@ -73,7 +74,8 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
 
     wait_ms(100);
 
-	Matrix4 X(PERIMETER_POINTS, 4);
+    reset();
+
     Point perimeter[PERIMETER_POINTS] = {{1,0,0}, {2,0,0}, {3,0,0}, {4,1,0}, {4,2,0}, {4,3,0}, {3,4,0}, {2,4,0}, {1,4,0}, {0,3,0}, {0,2,0}, {0,1,0}};
     Point cursor = {2,2,0};
 
@@ -145,10 +147,7 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
             if (cursor.x == perimeter[i].x && cursor.y == perimeter[i].y && !perimeter[i].on)
             {
                 // Record the sample data for later processing...
-                X.set(samples, 0, compass.getX(RAW));
-                X.set(samples, 1, compass.getY(RAW));
-                X.set(samples, 2, compass.getZ(RAW));
-                X.set(samples, 3, 1);
+                addSample(CompassSample(compass.getX(RAW), compass.getY(RAW), compass.getZ(RAW)));
 
                 // Record that this pixel has been visited.
                 perimeter[i].on = 1;
@@ -160,25 +159,10 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
     }
 
     // We have enough sample data to make a fairly accurate calibration.
-    // We use a Least Mean Squares approximation, as detailed in Freescale application note AN2426.
+    CompassSample cal;
 
-    // Firstly, calculate the square of each sample.
-	Matrix4 Y(X.height(), 1);
-	for (int i = 0; i < X.height(); i++)
-	{
-		float v = X.get(i, 0)*X.get(i, 0) + X.get(i, 1)*X.get(i, 1) + X.get(i, 2)*X.get(i, 2);
-		Y.set(i, 0, v);
-	}
-
-    // Now perform a Least Squares Approximation.
-	Matrix4 Alpha = X.multiplyT(X).invert();
-	Matrix4 Gamma = X.multiplyT(Y);
-	Matrix4 Beta = Alpha.multiply(Gamma);
-
-    // The result contains the approximate zero point of each axis, but doubled.
-    // Halve each sample, and record this as the compass calibration data.
-    CompassSample cal ((int)(Beta.get(0,0) / 2), (int)(Beta.get(1,0) / 2), (int)(Beta.get(2,0) / 2));
-    compass.setCalibration(cal);
+    if (solve(cal) == MICROBIT_OK)
+        compass.setCalibration(cal);
 
     // Show a smiley to indicate that we're done, and continue on with the user program.
     display.clear();
@@ -186,3 +170,230 @@ void MicroBitCompassCalibrator::calibrate(MicroBitEvent)
     wait_ms(1000);
     display.clear();
 }
+
+/**
+  * Starts calibrating the compass continuously in the background, using the samples the compass produces.
+  *
+  * The compass is recalibrated whenever the solution has converged and differs from the calibration in use.
+  * This requires no user interaction, but the device must be turned through a range of orientations before a solution can be found.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if no default EventModel is available.
+  */
+int MicroBitCompassCalibrator::enableStreaming()
+{
+    if (!EventModel::defaultEventBus)
+        return MICROBIT_NO_RESOURCES;
+
+    reset();
+
+    // Solving, and writing the result to flash, take too long to do wherever the compass raises its event.
+    // So handle samples in a fiber of our own instead, skipping any that arrive while we are still busy with the last.
+    EventModel::defaultEventBus->listen(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_DATA_UPDATE, this, &MicroBitCompassCalibrator::sampleReceived, MESSAGE_BUS_LISTENER_DROP_IF_BUSY);
+
+    // Ensure the compass is being polled, so that samples start to arrive.
+    compass.updateSample();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Stops calibrating the compass in the background.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if no default EventModel is available.
+  */
+int MicroBitCompassCalibrator::disableStreaming()
+{
+    if (!EventModel::defaultEventBus)
+        return MICROBIT_NO_RESOURCES;
+
+    EventModel::defaultEventBus->ignore(MICROBIT_ID_COMPASS, MICROBIT_COMPASS_EVT_DATA_UPDATE, this, &MicroBitCompassCalibrator::sampleReceived);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Reports how well the streaming calibration has converged.
+  *
+  * @return The distance the estimated zero offset moved at the most recent solution, in the compass's RAW units.
+  *         Smaller values indicate a more stable calibration. MICROBIT_CALIBRATION_REQUIRED is returned until two solutions have been found.
+  */
+int MicroBitCompassCalibrator::getConvergence()
+{
+    return convergence;
+}
+
+/**
+  * Clears the least squares sums, ready to accept a new set of samples.
+  *
+  * Together with addSample() and solve(), this also lets an application compute a calibration from samples of its own.
+  */
+void MicroBitCompassCalibrator::reset()
+{
+    XtX.clear();
+    XtY.clear();
+
+    sampleCount = 0;
+    solved = false;
+    solveCountdown = MICROBIT_COMPASS_CALIBRATOR_MIN_SAMPLES;
+    convergence = MICROBIT_CALIBRATION_REQUIRED;
+}
+
+/**
+  * Adds a sample to the least squares sums. This takes a handful of multiply-adds, and allocates no memory.
+  *
+  * We use a Least Mean Squares approximation, as detailed in Freescale application note AN2426.
+  * Each sample contributes a row X = [x y z 1], with Y = x^2 + y^2 + z^2, to the normal equations (XtX) B = XtY.
+  *
+  * @param s The sample to add, in the compass's RAW units.
+  */
+void MicroBitCompassCalibrator::addSample(CompassSample s)
+{
+    float v[4] = {(float)s.x, (float)s.y, (float)s.z, 1.0f};
+    float y = v[0]*v[0] + v[1]*v[1] + v[2]*v[2];
+
+    // Progressively forget older samples. This lets the calibration follow any changes in the device's surroundings,
+    // and keeps the sums well within the precision of a float.
+    if (sampleCount >= MICROBIT_COMPASS_CALIBRATOR_WINDOW)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = i; j < 4; j++)
+                XtX.at(i, j) *= 0.5f;
+
+            XtY.at(i, 0) *= 0.5f;
+        }
+
+        sampleCount /= 2;
+    }
+
+    // XtX is symmetric, so we only need to maintain its upper triangle.
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = i; j < 4; j++)
+            XtX.at(i, j) += v[i] * v[j];
+
+        XtY.at(i, 0) += v[i] * y;
+    }
+
+    sampleCount++;
+    last = s;
+}
+
+/**
+  * Solves the least squares problem for the samples accepted so far, using a 4x4 system held on the stack.
+  *
+  * @param result The centre of the best fitting sphere, which is the zero offset of each axis.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_CALIBRATION_REQUIRED if the samples do not cover
+  *         enough directions to determine a solution.
+  */
+int MicroBitCompassCalibrator::solve(CompassSample &result)
+{
+    Matrix<4, 5> A;
+    float beta[4];
+
+    // Build the augmented matrix [XtX | XtY], filling in the lower triangle of XtX.
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+            A.at(i, j) = i <= j ? XtX.at(i, j) : XtX.at(j, i);
+
+        A.at(i, 4) = XtY.at(i, 0);
+    }
+
+    // Gaussian elimination, with partial pivoting.
+    for (int c = 0; c < 4; c++)
+    {
+        int p = c;
+
+        for (int r = c + 1; r < 4; r++)
+            if (fabsf(A.at(r, c)) > fabsf(A.at(p, c)))
+                p = r;
+
+        // If the pivot is tiny compared to the original diagonal, this axis is (nearly) determined by the others.
+        // This happens when the samples are close to coplanar, such as when the device has only been turned flat on a table.
+        if (fabsf(A.at(p, c)) <= 1e-3f * XtX.at(c, c))
+            return MICROBIT_CALIBRATION_REQUIRED;
+
+        if (p != c)
+        {
+            for (int k = c; k < 5; k++)
+            {
+                float t = A.at(c, k);
+                A.at(c, k) = A.at(p, k);
+                A.at(p, k) = t;
+            }
+        }
+
+        for (int r = c + 1; r < 4; r++)
+        {
+            float f = A.at(r, c) / A.at(c, c);
+
+            for (int k = c; k < 5; k++)
+                A.at(r, k) -= f * A.at(c, k);
+        }
+    }
+
+    // Back substitution.
+    for (int i = 3; i >= 0; i--)
+    {
+        float v = A.at(i, 4);
+
+        for (int k = i + 1; k < 4; k++)
+            v -= A.at(i, k) * beta[k];
+
+        beta[i] = v / A.at(i, i);
+    }
+
+    // The result contains the approximate zero point of each axis, but doubled.
+    result = CompassSample((int)(beta[0] / 2), (int)(beta[1] / 2), (int)(beta[2] / 2));
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Event handler for streaming calibration. Called whenever the compass has a new sample.
+  */
+void MicroBitCompassCalibrator::sampleReceived(MicroBitEvent)
+{
+    // Leave the compass alone while an interactive calibration is taking place.
+    if (compass.isCalibrating())
+        return;
+
+    CompassSample s(compass.getX(RAW), compass.getY(RAW), compass.getZ(RAW));
+
+    // Ignore samples that add little new information, such as when the device is at rest.
+    if (sampleCount > 0 && abs(s.x - last.x) + abs(s.y - last.y) + abs(s.z - last.z) < MICROBIT_COMPASS_CALIBRATOR_MIN_DISTANCE)
+        return;
+
+    addSample(s);
+
+    if (--solveCountdown > 0)
+        return;
+
+    solveCountdown = MICROBIT_COMPASS_CALIBRATOR_SOLVE_INTERVAL;
+
+    CompassSample c;
+    if (solve(c) != MICROBIT_OK)
+        return;
+
+    // Record how far the solution has moved since the last one. The first solution has nothing to compare against.
+    if (!solved)
+    {
+        solved = true;
+        centre = c;
+        return;
+    }
+
+    convergence = abs(c.x - centre.x) + abs(c.y - centre.y) + abs(c.z - centre.z);
+    centre = c;
+
+    if (convergence >= MICROBIT_COMPASS_CALIBRATOR_CONVERGED)
+        return;
+
+    // Apply the solution, but only if it is materially different. The calibration is written to flash each time.
+    CompassSample current = compass.getCalibration();
+
+    if (!compass.isCalibrated() || abs(c.x - current.x) + abs(c.y - current.y) + abs(c.z - current.z) > MICROBIT_COMPASS_CALIBRATOR_TOLERANCE)
+        compass.setCalibration(c);
+}
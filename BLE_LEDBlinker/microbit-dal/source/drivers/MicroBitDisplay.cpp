@@ -76,8 +76,15 @@ MicroBitDisplay::MicroBitDisplay(uint16_t id, const MatrixMap &map) :
 
     LEDMatrix = new PortOut(Port0, row_mask | col_mask);
 
-    this->greyscaleBitMsk = 0x01;
-    this->timingCount = 0;
+    rowPatterns = new uint32_t[matrixMap.rows];
+    scrollingStrip = NULL;
+    greyscalePatterns = new uint32_t[matrixMap.rows * (matrixMap.columns + 1)];
+    greyscaleDelays = new uint16_t[matrixMap.rows * (matrixMap.columns + 1)];
+    rowPatternsGeneration = image.getGeneration();
+    rowPatternsSettled = false;
+    rowPatternsGreyscale = false;
+
+    this->greyscaleStep = 0;
     this->setBrightness(MICROBIT_DISPLAY_DEFAULT_BRIGHTNESS);
     this->mode = DISPLAY_MODE_BLACK_AND_WHITE;
     this->animationMode = ANIMATION_MODE_NONE;
@@ -117,8 +124,7 @@ void MicroBitDisplay::systemTick()
 
     if(mode == DISPLAY_MODE_GREYSCALE)
     {
-        greyscaleBitMsk = 0x01;
-        timingCount = 0;
+        greyscaleStep = 0;
         renderGreyscale();
     }
 
@@ -131,52 +137,132 @@ void MicroBitDisplay::renderFinish()
     *LEDMatrix = 0;
 }
 
-void MicroBitDisplay::render()
+void MicroBitDisplay::updateRowPatterns()
 {
-    // Simple optimisation.
-    // If display is at zero brightness, there's nothing to do.
-    if(brightness == 0)
+    uint16_t generation = image.getGeneration();
+    bool greyscale = (mode == DISPLAY_MODE_GREYSCALE);
+
+    // Writes through another reference to our bitmap aren't counted in our generation, so while there are any,
+    // the patterns are recomputed every frame.
+    if(generation == rowPatternsGeneration && rowPatternsSettled && !image.isShared() && (rowPatternsGreyscale || !greyscale))
         return;
 
-    // Calculate the bitpattern to write.
-    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
-    uint32_t col_data = 0;
+    // The generation is incremented before an image is written to, so the write may not have completed yet
+    // if we interrupted it. Keep computing the patterns until a tick sees no further change.
+    rowPatternsSettled = (generation == rowPatternsGeneration);
+    rowPatternsGeneration = generation;
+    rowPatternsGreyscale = greyscale;
 
-    for (int i = 0; i < matrixMap.columns; i++)
-    {
-        int index = (i * matrixMap.rows) + strobeRow;
+    // Only read the bitmap, so that we don't mark it as modified ourselves.
+    const uint8_t *bitmap = image.peekBitmap();
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
+    for (int row = 0; row < matrixMap.rows; row++)
+    {
+        uint32_t row_data = 0x01 << (matrixMap.rowStart + row);
+        uint32_t col_data = 0;
+        uint16_t onTime[matrixMap.columns];
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
+        for (int i = 0; i < matrixMap.columns; i++)
         {
-                x = width - 1 - y;
-                y = t;
-        }
+            int index = (i * matrixMap.rows) + row;
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
-        {
-                x = width - 1 - x;
-                y = height - 1 - y;
+            int x = matrixMap.map[index].x;
+            int y = matrixMap.map[index].y;
+            int t = x;
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_90)
+            {
+                    x = width - 1 - y;
+                    y = t;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_180)
+            {
+                    x = width - 1 - x;
+                    y = height - 1 - y;
+            }
+
+            if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+            {
+                    x = y;
+                    y = height - 1 - t;
+            }
+
+            if(bitmap[y*(width*2)+x])
+                col_data |= (1 << i);
+
+            if(!greyscale)
+                continue;
+
+            // In greyscale, each bit of a pixel's brightness contributes the time of its bit plane.
+            uint8_t level = min(bitmap[y*(width*2)+x], brightness);
+
+            onTime[i] = 0;
+
+            for (int bit = 0; bit < MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH; bit++)
+                if(level & (1 << bit))
+                    onTime[i] += greyScaleTimings[bit];
         }
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
+        // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
+        rowPatterns[row] = (~col_data << matrixMap.columnStart & col_mask) | row_data;
+
+        if(!greyscale)
+            continue;
+
+        // Light every pixel with a non-zero brightness, then turn them off in order of their on time.
+        uint32_t *patterns = &greyscalePatterns[row * (matrixMap.columns + 1)];
+        uint16_t *delays = &greyscaleDelays[row * (matrixMap.columns + 1)];
+        uint16_t elapsed = 0;
+        uint32_t lit = 0;
+        int step = 0;
+
+        for (int i = 0; i < matrixMap.columns; i++)
+            if(onTime[i])
+                lit |= (1 << i);
+
+        while (true)
         {
-                x = y;
-                y = height - 1 - t;
-        }
+            uint16_t next = 0xFFFF;
+
+            patterns[step] = (~lit << matrixMap.columnStart & col_mask) | row_data;
+
+            if(lit == 0)
+            {
+                delays[step] = 0;
+                break;
+            }
+
+            for (int i = 0; i < matrixMap.columns; i++)
+                if((lit & (1 << i)) && onTime[i] < next)
+                    next = onTime[i];
+
+            // The render timer can't fire sooner than its latency, so any pixels due to be turned off before then
+            // are turned off together, at the first time it can.
+            if(next < elapsed + MICROBIT_DISPLAY_TIMER_LATENCY_US)
+                next = elapsed + MICROBIT_DISPLAY_TIMER_LATENCY_US;
+
+            for (int i = 0; i < matrixMap.columns; i++)
+                if(onTime[i] <= next)
+                    lit &= ~(1 << i);
 
-        if(image.getBitmap()[y*(width*2)+x])
-            col_data |= (1 << i);
+            delays[step++] = next - elapsed;
+            elapsed = next;
+        }
     }
+}
 
-    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
-    col_data = ~col_data << matrixMap.columnStart & col_mask;
+void MicroBitDisplay::render()
+{
+    // Simple optimisation.
+    // If display is at zero brightness, there's nothing to do.
+    if(brightness == 0)
+        return;
 
-    // Write the new bit pattern
-    *LEDMatrix = col_data | row_data;
+    updateRowPatterns();
+
+    // Write the precomputed bit pattern. There's no row to light during the light sensing frame.
+    *LEDMatrix = strobeRow < matrixMap.rows ? rowPatterns[strobeRow] : 0;
 
     //timer does not have enough resolution for brightness of 1. 23.53 us
     if(brightness != MICROBIT_DISPLAY_MAXIMUM_BRIGHTNESS && brightness > MICROBIT_DISPLAY_MINIMUM_BRIGHTNESS)
@@ -208,58 +294,20 @@ void MicroBitDisplay::renderWithLightSense()
 
 void MicroBitDisplay::renderGreyscale()
 {
-    uint32_t row_data = 0x01 << (matrixMap.rowStart + strobeRow);
-    uint32_t col_data = 0;
-
-    // Calculate the bitpattern to write.
-    for (int i = 0; i < matrixMap.columns; i++)
-    {
-        int index = (i * matrixMap.rows) + strobeRow;
+    if(greyscaleStep == 0)
+        updateRowPatterns();
 
-        int x = matrixMap.map[index].x;
-        int y = matrixMap.map[index].y;
-        int t = x;
+    int index = strobeRow * (matrixMap.columns + 1) + greyscaleStep;
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_90)
-        {
-                x = width - 1 - y;
-                y = t;
-        }
+    // Write the precomputed bit pattern.
+    *LEDMatrix = greyscalePatterns[index];
 
-        if(rotation == MICROBIT_DISPLAY_ROTATION_180)
-        {
-                x = width - 1 - x;
-                y = height - 1 - y;
-        }
-
-        if(rotation == MICROBIT_DISPLAY_ROTATION_270)
-        {
-                x = y;
-                y = height - 1 - t;
-        }
-
-        if(min(image.getBitmap()[y * (width * 2) + x],brightness) & greyscaleBitMsk)
-            col_data |= (1 << i);
-    }
-
-    // Invert column bits (as we're sinking not sourcing power), and mask off any unused bits.
-    col_data = ~col_data << matrixMap.columnStart & col_mask;
-
-    // Write the new bit pattern
-    *LEDMatrix = col_data | row_data;
-
-    if(timingCount > MICROBIT_DISPLAY_GREYSCALE_BIT_DEPTH-1)
-        return;
-
-    greyscaleBitMsk <<= 1;
-
-    if(timingCount < 3)
+    // Schedule the next set of pixels to be turned off, if any remain lit.
+    if(greyscaleDelays[index])
     {
-        wait_us(greyScaleTimings[timingCount++]);
-        renderGreyscale();
-        return;
+        greyscaleStep++;
+        renderTimer.attach_us(this, &MicroBitDisplay::renderGreyscale, greyscaleDelays[index]);
     }
-    renderTimer.attach_us(this,&MicroBitDisplay::renderGreyscale, greyScaleTimings[timingCount++]);
 }
 
 /**
@@ -311,29 +359,74 @@ void MicroBitDisplay::sendAnimationCompleteEvent()
     MicroBitEvent(MICROBIT_ID_NOTIFY_ONE, MICROBIT_DISPLAY_EVT_FREE);
 }
 
+/**
+  * Renders the given string into the scrolling strip, preceded by the columns currently on
+  * the display, so that they scroll out as the text scrolls in.
+  *
+  * @param s The string to render.
+  */
+void MicroBitDisplay::renderScrollingStrip(ManagedString s)
+{
+    MicroBitFont font = MicroBitFont::getSystemFont();
+
+    int pitch = width + MICROBIT_DISPLAY_SPACING;
+    int start = width + MICROBIT_DISPLAY_SPACING + 1;
+
+    // The current image, then each character in turn, then a blank character so that the last one scrolls off.
+    delete[] scrollingStrip;
+
+    scrollingStripLength = start + pitch * (s.length() + 1);
+    scrollingStrip = new uint8_t[scrollingStripLength];
+    scrollingStripPosition = 0;
+
+    memclr(scrollingStrip, scrollingStripLength);
+
+    for (int x = 0; x < start; x++)
+        for (int y = 0; y < height; y++)
+            if (image.getPixelValue(x, y) > 0)
+                scrollingStrip[x] |= 1 << y;
+
+    // Only the visible columns are updated as we scroll, so clear the rest of the image now.
+    for (int x = width; x < image.getWidth(); x++)
+        for (int y = 0; y < height; y++)
+            image.setPixelValue(x, y, 0);
+
+    for (int i = 0; i < s.length(); i++)
+    {
+        char c = s.charAt(i);
+
+        if (c < MICROBIT_FONT_ASCII_START || c > font.asciiEnd)
+            continue;
+
+        const unsigned char *glyph = font.characters + (c - MICROBIT_FONT_ASCII_START) * 5;
+
+        for (int row = 0; row < MICROBIT_FONT_HEIGHT; row++)
+            for (int col = 0; col < MICROBIT_FONT_WIDTH; col++)
+                if (glyph[row] & (0x10 >> col))
+                    scrollingStrip[start + pitch * i + col] |= 1 << row;
+    }
+}
+
 /**
   * Internal scrollText update method.
-  * Shift the screen image by one pixel to the left. If necessary, paste in the next char.
+  * Shift the screen image by one pixel to the left, by copying the next window of the scrolling strip.
   */
 void MicroBitDisplay::updateScrollText()
 {
-    image.shiftLeft(1);
-    scrollingPosition++;
+    scrollingStripPosition++;
 
-    if (scrollingPosition == width + MICROBIT_DISPLAY_SPACING)
-    {
-        scrollingPosition = 0;
+    uint8_t *bitmap = image.getBitmap();
+    uint8_t *column = scrollingStrip + scrollingStripPosition;
 
-        image.print(scrollingChar < scrollingText.length() ? scrollingText.charAt(scrollingChar) : ' ',width,0);
+    for (int x = 0; x < width; x++)
+        for (int y = 0; y < height; y++)
+            bitmap[y * image.getWidth() + x] = (column[x] & (1 << y)) ? 255 : 0;
 
-        if (scrollingChar > scrollingText.length())
-        {
-            animationMode = ANIMATION_MODE_NONE;
-            this->sendAnimationCompleteEvent();
-            return;
-        }
-        scrollingChar++;
-   }
+    if (scrollingStripPosition == scrollingStripLength - width)
+    {
+        animationMode = ANIMATION_MODE_NONE;
+        this->sendAnimationCompleteEvent();
+    }
 }
 
 /**
@@ -734,9 +827,7 @@ int MicroBitDisplay::scrollAsync(ManagedString s, int delay)
     // If the display is free, it's our turn to display.
     if (animationMode == ANIMATION_MODE_NONE || animationMode == ANIMATION_MODE_STOPPED)
     {
-        scrollingPosition = width-1;
-        scrollingChar = 0;
-        scrollingText = s;
+        renderScrollingStrip(s);
 
         animationDelay = delay;
         animationTick = 0;
@@ -1010,6 +1101,7 @@ int MicroBitDisplay::setBrightness(int b)
         return MICROBIT_INVALID_PARAMETER;
 
     this->brightness = b;
+    this->rowPatternsSettled = false;
 
     return MICROBIT_OK;
 }
@@ -1079,6 +1171,7 @@ int MicroBitDisplay::getBrightness()
 void MicroBitDisplay::rotateTo(DisplayRotation rotation)
 {
     this->rotation = rotation;
+    this->rowPatternsSettled = false;
 }
 
 /**
@@ -1222,4 +1315,9 @@ int MicroBitDisplay::readLightLevel()
 MicroBitDisplay::~MicroBitDisplay()
 {
     system_timer_remove_component(this);
+
+    delete[] rowPatterns;
+    delete[] greyscalePatterns;
+    delete[] greyscaleDelays;
+    delete[] scrollingStrip;
 }
\ No newline at end of file
@@ -26,9 +26,30 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitConfig.h"
 #include "MicroBitI2C.h"
 #include "ErrorNo.h"
+#include "MicroBitEvent.h"
+#include "MicroBitFiber.h"
 #include "twi_master.h"
 #include "nrf_delay.h"
 
+#define MICROBIT_I2C_INTERRUPTS     (TWI_INTENSET_TXDSENT_Msk | TWI_INTENSET_RXDREADY_Msk | TWI_INTENSET_STOPPED_Msk | TWI_INTENSET_ERROR_Msk)
+
+MicroBitI2C* MicroBitI2C::instance = NULL;
+
+/*
+ * Queued transfers are driven entirely from this interrupt:
+ *
+ * Write: STARTTX(reg) -> TXDSENT (next byte, or STOP once all are sent) ... -> STOPPED (complete)
+ * Read:  STARTTX(reg) -> TXDSENT (repeated start: STARTRX) -> RXDREADY (store, RESUME) ... -> STOPPED (complete)
+ *
+ * During a read, the BB_SUSPEND shortcut holds the bus after each byte until it has been stored.
+ * The BB_STOP shortcut is used instead for the last byte, so the STOP condition follows it immediately.
+ */
+extern "C" void SPI0_TWI0_IRQHandler(void)
+{
+    if (MicroBitI2C::instance != NULL)
+        MicroBitI2C::instance->interruptHandler();
+}
+
 /**
   * Constructor.
   *
@@ -54,6 +75,79 @@ DEALINGS IN THE SOFTWARE.
 MicroBitI2C::MicroBitI2C(PinName sda, PinName scl) : I2C(sda,scl)
 {
     this->retries = 0;
+    this->status = 0;
+    this->index = 0;
+    this->sequence = 0;
+    this->head = NULL;
+    this->tail = NULL;
+    this->current = NULL;
+
+    // Interrupts are only enabled in the peripheral while queued transfers are in progress,
+    // so this does not disturb the blocking read() and write() operations.
+    instance = this;
+    NVIC_SetPriority(SPI0_TWI0_IRQn, MICROBIT_I2C_IRQ_PRIORITY);
+    NVIC_ClearPendingIRQ(SPI0_TWI0_IRQn);
+    NVIC_EnableIRQ(SPI0_TWI0_IRQn);
+}
+
+/**
+  * Applies the PAN56 workaround, by power cycling the TWI peripheral and clearing the bus.
+  */
+void MicroBitI2C::reset()
+{
+    _i2c.i2c->EVENTS_ERROR = 0;
+    _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
+    _i2c.i2c->POWER        = 0;
+    nrf_delay_us(5);
+    _i2c.i2c->POWER        = 1;
+    _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
+
+    twi_master_init_and_clear(NRF_TWI0);
+}
+
+/**
+  * Waits until the peripheral is idle, then prevents queued transfers from starting.
+  * Used to keep blocking operations from interleaving with queued ones.
+  *
+  * In interrupt context, queued transfers are completed by polling the peripheral, as the TWI interrupt
+  * cannot preempt the caller.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_BUSY if called from an interrupt handler that has
+  *         interrupted a blocking read or write.
+  */
+int MicroBitI2C::lock()
+{
+    while (true)
+    {
+        __disable_irq();
+
+        if (current == NULL && !(status & MICROBIT_I2C_STATUS_LOCKED))
+        {
+            status |= MICROBIT_I2C_STATUS_LOCKED;
+            __enable_irq();
+            return MICROBIT_OK;
+        }
+
+        __enable_irq();
+
+        if (__get_IPSR() != 0)
+        {
+            // A blocking transfer we have interrupted cannot complete until we return.
+            if (status & MICROBIT_I2C_STATUS_LOCKED)
+                return MICROBIT_BUSY;
+
+            interruptHandler();
+        }
+    }
+}
+
+/**
+  * Allows queued transfers to start again.
+  */
+void MicroBitI2C::unlock()
+{
+    status &= ~MICROBIT_I2C_STATUS_LOCKED;
+    start();
 }
 
 /**
@@ -67,26 +161,26 @@ MicroBitI2C::MicroBitI2C(PinName sda, PinName scl) : I2C(sda,scl)
   *
   * @param repeated if true, stop is not sent at the end. Defaults to false.
   *
-  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved read failure is detected.
+  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved read failure is detected, or MICROBIT_BUSY
+  *         if called from an interrupt handler that has interrupted another read or write.
   */
 int MicroBitI2C::read(int address, char *data, int length, bool repeated)
 {
+    if (lock() != MICROBIT_OK)
+        return MICROBIT_BUSY;
+
     int result = I2C::read(address,data,length,repeated);
 
     //0 indicates a success, presume failure
     while(result != 0 && retries < MICROBIT_I2C_MAX_RETRIES)
     {
-        _i2c.i2c->EVENTS_ERROR = 0;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
-        _i2c.i2c->POWER        = 0;
-        nrf_delay_us(5);
-        _i2c.i2c->POWER        = 1;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
-        twi_master_init_and_clear(NRF_TWI0);
+        reset();
         result = I2C::read(address,data,length,repeated);
         retries++;
     }
 
+    unlock();
+
     if(result != 0)
         return MICROBIT_I2C_ERROR;
 
@@ -105,30 +199,404 @@ int MicroBitI2C::read(int address, char *data, int length, bool repeated)
   *
   * @param repeated if true, stop is not sent at the end. Defaults to false.
   *
-  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved write failure is detected.
+  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved write failure is detected, or MICROBIT_BUSY
+  *         if called from an interrupt handler that has interrupted another read or write.
   */
 int MicroBitI2C::write(int address, const char *data, int length, bool repeated)
 {
+    if (lock() != MICROBIT_OK)
+        return MICROBIT_BUSY;
+
     int result = I2C::write(address,data,length,repeated);
 
     //0 indicates a success, presume failure
     while(result != 0 && retries < MICROBIT_I2C_MAX_RETRIES)
     {
-        _i2c.i2c->EVENTS_ERROR = 0;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
-        _i2c.i2c->POWER        = 0;
-        nrf_delay_us(5);
-        _i2c.i2c->POWER        = 1;
-        _i2c.i2c->ENABLE       = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
-
-        twi_master_init_and_clear(NRF_TWI0);
+        reset();
         result = I2C::write(address,data,length,repeated);
         retries++;
     }
 
+    unlock();
+
     if(result != 0)
         return MICROBIT_I2C_ERROR;
 
     retries = 0;
     return MICROBIT_OK;
 }
+
+/**
+  * Starts the transfer at the head of the queue, unless the peripheral is busy or locked.
+  */
+void MicroBitI2C::start()
+{
+    __disable_irq();
+
+    if (current == NULL && head != NULL && !(status & MICROBIT_I2C_STATUS_LOCKED))
+        begin(head);
+
+    __enable_irq();
+}
+
+/**
+  * Programs the peripheral to perform the given transfer from the beginning.
+  *
+  * @param t The transfer to perform.
+  */
+void MicroBitI2C::begin(MicroBitI2CTransfer *t)
+{
+    NRF_TWI_Type *twi = _i2c.i2c;
+
+    current = t;
+    index = 0;
+
+    twi->EVENTS_TXDSENT = 0;
+    twi->EVENTS_RXDREADY = 0;
+    twi->EVENTS_STOPPED = 0;
+    twi->EVENTS_ERROR = 0;
+    twi->SHORTS = 0;
+
+    twi->ADDRESS = t->address >> 1;
+    twi->INTENSET = MICROBIT_I2C_INTERRUPTS;
+
+    // Every transfer begins by writing the register address.
+    twi->TXD = t->reg;
+    twi->TASKS_STARTTX = 1;
+}
+
+/**
+  * Removes the current transfer from the queue, reports its result, and starts the next one.
+  *
+  * @param result The status to report.
+  */
+void MicroBitI2C::complete(int result)
+{
+    MicroBitI2CTransfer *t = current;
+
+    head = t->next;
+    if (head == NULL)
+    {
+        tail = NULL;
+        _i2c.i2c->INTENCLR = MICROBIT_I2C_INTERRUPTS;
+    }
+
+    current = NULL;
+
+    // Take what we need from the transfer before releasing it, as its owner may reuse it as soon as the status changes.
+    void (*callback)(MicroBitI2CTransfer *) = t->callback;
+    bool wake = t->flags & MICROBIT_I2C_TRANSFER_WAKE;
+    uint16_t event = t->event;
+
+    t->next = NULL;
+    t->status = result;
+
+    if (callback != NULL)
+        callback(t);
+
+    if (wake)
+        MicroBitEvent(MICROBIT_ID_I2C, event);
+
+    start();
+}
+
+/**
+  * Advances the transfer in progress. Called by the TWI interrupt handler.
+  */
+void MicroBitI2C::interruptHandler()
+{
+    NRF_TWI_Type *twi = _i2c.i2c;
+    MicroBitI2CTransfer *t = current;
+
+    if (t == NULL)
+    {
+        twi->INTENCLR = MICROBIT_I2C_INTERRUPTS;
+        return;
+    }
+
+    if (twi->EVENTS_ERROR)
+    {
+        twi->EVENTS_ERROR = 0;
+        twi->ERRORSRC = twi->ERRORSRC;
+
+        // Recover the peripheral, and either try again or give up.
+        reset();
+
+        if (t->retries < MICROBIT_I2C_MAX_RETRIES)
+        {
+            t->retries++;
+            begin(t);
+        }
+        else
+        {
+            complete(MICROBIT_I2C_ERROR);
+        }
+
+        return;
+    }
+
+    if (twi->EVENTS_TXDSENT)
+    {
+        twi->EVENTS_TXDSENT = 0;
+
+        if (t->flags & MICROBIT_I2C_TRANSFER_READ)
+        {
+            // The register address has been sent, so issue a repeated start and begin reading.
+            twi->SHORTS = t->length == 1 ? TWI_SHORTS_BB_STOP_Msk : TWI_SHORTS_BB_SUSPEND_Msk;
+            twi->TASKS_STARTRX = 1;
+        }
+        else if (index < t->length)
+        {
+            twi->TXD = t->data[index++];
+        }
+        else
+        {
+            twi->TASKS_STOP = 1;
+        }
+    }
+
+    if (twi->EVENTS_RXDREADY)
+    {
+        twi->EVENTS_RXDREADY = 0;
+
+        t->data[index++] = twi->RXD;
+
+        if (index == t->length - 1)
+            twi->SHORTS = TWI_SHORTS_BB_STOP_Msk;
+
+        if (index < t->length)
+            twi->TASKS_RESUME = 1;
+    }
+
+    if (twi->EVENTS_STOPPED)
+    {
+        twi->EVENTS_STOPPED = 0;
+        twi->SHORTS = 0;
+
+        complete(MICROBIT_OK);
+    }
+}
+
+/**
+  * Checks that a transfer is idle, and describes a valid transfer.
+  *
+  * @param t The transfer to check.
+  *
+  * @return MICROBIT_OK if the transfer can be queued, MICROBIT_BUSY if it is already queued,
+  *         or MICROBIT_INVALID_PARAMETER if it does not describe a valid transfer.
+  */
+int MicroBitI2C::validate(MicroBitI2CTransfer &t)
+{
+    if (t.status == MICROBIT_BUSY)
+        return MICROBIT_BUSY;
+
+    if ((t.length > 0 && t.data == NULL) || ((t.flags & MICROBIT_I2C_TRANSFER_READ) && t.length == 0))
+        return MICROBIT_INVALID_PARAMETER;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Adds a transfer to the queue, and returns without waiting for it to complete.
+  *
+  * The status of the transfer reads MICROBIT_BUSY until it completes. Its callback, if any, is then
+  * called in interrupt context. The transfer and its data buffer must remain valid until then.
+  *
+  * @param t The transfer to perform.
+  *
+  * @return MICROBIT_OK if the transfer was queued, MICROBIT_BUSY if it is already queued,
+  *         or MICROBIT_INVALID_PARAMETER if it does not describe a valid transfer.
+  *
+  * @code
+  * MicroBitI2CTransfer t;
+  *
+  * t.address = 0x1D << 1;
+  * t.reg = 0x01;
+  * t.flags = MICROBIT_I2C_TRANSFER_READ;
+  * t.length = 6;
+  * t.data = buffer;
+  *
+  * i2c.queue(t);
+  * @endcode
+  */
+int MicroBitI2C::queue(MicroBitI2CTransfer &t)
+{
+    int result = validate(t);
+
+    if (result != MICROBIT_OK)
+        return result;
+
+    t.next = NULL;
+    t.retries = 0;
+    t.status = MICROBIT_BUSY;
+
+    __disable_irq();
+
+    if (tail == NULL)
+        head = &t;
+    else
+        tail->next = &t;
+
+    tail = &t;
+
+    __enable_irq();
+
+    start();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Adds a transfer to the queue, and waits for it to complete.
+  *
+  * If the scheduler is running, the calling fiber sleeps while the transfer is in progress. Otherwise the processor
+  * spins until it completes. In interrupt context, where the TWI interrupt cannot preempt the caller, the peripheral
+  * is polled instead, completing any transfers queued ahead of this one.
+  *
+  * @param t The transfer to perform.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_I2C_ERROR if an unresolved bus failure is detected,
+  *         MICROBIT_BUSY if the transfer is already queued (or if called from an interrupt handler that has
+  *         interrupted a blocking read or write), MICROBIT_NO_RESOURCES if there is not enough memory to hold a copy
+  *         of the transfer, or MICROBIT_INVALID_PARAMETER if it does not describe a valid transfer.
+  *
+  * @note Outside of interrupt context, a copy of the transfer and its data is queued, so both may be on the caller's stack.
+  *       This must not be called from an idle tick, as the idle thread cannot sleep.
+  */
+int MicroBitI2C::transfer(MicroBitI2CTransfer &t)
+{
+    int result = validate(t);
+
+    if (result != MICROBIT_OK)
+        return result;
+
+    t.flags &= ~MICROBIT_I2C_TRANSFER_WAKE;
+
+    // The TWI interrupt has the lowest priority, so cannot preempt an interrupt handler. Drive the peripheral from here instead.
+    if (__get_IPSR() != 0)
+    {
+        // A blocking transfer we have interrupted cannot complete until we return.
+        if (status & MICROBIT_I2C_STATUS_LOCKED)
+            return MICROBIT_BUSY;
+
+        queue(t);
+
+        while (t.status == MICROBIT_BUSY)
+            interruptHandler();
+
+        return t.status;
+    }
+
+    // Fibers share a single stack, which is paged out whilst they sleep, so a transfer (and its data) on the caller's
+    // stack would not be there for the interrupt handler. Perform a copy instead, in memory that stays put.
+    MicroBitI2CTransfer *copy = (MicroBitI2CTransfer *) malloc(sizeof(MicroBitI2CTransfer) + t.length);
+
+    if (copy == NULL)
+        return MICROBIT_NO_RESOURCES;
+
+    *copy = t;
+    copy->data = (uint8_t *)(copy + 1);
+
+    if (!(t.flags & MICROBIT_I2C_TRANSFER_READ))
+        memcpy(copy->data, t.data, t.length);
+
+    // Register interest in the completion event before the transfer is queued, so it cannot be missed.
+    if (fiber_scheduler_running())
+    {
+        if (++sequence == MICROBIT_EVT_ANY)
+            sequence++;
+
+        copy->event = sequence;
+
+        if (fiber_wake_on_event(MICROBIT_ID_I2C, copy->event) == MICROBIT_OK)
+            copy->flags |= MICROBIT_I2C_TRANSFER_WAKE;
+    }
+
+    queue(*copy);
+
+    if (copy->flags & MICROBIT_I2C_TRANSFER_WAKE)
+        schedule();
+
+    // Spin if we could not sleep.
+    while (copy->status == MICROBIT_BUSY);
+
+    if ((t.flags & MICROBIT_I2C_TRANSFER_READ) && copy->status == MICROBIT_OK)
+        memcpy(t.data, copy->data, t.length);
+
+    result = copy->status;
+    t.status = result;
+    free(copy);
+
+    return result;
+}
+
+/**
+  * Reads a block of consecutive registers from a device, in a single transaction.
+  *
+  * @param address 8-bit I2C slave address [ addr | 0 ]
+  *
+  * @param reg The first register to read.
+  *
+  * @param data A pointer to a byte buffer used for storing retrieved data.
+  *
+  * @param length Number of bytes to read, between 1 and 255.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the read request failed.
+  *
+  * @note As transfer(), this puts the calling fiber to sleep until the read is complete.
+  */
+int MicroBitI2C::readRegister(uint8_t address, uint8_t reg, uint8_t *data, int length)
+{
+    MicroBitI2CTransfer t;
+
+    if (data == NULL || length <= 0 || length > 255)
+        return MICROBIT_INVALID_PARAMETER;
+
+    t.address = address;
+    t.reg = reg;
+    t.data = data;
+    t.length = length;
+    t.flags = MICROBIT_I2C_TRANSFER_READ;
+
+    return transfer(t);
+}
+
+/**
+  * Writes a block of consecutive registers on a device, in a single transaction.
+  *
+  * @param address 8-bit I2C slave address [ addr | 0 ]
+  *
+  * @param reg The first register to write.
+  *
+  * @param data A pointer to a byte buffer containing the data to write.
+  *
+  * @param length Number of bytes to write, between 0 and 255.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER or MICROBIT_I2C_ERROR if the write request failed.
+  *
+  * @note As transfer(), this puts the calling fiber to sleep until the write is complete.
+  */
+int MicroBitI2C::writeRegister(uint8_t address, uint8_t reg, const uint8_t *data, int length)
+{
+    MicroBitI2CTransfer t;
+
+    if ((data == NULL && length > 0) || length < 0 || length > 255)
+        return MICROBIT_INVALID_PARAMETER;
+
+    t.address = address;
+    t.reg = reg;
+    t.data = (uint8_t *)data;
+    t.length = length;
+
+    return transfer(t);
+}
+
+/**
+  * Determines if any queued transfers have yet to complete.
+  *
+  * @return true if the queue is not empty, false otherwise.
+  */
+bool MicroBitI2C::isBusy()
+{
+    return head != NULL;
+}
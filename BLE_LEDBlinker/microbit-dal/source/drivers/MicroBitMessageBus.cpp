@@ -61,9 +61,13 @@ DEALINGS IN THE SOFTWARE.
 MicroBitMessageBus::MicroBitMessageBus()
 {
 	this->listeners = NULL;
-    this->evt_queue_head = NULL;
-    this->evt_queue_tail = NULL;
+    this->listenerIndex = NULL;
+    this->listenerIndexSize = 0;
+    this->listenerIndexCapacity = 0;
+    this->evt_queue_head = 0;
     this->queueLength = 0;
+    this->queueCount = 0;
+    this->droppedEvents = 0;
 
 	fiber_add_idle_component(this);
 
@@ -150,7 +154,7 @@ void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
 {
     int processingComplete;
 
-    MicroBitEventQueueItem *prev = evt_queue_tail;
+    uint16_t count = queueCount;
 
     // Now process all handler regsitered as URGENT.
     // These pre-empt the queue, and are useful for fast, high priority services.
@@ -161,34 +165,39 @@ void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
     if (processingComplete)
         return;
 
-    // If we need to queue, but there is no space, then there's nothg we can do.
+    __disable_irq();
+
+    // If we need to queue, but there is no space, then there's nothing we can do but record the fact.
     if (queueLength >= MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH)
+    {
+        droppedEvents++;
+        __enable_irq();
         return;
+    }
 
     // Otherwise, we need to queue this event for later processing...
     // We queue this event at the tail of the queue at the point where we entered queueEvent()
     // This is important as the processing above *may* have generated further events, and
-    // we want to maintain ordering of events.
-    MicroBitEventQueueItem *item = new MicroBitEventQueueItem(evt);
+    // we want to maintain ordering of events. Any such events are at the tail of the queue (unless they have
+    // already been processed), so we shuffle them along by one to make room.
+    uint16_t later = (uint16_t)(queueCount - count);
 
-    // The queue was empty when we entered this function, so queue our event at the start of the queue.
-    __disable_irq();
+    if (later > queueLength)
+        later = queueLength;
 
-    if (prev == NULL)
-    {
-        item->next = evt_queue_head;
-        evt_queue_head = item;
-    }
-    else
+    int i = evt_queue_head + queueLength;
+
+    while (later--)
     {
-        item->next = prev->next;
-        prev->next = item;
+        int j = i - 1;
+        evt_queue[i % MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH] = evt_queue[j % MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH];
+        i = j;
     }
 
-    if (item->next == NULL)
-        evt_queue_tail = item;
+    evt_queue[i % MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH] = evt;
 
     queueLength++;
+    queueCount++;
 
     __enable_irq();
 }
@@ -196,29 +205,69 @@ void MicroBitMessageBus::queueEvent(MicroBitEvent &evt)
 /**
   * Extract the next event from the front of the event queue (if present).
   *
-  * @return a pointer to the MicroBitEventQueueItem that is at the head of the list.
+  * @param evt The MicroBitEvent to store the event in.
+  *
+  * @return 1 if an event was extracted, 0 if the queue is empty.
   */
-MicroBitEventQueueItem* MicroBitMessageBus::dequeueEvent()
+int MicroBitMessageBus::dequeueEvent(MicroBitEvent &evt)
 {
-    MicroBitEventQueueItem *item = NULL;
+    int result = 0;
 
     __disable_irq();
 
-    if (evt_queue_head != NULL)
+    if (queueLength > 0)
     {
-        item = evt_queue_head;
-        evt_queue_head = item->next;
-
-        if (evt_queue_head == NULL)
-            evt_queue_tail = NULL;
+        evt = evt_queue[evt_queue_head];
+        evt_queue_head = (evt_queue_head + 1) % MESSAGE_BUS_LISTENER_MAX_QUEUE_DEPTH;
 
         queueLength--;
+        result = 1;
     }
 
     __enable_irq();
 
+    return result;
+}
+
+/**
+  * Determines if the given listener is marked for deletion, and is not running, so can be deleted.
+  */
+static inline bool listener_removable(MicroBitListener *l)
+{
+    return (l->flags & MESSAGE_BUS_LISTENER_DELETING) && !(l->flags & MESSAGE_BUS_LISTENER_BUSY);
+}
+
+/**
+  * Counts the distinct IDs in a chain of listeners, optionally recording the first listener for each in an index.
+  * Wildcard listeners (which always lead the chain) and listeners that are about to be deleted are left out.
+  *
+  * @param l The chain of listeners, sorted by ID.
+  *
+  * @param index The index to fill in, or NULL to simply count the IDs.
+  *
+  * @return The number of distinct IDs.
+  */
+static int index_listeners(MicroBitListener *l, MicroBitListenerIndexEntry *index)
+{
+    uint16_t last = MICROBIT_ID_ANY;
+    int size = 0;
+
+    for (; l != NULL; l = l->next)
+    {
+        if (l->id == last || listener_removable(l))
+            continue;
+
+        if (index != NULL)
+        {
+            index[size].id = l->id;
+            index[size].first = l;
+        }
+
+        last = l->id;
+        size++;
+    }
 
-    return item;
+    return size;
 }
 
 /**
@@ -229,27 +278,38 @@ MicroBitEventQueueItem* MicroBitMessageBus::dequeueEvent()
 int MicroBitMessageBus::deleteMarkedListeners()
 {
 	MicroBitListener *l, *p;
+    MicroBitListener *garbage = NULL;
     int removed = 0;
 
+    for (l = listeners; l != NULL; l = l->next)
+        if (listener_removable(l))
+            removed++;
+
+    if (removed == 0)
+        return 0;
+
+    // The index is used from interrupt context, so take the listeners out of it before they are unlinked.
+    // Nothing then refers to a listener once it has been unlinked, and it can safely be moved onto the garbage chain.
+    rebuildListenerIndex();
+
 	l = listeners;
 	p = NULL;
 
     // Walk this list of event handlers. Delete any that match the given listener.
     while (l != NULL)
     {
-        if ((l->flags & MESSAGE_BUS_LISTENER_DELETING) && !(l->flags & MESSAGE_BUS_LISTENER_BUSY))
+        if (listener_removable(l))
         {
-            if (p == NULL)
-                listeners = l->next;
-            else
-                p->next = l->next;
-
-            // delete the listener.
             MicroBitListener *t = l;
             l = l->next;
 
-            delete t;
-            removed++;
+            if (p == NULL)
+                listeners = l;
+            else
+                p->next = l;
+
+            t->next = garbage;
+            garbage = t;
 
             continue;
         }
@@ -258,9 +318,89 @@ int MicroBitMessageBus::deleteMarkedListeners()
         l = l->next;
     }
 
+    // delete the listeners.
+    while (garbage != NULL)
+    {
+        MicroBitListener *t = garbage;
+        garbage = garbage->next;
+
+        delete t;
+    }
+
     return removed;
 }
 
+/**
+  * Rebuilds the listener index from the chain of active listeners.
+  * Called whenever listeners are added to or removed from the chain.
+  *
+  * The index only grows, doubling in size as needed, so it is rarely reallocated as listeners are added.
+  */
+void MicroBitMessageBus::rebuildListenerIndex()
+{
+    int size = index_listeners(listeners, NULL);
+
+    if (size <= listenerIndexCapacity)
+    {
+        // Update the index in place. It may be in use from interrupt context, so lock interrupts out whilst it changes.
+        __disable_irq();
+
+        index_listeners(listeners, listenerIndex);
+        listenerIndexSize = size;
+
+        __enable_irq();
+
+        return;
+    }
+
+    int capacity = max(size, max(4, 2 * listenerIndexCapacity));
+    MicroBitListenerIndexEntry *index = new MicroBitListenerIndexEntry[capacity];
+    MicroBitListenerIndexEntry *oldIndex;
+
+    index_listeners(listeners, index);
+
+    // Swap in the new index atomically.
+    __disable_irq();
+
+    oldIndex = listenerIndex;
+    listenerIndex = index;
+    listenerIndexSize = size;
+    listenerIndexCapacity = capacity;
+
+    __enable_irq();
+
+    delete[] oldIndex;
+}
+
+/**
+  * Determines the first listener in the chain registered for the given ID.
+  *
+  * @param id The ID to look up. Must not be MICROBIT_ID_ANY.
+  *
+  * @return The first MicroBitListener registered for the given ID, or NULL if there are none.
+  */
+MicroBitListener *MicroBitMessageBus::findListeners(uint16_t id)
+{
+    int low = 0;
+    int high = listenerIndexSize - 1;
+
+    // Binary search of the index, which is held in increasing order of ID.
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+
+        if (listenerIndex[mid].id == id)
+            return listenerIndex[mid].first;
+
+        if (listenerIndex[mid].id < id)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return NULL;
+}
+
 /**
   * Periodic callback from MicroBit.
   *
@@ -272,25 +412,19 @@ void MicroBitMessageBus::idleTick()
     // Clear out any listeners marked for deletion
     this->deleteMarkedListeners();
 
-    MicroBitEventQueueItem *item = this->dequeueEvent();
+    MicroBitEvent evt(MICROBIT_ID_ANY, MICROBIT_EVT_ANY, CREATE_ONLY);
 
     // Whilst there are events to process and we have no useful other work to do, pull them off the queue and process them.
-    while (item)
+    while (this->dequeueEvent(evt))
     {
         // send the event to all standard event listeners.
-        this->process(item->evt);
-
-        // Free the queue item.
-        delete item;
+        this->process(evt);
 
         // If we have created some useful work to do, we stop processing.
         // This helps to minimise the number of blocked fibers we create at any point in time, therefore
         // also reducing the RAM footprint.
         if(!scheduler_runqueue_empty())
             break;
-
-        // Pull the next event to process, if there is one.
-        item = this->dequeueEvent();
     }
 }
 
@@ -339,14 +473,44 @@ int MicroBitMessageBus::send(MicroBitEvent evt)
   */
 int MicroBitMessageBus::process(MicroBitEvent &evt, bool urgent)
 {
-	MicroBitListener *l;
+    int complete = 1;
+
+    // Listeners for MICROBIT_ID_ANY always lead the chain, as it is held in increasing order of ID.
+    // These are processed first, to preserve the ordering of the chain.
+    if (listeners != NULL && listeners->id == MICROBIT_ID_ANY)
+        complete &= processListeners(listeners, evt, urgent);
+
+    // Then use the index to jump straight to the listeners registered for this event's ID.
+    if (evt.source != MICROBIT_ID_ANY)
+        complete &= processListeners(findListeners(evt.source), evt, urgent);
+
+    return complete;
+}
+
+/**
+  * Delivers the given event to the run of listeners starting at l that share the same ID.
+  *
+  * @param l The first listener in the run.
+  *
+  * @param evt The event to deliver.
+  *
+  * @param urgent The type of listeners to process.
+  *
+  * @return 1 if all matching listeners were processed, 0 if further processing is required.
+  */
+int MicroBitMessageBus::processListeners(MicroBitListener *l, MicroBitEvent &evt, bool urgent)
+{
     int complete = 1;
     bool listenerUrgent;
 
-    l = listeners;
-    while (l != NULL)
+    if (l == NULL)
+        return complete;
+
+    uint16_t id = l->id;
+
+    while (l != NULL && l->id == id)
     {
-	    if((l->id == evt.source || l->id == MICROBIT_ID_ANY) && (l->value == evt.value || l->value == MICROBIT_EVT_ANY))
+	    if(l->value == evt.value || l->value == MICROBIT_EVT_ANY)
         {
             // If we're running under the fiber scheduler, then derive the THREADING_MODE for the callback based on the
             // metadata in the listener itself.
@@ -428,6 +592,8 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
 	if (listeners == NULL)
 	{
 		listeners = newListener;
+        rebuildListenerIndex();
+
         MicroBitEvent(MICROBIT_ID_MESSAGE_BUS_LISTENER, newListener->id);
 
 		return MICROBIT_OK;
@@ -469,6 +635,8 @@ int MicroBitMessageBus::add(MicroBitListener *newListener)
 		p->next = newListener;
 	}
 
+    rebuildListenerIndex();
+
     MicroBitEvent(MICROBIT_ID_MESSAGE_BUS_LISTENER, newListener->id);
     return MICROBIT_OK;
 }
@@ -540,10 +708,22 @@ MicroBitListener* MicroBitMessageBus::elementAt(int n)
     return l;
 }
 
+/**
+  * Determines the number of events that have been dropped because the event queue was full.
+  *
+  * @return The number of events dropped since this MicroBitMessageBus was created.
+  */
+uint32_t MicroBitMessageBus::getDroppedEventCount()
+{
+    return droppedEvents;
+}
+
 /**
   * Destructor for MicroBitMessageBus, where we deregister this instance from the array of fiber components.
   */
 MicroBitMessageBus::~MicroBitMessageBus()
 {
     fiber_remove_idle_component(this);
+
+    delete[] listenerIndex;
 }
\ No newline at end of file
@@ -31,6 +31,7 @@ DEALINGS IN THE SOFTWARE.
 #include "ErrorNo.h"
 #include "MicroBitFiber.h"
 #include "MicroBitBLEManager.h"
+#include "us_ticker_api.h"
 
 /**
   * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -57,41 +58,78 @@ DEALINGS IN THE SOFTWARE.
 
 MicroBitRadio* MicroBitRadio::instance = NULL;
 
+/*
+ * The RADIO module is driven entirely from this interrupt, using the hardware SHORTS to chain
+ * the steps of each operation together without software intervention:
+ *
+ * Receive:  RXEN -> READY -(short)-> START -> END (interrupt: store the packet, START again)
+ * Transmit: TXEN -> READY -(short)-> START -> END -(short)-> DISABLE -> DISABLED (interrupt)
+ *
+ * Whenever the radio is DISABLED, either because send() stopped the receiver or because a transmission
+ * has just completed, the next packet in the transmit queue is sent. When the queue is empty, the radio
+ * returns to listening. Back to back packets are therefore sent without returning to receive mode in between.
+ */
 extern "C" void RADIO_IRQHandler(void)
 {
-    if(NRF_RADIO->EVENTS_READY)
-    {
-        NRF_RADIO->EVENTS_READY = 0;
-
-        // Start listening and wait for the END event
-        NRF_RADIO->TASKS_START = 1;
-    }
-
     if(NRF_RADIO->EVENTS_END)
     {
         NRF_RADIO->EVENTS_END = 0;
-        if(NRF_RADIO->CRCSTATUS == 1)
+
+        if(MicroBitRadio::instance->isTransmitting())
+        {
+            // The packet has been sent, and the transmitter is already being turned off.
+            // We'll decide what to do next when the DISABLED event arrives.
+            MicroBitRadio::instance->endTx();
+        }
+        else
         {
-            uint8_t sample = NRF_RADIO->RSSISAMPLE;
+            if(NRF_RADIO->CRCSTATUS == 1)
+            {
+                uint8_t sample = NRF_RADIO->RSSISAMPLE;
+
+                // Associate this packet's rssi value with the data just
+                // transferred by DMA receive
+                MicroBitRadio::instance->setRSSI(sample);
+
+                // Now move on to the next buffer, if possible.
+                // The queued packet will get the rssi value set above.
+                MicroBitRadio::instance->queueRxBuf();
+
+                // Set the new buffer for DMA
+                NRF_RADIO->PACKETPTR = (uint32_t) MicroBitRadio::instance->getRxBuf();
+            }
+            else
+            {
+                MicroBitRadio::instance->setRSSI(0);
+            }
+
+            // Start listening and wait for the END event, unless the receiver is being turned off to send a packet.
+            if(MicroBitRadio::instance->getTxQueueDepth() == 0)
+                NRF_RADIO->TASKS_START = 1;
+        }
+    }
 
-            // Associate this packet's rssi value with the data just
-            // transferred by DMA receive
-            MicroBitRadio::instance->setRSSI(sample);
+    if(NRF_RADIO->EVENTS_DISABLED)
+    {
+        NRF_RADIO->EVENTS_DISABLED = 0;
 
-            // Now move on to the next buffer, if possible.
-            // The queued packet will get the rssi value set above.
-            MicroBitRadio::instance->queueRxBuf();
+        FrameBuffer *p = MicroBitRadio::instance->beginTx();
 
-            // Set the new buffer for DMA
-            NRF_RADIO->PACKETPTR = (uint32_t) MicroBitRadio::instance->getRxBuf();
+        if(p != NULL)
+        {
+            // Send the next packet. The transmission starts as soon as the transmitter is ready,
+            // and the transmitter is turned off again as soon as the packet is complete.
+            NRF_RADIO->PACKETPTR = (uint32_t) p;
+            NRF_RADIO->SHORTS = RADIO_SHORTS_READY_START_Msk | RADIO_SHORTS_END_DISABLE_Msk;
+            NRF_RADIO->TASKS_TXEN = 1;
         }
         else
         {
-            MicroBitRadio::instance->setRSSI(0);
+            // Nothing left to send, so start listening for the next packet.
+            NRF_RADIO->PACKETPTR = (uint32_t) MicroBitRadio::instance->getRxBuf();
+            NRF_RADIO->SHORTS = RADIO_SHORTS_READY_START_Msk | RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
+            NRF_RADIO->TASKS_RXEN = 1;
         }
-
-        // Start listening and wait for the END event
-        NRF_RADIO->TASKS_START = 1;
     }
 }
 
@@ -108,10 +146,17 @@ MicroBitRadio::MicroBitRadio(uint16_t id) : datagram(*this), event (*this)
     this->id = id;
     this->status = 0;
 	this->group = MICROBIT_RADIO_DEFAULT_GROUP;
-	this->queueDepth = 0;
     this->rssi = 0;
-    this->rxQueue = NULL;
-    this->rxBuf = NULL;
+    this->rxPool = NULL;
+    this->rxHead = 0;
+    this->rxTail = 0;
+    this->rxDropped = 0;
+    this->txPool = NULL;
+    this->txHead = 0;
+    this->txTail = 0;
+    this->txStartedAt = 0;
+
+    memset(&txStats, 0, sizeof(txStats));
 
     instance = this;
 }
@@ -162,53 +207,126 @@ int MicroBitRadio::setFrequencyBand(int band)
   */
 FrameBuffer* MicroBitRadio::getRxBuf()
 {
-    return rxBuf;
+    if (rxPool == NULL)
+        return NULL;
+
+    return &rxPool[rxHead];
 }
 
 /**
   * Attempt to queue a buffer received by the radio hardware, if sufficient space is available.
+  * This takes constant time, and allocates no memory, so is safe to call from the RADIO interrupt.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if a replacement receiver buffer
-  *         could not be allocated (either by policy or memory exhaustion).
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the receiver queue is full,
+  *         in which case the packet is dropped.
   */
 int MicroBitRadio::queueRxBuf()
 {
-    if (rxBuf == NULL)
+    if (rxPool == NULL)
         return MICROBIT_INVALID_PARAMETER;
 
-    if (queueDepth >= MICROBIT_RADIO_MAXIMUM_RX_BUFFERS)
+    uint8_t newHead = (rxHead + 1) % MICROBIT_RADIO_RX_POOL_SIZE;
+
+    // The buffer before the tail is the one last returned by recv(), and may still be in use.
+    // If that is the next one, the queue is full, so the hardware keeps (and overwrites) its current buffer.
+    if (newHead == (rxTail + MICROBIT_RADIO_RX_POOL_SIZE - 1) % MICROBIT_RADIO_RX_POOL_SIZE)
+    {
+        rxDropped++;
         return MICROBIT_NO_RESOURCES;
+    }
 
     // Store the received RSSI value in the frame
-    rxBuf->rssi = getRSSI();
+    rxPool[rxHead].rssi = getRSSI();
 
-    // Ensure that a replacement buffer is available before queuing.
-    FrameBuffer *newRxBuf = new FrameBuffer();
+    // Move the receiver hardware on to the next buffer. The old one will be passed on to higher layer protocols/apps.
+    rxHead = newHead;
 
-    if (newRxBuf == NULL)
-        return MICROBIT_NO_RESOURCES;
+    return MICROBIT_OK;
+}
 
-    // We add to the tail of the queue to preserve causal ordering.
-    rxBuf->next = NULL;
+/**
+  * Retrieve the packet at the front of the transmit queue, and record that the transmitter is in use.
+  *
+  * @return a pointer to the packet to transmit next, or NULL if the transmit queue is empty.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+FrameBuffer* MicroBitRadio::beginTx()
+{
+    if (txPool == NULL || txTail == txHead)
+        return NULL;
 
-    if (rxQueue == NULL)
-    {
-        rxQueue = rxBuf;
-    }
-    else
-    {
-        FrameBuffer *p = rxQueue;
-        while (p->next != NULL)
-            p = p->next;
+    status |= MICROBIT_RADIO_STATUS_TRANSMITTING;
+    txStartedAt = us_ticker_read();
 
-        p->next = rxBuf;
-    }
+    return &txPool[txTail];
+}
+
+/**
+  * Remove the packet just transmitted from the transmit queue, and record that the transmitter is idle.
+  * This takes constant time, and allocates no memory, so is safe to call from the RADIO interrupt.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if no transmission was in progress.
+  *
+  * @note should only be called from RADIO_IRQHandler...
+  */
+int MicroBitRadio::endTx()
+{
+    if (!(status & MICROBIT_RADIO_STATUS_TRANSMITTING))
+        return MICROBIT_NO_DATA;
 
-    // Increase our received packet count
-    queueDepth++;
+    uint32_t now = us_ticker_read();
+    uint32_t latency = now - txQueuedAt[txTail];
 
-    // Allocate a new buffer for the receiver hardware to use. the old on will be passed on to higher layer protocols/apps.
-    rxBuf = newRxBuf;
+    txStats.packets++;
+    txStats.airtime += now - txStartedAt;
+    txStats.latency += latency;
+
+    if (latency > txStats.maxLatency)
+        txStats.maxLatency = latency;
+
+    txTail = (txTail + 1) % MICROBIT_RADIO_TX_POOL_SIZE;
+    status &= ~MICROBIT_RADIO_STATUS_TRANSMITTING;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines if the transmitter is currently in use.
+  *
+  * @return 1 if a packet is being transmitted, 0 otherwise.
+  */
+int MicroBitRadio::isTransmitting()
+{
+    return (status & MICROBIT_RADIO_STATUS_TRANSMITTING) ? 1 : 0;
+}
+
+/**
+  * Determines the number of packets waiting to be sent, including any packet currently being transmitted.
+  *
+  * @return The number of packets in the transmit queue.
+  */
+int MicroBitRadio::getTxQueueDepth()
+{
+    return (txHead + MICROBIT_RADIO_TX_POOL_SIZE - txTail) % MICROBIT_RADIO_TX_POOL_SIZE;
+}
+
+/**
+  * Retrieves statistics describing the performance of the transmit queue.
+  *
+  * @param stats The structure to fill in.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitRadio::getTxStatistics(RadioTxStatistics &stats)
+{
+    // Take a consistent snapshot, as the RADIO interrupt updates these as each packet is sent.
+    NVIC_DisableIRQ(RADIO_IRQn);
+
+    stats = txStats;
+    stats.queueDepth = getTxQueueDepth();
+
+    NVIC_EnableIRQ(RADIO_IRQn);
 
     return MICROBIT_OK;
 }
@@ -258,11 +376,14 @@ int MicroBitRadio::enable()
     if (ble_running())
         return MICROBIT_NOT_SUPPORTED;
 
-    // If this is the first time we've been enable, allocate out receive buffers.
-    if (rxBuf == NULL)
-        rxBuf = new FrameBuffer();
+    // If this is the first time we've been enable, allocate out receive and transmit buffers.
+    if (rxPool == NULL)
+        rxPool = new FrameBuffer[MICROBIT_RADIO_RX_POOL_SIZE];
 
-    if (rxBuf == NULL)
+    if (txPool == NULL)
+        txPool = new FrameBuffer[MICROBIT_RADIO_TX_POOL_SIZE];
+
+    if (rxPool == NULL || txPool == NULL)
         return MICROBIT_NO_RESOURCES;
 
     // Enable the High Frequency clock on the processor. This is a pre-requisite for
@@ -314,22 +435,19 @@ int MicroBitRadio::enable()
     NRF_RADIO->DATAWHITEIV = 0x18;
 
     // Set up the RADIO module to read and write from our internal buffer.
-    NRF_RADIO->PACKETPTR = (uint32_t)rxBuf;
+    NRF_RADIO->PACKETPTR = (uint32_t)getRxBuf();
 
-    // Configure the hardware to issue an interrupt whenever a task is complete (e.g. send/receive).
-    NRF_RADIO->INTENSET = 0x00000008;
+    // Configure the hardware to issue an interrupt whenever a packet is sent or received (END),
+    // and whenever the transceiver is turned off (DISABLED), so we can switch between transmit and receive.
+    NRF_RADIO->EVENTS_END = 0;
+    NRF_RADIO->EVENTS_DISABLED = 0;
+    NRF_RADIO->INTENSET = 0x00000018;
     NVIC_ClearPendingIRQ(RADIO_IRQn);
     NVIC_EnableIRQ(RADIO_IRQn);
 
-    NRF_RADIO->SHORTS |= RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
-
-    // Start listening for the next packet
-    NRF_RADIO->EVENTS_READY = 0;
+    // Start listening for the next packet as soon as the receiver is ready, and sample the RSSI of each packet.
+    NRF_RADIO->SHORTS = RADIO_SHORTS_READY_START_Msk | RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
     NRF_RADIO->TASKS_RXEN = 1;
-    while(NRF_RADIO->EVENTS_READY == 0);
-
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
 
     // register ourselves for a callback event, in order to empty the receive queue.
     fiber_add_idle_component(this);
@@ -342,6 +460,8 @@ int MicroBitRadio::enable()
 
 /**
   * Disables the radio for use as a multipoint sender/receiver.
+  * When called from a fiber, packets still waiting in the transmit queue are given time to be sent first.
+  * Any that remain are discarded.
   *
   * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running.
   */
@@ -354,9 +474,19 @@ int MicroBitRadio::disable()
     if (!(status & MICROBIT_RADIO_STATUS_INITIALISED))
         return MICROBIT_OK;
 
-    // Disable interrupts and STOP any ongoing packet reception.
+    // Give any packets still in the transmit queue time to be sent. They are sent by the RADIO interrupt, so we can
+    // only wait from a fiber, and a full queue is sent well within a scheduler tick per packet.
+    if (fiber_scheduler_running() && !inInterruptContext())
+        for (int i = 0; i < MICROBIT_RADIO_TX_POOL_SIZE && getTxQueueDepth() > 0; i++)
+            fiber_sleep(SYSTEM_TICK_PERIOD_MS);
+
+    // Disable interrupts and STOP any ongoing packet reception or transmission.
     NVIC_DisableIRQ(RADIO_IRQn);
 
+    // Discard anything we couldn't wait for.
+    txTail = txHead;
+    status &= ~MICROBIT_RADIO_STATUS_TRANSMITTING;
+
     NRF_RADIO->EVENTS_DISABLED = 0;
     NRF_RADIO->TASKS_DISABLE = 1;
     while(NRF_RADIO->EVENTS_DISABLED == 0);
@@ -397,10 +527,11 @@ int MicroBitRadio::setGroup(uint8_t group)
   */
 void MicroBitRadio::idleTick()
 {
-    // Walk the list of packets and process each one.
-    while(rxQueue)
+    // Walk the queue of packets and process each one.
+    while(rxTail != rxHead)
     {
-        FrameBuffer *p = rxQueue;
+        uint8_t tail = rxTail;
+        FrameBuffer *p = &rxPool[tail];
 
         switch (p->protocol)
         {
@@ -409,6 +540,7 @@ void MicroBitRadio::idleTick()
                 break;
 
             case MICROBIT_RADIO_PROTOCOL_EVENTBUS:
+            case MICROBIT_RADIO_PROTOCOL_EVENTBATCH:
                 event.packetReceived();
                 break;
 
@@ -417,12 +549,9 @@ void MicroBitRadio::idleTick()
         }
 
         // If the packet was processed, it will have been recv'd, and taken from the queue.
-        // If this was a packet for an unknown protocol, it will still be there, so simply free it.
-        if (p == rxQueue)
-        {
+        // If this was a packet for an unknown protocol, it will still be there, so simply discard it.
+        if (rxTail == tail)
             recv();
-            delete p;
-        }
     }
 }
 
@@ -433,7 +562,7 @@ void MicroBitRadio::idleTick()
   */
 int MicroBitRadio::dataReady()
 {
-    return queueDepth;
+    return (rxHead + MICROBIT_RADIO_RX_POOL_SIZE - rxTail) % MICROBIT_RADIO_RX_POOL_SIZE;
 }
 
 /**
@@ -443,35 +572,42 @@ int MicroBitRadio::dataReady()
   *
   * @return The buffer containing the the packet. If no data is available, NULL is returned.
   *
-  * @note Once recv() has been called, it is the callers responsibility to
-  *       delete the buffer when appropriate.
+  * @note The buffer belongs to the radio, and must not be deleted. It remains valid until
+  *       the next call to recv(), after which it is reused for incoming packets.
   */
 FrameBuffer* MicroBitRadio::recv()
 {
-    FrameBuffer *p = rxQueue;
+    // Only the RADIO interrupt moves the head, and only we move the tail, so no locking is needed.
+    if (rxTail == rxHead)
+        return NULL;
 
-    if (p)
-    {
-         // Protect shared resource from ISR activity
-        NVIC_DisableIRQ(RADIO_IRQn); 
-
-        rxQueue = rxQueue->next;
-        queueDepth--;
+    FrameBuffer *p = &rxPool[rxTail];
 
-        // Allow ISR access to shared resource
-        NVIC_EnableIRQ(RADIO_IRQn);
-    }
+    rxTail = (rxTail + 1) % MICROBIT_RADIO_RX_POOL_SIZE;
 
     return p;
 }
 
+/**
+  * Determines the number of received packets that have been discarded because
+  * the receiver queue was full.
+  *
+  * @return The number of packets dropped.
+  */
+int MicroBitRadio::getDroppedCount()
+{
+    return rxDropped;
+}
+
 /**
   * Transmits the given buffer onto the broadcast radio.
-  * The call will wait until the transmission of the packet has completed before returning.
+  * The packet is copied into the transmit queue, and the call returns immediately.
+  * Transmission then takes place in the background, driven by the RADIO interrupt.
   *
-  * @param data The packet contents to transmit.
+  * @param buffer The packet contents to transmit.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NOT_SUPPORTED if the BLE stack is running.
+  * @return MICROBIT_OK on success, MICROBIT_NOT_SUPPORTED if the BLE stack is running or the radio
+  *         has not been enabled, or MICROBIT_NO_RESOURCES if the transmit queue is full.
   */
 int MicroBitRadio::send(FrameBuffer *buffer)
 {
@@ -484,46 +620,41 @@ int MicroBitRadio::send(FrameBuffer *buffer)
     if (buffer->length > MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE - 1)
         return MICROBIT_INVALID_PARAMETER;
 
-    // Firstly, disable the Radio interrupt. We want to wait until the trasmission completes.
-    NVIC_DisableIRQ(RADIO_IRQn);
+    // The transmit queue is driven by the RADIO interrupt, so the radio must be up and running. We don't enable it
+    // here, as that allocates its buffers, and we may be called from an interrupt.
+    if (!(status & MICROBIT_RADIO_STATUS_INITIALISED))
+        return MICROBIT_NOT_SUPPORTED;
 
-    // Turn off the transceiver.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+    // Lock out the RADIO interrupt while we update the queue.
+    NVIC_DisableIRQ(RADIO_IRQn);
 
-    // Configure the radio to send the buffer provided.
-    NRF_RADIO->PACKETPTR = (uint32_t) buffer;
+    uint8_t newHead = (txHead + 1) % MICROBIT_RADIO_TX_POOL_SIZE;
 
-    // Turn on the transmitter, and wait for it to signal that it's ready to use.
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_TXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0);
+    if (newHead == txTail)
+    {
+        txStats.dropped++;
+        NVIC_EnableIRQ(RADIO_IRQn);
+        return MICROBIT_NO_RESOURCES;
+    }
 
-    // Start transmission and wait for end of packet.
-    NRF_RADIO->TASKS_START = 1;
-    NRF_RADIO->EVENTS_END = 0;
-    while(NRF_RADIO->EVENTS_END == 0);
+    // Take a copy of the packet, so the caller can reuse their buffer straight away.
+    // The length field counts the bytes that follow it.
+    memcpy(&txPool[txHead], buffer, buffer->length + 1);
+    txQueuedAt[txHead] = us_ticker_read();
 
-    // Return the radio to using the default receive buffer
-    NRF_RADIO->PACKETPTR = (uint32_t) rxBuf;
+    // If the queue was empty, the radio is listening. Turn the receiver off, and the DISABLED event will start the transmission.
+    // Otherwise, the packet will be sent after those ahead of it, when the transmitter is next disabled.
+    bool idle = txHead == txTail;
 
-    // Turn off the transmitter.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while(NRF_RADIO->EVENTS_DISABLED == 0);
+    txHead = newHead;
 
-    // Start listening for the next packet
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while(NRF_RADIO->EVENTS_READY == 0);
+    if (getTxQueueDepth() > txStats.maxQueueDepth)
+        txStats.maxQueueDepth = getTxQueueDepth();
 
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+    if (idle)
+        NRF_RADIO->TASKS_DISABLE = 1;
 
-    // Re-enable the Radio interrupt.
-    NVIC_ClearPendingIRQ(RADIO_IRQn);
     NVIC_EnableIRQ(RADIO_IRQn);
 
     return MICROBIT_OK;
-}
\ No newline at end of file
+}
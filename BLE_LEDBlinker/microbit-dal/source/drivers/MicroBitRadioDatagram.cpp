@@ -49,6 +49,9 @@ DEALINGS IN THE SOFTWARE.
 MicroBitRadioDatagram::MicroBitRadioDatagram(MicroBitRadio &r) : radio(r)
 {
     this->rxQueue = NULL;
+    this->rxHead = 0;
+    this->rxTail = 0;
+    this->rxDropped = 0;
 }
 
 /**
@@ -65,19 +68,18 @@ MicroBitRadioDatagram::MicroBitRadioDatagram(MicroBitRadio &r) : radio(r)
   */
 int MicroBitRadioDatagram::recv(uint8_t *buf, int len)
 {
-    if (buf == NULL || rxQueue == NULL || len < 0)
+    if (buf == NULL || rxTail == rxHead || len < 0)
         return MICROBIT_INVALID_PARAMETER;
 
     // Take the first buffer from the queue.
-    FrameBuffer *p = rxQueue;
-    rxQueue = rxQueue->next;
+    FrameBuffer *p = &rxQueue[rxTail];
+    rxTail = (rxTail + 1) % (MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 1);
 
     int l = min(len, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1));
 
     // Fill in the buffer provided, if possible.
     memcpy(buf, p->payload, l);
 
-    delete p;
     return l;
 }
 
@@ -91,30 +93,27 @@ int MicroBitRadioDatagram::recv(uint8_t *buf, int len)
   */
 PacketBuffer MicroBitRadioDatagram::recv()
 {
-    if (rxQueue == NULL)
+    if (rxTail == rxHead)
         return PacketBuffer::EmptyPacket;
 
-    FrameBuffer *p = rxQueue;
-    rxQueue = rxQueue->next;
-
-    PacketBuffer packet(p->payload, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1), p->rssi);
+    FrameBuffer *p = &rxQueue[rxTail];
+    rxTail = (rxTail + 1) % (MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 1);
 
-    delete p;
-    return packet;
+    return PacketBuffer(p->payload, p->length - (MICROBIT_RADIO_HEADER_SIZE - 1), p->rssi);
 }
 
 /**
   * Transmits the given buffer onto the broadcast radio.
   *
-  * This is a synchronous call that will wait until the transmission of the packet
-  * has completed before returning.
+  * The packet is queued for transmission, and the call returns immediately.
   *
   * @param buffer The packet contents to transmit.
   *
   * @param len The number of bytes to transmit.
   *
   * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
-  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`,
+  *         or MICROBIT_NO_RESOURCES if the radio's transmit queue is full.
   */
 int MicroBitRadioDatagram::send(uint8_t *buffer, int len)
 {
@@ -135,13 +134,13 @@ int MicroBitRadioDatagram::send(uint8_t *buffer, int len)
 /**
   * Transmits the given string onto the broadcast radio.
   *
-  * This is a synchronous call that will wait until the transmission of the packet
-  * has completed before returning.
+  * The packet is queued for transmission, and the call returns immediately.
   *
   * @param data The packet contents to transmit.
   *
   * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
-  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`,
+  *         or MICROBIT_NO_RESOURCES if the radio's transmit queue is full.
   */
 int MicroBitRadioDatagram::send(PacketBuffer data)
 {
@@ -151,13 +150,13 @@ int MicroBitRadioDatagram::send(PacketBuffer data)
 /**
   * Transmits the given string onto the broadcast radio.
   *
-  * This is a synchronous call that will wait until the transmission of the packet
-  * has completed before returning.
+  * The packet is queued for transmission, and the call returns immediately.
   *
   * @param data The packet contents to transmit.
   *
   * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the buffer is invalid,
-  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`.
+  *         or the number of bytes to transmit is greater than `MICROBIT_RADIO_MAX_PACKET_SIZE + MICROBIT_RADIO_HEADER_SIZE`,
+  *         or MICROBIT_NO_RESOURCES if the radio's transmit queue is full.
   */
 int MicroBitRadioDatagram::send(ManagedString data)
 {
@@ -172,32 +171,37 @@ int MicroBitRadioDatagram::send(ManagedString data)
 void MicroBitRadioDatagram::packetReceived()
 {
     FrameBuffer *packet = radio.recv();
-    int queueDepth = 0;
 
-    // We add to the tail of the queue to preserve causal ordering.
-    packet->next = NULL;
+    // Our queue is only created once the first datagram arrives.
+    if (rxQueue == NULL)
+        rxQueue = new FrameBuffer[MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 1];
 
     if (rxQueue == NULL)
+        return;
+
+    uint8_t newHead = (rxHead + 1) % (MICROBIT_RADIO_MAXIMUM_RX_BUFFERS + 1);
+
+    if (newHead == rxTail)
     {
-        rxQueue = packet;
-    }
-    else
-    {
-        FrameBuffer *p = rxQueue;
-        while (p->next != NULL)
-        {
-            p = p->next;
-            queueDepth++;
-        }
-
-        if (queueDepth >= MICROBIT_RADIO_MAXIMUM_RX_BUFFERS)
-        {
-            delete packet;
-            return;
-        }
-
-        p->next = packet;
+        rxDropped++;
+        return;
     }
 
+    // We add to the head of the queue to preserve causal ordering.
+    // The radio reuses its buffers, so we keep a copy.
+    memcpy(&rxQueue[rxHead], packet, sizeof(FrameBuffer));
+    rxHead = newHead;
+
     MicroBitEvent(MICROBIT_ID_RADIO, MICROBIT_RADIO_EVT_DATAGRAM);
 }
+
+/**
+  * Determines the number of received datagrams that have been discarded because
+  * too many were already waiting to be received.
+  *
+  * @return The number of datagrams dropped.
+  */
+int MicroBitRadioDatagram::getDroppedCount()
+{
+    return rxDropped;
+}
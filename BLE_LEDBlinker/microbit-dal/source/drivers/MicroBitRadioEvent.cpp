@@ -25,6 +25,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include "MicroBitConfig.h"
 #include "MicroBitRadio.h"
+#include "MicroBitSystemTimer.h"
 
 /**
  * Provides a simple broadcast radio abstraction, built upon the raw nrf51822 RADIO module.
@@ -51,6 +52,227 @@ DEALINGS IN THE SOFTWARE.
 MicroBitRadioEvent::MicroBitRadioEvent(MicroBitRadio &r) : radio(r)
 {
     this->suppressForwarding = false;
+    this->batchLength = 0;
+    this->batchDeadline = 0;
+    this->deadline = 0;
+    this->window = 0;
+    this->historyIndex = 0;
+
+    memset(history, 0, sizeof(history));
+    memset(&stats, 0, sizeof(stats));
+}
+
+/**
+  * Coalesces forwarded events into shared packets, rather than sending one packet per event.
+  *
+  * A packet is sent as soon as it is full, or once its oldest event has waited for the given deadline.
+  * Batched packets use the MICROBIT_RADIO_PROTOCOL_EVENTBATCH protocol, and are only understood by
+  * micro:bits running a runtime that supports it.
+  *
+  * @param deadline The maximum time an event may wait to be sent, in milliseconds.
+  *        Defaults to MICROBIT_RADIO_EVENT_BATCH_DEADLINE.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the deadline is zero.
+  */
+int MicroBitRadioEvent::enableBatching(uint32_t deadline)
+{
+    if (deadline == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    // Register for a periodic callback to enforce the deadline, if we haven't already.
+    if (this->deadline == 0)
+        system_timer_add_component(this);
+
+    this->deadline = deadline;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Returns to sending one packet per forwarded event. Any events waiting in a batch are sent immediately.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitRadioEvent::disableBatching()
+{
+    if (deadline == 0)
+        return MICROBIT_OK;
+
+    system_timer_remove_component(this);
+    deadline = 0;
+
+    flush();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Suppresses forwarding of events that repeat the source and value of an event forwarded recently.
+  *
+  * @param window The period within which repeated events are suppressed, in milliseconds. Zero disables suppression.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitRadioEvent::setDeduplicationWindow(uint32_t window)
+{
+    this->window = window;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Sends any events waiting in the current batch immediately.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if no events were waiting,
+  *         or an error code from MicroBitRadio::send().
+  */
+int MicroBitRadioEvent::flush()
+{
+    FrameBuffer buf;
+
+    __disable_irq();
+    int count = packBatch(buf);
+    __enable_irq();
+
+    if (count == 0)
+        return MICROBIT_NO_DATA;
+
+    return sendBatch(buf, count);
+}
+
+/**
+  * Retrieves statistics describing the events forwarded and received.
+  * The average number of events per packet is eventsSent / packetsSent, and eventsReceived / packetsReceived.
+  * The latency of received events is the time each waited in the sender's batch before being transmitted, and
+  * does not include the time spent on air or in the receiver's event queue.
+  *
+  * @param s The structure to fill in.
+  *
+  * @return MICROBIT_OK on success.
+  */
+int MicroBitRadioEvent::getStatistics(RadioEventStatistics &s)
+{
+    __disable_irq();
+    s = stats;
+    __enable_irq();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Periodic callback from MicroBit system timer.
+  *
+  * Sends the current batch of events once its deadline has passed.
+  */
+void MicroBitRadioEvent::systemTick()
+{
+    if (batchLength > 0 && (int32_t)((uint32_t)system_timer_current_time_us() - batchDeadline) >= 0)
+        flush();
+}
+
+/**
+  * Determines if the given event repeats one forwarded within the de-duplication window,
+  * and if not, records it as forwarded.
+  *
+  * @param e The event to test.
+  *
+  * @return true if the event should be suppressed, false otherwise.
+  */
+bool MicroBitRadioEvent::isDuplicate(MicroBitEvent &e)
+{
+    uint32_t now = (uint32_t)e.timestamp;
+    bool duplicate = false;
+    int i;
+
+    __disable_irq();
+
+    for (i = 0; i < MICROBIT_RADIO_EVENT_HISTORY_SIZE; i++)
+        if (history[i].source == e.source && history[i].value == e.value)
+            break;
+
+    if (i < MICROBIT_RADIO_EVENT_HISTORY_SIZE && now - history[i].timestamp < window * 1000)
+    {
+        stats.eventsSuppressed++;
+        duplicate = true;
+    }
+    else
+    {
+        // Not seen recently. Refresh its entry if it has one, otherwise replace the oldest.
+        if (i == MICROBIT_RADIO_EVENT_HISTORY_SIZE)
+        {
+            i = historyIndex;
+            historyIndex = (historyIndex + 1) % MICROBIT_RADIO_EVENT_HISTORY_SIZE;
+        }
+
+        history[i].source = e.source;
+        history[i].value = e.value;
+        history[i].timestamp = now;
+    }
+
+    __enable_irq();
+
+    return duplicate;
+}
+
+/**
+  * Packs the waiting events into the given packet, and empties the batch.
+  *
+  * @param buf The packet to fill in.
+  *
+  * @return The number of events packed, or zero if none were waiting.
+  *
+  * @note must be called with interrupts disabled.
+  */
+int MicroBitRadioEvent::packBatch(FrameBuffer &buf)
+{
+    int count = batchLength;
+
+    if (count == 0)
+        return 0;
+
+    // Stamp each event with how long it has waited, so the receiver can measure latency.
+    uint32_t now = (uint32_t)system_timer_current_time_us();
+
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t age = now - batchTimestamp[i];
+        batch[i].age = age > 0xFFFF ? 0xFFFF : age;
+    }
+
+    buf.length = count * sizeof(RadioEventRecord) + MICROBIT_RADIO_HEADER_SIZE - 1;
+    buf.version = 1;
+    buf.group = 0;
+    buf.protocol = MICROBIT_RADIO_PROTOCOL_EVENTBATCH;
+    memcpy(buf.payload, batch, count * sizeof(RadioEventRecord));
+
+    batchLength = 0;
+
+    return count;
+}
+
+/**
+  * Transmits a packet of forwarded events, and records it in the statistics.
+  *
+  * @param buf The packet to send.
+  *
+  * @param count The number of events it contains.
+  *
+  * @return MICROBIT_OK on success, or an error code from MicroBitRadio::send().
+  */
+int MicroBitRadioEvent::sendBatch(FrameBuffer &buf, int count)
+{
+    int result = radio.send(&buf);
+
+    if (result == MICROBIT_OK)
+    {
+        // Batches are also sent from the system timer interrupt.
+        __disable_irq();
+        stats.eventsSent += count;
+        stats.packetsSent++;
+        __enable_irq();
+    }
+
+    return result;
 }
 
 /**
@@ -139,18 +361,42 @@ int MicroBitRadioEvent::ignore(uint16_t id, uint16_t value, EventModel &eventBus
 /**
   * Protocol handler callback. This is called when the radio receives a packet marked as using the event protocol.
   *
-  * This function process this packet, and fires the event contained inside onto the default EventModel.
+  * This function process this packet, and fires the events contained inside onto the default EventModel.
   */
 void MicroBitRadioEvent::packetReceived()
 {
     FrameBuffer *p = radio.recv();
-    MicroBitEvent *e = (MicroBitEvent *) p->payload;
 
     suppressForwarding = true;
-    e->fire();
-    suppressForwarding = false;
 
-    delete p;
+    if (p->protocol == MICROBIT_RADIO_PROTOCOL_EVENTBATCH)
+    {
+        int count = (p->length - (MICROBIT_RADIO_HEADER_SIZE - 1)) / (int)sizeof(RadioEventRecord);
+        RadioEventRecord r;
+
+        for (int i = 0; i < count; i++)
+        {
+            memcpy(&r, p->payload + i * sizeof(RadioEventRecord), sizeof(RadioEventRecord));
+
+            stats.eventsReceived++;
+            stats.latency += r.age;
+
+            if (r.age > stats.maxLatency)
+                stats.maxLatency = r.age;
+
+            MicroBitEvent(r.source, r.value);
+        }
+    }
+    else
+    {
+        MicroBitEvent *e = (MicroBitEvent *) p->payload;
+
+        stats.eventsReceived++;
+        e->fire();
+    }
+
+    stats.packetsReceived++;
+    suppressForwarding = false;
 }
 
 /**
@@ -163,13 +409,42 @@ void MicroBitRadioEvent::eventReceived(MicroBitEvent e)
     if(suppressForwarding)
         return;
 
+    if(window && isDuplicate(e))
+        return;
+
     FrameBuffer buf;
 
-    buf.length = sizeof(MicroBitEvent) + MICROBIT_RADIO_HEADER_SIZE - 1;
-    buf.version = 1;
-    buf.group = 0;
-    buf.protocol = MICROBIT_RADIO_PROTOCOL_EVENTBUS;
-    memcpy(buf.payload, (const uint8_t *)&e, sizeof(MicroBitEvent));
+    if(deadline == 0)
+    {
+        buf.length = sizeof(MicroBitEvent) + MICROBIT_RADIO_HEADER_SIZE - 1;
+        buf.version = 1;
+        buf.group = 0;
+        buf.protocol = MICROBIT_RADIO_PROTOCOL_EVENTBUS;
+        memcpy(buf.payload, (const uint8_t *)&e, sizeof(MicroBitEvent));
+
+        sendBatch(buf, 1);
+        return;
+    }
+
+    // This may be called from interrupt context, so add the event to the batch atomically,
+    // and take the batch as soon as it is full. The packet itself is sent once interrupts are enabled again.
+    int count = 0;
+
+    __disable_irq();
+
+    if (batchLength == 0)
+        batchDeadline = (uint32_t)e.timestamp + deadline * 1000;
+
+    batch[batchLength].source = e.source;
+    batch[batchLength].value = e.value;
+    batchTimestamp[batchLength] = (uint32_t)e.timestamp;
+    batchLength++;
+
+    if (batchLength == MICROBIT_RADIO_EVENT_BATCH_SIZE)
+        count = packBatch(buf);
+
+    __enable_irq();
 
-    radio.send(&buf);
+    if (count)
+        sendBatch(buf, count);
 }
@@ -55,8 +55,10 @@ int MicroBitSerial::baudrate = 0;
   *
   *       Buffers aren't allocated until the first send or receive respectively.
   */
-MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uint8_t txBufferSize) : RawSerial(tx,rx), delimeters()
+MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uint8_t txBufferSize) : RawSerial(tx,rx)
 {
+    this->delimeters.clear();
+
     // + 1 so there is a usable buffer size, of the size the user requested.
     this->rxBuffSize = rxBufferSize + 1;
     this->txBuffSize = txBufferSize + 1;
@@ -66,6 +68,8 @@ MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uin
 
     this->rxBuffHead = 0;
     this->rxBuffTail = 0;
+    this->rxScanPosition = 0;
+    this->rxScanDelimeters.clear();
 
     this->txBuffHead = 0;
     this->txBuffTail = 0;
@@ -80,52 +84,152 @@ MicroBitSerial::MicroBitSerial(PinName tx, PinName rx, uint8_t rxBufferSize, uin
 
 }
 
+/**
+  * Removes all characters from the set.
+  */
+void DelimeterMap::clear()
+{
+    memclr(map, sizeof(map));
+}
+
+/**
+  * Replaces the contents of the set with the given characters.
+  *
+  * @param delimeters the characters to match e.g. ManagedString("\r\n")
+  */
+void DelimeterMap::set(ManagedString delimeters)
+{
+    clear();
+
+    for(int i = 0; i < delimeters.length(); i++)
+    {
+        uint8_t c = delimeters.charAt(i);
+        map[c >> 5] |= 1UL << (c & 31);
+    }
+}
+
+/**
+  * Adds the characters of another set to this one.
+  *
+  * @param other the set of characters to add.
+  */
+void DelimeterMap::add(const DelimeterMap &other)
+{
+    for(int i = 0; i < 8; i++)
+        map[i] |= other.map[i];
+}
+
+/**
+  * Describes the bytes of a circular buffer between two positions.
+  *
+  * @param buffer the circular buffer
+  *
+  * @param size the size of the circular buffer
+  *
+  * @param tailPosition the position of the first byte of the run
+  *
+  * @param headPosition the position after the last byte of the run
+  */
+void CircularSpan::set(uint8_t *buffer, int size, int tailPosition, int headPosition)
+{
+    first = buffer + tailPosition;
+    second = buffer;
+
+    if(headPosition >= tailPosition)
+    {
+        firstLength = headPosition - tailPosition;
+        secondLength = 0;
+    }
+    else
+    {
+        firstLength = size - tailPosition;
+        secondLength = headPosition;
+    }
+}
+
+/**
+  * Copies the run into a new ManagedString. This is the only copy made.
+  *
+  * @return a ManagedString containing the bytes of the run, in order.
+  */
+ManagedString CircularSpan::toString() const
+{
+    int len = length();
+
+    if(len == 0)
+        return ManagedString();
+
+    // Build the string in place, rather than via a temporary linear buffer.
+    StringData *p = (StringData *) malloc(4 + len + 1);
+    p->init();
+    p->len = len;
+
+    memcpy(p->data, first, firstLength);
+    memcpy(p->data + firstLength, second, secondLength);
+    p->data[len] = 0;
+
+    ManagedString s(p);
+    p->decr();
+
+    return s;
+}
+
 /**
   * An internal interrupt callback for MicroBitSerial configured for when a
   * character is received.
   *
-  * Each time a character is received fill our circular buffer!
+  * Drains every character the UART is holding into our circular buffer, then
+  * raises at most one event of each type for the whole batch.
   */
 void MicroBitSerial::dataReceived()
 {
     if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
         return;
 
-    //get the received character
-    char c = getc();
-
-    int delimeterOffset = 0;
-    int delimLength = this->delimeters.length();
+    bool delimeterMatch = false;
+    bool headMatch = false;
+    bool full = false;
 
-    //iterate through our delimeters (if any) to see if there is a match
-    while(delimeterOffset < delimLength)
+    // The UART holds several received bytes, so take all of them while we're here
+    // rather than paying for an interrupt per byte.
+    while(readable())
     {
-        //fire an event if there is to block any waiting fibers
-        if(this->delimeters.charAt(delimeterOffset) == c)
-            MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
+        //get the received character
+        char c = getc();
 
-        delimeterOffset++;
-    }
+        if(delimeters.contains(c))
+            delimeterMatch = true;
 
-    uint16_t newHead = (rxBuffHead + 1) % rxBuffSize;
+        uint16_t newHead = (rxBuffHead + 1) % rxBuffSize;
 
-    //look ahead to our newHead value to see if we are about to collide with the tail
-    if(newHead != rxBuffTail)
-    {
-        //if we are not, store the character, and update our actual head.
-        this->rxBuff[rxBuffHead] = c;
-        rxBuffHead = newHead;
+        //look ahead to our newHead value to see if we are about to collide with the tail
+        if(newHead != rxBuffTail)
+        {
+            //if we are not, store the character, and update our actual head.
+            this->rxBuff[rxBuffHead] = c;
+            rxBuffHead = newHead;
 
-        //if we have any fibers waiting for a specific number of characters, unblock them
-        if(rxBuffHeadMatch >= 0)
-            if(rxBuffHead == rxBuffHeadMatch)
+            //note if we have any fibers waiting for a specific number of characters
+            if(rxBuffHeadMatch >= 0 && rxBuffHead == rxBuffHeadMatch)
             {
                 rxBuffHeadMatch = -1;
-                MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_HEAD_MATCH);
+                headMatch = true;
             }
+        }
+        else
+            //otherwise, our buffer is full, and the character is dropped.
+            full = true;
     }
-    else
-        //otherwise, our buffer is full, send an event to the user...
+
+    //fire an event if there is to block any waiting fibers
+    if(delimeterMatch)
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
+
+    if(headMatch)
+        MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_HEAD_MATCH);
+
+    //let the user know that data was lost...
+    if(full)
         MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_RX_FULL);
 }
 
@@ -248,6 +352,7 @@ int MicroBitSerial::initialiseRx()
 
     this->rxBuffHead = 0;
     this->rxBuffTail = 0;
+    this->rxScanPosition = 0;
 
     //set the receive interrupt
     status |= MICROBIT_SERIAL_RX_BUFF_INIT;
@@ -339,38 +444,11 @@ int MicroBitSerial::getChar(MicroBitSerialMode mode)
     char c = rxBuff[rxBuffTail];
 
     rxBuffTail = (rxBuffTail + 1) % rxBuffSize;
+    rxScanPosition = rxBuffTail;
 
     return c;
 }
 
-/**
-  * An internal method that copies values from a circular buffer to a linear buffer.
-  *
-  * @param circularBuff a pointer to the source circular buffer
-  *
-  * @param circularBuffSize the size of the circular buffer
-  *
-  * @param linearBuff a pointer to the destination linear buffer
-  *
-  * @param tailPosition the tail position in the circular buffer you want to copy from
-  *
-  * @param headPosition the head position in the circular buffer you want to copy to
-  *
-  * @note this method assumes that the linear buffer has the appropriate amount of
-  *       memory to contain the copy operation
-  */
-void MicroBitSerial::circularCopy(uint8_t *circularBuff, uint8_t circularBuffSize, uint8_t *linearBuff, uint16_t tailPosition, uint16_t headPosition)
-{
-    int toBuffIndex = 0;
-
-    while(tailPosition != headPosition)
-    {
-        linearBuff[toBuffIndex++] = circularBuff[tailPosition];
-
-        tailPosition = (tailPosition + 1) % circularBuffSize;
-    }
-}
-
 /**
   * Sends a single character over the serial line.
   *
@@ -710,90 +788,265 @@ int MicroBitSerial::read(uint8_t *buffer, int bufferLen, MicroBitSerialMode mode
   */
 ManagedString MicroBitSerial::readUntil(ManagedString delimeters, MicroBitSerialMode mode)
 {
+    CircularSpan span;
 
-    if(rxInUse())
-        return ManagedString();
+    int len = peekUntil(delimeters, span, mode);
 
-    //lazy initialisation of our rx buffer
-    if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
-    {
-        int result = initialiseRx();
+    if(len < 0)
+        return ManagedString();
 
-        if(result != MICROBIT_OK)
-            return result;
-    }
+    ManagedString s = span.toString();
 
-    lockRx();
+    //plus one for the character we listened for...
+    consume(len + 1);
 
-    int localTail = rxBuffTail;
-    int preservedTail = rxBuffTail;
+    return s;
+}
 
-    int foundIndex = -1;
+/**
+  * An internal method that continues the scan of the rxBuff for a delimeter, from
+  * where the last scan stopped.
+  *
+  * @return the position of the first delimeter after the rxBuffTail, or -1 if
+  *         there is no delimeter in the rxBuff.
+  */
+int MicroBitSerial::scanUntil()
+{
+    //take a copy of the head, as it is updated by our interrupt handler.
+    uint16_t head = rxBuffHead;
 
-    //ASYNC mode just iterates through our stored characters checking for any matches.
-    while(localTail != rxBuffHead && foundIndex  == -1)
+    //every character before rxScanPosition has already been checked.
+    while(rxScanPosition != head)
     {
-        //we use localTail to prevent modification of the actual tail.
-        char c = rxBuff[localTail];
+        if(rxScanDelimeters.contains(rxBuff[rxScanPosition]))
+            return rxScanPosition;
 
-        for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
-            if(delimeters.charAt(delimeterIterator) == c)
-                foundIndex = localTail;
+        rxScanPosition = (rxScanPosition + 1) % rxBuffSize;
+    }
+
+    return -1;
+}
 
-        localTail = (localTail + 1) % rxBuffSize;
+/**
+  * An internal method that finds the first delimeter in the rxBuff, waiting for one
+  * to arrive as determined by the mode.
+  *
+  * @param delimeters the characters to match received characters against.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP.
+  *
+  * @return the position of the delimeter in the rxBuff, or -1 if none was found.
+  */
+int MicroBitSerial::findDelimeter(ManagedString delimeters, MicroBitSerialMode mode)
+{
+    DelimeterMap map;
+    map.set(delimeters);
+
+    //if we're looking for something different this time, our previous scan is of no use.
+    if(memcmp(&map, &rxScanDelimeters, sizeof(DelimeterMap)) != 0)
+    {
+        rxScanDelimeters = map;
+        rxScanPosition = rxBuffTail;
     }
 
+    int foundIndex = scanUntil();
+
     //if our mode is SYNC_SPINWAIT and we didn't see any matching characters in our buffer
     //spin until we find a match!
     if(mode == SYNC_SPINWAIT)
-    {
         while(foundIndex == -1)
+            foundIndex = scanUntil();
+
+    //if our mode is SYNC_SLEEP, we sleep until our interrupt handler sees a matching character.
+    if(mode == SYNC_SLEEP && foundIndex == -1)
+    {
+        //match our delimeters in the interrupt handler, alongside any configured through eventOn().
+        DelimeterMap previous = this->delimeters;
+        this->delimeters.add(map);
+
+        while(true)
         {
-            while(localTail == rxBuffHead);
+            //block before we scan for the last time, so that a delimeter received after the scan is sure to wake us.
+            fiber_wake_on_event(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
+
+            foundIndex = scanUntil();
 
-            char c = rxBuff[localTail];
+            //if one was received since our last scan, its event may have been raised before we blocked.
+            if(foundIndex != -1)
+                MicroBitEvent(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH);
 
-            for(int delimeterIterator = 0; delimeterIterator < delimeters.length(); delimeterIterator++)
-                if(delimeters.charAt(delimeterIterator) == c)
-                    foundIndex = localTail;
+            schedule();
 
-            localTail = (localTail + 1) % rxBuffSize;
+            if(foundIndex != -1 || (foundIndex = scanUntil()) != -1)
+                break;
         }
+
+        this->delimeters = previous;
     }
 
-    //if our mode is SYNC_SLEEP, we set up an event to be fired when we see a
-    //matching character.
-    if(mode == SYNC_SLEEP && foundIndex == -1)
-    {
-        eventOn(delimeters, mode);
+    return foundIndex;
+}
 
-        foundIndex = rxBuffHead - 1;
+/**
+  * Finds the characters up to one of the delimeters in the rxBuff, without copying
+  * them or removing them from the rxBuff.
+  *
+  * Scanning resumes from where the previous call stopped, so polling for a line
+  * only ever examines each received character once.
+  *
+  * @param delimeters a ManagedString containing a sequence of delimeter characters e.g. ManagedString("\r\n")
+  *
+  * @param span set to describe the characters before the delimeter, which stay valid
+  *        until they are removed with consume().
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP, which
+  *        behave as described for readUntil().
+  *
+  * @return the number of characters before the delimeter, MICROBIT_NO_DATA if no
+  *         delimeter was found, or MICROBIT_SERIAL_IN_USE if another fiber is currently
+  *         using this instance for reception.
+  *
+  * @code
+  * CircularSpan line;
+  * int len = serial.peekUntil("\n", line);
+  *
+  * if (len >= 0)
+  * {
+  *     handleCommand(line.first, line.firstLength, line.second, line.secondLength);
+  *     serial.consume(len + 1);    // + 1 for the delimeter
+  * }
+  * @endcode
+  */
+int MicroBitSerial::peekUntil(ManagedString delimeters, CircularSpan &span, MicroBitSerialMode mode)
+{
+    if(rxInUse())
+        return MICROBIT_SERIAL_IN_USE;
+
+    //lazy initialisation of our rx buffer
+    if(!(status & MICROBIT_SERIAL_RX_BUFF_INIT))
+    {
+        int result = initialiseRx();
 
-        this->delimeters = ManagedString();
+        if(result != MICROBIT_OK)
+            return result;
     }
 
-    if(foundIndex >= 0)
+    lockRx();
+
+    int foundIndex = findDelimeter(delimeters, mode);
+
+    unlockRx();
+
+    if(foundIndex < 0)
+        return MICROBIT_NO_DATA;
+
+    span.set(rxBuff, rxBuffSize, rxBuffTail, foundIndex);
+
+    return span.length();
+}
+
+/**
+  * Removes characters from the rxBuff, without copying them.
+  *
+  * @param len the number of characters to remove.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if fewer than len
+  *         characters are buffered, or MICROBIT_SERIAL_IN_USE if another fiber is
+  *         currently using this instance for reception.
+  */
+int MicroBitSerial::consume(int len)
+{
+    if(rxInUse())
+        return MICROBIT_SERIAL_IN_USE;
+
+    if(len < 0 || len > rxBufferedSize())
+        return MICROBIT_INVALID_PARAMETER;
+
+    lockRx();
+
+    rxBuffTail = (rxBuffTail + len) % rxBuffSize;
+    rxScanPosition = rxBuffTail;
+
+    unlockRx();
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Finds the free space in the txBuff, so that it can be filled directly rather than
+  * copied from another buffer. The space must then be handed back with commitTx().
+  *
+  * This instance is locked for transmission until commitTx() is called.
+  *
+  * @param span set to describe the free space in the txBuff.
+  *
+  * @return the number of bytes of free space, MICROBIT_SERIAL_IN_USE if another fiber
+  *         is currently transmitting with this instance, or MICROBIT_NO_RESOURCES if
+  *         the txBuff could not be allocated.
+  */
+int MicroBitSerial::reserveTx(CircularSpan &span)
+{
+    if(txInUse())
+        return MICROBIT_SERIAL_IN_USE;
+
+    //lazy initialisation of our tx buffer
+    if(!(status & MICROBIT_SERIAL_TX_BUFF_INIT))
     {
-        //calculate our local buffer size
-        int localBuffSize = (preservedTail > foundIndex) ? (rxBuffSize - preservedTail) + foundIndex : foundIndex - preservedTail;
+        int result = initialiseTx();
 
-        uint8_t localBuff[localBuffSize + 1];
+        if(result != MICROBIT_OK)
+            return result;
+    }
+
+    lockTx();
+
+    //the space runs from our head up to, but not including, the slot before the tail.
+    span.set(txBuff, txBuffSize, txBuffHead, (txBuffTail + txBuffSize - 1) % txBuffSize);
 
-        memclr(&localBuff, localBuffSize + 1);
+    return span.length();
+}
 
-        circularCopy(rxBuff, rxBuffSize, localBuff, preservedTail, foundIndex);
+/**
+  * Transmits bytes written directly into the space found by reserveTx(), and unlocks
+  * this instance for transmission.
+  *
+  * @param len the number of bytes written, from the start of the reserved space.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP, which
+  *        behave as described for send().
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if len is larger
+  *         than the reserved space.
+  */
+int MicroBitSerial::commitTx(int len, MicroBitSerialMode mode)
+{
+    if(len < 0 || len > txBuffSize - 1 - txBufferedSize())
+    {
+        unlockTx();
+        return MICROBIT_INVALID_PARAMETER;
+    }
 
-        //plus one for the character we listened for...
-        rxBuffTail = (rxBuffTail + localBuffSize + 1) % rxBuffSize;
+    if(len > 0)
+    {
+        txBuffHead = (txBuffHead + len) % txBuffSize;
 
-        unlockRx();
+        if(mode == SYNC_SLEEP)
+            fiber_wake_on_event(MICROBIT_ID_NOTIFY, MICROBIT_SERIAL_EVT_TX_EMPTY);
 
-        return ManagedString((char *)localBuff, localBuffSize);
+        //set the TX interrupt
+        attach(this, &MicroBitSerial::dataWritten, Serial::TxIrq);
     }
 
-    unlockRx();
+    //wait for space in the txBuff, as determined by the mode. A sleeping fiber is woken as soon as
+    //the txBuff empties, rather than at the next scheduler tick as fiber_sleep() would.
+    if(mode == SYNC_SLEEP && len > 0)
+        schedule();
+    else
+        send(mode);
 
-    return ManagedString();
+    unlockTx();
+
+    return MICROBIT_OK;
 }
 
 /**
@@ -916,7 +1169,7 @@ int MicroBitSerial::eventOn(ManagedString delimeters, MicroBitSerialMode mode)
         return MICROBIT_INVALID_PARAMETER;
 
     //configure our head match...
-    this->delimeters = delimeters;
+    this->delimeters.set(delimeters);
 
     //block!
     if(mode == SYNC_SLEEP)
@@ -1036,6 +1289,7 @@ int MicroBitSerial::clearRxBuffer()
     lockRx();
 
     rxBuffTail = rxBuffHead;
+    rxScanPosition = rxBuffTail;
 
     unlockRx();
 
@@ -0,0 +1,371 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MicroBitConfig.h"
+#include "MicroBitSerialFramer.h"
+#include "EventModel.h"
+#include "ErrorNo.h"
+
+/**
+  * Provides a packet based transport on top of a MicroBitSerial instance, so that binary
+  * data can be exchanged without relying upon delimeter characters in the data.
+  *
+  * Each frame is SLIP encoded, and carries a CRC-16 (CCITT) of its payload.
+  */
+
+/**
+  * Calculates the CRC-16 (CCITT) of a block of memory.
+  *
+  * @param data the data to checksum.
+  *
+  * @param length the number of bytes to checksum.
+  *
+  * @return the CRC of the given data.
+  */
+static uint16_t frame_crc(const uint8_t *data, int length)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (length--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+
+    return crc;
+}
+
+/**
+  * Calculates the number of bytes needed to SLIP encode a block of memory.
+  *
+  * @param data the data to encode.
+  *
+  * @param length the number of bytes to encode.
+  *
+  * @return the length of the encoded data, excluding any delimeters.
+  */
+static int frame_encoded_length(const uint8_t *data, int length)
+{
+    int encodedLength = length;
+
+    for (int i = 0; i < length; i++)
+        if (data[i] == MICROBIT_SERIAL_FRAME_END || data[i] == MICROBIT_SERIAL_FRAME_ESC)
+            encodedLength++;
+
+    return encodedLength;
+}
+
+/**
+  * Constructor.
+  *
+  * Creates an instance of a MicroBitSerialFramer, which offers the ability to exchange
+  * binary packets over the given serial port.
+  *
+  * @param s The underlying serial port used to send and receive data.
+  */
+MicroBitSerialFramer::MicroBitSerialFramer(MicroBitSerial &s) : serial(s)
+{
+    const char end[] = { (char)MICROBIT_SERIAL_FRAME_END, 0 };
+
+    this->delimeter = ManagedString(end);
+    this->dropped = 0;
+
+    for (int i = 0; i < MICROBIT_SERIAL_FRAME_POOL_SIZE; i++)
+        frames[i].length = 0;
+
+    // Have the serial port raise an event whenever the end of a frame is received.
+    serial.eventOn(delimeter, ASYNC);
+
+    if (EventModel::defaultEventBus)
+        EventModel::defaultEventBus->listen(MICROBIT_ID_SERIAL, MICROBIT_SERIAL_EVT_DELIM_MATCH, this, &MicroBitSerialFramer::dataReceived);
+}
+
+/**
+  * Transmits the given buffer as a single frame.
+  *
+  * @param buffer The frame payload to transmit.
+  *
+  * @param len The number of bytes to transmit.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP. Each mode
+  *        gives a different behaviour:
+  *
+  *            ASYNC - The frame is queued only if all of it fits in the txBuff, and
+  *                    this method returns immediately.
+  *
+  *            SYNC_SPINWAIT - The frame is queued a txBuff at a time, spinning (locking
+  *                            up the processor) until each part is sent.
+  *
+  *            SYNC_SLEEP - The frame is queued a txBuff at a time, with the calling fiber
+  *                         sleeping until each part is sent.
+  *
+  *         Defaults to SYNC_SLEEP.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the buffer is invalid,
+  *         MICROBIT_NO_RESOURCES if the mode is ASYNC and the frame does not fit in the txBuff,
+  *         or MICROBIT_SERIAL_IN_USE if another fiber is using the serial port for transmission.
+  */
+int MicroBitSerialFramer::send(uint8_t *buffer, int len, MicroBitSerialMode mode)
+{
+    if (buffer == NULL || len <= 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint16_t crc = frame_crc(buffer, len);
+    uint8_t trailer[MICROBIT_SERIAL_FRAME_CRC_SIZE] = { (uint8_t)(crc >> 8), (uint8_t)(crc & 0xFF) };
+
+    // The frame is a leading delimeter (to flush out any line noise), the payload, the CRC, then a trailing delimeter.
+    int encodedLength = 2 + frame_encoded_length(buffer, len) + frame_encoded_length(trailer, MICROBIT_SERIAL_FRAME_CRC_SIZE);
+    int last = len + MICROBIT_SERIAL_FRAME_CRC_SIZE;
+    int position = -1;
+    uint8_t pending = 0;
+
+    while (position <= last)
+    {
+        CircularSpan span;
+        int space = serial.reserveTx(span);
+
+        if (space < 0)
+            return space;
+
+        if (mode == ASYNC && space < encodedLength)
+        {
+            serial.commitTx(0, mode);
+            return MICROBIT_NO_RESOURCES;
+        }
+
+        // Encode as much of the frame as will fit, straight into the txBuff.
+        int written = 0;
+
+        while (written < space && position <= last)
+        {
+            uint8_t *out = written < span.firstLength ? span.first + written : span.second + (written - span.firstLength);
+
+            if (pending)
+            {
+                *out = pending;
+                pending = 0;
+                position++;
+            }
+            else if (position == -1 || position == last)
+            {
+                *out = MICROBIT_SERIAL_FRAME_END;
+                position++;
+            }
+            else
+            {
+                uint8_t c = position < len ? buffer[position] : trailer[position - len];
+
+                if (c == MICROBIT_SERIAL_FRAME_END || c == MICROBIT_SERIAL_FRAME_ESC)
+                {
+                    *out = MICROBIT_SERIAL_FRAME_ESC;
+                    pending = (c == MICROBIT_SERIAL_FRAME_END) ? MICROBIT_SERIAL_FRAME_ESC_END : MICROBIT_SERIAL_FRAME_ESC_ESC;
+                }
+                else
+                {
+                    *out = c;
+                    position++;
+                }
+            }
+
+            written++;
+        }
+
+        serial.commitTx(written, mode);
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Transmits the given PacketBuffer as a single frame.
+  *
+  * @param data The frame payload to transmit.
+  *
+  * @param mode the selected mode, one of: ASYNC, SYNC_SPINWAIT, SYNC_SLEEP.
+  *
+  * @return MICROBIT_OK on success, or an error code as described for send(uint8_t *, int, MicroBitSerialMode).
+  */
+int MicroBitSerialFramer::send(PacketBuffer data, MicroBitSerialMode mode)
+{
+    return send(data.getBytes(), data.length(), mode);
+}
+
+/**
+  * Retrieves the payload of a received frame, without copying it.
+  *
+  * @param index The frame buffer, as given by the value of a frame ready event.
+  *
+  * @return A pointer to the payload, or NULL if the frame buffer does not hold a frame.
+  */
+uint8_t *MicroBitSerialFramer::getFrame(int index)
+{
+    if (index < 0 || index >= MICROBIT_SERIAL_FRAME_POOL_SIZE || frames[index].length == 0)
+        return NULL;
+
+    return frames[index].data;
+}
+
+/**
+  * Determines the length of the payload of a received frame.
+  *
+  * @param index The frame buffer, as given by the value of a frame ready event.
+  *
+  * @return The length of the payload, or MICROBIT_INVALID_PARAMETER if the frame buffer does not hold a frame.
+  */
+int MicroBitSerialFramer::getFrameLength(int index)
+{
+    if (index < 0 || index >= MICROBIT_SERIAL_FRAME_POOL_SIZE || frames[index].length == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return frames[index].length;
+}
+
+/**
+  * Returns a frame buffer to the pool, so that it can receive another frame.
+  *
+  * @param index The frame buffer, as given by the value of a frame ready event.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the index is invalid.
+  */
+int MicroBitSerialFramer::release(int index)
+{
+    if (index < 0 || index >= MICROBIT_SERIAL_FRAME_POOL_SIZE)
+        return MICROBIT_INVALID_PARAMETER;
+
+    frames[index].length = 0;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Determines the number of received frames that have been discarded, either
+  * because they were corrupt or because there was no free frame buffer.
+  *
+  * @return the number of frames discarded.
+  */
+int MicroBitSerialFramer::getDroppedCount()
+{
+    return dropped;
+}
+
+/**
+  * Decodes a frame from the rxBuff of our MicroBitSerial instance into a free frame buffer.
+  *
+  * @param span the encoded frame, without its delimeter.
+  */
+void MicroBitSerialFramer::frameReceived(CircularSpan &span)
+{
+    int index;
+
+    for (index = 0; index < MICROBIT_SERIAL_FRAME_POOL_SIZE; index++)
+        if (frames[index].length == 0)
+            break;
+
+    if (index == MICROBIT_SERIAL_FRAME_POOL_SIZE)
+    {
+        dropped++;
+        return;
+    }
+
+    SerialFrame *frame = &frames[index];
+    int length = 0;
+    bool escaped = false;
+
+    for (int i = 0; i < span.length(); i++)
+    {
+        uint8_t c = i < span.firstLength ? span.first[i] : span.second[i - span.firstLength];
+
+        if (escaped)
+        {
+            escaped = false;
+
+            if (c == MICROBIT_SERIAL_FRAME_ESC_END)
+                c = MICROBIT_SERIAL_FRAME_END;
+            else if (c == MICROBIT_SERIAL_FRAME_ESC_ESC)
+                c = MICROBIT_SERIAL_FRAME_ESC;
+            else
+            {
+                length = -1;
+                break;
+            }
+        }
+        else if (c == MICROBIT_SERIAL_FRAME_ESC)
+        {
+            escaped = true;
+            continue;
+        }
+
+        // Anything too large for a frame buffer is discarded.
+        if (length == sizeof(frame->data))
+        {
+            length = -1;
+            break;
+        }
+
+        frame->data[length++] = c;
+    }
+
+    // Discard anything that was truncated, badly escaped, has no payload or fails its CRC check.
+    if (escaped || length <= MICROBIT_SERIAL_FRAME_CRC_SIZE)
+    {
+        dropped++;
+        return;
+    }
+
+    length -= MICROBIT_SERIAL_FRAME_CRC_SIZE;
+
+    if (frame_crc(frame->data, length) != ((frame->data[length] << 8) | frame->data[length + 1]))
+    {
+        dropped++;
+        return;
+    }
+
+    frame->length = length;
+
+    MicroBitEvent(MICROBIT_ID_SERIAL_FRAME, MICROBIT_SERIAL_FRAME_EVT_READY(index));
+}
+
+/**
+  * Protocol handler callback. This is called when a frame delimeter is received
+  * by our MicroBitSerial instance.
+  *
+  * This function decodes every complete frame in the rxBuff.
+  */
+void MicroBitSerialFramer::dataReceived(MicroBitEvent)
+{
+    CircularSpan span;
+    int len;
+
+    while ((len = serial.peekUntil(delimeter, span, ASYNC)) >= 0)
+    {
+        // Consecutive delimeters are used to separate frames, so empty frames are expected, and ignored.
+        if (len > 0)
+            frameReceived(span);
+
+        serial.consume(len + 1);
+    }
+}
@@ -40,8 +40,8 @@ DEALINGS IN THE SOFTWARE.
   */
 MicroBitStorage::MicroBitStorage()
 {
-    //initialise our magic block, if required.
-    size();
+    //locate our active page and index its records, initialising flash if required.
+    init();
 }
 
 /**
@@ -139,167 +139,610 @@ void MicroBitStorage::flashWordWrite(uint32_t * address, uint32_t value)
 }
 
 /**
-  * Function for populating the scratch page with a KeyValueStore.
+  * Calculates the CRC-16 (CCITT) of a block of memory.
   *
-  * @param store the KeyValueStore struct to write to the scratch page.
+  * @param data the data to checksum.
+  *
+  * @param length the number of bytes to checksum.
+  *
+  * @return the CRC of the given data.
   */
-void MicroBitStorage::scratchKeyValueStore(KeyValueStore store)
+static uint16_t storage_crc(const uint8_t *data, int length)
 {
-    //calculate our various offsets
-    uint32_t *s = (uint32_t *) &store;
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
-
-    //KeyValueStore is word aligned.
-    int wordsToWrite = sizeof(KeyValueStore) / 4;
+    uint16_t crc = 0xFFFF;
 
-    //write the given KeyValueStore
-    for (int i = 0; i < wordsToWrite; i++)
+    while (length--)
     {
-        flashWordWrite(scratchPointer, *s);
-        scratchPointer++;
-        s++;
+        crc ^= (uint16_t)(*data++) << 8;
+
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
     }
+
+    return crc;
 }
 
 /**
-  * Function for populating the scratch page with a KeyValuePair.
+  * Calculates a 16 bit FNV-1a hash of a key, as held in the index.
   *
-  * @param pair the KeyValuePair struct to write to the scratch page.
+  * @param key the null terminated key to hash.
   *
-  * @param flashPointer the pointer in flash where this KeyValuePair resides. This pointer
-  * is used to determine the offset into the scratch page, where the KeyValuePair should
-  * be written.
+  * @return the hash of the given key.
   */
-void MicroBitStorage::scratchKeyValuePair(KeyValuePair pair, uint32_t* flashPointer)
+static uint16_t storage_hash(const char *key)
 {
-    //we can only write using words
-    uint32_t *p = (uint32_t *) &pair;
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < MICROBIT_STORAGE_KEY_SIZE && key[i]; i++)
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+
+    return (uint16_t)(hash ^ (hash >> 16));
+}
 
-    //calculate our various offsets
+/**
+  * Determines the address of one of the pages used by the store.
+  *
+  * @param page the page to locate (0 or 1).
+  *
+  * @return a pointer to the first word of the page.
+  */
+uint32_t* MicroBitStorage::pageAddress(int page)
+{
     uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
+    uint32_t pg_num = NRF_FICR->CODESIZE - (page ? MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET : MICROBIT_STORAGE_STORE_PAGE_OFFSET);
 
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
+    return (uint32_t *)(pg_size * pg_num);
+}
 
-    uint32_t flashPointerOffset = flashPointer - flashBlockPointer;
+/**
+  * Scans the pages used by the store, selects the active page and rebuilds the index
+  * of live records. A page written by the previous, single page store is converted if
+  * its pairs fit in a page of records, and indexed in place otherwise.
+  */
+void MicroBitStorage::init()
+{
+    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
+    uint32_t recordSize = sizeof(KeyValueRecord) / 4;
 
-    scratchPointer += flashPointerOffset;
+    uint32_t legacyCapacity = (pg_size - sizeof(KeyValueStore)) / sizeof(KeyValuePair);
 
-    //KeyValuePair is word aligned...
-    int wordsToWrite = sizeof(KeyValuePair) / 4;
+    capacity = (pg_size - sizeof(KeyValueLog)) / sizeof(KeyValueRecord);
+    indexSize = 0;
+    indexSlots = 1;
+    legacy = 0;
 
-    //write
-    for (int i = 0; i < wordsToWrite; i++)
+    transaction = NULL;
+    transactionSize = 0;
+
+    KeyValueLog *log0 = (KeyValueLog *)pageAddress(0);
+    KeyValueLog *log1 = (KeyValueLog *)pageAddress(1);
+
+    int valid0 = log0->magic == MICROBIT_STORAGE_LOG_MAGIC;
+    int valid1 = log1->magic == MICROBIT_STORAGE_LOG_MAGIC;
+
+    //the index must be able to hold every pair of a page written by the previous store, and is kept
+    //no more than three quarters full so that probe sequences stay short.
+    while (indexSlots * 3 < (legacyCapacity > capacity ? legacyCapacity : capacity) * 4)
+        indexSlots <<= 1;
+
+    index = new KeyValueIndex[indexSlots];
+    memset(index, 0, indexSlots * sizeof(KeyValueIndex));
+
+    //if we haven't used flash before, we need to configure it, keeping any data from the old format.
+    if (!valid0 && !valid1)
     {
-        flashWordWrite(scratchPointer, *p);
-        scratchPointer++;
-        p++;
+        KeyValueStore *store = (KeyValueStore *)pageAddress(0);
+
+        sequence = 0;
+        activePage = 0;
+        writeOffset = sizeof(KeyValueLog) / 4;
+
+        if (store->magic == MICROBIT_STORAGE_MAGIC)
+        {
+            //index the old pairs in place, at the offsets their KeyValuePairs would have as KeyValueRecords.
+            for (uint32_t i = 0; i < store->size && i < legacyCapacity; i++)
+            {
+                KeyValuePair *pair = (KeyValuePair *)(store + 1) + i;
+
+                indexInsert(storage_hash((char *)pair->key), ((uint32_t *)pair - (uint32_t *)store) - (sizeof(KeyValueRecord) - sizeof(KeyValuePair)) / 4);
+            }
+
+            legacy = 1;
+        }
+
+        //convert the old page if its pairs fit in the new one. Otherwise it is left as it is, and converted
+        //by the first update that leaves few enough pairs.
+        if (indexSize <= capacity)
+            compact(NULL, 0);
+
+        return;
     }
+
+    //the page with the latest sequence number holds the current data.
+    activePage = (valid1 && (!valid0 || log1->sequence > log0->sequence)) ? 1 : 0;
+    sequence = activePage ? log1->sequence : log0->sequence;
+
+    uint32_t *page = pageAddress(activePage);
+    uint32_t offset = sizeof(KeyValueLog) / 4;
+    uint32_t batchStart = 0;
+
+    while (offset + recordSize <= pg_size / 4)
+    {
+        KeyValueRecord *record = (KeyValueRecord *)(page + offset);
+
+        //the log ends at the first erased word.
+        if (*(page + offset) == 0xFFFFFFFF)
+            break;
+
+        //records torn by a reset will fail their CRC check, and are skipped.
+        int valid = record->crc == storage_crc((uint8_t *)&record->pair, sizeof(KeyValuePair));
+
+        if (valid && (record->type == MICROBIT_STORAGE_RECORD_BATCH_PAIR || record->type == MICROBIT_STORAGE_RECORD_BATCH_DELETED))
+        {
+            if (!batchStart)
+                batchStart = offset;
+        }
+        else if (valid && record->type == MICROBIT_STORAGE_RECORD_COMMIT && batchStart)
+        {
+            applyBatch(batchStart, offset);
+            batchStart = 0;
+        }
+        else
+        {
+            //a batch that isn't followed by its commit record is never applied.
+            batchStart = 0;
+
+            if (valid)
+                applyRecord(offset);
+        }
+
+        offset += recordSize;
+    }
+
+    writeOffset = offset;
+
+    //if we were reset part way through a commit, compact the store so that the partial batch can't be
+    //mistaken for part of the next one.
+    if (batchStart)
+        compact(NULL, 0);
 }
 
 /**
-  * Places a given key, and it's corresponding value into flash at the earliest
-  * available point.
-  *
-  * @param key the unique name that should be used as an identifier for the given data.
-  *            The key is presumed to be null terminated.
+  * Locates the live record with the given key in the index.
   *
-  * @param data a pointer to the beginning of the data to be persisted.
-  *
-  * @param dataSize the size of the data to be persisted
+  * @param key the null terminated key to look for.
   *
-  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-  *         MICROBIT_NO_RESOURCES if the storage page is full
+  * @return the slot of the record in the index, or -1 if the key is not stored.
   */
-int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
+int MicroBitStorage::indexOf(const char* key)
 {
-    KeyValuePair pair = KeyValuePair();
+    uint32_t *page = pageAddress(activePage);
+    uint16_t hash = storage_hash(key);
 
-    int keySize = strlen(key) + 1;
+    //probe from the slot the hash selects, until an empty slot shows the key isn't stored.
+    for (int i = hash & (indexSlots - 1); index[i].offset; i = (i + 1) & (indexSlots - 1))
+    {
+        //only read the key back from flash if the hashes match.
+        if (index[i].hash != hash)
+            continue;
 
-    if(keySize > (int)sizeof(pair.key) || dataSize > (int)sizeof(pair.value) || dataSize < 0)
-        return MICROBIT_INVALID_PARAMETER;
+        KeyValueRecord *record = (KeyValueRecord *)(page + index[i].offset);
 
-    KeyValuePair *currentValue = get(key);
+        if (strncmp(key, (char *)record->pair.key, MICROBIT_STORAGE_KEY_SIZE) == 0)
+            return i;
+    }
 
-    int upToDate = currentValue && (memcmp(currentValue->value, data, dataSize) == 0);
+    return -1;
+}
 
-    if(currentValue)
-        delete currentValue;
+/**
+  * Adds a record to the index. The caller must ensure its key is not already indexed.
+  *
+  * @param hash the hash of the record's key.
+  *
+  * @param offset the offset, in words, of the record in the active page.
+  */
+void MicroBitStorage::indexInsert(uint16_t hash, uint16_t offset)
+{
+    int i = hash & (indexSlots - 1);
 
-    if(upToDate)
-        return MICROBIT_OK;
+    while (index[i].offset)
+        i = (i + 1) & (indexSlots - 1);
 
-    memcpy(pair.key, key, keySize);
-    memcpy(pair.value, data, dataSize);
+    index[i].hash = hash;
+    index[i].offset = offset;
+    indexSize++;
+}
 
-    //calculate our various offsets.
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t *flashPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = flashPointer;
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
+/**
+  * Removes a record from the index, moving back any records that were displaced past it.
+  *
+  * @param slot the slot of the record in the index.
+  */
+void MicroBitStorage::indexRemove(int slot)
+{
+    int i = slot;
+    int j = slot;
+
+    //rather than leaving a marker, fill the gap with the next record whose probe sequence passes through it.
+    while (1)
+    {
+        j = (j + 1) & (indexSlots - 1);
 
-    uint32_t kvStoreSize = sizeof(KeyValueStore) / 4;
-    uint32_t kvPairSize = sizeof(KeyValuePair) / 4;
+        if (!index[j].offset)
+            break;
 
-    int storeSize = size();
+        //the distance each record lies from the slot its hash selects.
+        int home = index[j].hash & (indexSlots - 1);
 
-    //our KeyValueStore struct is always at 0
-    flashPointer += kvStoreSize;
+        if (((j - home) & (indexSlots - 1)) >= ((j - i) & (indexSlots - 1)))
+        {
+            index[i] = index[j];
+            i = j;
+        }
+    }
 
-    KeyValuePair storedPair = KeyValuePair();
+    index[i].offset = 0;
+    indexSize--;
+}
 
-    int found = 0;
+/**
+  * Updates the index with a record held in the active page.
+  *
+  * @param offset the offset, in words, of the record in the active page.
+  */
+void MicroBitStorage::applyRecord(uint16_t offset)
+{
+    KeyValueRecord *record = (KeyValueRecord *)(pageAddress(activePage) + offset);
 
-    //erase our scratch page
-    flashPageErase(scratchPointer);
+    int i = indexOf((char *)record->pair.key);
 
-    //iterate through key value pairs in flash, writing them to the scratch page.
-    for(int i = 0; i < storeSize; i++)
+    if (record->type == MICROBIT_STORAGE_RECORD_PAIR || record->type == MICROBIT_STORAGE_RECORD_BATCH_PAIR)
     {
-        memcpy(&storedPair, flashPointer, sizeof(KeyValuePair));
+        if (i < 0)
+            indexInsert(storage_hash((char *)record->pair.key), offset);
+        else
+            index[i].offset = offset;
+    }
+
+    if ((record->type == MICROBIT_STORAGE_RECORD_DELETED || record->type == MICROBIT_STORAGE_RECORD_BATCH_DELETED) && i >= 0)
+        indexRemove(i);
+}
 
-        //check if the keys match...
-        if(strcmp((char *)storedPair.key, (char *)pair.key) == 0)
+/**
+  * Updates the index with a committed batch of records held in the active page.
+  *
+  * @param start the offset, in words, of the first record in the batch.
+  *
+  * @param end the offset, in words, of the commit record that ends the batch.
+  */
+void MicroBitStorage::applyBatch(uint16_t start, uint16_t end)
+{
+    uint32_t *page = pageAddress(activePage);
+
+    //apply removals before additions, so the index never holds more than capacity records.
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (uint16_t offset = start; offset < end; offset += sizeof(KeyValueRecord) / 4)
         {
-            found = 1;
-            //scratch our KeyValueStore struct so that it is preserved.
-            scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
-            scratchKeyValuePair(pair, flashPointer);
+            KeyValueRecord *record = (KeyValueRecord *)(page + offset);
+
+            if ((record->type == MICROBIT_STORAGE_RECORD_BATCH_PAIR) == (pass == 1))
+                applyRecord(offset);
         }
-        else
+    }
+}
+
+/**
+  * Writes a record at the end of the active page.
+  * The caller must ensure there is space in the active page.
+  *
+  * @param record the record to write.
+  *
+  * @param type the type to record it with.
+  *
+  * @return the offset, in words, of the record in the active page.
+  */
+uint16_t MicroBitStorage::appendRecord(KeyValueRecord &record, uint16_t type)
+{
+    uint16_t offset = writeOffset;
+    uint16_t recordType = record.type;
+
+    record.type = type;
+    flashCopy((uint32_t *)&record, pageAddress(activePage) + offset, sizeof(KeyValueRecord) / 4);
+    record.type = recordType;
+
+    writeOffset += sizeof(KeyValueRecord) / 4;
+
+    return offset;
+}
+
+/**
+  * Copies the live records into the inactive page, then makes that page active.
+  *
+  * @param records an optional list of records to apply during the copy, each replacing or removing
+  *        any live record with the same key. May be NULL.
+  *
+  * @param count the number of records in the list.
+  *
+  * @note the caller must ensure the resulting records fit in a page.
+  */
+void MicroBitStorage::compact(KeyValueRecord *records, int count)
+{
+    uint32_t *page = pageAddress(activePage);
+    uint32_t *target = pageAddress(activePage ^ 1);
+    uint32_t recordSize = sizeof(KeyValueRecord) / 4;
+    uint32_t offset = sizeof(KeyValueLog) / 4;
+
+    flashPageErase(target);
+
+    //drop any record superseded by one we've been given.
+    for (int j = 0; j < count; j++)
+    {
+        int i = indexOf((char *)records[j].pair.key);
+
+        if (i >= 0)
+            indexRemove(i);
+    }
+
+    for (int i = 0; i < indexSlots; i++)
+    {
+        if (!index[i].offset)
+            continue;
+
+        KeyValueRecord *record = (KeyValueRecord *)(page + index[i].offset);
+
+        //only the pair is copied, as pairs indexed in a page written by the previous store have no type or CRC.
+        KeyValueRecord copy;
+        copy.type = MICROBIT_STORAGE_RECORD_PAIR;
+        memcpy(&copy.pair, &record->pair, sizeof(KeyValuePair));
+        copy.crc = storage_crc((uint8_t *)&copy.pair, sizeof(KeyValuePair));
+
+        //the record keeps its hash, and so its slot in the index.
+        flashCopy((uint32_t *)&copy, target + offset, recordSize);
+        index[i].offset = offset;
+        offset += recordSize;
+    }
+
+    for (int j = 0; j < count; j++)
+    {
+        if (records[j].type == MICROBIT_STORAGE_RECORD_PAIR)
         {
-            scratchKeyValuePair(storedPair, flashPointer);
+            flashCopy((uint32_t *)&records[j], target + offset, recordSize);
+            indexInsert(storage_hash((char *)records[j].pair.key), offset);
+            offset += recordSize;
         }
+    }
+
+    //write our header last, so that the new page only becomes valid once it is complete.
+    KeyValueLog log;
+    log.magic = MICROBIT_STORAGE_LOG_MAGIC;
+    log.sequence = sequence + 1;
+
+    flashCopy((uint32_t *)&log, target, sizeof(KeyValueLog) / 4);
+
+    sequence = log.sequence;
+    activePage ^= 1;
+    writeOffset = offset;
+    legacy = 0;
+}
+
+/**
+  * Adds a list of records to the log as a single atomic update, compacting the store
+  * first if they don't fit in the active page.
+  *
+  * @param records the records to add. Each must have a different key.
+  *
+  * @param count the number of records in the list.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_NO_RESOURCES if the store is full.
+  */
+int MicroBitStorage::writeRecords(KeyValueRecord *records, int count)
+{
+    uint32_t recordSize = sizeof(KeyValueRecord) / 4;
+    int live = indexSize;
+
+    for (int i = 0; i < count; i++)
+    {
+        int stored = indexOf((char *)records[i].pair.key) >= 0;
+
+        if (records[i].type == MICROBIT_STORAGE_RECORD_PAIR && !stored)
+            live++;
+
+        if (records[i].type == MICROBIT_STORAGE_RECORD_DELETED && stored)
+            live--;
+
+        records[i].crc = storage_crc((uint8_t *)&records[i].pair, sizeof(KeyValuePair));
+    }
+
+    if (live > capacity)
+        return MICROBIT_NO_RESOURCES;
+
+    //a batch of records is followed by a commit record.
+    uint32_t required = (count == 1) ? recordSize : (count + 1) * recordSize;
 
-        flashPointer += kvPairSize;
+    //a page written by the previous store is never appended to, but converted.
+    if (legacy || writeOffset + required > NRF_FICR->CODEPAGESIZE / 4)
+    {
+        compact(records, count);
+        return MICROBIT_OK;
     }
 
-    if(!found)
+    if (count == 1)
     {
-        //if we haven't got a match for the key, check we can add a new KeyValuePair
-        if(storeSize == (int)((pg_size - kvStoreSize) / MICROBIT_STORAGE_BLOCK_SIZE))
-            return MICROBIT_NO_RESOURCES;
+        applyRecord(appendRecord(records[0], records[0].type));
+        return MICROBIT_OK;
+    }
+
+    uint16_t start = writeOffset;
+
+    for (int i = 0; i < count; i++)
+        appendRecord(records[i], records[i].type == MICROBIT_STORAGE_RECORD_PAIR ? MICROBIT_STORAGE_RECORD_BATCH_PAIR : MICROBIT_STORAGE_RECORD_BATCH_DELETED);
+
+    KeyValueRecord commit;
+    memset(&commit, 0, sizeof(KeyValueRecord));
+    commit.crc = storage_crc((uint8_t *)&commit.pair, sizeof(KeyValuePair));
+
+    applyBatch(start, appendRecord(commit, MICROBIT_STORAGE_RECORD_COMMIT));
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Adds a record to the open transaction, replacing any earlier record for the same key.
+  *
+  * @param record the record to add.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if a removed key is not stored,
+  *         or MICROBIT_NO_RESOURCES if the transaction is full.
+  */
+int MicroBitStorage::stageRecord(KeyValueRecord &record)
+{
+    int i;
+
+    for (i = 0; i < transactionSize; i++)
+        if (strncmp((char *)transaction[i].pair.key, (char *)record.pair.key, MICROBIT_STORAGE_KEY_SIZE) == 0)
+            break;
+
+    if (i == transactionSize && record.type == MICROBIT_STORAGE_RECORD_DELETED && indexOf((char *)record.pair.key) < 0)
+        return MICROBIT_NO_DATA;
+
+    if (i == MICROBIT_STORAGE_TRANSACTION_SIZE)
+        return MICROBIT_NO_RESOURCES;
+
+    if (i == transactionSize)
+        transactionSize++;
+
+    transaction[i] = record;
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Starts a transaction. Subsequent calls to put() and remove() are held in RAM
+  * until commitTransaction() writes them to flash together.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_BUSY if a transaction is already open.
+  *
+  * @code
+  * storage.beginTransaction();
+  * storage.put("x", (uint8_t *)&x, sizeof(int));
+  * storage.put("y", (uint8_t *)&y, sizeof(int));
+  * storage.commitTransaction();
+  * @endcode
+  *
+  * @note get() and find() continue to return the committed values while a transaction is open.
+  *
+  * @note a transaction can update at most MICROBIT_STORAGE_TRANSACTION_SIZE keys. Further calls to
+  *       put() or remove() for other keys fail with MICROBIT_NO_RESOURCES.
+  */
+int MicroBitStorage::beginTransaction()
+{
+    if (transaction)
+        return MICROBIT_BUSY;
 
-        storeSize += 1;
+    transaction = new KeyValueRecord[MICROBIT_STORAGE_TRANSACTION_SIZE];
+    transactionSize = 0;
 
-        //scratch our updated values.
-        scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
-        scratchKeyValuePair(pair, flashPointer);
+    return MICROBIT_OK;
+}
+
+/**
+  * Writes every put() and remove() made since beginTransaction() to flash as a single
+  * update. If the micro:bit is reset part way through, none of them take effect.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if no transaction is open,
+  *         or MICROBIT_NO_RESOURCES if the store would be full, in which case nothing is written.
+  */
+int MicroBitStorage::commitTransaction()
+{
+    if (!transaction)
+        return MICROBIT_INVALID_PARAMETER;
+
+    int count = 0;
+    int result = MICROBIT_OK;
+
+    //avoid wearing the flash for values that are already up to date, or keys that were never stored.
+    for (int i = 0; i < transactionSize; i++)
+    {
+        const KeyValuePair *currentValue = find((char *)transaction[i].pair.key);
+
+        if (transaction[i].type == MICROBIT_STORAGE_RECORD_PAIR && currentValue && memcmp(currentValue, &transaction[i].pair, sizeof(KeyValuePair)) == 0)
+            continue;
+
+        if (transaction[i].type == MICROBIT_STORAGE_RECORD_DELETED && !currentValue)
+            continue;
+
+        transaction[count++] = transaction[i];
     }
 
-    //erase our storage page
-    flashPageErase((uint32_t *)flashBlockPointer);
+    if (count)
+        result = writeRecords(transaction, count);
+
+    abortTransaction();
+
+    return result;
+}
+
+/**
+  * Discards every put() and remove() made since beginTransaction().
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if no transaction is open.
+  */
+int MicroBitStorage::abortTransaction()
+{
+    if (!transaction)
+        return MICROBIT_INVALID_PARAMETER;
+
+    delete[] transaction;
 
-    //copy from scratch to storage.
-    flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, kvStoreSize + (storeSize * kvPairSize));
+    transaction = NULL;
+    transactionSize = 0;
 
     return MICROBIT_OK;
 }
 
+/**
+  * Places a given key, and it's corresponding value into flash at the earliest
+  * available point.
+  *
+  * @param key the unique name that should be used as an identifier for the given data.
+  *            The key is presumed to be null terminated.
+  *
+  * @param data a pointer to the beginning of the data to be persisted.
+  *
+  * @param dataSize the size of the data to be persisted
+  *
+  * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
+  *         MICROBIT_NO_RESOURCES if the store is full
+  */
+int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
+{
+    KeyValueRecord record;
+
+    int keySize = strlen(key) + 1;
+
+    if(keySize > (int)sizeof(record.pair.key) || dataSize > (int)sizeof(record.pair.value) || dataSize < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    const KeyValuePair *currentValue = find(key);
+
+    //avoid wearing the flash if the stored value is already up to date.
+    if(!transaction && currentValue && memcmp(currentValue->value, data, dataSize) == 0)
+        return MICROBIT_OK;
+
+    memset(&record, 0, sizeof(KeyValueRecord));
+    record.type = MICROBIT_STORAGE_RECORD_PAIR;
+
+    memcpy(record.pair.key, key, keySize);
+    memcpy(record.pair.value, data, dataSize);
+
+    if(transaction)
+        return stageRecord(record);
+
+    return writeRecords(&record, 1);
+}
+
 /**
   * Places a given key, and it's corresponding value into flash at the earliest
   * available point.
@@ -311,7 +754,7 @@ int MicroBitStorage::put(const char *key, uint8_t *data, int dataSize)
   * @param dataSize the size of the data to be persisted
   *
   * @return MICROBIT_OK on success, MICROBIT_INVALID_PARAMETER if the key or size is too large,
-  *         MICROBIT_NO_RESOURCES if the storage page is full
+  *         MICROBIT_NO_RESOURCES if the store is full
   */
 int MicroBitStorage::put(ManagedString key, uint8_t* data, int dataSize)
 {
@@ -330,42 +773,14 @@ int MicroBitStorage::put(ManagedString key, uint8_t* data, int dataSize)
   */
 KeyValuePair* MicroBitStorage::get(const char* key)
 {
-    //calculate our offsets for our storage page
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
+    const KeyValuePair *storedPair = find(key);
 
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
-
-    int storeSize = size();
-
-    //we haven't got anything stored, so return...
-    if(storeSize == 0)
+    if(storedPair == NULL)
         return NULL;
 
-    //our KeyValueStore struct is always at 0
-    flashBlockPointer += sizeof(KeyValueStore) / 4;
-
     KeyValuePair *pair = new KeyValuePair();
 
-    int i;
-
-    //iterate through flash until we have a match, or drop out.
-    for(i = 0; i < storeSize; i++)
-    {
-        memcpy(pair, flashBlockPointer, sizeof(KeyValuePair));
-
-        if(strcmp(key,(char *)pair->key) == 0)
-            break;
-
-        flashBlockPointer += sizeof(KeyValuePair) / 4;
-    }
-
-    //clean up
-    if(i == storeSize)
-    {
-        delete pair;
-        return NULL;
-    }
+    memcpy(pair, storedPair, sizeof(KeyValuePair));
 
     return pair;
 }
@@ -386,75 +801,64 @@ KeyValuePair* MicroBitStorage::get(ManagedString key)
 }
 
 /**
-  * Removes a KeyValuePair identified by a given key.
+  * Locates a KeyValuePair identified by a given key, without copying it out of flash.
   *
   * @param key the unique name used to identify a KeyValuePair in flash.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-  *         was not found in flash.
+  * @return a pointer to the KeyValuePair in flash, or NULL if the key was not found in storage.
+  *
+  * @note the pointer is only valid until the next call to put() or remove().
   */
-int MicroBitStorage::remove(const char* key)
+const KeyValuePair* MicroBitStorage::find(const char* key)
 {
-    //calculate our various offsets
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t *flashPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET));
-    uint32_t *flashBlockPointer = flashPointer;
-    uint32_t *scratchPointer = (uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET));
-
-    uint32_t kvStoreSize = sizeof(KeyValueStore) / 4;
-    uint32_t kvPairSize = sizeof(KeyValuePair) / 4;
-
-    int storeSize = size();
+    int i = indexOf(key);
 
-    //if we have no data, we have nothing to do.
-    if(storeSize == 0)
-        return MICROBIT_NO_DATA;
-
-    //our KeyValueStore struct is always at 0
-    flashPointer += kvStoreSize;
-    scratchPointer += kvStoreSize;
+    if(i < 0)
+        return NULL;
 
-    KeyValuePair storedPair = KeyValuePair();
+    return &((KeyValueRecord *)(pageAddress(activePage) + index[i].offset))->pair;
+}
 
-    int found = 0;
+/**
+  * Locates a KeyValuePair identified by a given key, without copying it out of flash.
+  *
+  * @param key the unique name used to identify a KeyValuePair in flash.
+  *
+  * @return a pointer to the KeyValuePair in flash, or NULL if the key was not found in storage.
+  *
+  * @note the pointer is only valid until the next call to put() or remove().
+  */
+const KeyValuePair* MicroBitStorage::find(ManagedString key)
+{
+    return find((char *)key.toCharArray());
+}
 
-    //set up our scratch area
-    flashPageErase(scratchPointer);
+/**
+  * Removes a KeyValuePair identified by a given key.
+  *
+  * @param key the unique name used to identify a KeyValuePair in flash.
+  *
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key
+  *         was not found in flash, or MICROBIT_NO_RESOURCES if a page written by the
+  *         previous store would still hold more pairs than a page of records.
+  */
+int MicroBitStorage::remove(const char* key)
+{
+    KeyValueRecord record;
 
-    //iterate through our flash copy pairs to scratch, unless there is a key patch
-    for(int i = 0; i < storeSize; i++)
-    {
-        memcpy(&storedPair, flashPointer, sizeof(KeyValuePair));
+    //record the removal by appending a deleted record for this key.
+    memset(&record, 0, sizeof(KeyValueRecord));
+    record.type = MICROBIT_STORAGE_RECORD_DELETED;
 
-        //if we have a match, don't increment our scratchPointer
-        if(strcmp((char *)storedPair.key, (char *)key) == 0)
-        {
-            found = 1;
-            //write our new KeyValueStore data
-            scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize - 1));
-        }
-        else
-        {
-            //otherwise copy the KeyValuePair from our storage page.
-            flashCopy(flashPointer, scratchPointer, sizeof(KeyValuePair) / 4);
-            scratchPointer += sizeof(KeyValuePair) / 4;
-        }
+    strncpy((char *)record.pair.key, key, MICROBIT_STORAGE_KEY_SIZE);
 
-        flashPointer += sizeof(KeyValuePair) / 4;
-    }
+    if(transaction)
+        return stageRecord(record);
 
-    //if we haven't got a match, write our old KeyValueStore struct
-    if(!found)
-    {
-        scratchKeyValueStore(KeyValueStore(MICROBIT_STORAGE_MAGIC, storeSize));
+    if(indexOf(key) < 0)
         return MICROBIT_NO_DATA;
-    }
-
-    //copy scratch to our storage page
-    flashPageErase((uint32_t *)flashBlockPointer);
-    flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, kvStoreSize + (storeSize * kvPairSize));
 
-    return MICROBIT_OK;
+    return writeRecords(&record, 1);
 }
 
 /**
@@ -462,8 +866,9 @@ int MicroBitStorage::remove(const char* key)
   *
   * @param key the unique name used to identify a KeyValuePair in flash.
   *
-  * @return MICROBIT_OK on success, or MICROBIT_NO_DATA if the given key
-  *         was not found in flash.
+  * @return MICROBIT_OK on success, MICROBIT_NO_DATA if the given key
+  *         was not found in flash, or MICROBIT_NO_RESOURCES if a page written by the
+  *         previous store would still hold more pairs than a page of records.
   */
 int MicroBitStorage::remove(ManagedString key)
 {
@@ -477,30 +882,5 @@ int MicroBitStorage::remove(ManagedString key)
   */
 int MicroBitStorage::size()
 {
-    uint32_t pg_size = NRF_FICR->CODEPAGESIZE;
-    uint32_t pg_num  = NRF_FICR->CODESIZE - MICROBIT_STORAGE_STORE_PAGE_OFFSET;
-
-    uint32_t *flashBlockPointer = (uint32_t *)(pg_size * pg_num);
-
-    KeyValueStore store = KeyValueStore();
-
-    //read our data!
-    memcpy(&store, flashBlockPointer, sizeof(KeyValueStore));
-
-    //if we haven't used flash before, we need to configure it
-    if(store.magic != MICROBIT_STORAGE_MAGIC)
-    {
-        store.magic = MICROBIT_STORAGE_MAGIC;
-        store.size = 0;
-
-        //erase the scratch page and write our new KeyValueStore
-        flashPageErase((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)));
-        scratchKeyValueStore(store);
-
-        //erase flash, and copy the scratch page over
-        flashPageErase((uint32_t *)flashBlockPointer);
-        flashCopy((uint32_t *)(pg_size * (NRF_FICR->CODESIZE - MICROBIT_STORAGE_SCRATCH_PAGE_OFFSET)), flashBlockPointer, pg_size/4);
-    }
-
-    return store.size;
-}
\ No newline at end of file
+    return indexSize;
+}
@@ -71,13 +71,10 @@ MicroBitThermometer::MicroBitThermometer(MicroBitStorage& _storage, uint16_t id)
     this->sampleTime = 0;
     this->offset = 0;
 
-    KeyValuePair *tempCalibration =  storage->get("tempCal");
+    const KeyValuePair *tempCalibration =  storage->find("tempCal");
 
     if(tempCalibration != NULL)
-    {
         memcpy(&offset, tempCalibration->value, sizeof(int16_t));
-        delete tempCalibration;
-    }
 }
 
 /**
@@ -0,0 +1,173 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Matrix kernels, operating on row major buffers of floats.
+  *
+  * These are shared by the Matrix and Matrix4 classes. None of them allocate memory or check bounds,
+  * so the caller is responsible for providing buffers of the right size.
+  */
+
+#include "MicroBitConfig.h"
+#include "Matrix.h"
+
+/**
+  * Multiplies two matrices.
+  *
+  * @param a The left hand matrix, of rows x inner elements.
+  *
+  * @param b The right hand matrix, of inner x cols elements.
+  *
+  * @param result The buffer to write the rows x cols result to.
+  */
+void matrix_multiply(const float *a, const float *b, float *result, int rows, int inner, int cols)
+{
+    for (int r = 0; r < rows; r++)
+    {
+        const float *row = a + r * inner;
+
+        for (int c = 0; c < cols; c++)
+        {
+            const float *col = b + c;
+            float v = 0.0f;
+
+            for (int i = 0; i < inner; i++)
+                v += row[i] * col[i * cols];
+
+            *result++ = v;
+        }
+    }
+}
+
+/**
+  * Multiplies the transpose of a matrix with another matrix, without building the transpose.
+  *
+  * The result is accumulated one row of each input at a time, so both inputs are walked in memory order.
+  *
+  * @param a The left hand matrix, of inner x rows elements. Its transpose is used.
+  *
+  * @param b The right hand matrix, of inner x cols elements.
+  *
+  * @param result The buffer to write the rows x cols result to.
+  */
+void matrix_multiply_transpose(const float *a, const float *b, float *result, int rows, int inner, int cols)
+{
+    for (int i = 0; i < rows * cols; i++)
+        result[i] = 0.0f;
+
+    for (int i = 0; i < inner; i++)
+    {
+        const float *rowA = a + i * rows;
+        const float *rowB = b + i * cols;
+        float *out = result;
+
+        for (int r = 0; r < rows; r++)
+        {
+            float v = rowA[r];
+
+            for (int c = 0; c < cols; c++)
+                *out++ += v * rowB[c];
+        }
+    }
+}
+
+/**
+  * Transposes a matrix.
+  *
+  * @param a The matrix to transpose, of rows x cols elements.
+  *
+  * @param result The buffer to write the cols x rows result to.
+  */
+void matrix_transpose(const float *a, float *result, int rows, int cols)
+{
+    for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++)
+            result[c * rows + r] = *a++;
+}
+
+/**
+  * Inverts a 4x4 matrix, using the 2x2 sub-determinants of its upper and lower halves.
+  *
+  * Each sub-determinant is shared by several cofactors, so this takes roughly half the
+  * multiplications of a direct cofactor expansion.
+  *
+  * @param a The matrix to invert, of 16 elements.
+  *
+  * @param result The buffer to write the 16 element inverse to. This may be the same buffer as a.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER if the matrix is singular.
+  */
+int matrix_invert4(const float *a, float *result)
+{
+    float a00 = a[0],  a01 = a[1],  a02 = a[2],  a03 = a[3];
+    float a10 = a[4],  a11 = a[5],  a12 = a[6],  a13 = a[7];
+    float a20 = a[8],  a21 = a[9],  a22 = a[10], a23 = a[11];
+    float a30 = a[12], a31 = a[13], a32 = a[14], a33 = a[15];
+
+    // Sub-determinants of the upper two rows...
+    float s0 = a00 * a11 - a01 * a10;
+    float s1 = a00 * a12 - a02 * a10;
+    float s2 = a00 * a13 - a03 * a10;
+    float s3 = a01 * a12 - a02 * a11;
+    float s4 = a01 * a13 - a03 * a11;
+    float s5 = a02 * a13 - a03 * a12;
+
+    // ... and of the lower two rows.
+    float c0 = a20 * a31 - a21 * a30;
+    float c1 = a20 * a32 - a22 * a30;
+    float c2 = a20 * a33 - a23 * a30;
+    float c3 = a21 * a32 - a22 * a31;
+    float c4 = a21 * a33 - a23 * a31;
+    float c5 = a22 * a33 - a23 * a32;
+
+    float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+    if (det == 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    det = 1.0f / det;
+
+    result[0] = ( a11 * c5 - a12 * c4 + a13 * c3) * det;
+    result[1] = (-a01 * c5 + a02 * c4 - a03 * c3) * det;
+    result[2] = ( a31 * s5 - a32 * s4 + a33 * s3) * det;
+    result[3] = (-a21 * s5 + a22 * s4 - a23 * s3) * det;
+
+    result[4] = (-a10 * c5 + a12 * c2 - a13 * c1) * det;
+    result[5] = ( a00 * c5 - a02 * c2 + a03 * c1) * det;
+    result[6] = (-a30 * s5 + a32 * s2 - a33 * s1) * det;
+    result[7] = ( a20 * s5 - a22 * s2 + a23 * s1) * det;
+
+    result[8] = ( a10 * c4 - a11 * c2 + a13 * c0) * det;
+    result[9] = (-a00 * c4 + a01 * c2 - a03 * c0) * det;
+    result[10] = ( a30 * s4 - a31 * s2 + a33 * s0) * det;
+    result[11] = (-a20 * s4 + a21 * s2 - a23 * s0) * det;
+
+    result[12] = (-a10 * c3 + a11 * c1 - a12 * c0) * det;
+    result[13] = ( a00 * c3 - a01 * c1 + a02 * c0) * det;
+    result[14] = (-a30 * s3 + a31 * s1 - a32 * s0) * det;
+    result[15] = ( a20 * s3 - a21 * s1 + a22 * s0) * det;
+
+    return MICROBIT_OK;
+}
@@ -93,6 +93,39 @@ Matrix4::Matrix4(const Matrix4 &matrix)
 
 }
 
+/**
+  * Copy assignment operator.
+  * Makes this matrix an identical copy of the given matrix.
+  *
+  * @param matrix The matrix to copy.
+  *
+  * @return A reference to this matrix.
+  */
+Matrix4& Matrix4::operator = (const Matrix4 &matrix)
+{
+	if (this == &matrix)
+		return *this;
+
+	int size = matrix.rows * matrix.cols;
+
+	// Only reallocate if the number of elements has changed.
+	if (size != rows * cols)
+	{
+		if (data != NULL)
+			delete[] data;
+
+		data = size > 0 ? new float[size] : NULL;
+	}
+
+	rows = matrix.rows;
+	cols = matrix.cols;
+
+	for (int i = 0; i < size; i++)
+		data[i] = matrix.data[i];
+
+	return *this;
+}
+
 /**
   * Determines the number of columns in this matrix.
   *
@@ -174,11 +207,10 @@ void Matrix4::set(int row, int col, float v)
   */
 Matrix4 Matrix4::transpose()
 {
-	Matrix4 result = Matrix4(cols, rows);
+	Matrix4 result(cols, rows);
 
-	for (int i = 0; i < width(); i++)
-		for (int j = 0; j < height(); j++)
-			result.set(i, j, get(j, i));
+	if (result.data != NULL)
+		matrix_transpose(data, result.data, rows, cols);
 
 	return result;
 }
@@ -206,18 +238,13 @@ Matrix4 Matrix4::multiply(Matrix4 &matrix, bool transpose)
 
 	Matrix4 result(h, matrix.width());
 
-	for (int r = 0; r < result.height(); r++)
-	{
-		for (int c = 0; c < result.width(); c++)
-		{
-			float v = 0.0;
+	if (result.data == NULL)
+		return result;
 
-			for (int i = 0; i < w; i++)
-				v += (transpose ? get(i, r) : get(r, i)) * matrix.get(i, c);
-
-			result.set(r, c, v);
-		}
-	}
+	if (transpose)
+		matrix_multiply_transpose(data, matrix.data, result.data, h, w, matrix.width());
+	else
+		matrix_multiply(data, matrix.data, result.data, h, w, matrix.width());
 
 	return result;
 }
@@ -240,33 +267,9 @@ Matrix4 Matrix4::invert()
 
 	Matrix4 result(width(), height());
 
-	result.data[0] = data[5] * data[10] * data[15] - data[5] * data[11] * data[14] - data[9] * data[6] * data[15] + data[9] * data[7] * data[14] + data[13] * data[6] * data[11] - data[13] * data[7] * data[10];
-	result.data[1] = -data[1] * data[10] * data[15] + data[1] * data[11] * data[14] + data[9] * data[2] * data[15] - data[9] * data[3] * data[14] - data[13] * data[2] * data[11] + data[13] * data[3] * data[10];
-	result.data[2] = data[1] * data[6] * data[15] - data[1] * data[7] * data[14] - data[5] * data[2] * data[15] + data[5] * data[3] * data[14] + data[13] * data[2] * data[7] - data[13] * data[3] * data[6];
-	result.data[3] = -data[1] * data[6] * data[11] + data[1] * data[7] * data[10] + data[5] * data[2] * data[11] - data[5] * data[3] * data[10] - data[9] * data[2] * data[7] + data[9] * data[3] * data[6];
-	result.data[4] = -data[4] * data[10] * data[15] + data[4] * data[11] * data[14] + data[8] * data[6] * data[15] - data[8] * data[7] * data[14] - data[12] * data[6] * data[11] + data[12] * data[7] * data[10];
-	result.data[5] = data[0] * data[10] * data[15] - data[0] * data[11] * data[14] - data[8] * data[2] * data[15] + data[8] * data[3] * data[14] + data[12] * data[2] * data[11] - data[12] * data[3] * data[10];
-	result.data[6] = -data[0] * data[6] * data[15] + data[0] * data[7] * data[14] + data[4] * data[2] * data[15] - data[4] * data[3] * data[14] - data[12] * data[2] * data[7] + data[12] * data[3] * data[6];
-	result.data[7] = data[0] * data[6] * data[11] - data[0] * data[7] * data[10] - data[4] * data[2] * data[11] + data[4] * data[3] * data[10] + data[8] * data[2] * data[7] - data[8] * data[3] * data[6];
-	result.data[8] = data[4] * data[9] * data[15] - data[4] * data[11] * data[13] - data[8] * data[5] * data[15] + data[8] * data[7] * data[13] + data[12] * data[5] * data[11] - data[12] * data[7] * data[9];
-	result.data[9] = -data[0] * data[9] * data[15] + data[0] * data[11] * data[13] + data[8] * data[1] * data[15] - data[8] * data[3] * data[13] - data[12] * data[1] * data[11] + data[12] * data[3] * data[9];
-	result.data[10] = data[0] * data[5] * data[15] - data[0] * data[7] * data[13] - data[4] * data[1] * data[15] + data[4] * data[3] * data[13] + data[12] * data[1] * data[7] - data[12] * data[3] * data[5];
-	result.data[11] = -data[0] * data[5] * data[11] + data[0] * data[7] * data[9] + data[4] * data[1] * data[11] - data[4] * data[3] * data[9] - data[8] * data[1] * data[7] + data[8] * data[3] * data[5];
-	result.data[12] = -data[4] * data[9] * data[14] + data[4] * data[10] * data[13] + data[8] * data[5] * data[14] - data[8] * data[6] * data[13] - data[12] * data[5] * data[10] + data[12] * data[6] * data[9];
-	result.data[13] = data[0] * data[9] * data[14] - data[0] * data[10] * data[13] - data[8] * data[1] * data[14] + data[8] * data[2] * data[13] + data[12] * data[1] * data[10] - data[12] * data[2] * data[9];
-	result.data[14] = -data[0] * data[5] * data[14] + data[0] * data[6] * data[13] + data[4] * data[1] * data[14] - data[4] * data[2] * data[13] - data[12] * data[1] * data[6] + data[12] * data[2] * data[5];
-	result.data[15] = data[0] * data[5] * data[10] - data[0] * data[6] * data[9] - data[4] * data[1] * data[10] + data[4] * data[2] * data[9] + data[8] * data[1] * data[6] - data[8] * data[2] * data[5];
-
-	float det = data[0] * result.data[0] + data[1] * result.data[4] + data[2] * result.data[8] + data[3] * result.data[12];
-
-	if (det == 0)
+	if (matrix_invert4(data, result.data) != MICROBIT_OK)
 		return Matrix4(0, 0);
 
-	det = 1.0f / det;
-
-	for (int i = 0; i < 16; i++)
-		result.data[i] *= det;
-
 	return result;
 }
 
@@ -279,7 +282,7 @@ Matrix4::~Matrix4()
 {
 	if (data != NULL)
 	{
-		delete data;
+		delete[] data;
 		data = NULL;
 	}
 }
@@ -54,6 +54,8 @@ MicroBitImage MicroBitImage::EmptyImage((ImageData*)(void*)empty);
   */
 MicroBitImage::MicroBitImage()
 {
+    this->generation = 0;
+
     // Create new reference to the EmptyImage and we're done.
     init_empty();
 }
@@ -80,6 +82,7 @@ MicroBitImage::MicroBitImage()
   */
 MicroBitImage::MicroBitImage(const int16_t x, const int16_t y)
 {
+    this->generation = 0;
     this->init(x,y,NULL);
 }
 
@@ -96,6 +99,7 @@ MicroBitImage::MicroBitImage(const int16_t x, const int16_t y)
   */
 MicroBitImage::MicroBitImage(const MicroBitImage &image)
 {
+    generation = 0;
     ptr = image.ptr;
     ptr->incr();
 }
@@ -123,6 +127,8 @@ MicroBitImage::MicroBitImage(const char *s)
     char *parseWritePtr;
     uint8_t *bitmapPtr;
 
+    this->generation = 0;
+
     if (s == NULL)
     {
         init_empty();
@@ -207,6 +213,7 @@ MicroBitImage::MicroBitImage(const char *s)
   */
 MicroBitImage::MicroBitImage(ImageData *p)
 {
+    generation = 0;
     ptr = p;
     ptr->incr();
 }
@@ -220,6 +227,7 @@ ImageData *MicroBitImage::leakData()
 {
     ImageData* res = ptr;
     init_empty();
+    modified();
     return res;
 }
 
@@ -241,6 +249,7 @@ ImageData *MicroBitImage::leakData()
   */
 MicroBitImage::MicroBitImage(const int16_t x, const int16_t y, const uint8_t *bitmap)
 {
+    this->generation = 0;
     this->init(x,y,bitmap);
 }
 
@@ -324,6 +333,8 @@ MicroBitImage& MicroBitImage::operator = (const MicroBitImage& i)
     ptr = i.ptr;
     ptr->incr();
 
+    modified();
+
     return *this;
 }
 
@@ -350,7 +361,7 @@ bool MicroBitImage::operator== (const MicroBitImage& i)
     if (ptr == i.ptr)
         return true;
     else
-        return (ptr->width == i.ptr->width && ptr->height == i.ptr->height && (memcmp(getBitmap(), i.ptr->data, getSize())==0));
+        return (ptr->width == i.ptr->width && ptr->height == i.ptr->height && (memcmp(ptr->data, i.ptr->data, getSize())==0));
 }
 
 
@@ -415,7 +426,7 @@ int MicroBitImage::getPixelValue(int16_t x , int16_t y)
     if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
         return MICROBIT_INVALID_PARAMETER;
 
-    return this->getBitmap()[y*getWidth()+x];
+    return ptr->data[y*getWidth()+x];
 }
 
 /**
@@ -787,7 +798,7 @@ ManagedString MicroBitImage::toString()
 
     parseBuffer[stringSize] = '\0';
 
-    uint8_t *bitmapPtr = getBitmap();
+    uint8_t *bitmapPtr = ptr->data;
 
     int parseIndex = 0;
     int widthCount = 0;
@@ -851,7 +862,7 @@ MicroBitImage MicroBitImage::crop(int startx, int starty, int cropWidth, int cro
     uint8_t cropped[newWidth * newHeight];
 
     //calculate the pointer to where we want to begin cropping
-    uint8_t *copyPointer = getBitmap() + (getWidth() * starty) + startx;
+    uint8_t *copyPointer = ptr->data + (getWidth() * starty) + startx;
 
     //get a reference to our storage
     uint8_t *pastePointer = cropped;
@@ -883,5 +894,5 @@ bool MicroBitImage::isReadOnly()
   */
 MicroBitImage MicroBitImage::clone()
 {
-    return MicroBitImage(getWidth(), getHeight(), getBitmap());
+    return MicroBitImage(getWidth(), getHeight(), ptr->data);
 }
\ No newline at end of file
@@ -0,0 +1,537 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 British Broadcasting Corporation.
+This software is provided by Lancaster University by arrangement with the BBC.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+/**
+  * Class definition for a MicroBitPackedImage.
+  *
+  * A MicroBitPackedImage is a black and white bitmap, stored with one bit per pixel.
+  * n.b. This is a mutable, managed type.
+  */
+
+#include "MicroBitConfig.h"
+#include "MicroBitPackedImage.h"
+#include "MicroBitCompat.h"
+#include "ErrorNo.h"
+
+/*
+ * The null image. We cannot allocate a zero-sized image, so every empty
+ * MicroBitPackedImage refers to this read-only instance instead.
+ */
+static const uint16_t empty[] __attribute__ ((aligned (4))) = { 0xffff, 0, 0, 0, };
+
+/**
+  * Reads 32 consecutive pixels from a packed row, starting at the given column.
+  * Columns outside of the row read as clear pixels.
+  *
+  * @param row The first word of the row.
+  *
+  * @param stride The number of words in the row.
+  *
+  * @param x The column of the first pixel to read. May be negative.
+  *
+  * @return The pixels, with column x in the least significant bit.
+  */
+static inline uint32_t read_bits(const uint32_t *row, int stride, int x)
+{
+    int word = x < 0 ? -((31 - x) / 32) : x / 32;
+    int bit = x - word * 32;
+
+    uint32_t lo = (word >= 0 && word < stride) ? row[word] : 0;
+
+    if (bit == 0)
+        return lo;
+
+    uint32_t hi = (word + 1 >= 0 && word + 1 < stride) ? row[word + 1] : 0;
+
+    return (lo >> bit) | (hi << (32 - bit));
+}
+
+/**
+  * Calculates a mask of the pixels in a given word of a row that lie within the given columns.
+  *
+  * @param word The index of the word in the row.
+  *
+  * @param start The first column to include.
+  *
+  * @param end The column after the last one to include.
+  *
+  * @return The mask, which is zero if no columns of the word lie in the range.
+  */
+static inline uint32_t column_mask(int word, int start, int end)
+{
+    int lo = start - word * 32;
+    int hi = end - word * 32;
+
+    if (lo < 0)
+        lo = 0;
+
+    if (hi > 32)
+        hi = 32;
+
+    if (lo >= hi)
+        return 0;
+
+    uint32_t mask = hi == 32 ? 0xFFFFFFFF : (1UL << hi) - 1;
+
+    return mask & ~((1UL << lo) - 1);
+}
+
+/**
+  * Counts the number of set bits in the given word.
+  */
+static inline int count_bits(uint32_t v)
+{
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+/**
+  * Default Constructor.
+  * Creates a new, empty image with no pixels.
+  */
+MicroBitPackedImage::MicroBitPackedImage()
+{
+    ptr = (PackedImageData*)(void*)empty;
+}
+
+/**
+  * Constructor.
+  * Create a blank bitmap representation of a given size.
+  *
+  * @param x the width of the image.
+  *
+  * @param y the height of the image.
+  */
+MicroBitPackedImage::MicroBitPackedImage(const int16_t x, const int16_t y)
+{
+    this->init(x,y);
+}
+
+/**
+  * Constructor.
+  * Create a packed copy of a MicroBitImage. Any pixel with a non-zero brightness is set.
+  *
+  * @param image The MicroBitImage to copy.
+  *
+  * @code
+  * MicroBitImage i("0,1,0,1,0\n1,0,1,0,1\n0,1,0,1,0\n1,0,1,0,1\n0,1,0,1,0\n"); // 5x5 image
+  * MicroBitPackedImage p(i);
+  * @endcode
+  */
+MicroBitPackedImage::MicroBitPackedImage(MicroBitImage image)
+{
+    this->init(image.getWidth(), image.getHeight());
+
+    uint32_t *row = ptr->data;
+
+    for (int y = 0; y < getHeight(); y++)
+    {
+        for (int x = 0; x < getWidth(); x++)
+            if (image.getPixelValue(x, y))
+                row[x / 32] |= 1UL << (x % 32);
+
+        row += getStride();
+    }
+}
+
+/**
+  * Copy Constructor.
+  * Add ourselves as a reference to an existing MicroBitPackedImage.
+  *
+  * @param image The MicroBitPackedImage to reference.
+  */
+MicroBitPackedImage::MicroBitPackedImage(const MicroBitPackedImage &image)
+{
+    ptr = image.ptr;
+    ptr->incr();
+}
+
+/**
+  * Destructor.
+  *
+  * Removes buffer resources held by the instance.
+  */
+MicroBitPackedImage::~MicroBitPackedImage()
+{
+    ptr->decr();
+}
+
+/**
+  * Internal constructor which provides sanity checking and initialises class properties.
+  *
+  * @param x the width of the image
+  *
+  * @param y the height of the image
+  */
+void MicroBitPackedImage::init(const int16_t x, const int16_t y)
+{
+    //sanity check size of image - you cannot have a negative sizes
+    if(x < 0 || y < 0)
+    {
+        ptr = (PackedImageData*)(void*)empty;
+        return;
+    }
+
+    ptr = (PackedImageData*)malloc(sizeof(PackedImageData) + ((x + 31) / 32) * y * sizeof(uint32_t));
+    ptr->init();
+    ptr->width = x;
+    ptr->height = y;
+
+    this->clear();
+}
+
+/**
+  * Copy assign operation.
+  *
+  * Decrement our reference count and free up the buffer as necessary,
+  * then refer to the buffer of the supplied MicroBitPackedImage.
+  *
+  * @param i The MicroBitPackedImage to reference.
+  */
+MicroBitPackedImage& MicroBitPackedImage::operator = (const MicroBitPackedImage& i)
+{
+    if(ptr == i.ptr)
+        return *this;
+
+    ptr->decr();
+    ptr = i.ptr;
+    ptr->incr();
+
+    return *this;
+}
+
+/**
+  * Equality operation.
+  *
+  * @param i The MicroBitPackedImage to test ourselves against.
+  *
+  * @return true if this MicroBitPackedImage is identical to the one supplied, false otherwise.
+  */
+bool MicroBitPackedImage::operator== (const MicroBitPackedImage& i)
+{
+    if (ptr == i.ptr)
+        return true;
+
+    // Padding bits are always clear, so whole rows can be compared directly.
+    return (ptr->width == i.ptr->width && ptr->height == i.ptr->height &&
+            memcmp(ptr->data, i.ptr->data, getStride() * getHeight() * sizeof(uint32_t)) == 0);
+}
+
+/**
+  * Resets all pixels in this image to 0.
+  */
+void MicroBitPackedImage::clear()
+{
+    memclr(ptr->data, getStride() * getHeight() * sizeof(uint32_t));
+}
+
+/**
+  * Sets the pixel at the given co-ordinates.
+  *
+  * @param x The co-ordinate of the pixel to change.
+  *
+  * @param y The co-ordinate of the pixel to change.
+  *
+  * @param value Non-zero to set the pixel, or 0 to clear it.
+  *
+  * @return MICROBIT_OK, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitPackedImage::setPixelValue(int16_t x , int16_t y, uint8_t value)
+{
+    //sanity check
+    if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    uint32_t *word = ptr->data + y * getStride() + x / 32;
+
+    if (value)
+        *word |= 1UL << (x % 32);
+    else
+        *word &= ~(1UL << (x % 32));
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Retrieves the value of a given pixel.
+  *
+  * @param x The x co-ordinate of the pixel to read. Must be within the dimensions of the image.
+  *
+  * @param y The y co-ordinate of the pixel to read. Must be within the dimensions of the image.
+  *
+  * @return 255 if the pixel is set, 0 if it is clear, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitPackedImage::getPixelValue(int16_t x , int16_t y)
+{
+    //sanity check
+    if(x >= getWidth() || y >= getHeight() || x < 0 || y < 0)
+        return MICROBIT_INVALID_PARAMETER;
+
+    return (ptr->data[y * getStride() + x / 32] & (1UL << (x % 32))) ? 255 : 0;
+}
+
+/**
+  * Pastes a given bitmap at the given co-ordinates.
+  *
+  * Any pixels in the relevant area of this image are replaced.
+  *
+  * @param image The MicroBitPackedImage to paste.
+  *
+  * @param x The leftmost X co-ordinate in this image where the given image should be pasted. Defaults to 0.
+  *
+  * @param y The uppermost Y co-ordinate in this image where the given image should be pasted. Defaults to 0.
+  *
+  * @param alpha set to 1 if clear pixels in given image should be treated as transparent. Set to 0 otherwise. Defaults to 0.
+  *
+  * @return The number of pixels written.
+  */
+int MicroBitPackedImage::paste(const MicroBitPackedImage &image, int16_t x, int16_t y, uint8_t alpha)
+{
+    int pxWritten = 0;
+
+    // Sanity check.
+    // We permit writes that overlap us, but ones that are clearly out of scope we can filter early.
+    if (x >= getWidth() || y >= getHeight() || x+image.getWidth() <= 0 || y+image.getHeight() <= 0)
+        return 0;
+
+    // Calculate the region of this image that we will write to.
+    int startx = max(x, 0);
+    int endx = min(x + image.getWidth(), getWidth());
+    int starty = max(y, 0);
+    int endy = min(y + image.getHeight(), getHeight());
+
+    int stride = getStride();
+    int imageStride = image.getStride();
+
+    for (int row = starty; row < endy; row++)
+    {
+        uint32_t *pOut = ptr->data + row * stride;
+        const uint32_t *pIn = image.ptr->data + (row - y) * imageStride;
+
+        for (int w = startx / 32; w <= (endx - 1) / 32; w++)
+        {
+            uint32_t mask = column_mask(w, startx, endx);
+            uint32_t bits = read_bits(pIn, imageStride, w * 32 - x) & mask;
+
+            // Copy the bits in this word, either merging with or replacing what is already there.
+            if (alpha)
+            {
+                pOut[w] |= bits;
+                pxWritten += count_bits(bits);
+            }
+            else
+            {
+                pOut[w] = (pOut[w] & ~mask) | bits;
+                pxWritten += count_bits(mask);
+            }
+        }
+    }
+
+    return pxWritten;
+}
+
+/**
+  * Shifts the pixels in this Image a given number of pixels to the left.
+  *
+  * @param n The number of pixels to shift.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitPackedImage::shiftLeft(int16_t n)
+{
+    if (n <= 0 )
+        return MICROBIT_INVALID_PARAMETER;
+
+    if(n >= getWidth())
+    {
+        clear();
+        return MICROBIT_OK;
+    }
+
+    int stride = getStride();
+    uint32_t *row = ptr->data;
+
+    for (int y = 0; y < getHeight(); y++)
+    {
+        // Each word only depends on itself and those to its right, so we can work left to right in place.
+        // Padding bits are clear, so blank columns shift in from the right for free.
+        for (int w = 0; w < stride; w++)
+            row[w] = read_bits(row, stride, w * 32 + n);
+
+        row += stride;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Shifts the pixels in this Image a given number of pixels to the right.
+  *
+  * @param n The number of pixels to shift.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitPackedImage::shiftRight(int16_t n)
+{
+    if (n <= 0 )
+        return MICROBIT_INVALID_PARAMETER;
+
+    if(n >= getWidth())
+    {
+        clear();
+        return MICROBIT_OK;
+    }
+
+    int stride = getStride();
+    uint32_t padding = column_mask(stride - 1, 0, getWidth());
+    uint32_t *row = ptr->data;
+
+    for (int y = 0; y < getHeight(); y++)
+    {
+        // Each word only depends on itself and those to its left, so we work right to left in place.
+        for (int w = stride - 1; w >= 0; w--)
+            row[w] = read_bits(row, stride, w * 32 - n);
+
+        // Discard any pixels that were shifted off the right edge, into the padding.
+        row[stride - 1] &= padding;
+        row += stride;
+    }
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Shifts the pixels in this Image a given number of pixels upward.
+  *
+  * @param n The number of pixels to shift.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitPackedImage::shiftUp(int16_t n)
+{
+    if (n <= 0 )
+        return MICROBIT_INVALID_PARAMETER;
+
+    if(n >= getHeight())
+    {
+        clear();
+        return MICROBIT_OK;
+    }
+
+    int rowSize = getStride() * sizeof(uint32_t);
+    int pixels = rowSize * (getHeight() - n);
+    uint8_t *p = (uint8_t *)ptr->data;
+
+    memmove(p, p + rowSize * n, pixels);
+    memclr(p + pixels, rowSize * n);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Shifts the pixels in this Image a given number of pixels downward.
+  *
+  * @param n The number of pixels to shift.
+  *
+  * @return MICROBIT_OK on success, or MICROBIT_INVALID_PARAMETER.
+  */
+int MicroBitPackedImage::shiftDown(int16_t n)
+{
+    if (n <= 0 )
+        return MICROBIT_INVALID_PARAMETER;
+
+    if(n >= getHeight())
+    {
+        clear();
+        return MICROBIT_OK;
+    }
+
+    int rowSize = getStride() * sizeof(uint32_t);
+    uint8_t *p = (uint8_t *)ptr->data;
+
+    memmove(p + rowSize * n, p, rowSize * (getHeight() - n));
+    memclr(p, rowSize * n);
+
+    return MICROBIT_OK;
+}
+
+/**
+  * Returns a new image, containing the given region of this image.
+  *
+  * @param startx the leftmost column of the region.
+  *
+  * @param starty the uppermost row of the region.
+  *
+  * @param cropWidth the width of the region.
+  *
+  * @param cropHeight the height of the region.
+  *
+  * @return a new MicroBitPackedImage, clipped to the bounds of this image.
+  */
+MicroBitPackedImage MicroBitPackedImage::crop(int startx, int starty, int cropWidth, int cropHeight)
+{
+    int endx = min(startx + cropWidth, getWidth());
+    int endy = min(starty + cropHeight, getHeight());
+
+    startx = max(startx, 0);
+    starty = max(starty, 0);
+
+    if (endx <= startx || endy <= starty)
+        return MicroBitPackedImage();
+
+    MicroBitPackedImage cropped(endx - startx, endy - starty);
+    cropped.paste(*this, -startx, -starty);
+
+    return cropped;
+}
+
+/**
+  * Converts this image to a MicroBitImage, with set pixels at full brightness.
+  *
+  * @return a new MicroBitImage of the same size.
+  *
+  * @code
+  * MicroBitPackedImage p(5,5);
+  * p.setPixelValue(2,2,1);
+  * uBit.display.print(p.toImage());
+  * @endcode
+  */
+MicroBitImage MicroBitPackedImage::toImage()
+{
+    MicroBitImage image(getWidth(), getHeight());
+
+    uint8_t *pOut = image.getBitmap();
+    uint32_t *row = ptr->data;
+
+    for (int y = 0; y < getHeight(); y++)
+    {
+        for (int x = 0; x < getWidth(); x++)
+            *pOut++ = (row[x / 32] & (1UL << (x % 32))) ? 255 : 0;
+
+        row += getStride();
+    }
+
+    return image;
+}
@@ -30,7 +30,7 @@ DEALINGS IN THE SOFTWARE.
 #include "mbed.h"
 #include "MicroBitConfig.h"
 #include "RefCounted.h"
-#include "MicroBitDisplay.h"
+#include "ErrorNo.h"
 
 /**
   * Initializes for one outstanding reference.
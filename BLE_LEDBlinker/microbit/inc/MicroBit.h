@@ -33,12 +33,15 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitDevice.h"
 #include "ErrorNo.h"
 #include "MicroBitSystemTimer.h"
+#include "Matrix.h"
 #include "Matrix4.h"
 #include "MicroBitCompat.h"
+#include "MicroBitFixedMath.h"
 #include "MicroBitComponent.h"
 #include "ManagedType.h"
 #include "ManagedString.h"
 #include "MicroBitImage.h"
+#include "MicroBitPackedImage.h"
 #include "MicroBitFont.h"
 #include "MicroBitEvent.h"
 #include "DynamicPwm.h"
@@ -55,6 +58,7 @@ DEALINGS IN THE SOFTWARE.
 #include "MicroBitMultiButton.h"
 
 #include "MicroBitSerial.h"
+#include "MicroBitSerialFramer.h"
 #include "MicroBitIO.h"
 #include "MicroBitMatrixMaps.h"
 #include "MicroBitDisplay.h"